@@ -1,6 +1,8 @@
 #ifndef GLTFMATERIAL_GLSL
 #define GLTFMATERIAL_GLSL 1
 
+#include "vertex.glsl"
+
 void getMetallicRoughness(inout State state, in GltfMaterial material)
 {
     // KHR_materials_ior
@@ -112,8 +114,9 @@ void getMaterialsAndTextures(inout State state, inout GltfMaterial material)
     // Perturbating the normal if a normal map is present
     if(material.normalTexture > -1)
     {
-        vec3 normalVector = texture(textureSampler[nonuniformEXT(material.normalTexture)], state.texCoord).xyz;
-        normalVector = normalize(normalVector * 2.0 - 1.0);
+        // Only xy is read, cooked normal maps are BC5 and hold no z
+        vec2 normalXY = texture(textureSampler[nonuniformEXT(material.normalTexture)], state.texCoord).xy * 2.0 - 1.0;
+        vec3 normalVector = vec3(normalXY, sqrt(max(0.0, 1.0 - dot(normalXY, normalXY))));
         normalVector *= vec3(material.normalTextureScale, material.normalTextureScale, 1.0);
         state.normal = normalize(TBN * normalVector);
     }
@@ -160,18 +163,35 @@ void getMaterialsAndTextures(inout State state, inout GltfMaterial material)
     state.mat.clearcoatRoughness = max(state.mat.clearcoatRoughness, 0.001);
 }
 
+// Indices of a triangle, the index buffer holds 16 or 32 bit indices
+uvec3 getTriangleIndices(ObjDesc objResource, int primitiveID)
+{
+    if(objResource.indexSize == 2)
+    {
+        Indices16 indices = Indices16(objResource.indexAddress);
+        uint first = uint(primitiveID) * 3u;
+        uvec3 ind;
+        for(uint k = 0u; k < 3u; ++k)
+        {
+            uint i = first + k;
+            ind[k] = (indices.i[i >> 1u] >> ((i & 1u) * 16u)) & 0xFFFFu;
+        }
+        return ind;
+    }
+    return uvec3(Indices(objResource.indexAddress).i[primitiveID]);
+}
+
 void getShadeState(inout State state, HitPayload prd) {
     ObjDesc objResource = objDesc.i[prd.instanceCustomIndex];
     MatIndices matIndices = MatIndices(objResource.materialIndexAddress);
     Materials materials = Materials(objResource.materialAddress);
     
-    Indices indices = Indices(objResource.indexAddress);
     Vertices vertices = Vertices(objResource.vertexAddress);
 
     state.matId = matIndices.i[prd.primitiveID];
 
     // Indices of the triangle
-    ivec3 ind = indices.i[prd.primitiveID];
+    uvec3 ind = getTriangleIndices(objResource, prd.primitiveID);
   
     // Vertex of the triangle
     Vertex v0 = vertices.v[ind.x];
@@ -184,14 +204,16 @@ void getShadeState(inout State state, HitPayload prd) {
     const vec3 pos = v0.pos * barycentrics.x + v1.pos * barycentrics.y + v2.pos * barycentrics.z;
     const vec3 worldPos = vec3(prd.objectToWorld * vec4(pos, 1.0));  // Transforming the position to world space
     // Normal
-    const vec3 nrm = normalize(v0.normal * barycentrics.x + v1.normal * barycentrics.y + v2.normal * barycentrics.z);
+    const vec3 n0 = decodeNormal(v0), n1 = decodeNormal(v1), n2 = decodeNormal(v2);
+    const vec3 nrm = normalize(n0 * barycentrics.x + n1 * barycentrics.y + n2 * barycentrics.z);
     const vec3 worldNrm = normalize(vec3(nrm * prd.worldToObject));
     // texture coordinate
-    const vec2 texCoord = v0.texCoord * barycentrics.x + v1.texCoord * barycentrics.y + v2.texCoord * barycentrics.z;
+    const vec2 texCoord = decodeTexCoord(v0) * barycentrics.x + decodeTexCoord(v1) * barycentrics.y + decodeTexCoord(v2) * barycentrics.z;
     // Tangent & Bitangent
-    const vec3 tangent = normalize(v0.tangent * barycentrics.x + v1.tangent * barycentrics.y + v2.tangent * barycentrics.z);
+    const vec4 t0 = decodeTangent(v0), t1 = decodeTangent(v1), t2 = decodeTangent(v2);
+    const vec3 tangent = normalize(t0.xyz * barycentrics.x + t1.xyz * barycentrics.y + t2.xyz * barycentrics.z);
     vec3 worldTangent = normalize(vec3(tangent * prd.worldToObject));
-    const vec3 bitangent = normalize(v0.bitangent * barycentrics.x + v1.bitangent * barycentrics.y + v2.bitangent * barycentrics.z);
+    const vec3 bitangent = normalize(decodeBitangent(nrm, tangent, t0.w));
     vec3 worldBitangent = normalize(vec3(bitangent * prd.worldToObject));
 
     state.position = worldPos;
@@ -78,6 +78,7 @@ struct PointLight {
 struct ObjDesc
 {
 	int      txtOffset;             // Texture index offset in the array of textures
+	int      indexSize;             // Bytes per index, 2 or 4
 	uint64_t vertexAddress;         // Address of the Vertex buffer
 	uint64_t indexAddress;          // Address of the index buffer
 	uint64_t materialAddress;       // Address of the material buffer
@@ -175,13 +176,12 @@ struct PushConstantPost
     float exposure;
 };
 
-struct Vertex  // See ObjLoader, copy of VertexObj, could be compressed for device
+struct Vertex  // Packed device vertex, see PackedVertex in src/Vertex.h and vertex.glsl
 {
 	vec3 pos;
-	vec3 normal;
-	vec2 texCoord;
-	vec3 tangent;
-	vec3 bitangent;
+	uint normal;    // octahedral, 2x snorm16
+	uint tangent;   // octahedral xy, handedness w, 4x snorm8
+	uint texCoord;  // 2x half
 };
 
 #define ALPHA_OPAQUE 0
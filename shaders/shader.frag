@@ -17,6 +17,7 @@ layout(push_constant) uniform PushConstants {
 
 layout(buffer_reference, scalar) buffer Vertices { Vertex v[]; }; // Positions of an object
 layout(buffer_reference, scalar) buffer Indices { ivec3 i[]; }; // Triangle indices
+layout(buffer_reference, scalar) buffer Indices16 { uint i[]; }; // 16-bit triangle indices, two per uint
 layout(buffer_reference, scalar) buffer Materials { GltfMaterial m[]; }; // Array of all materials on an object
 layout(buffer_reference, scalar) buffer MatIndices { int i[]; }; // Material ID for each triangle
 
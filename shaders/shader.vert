@@ -6,6 +6,7 @@
 #extension GL_EXT_shader_explicit_arithmetic_types_int64 : require
 
 #include "host_device.h"
+#include "vertex.glsl"
 
 layout(push_constant) uniform PushConstants {
     PushConstantRaster constants;
@@ -20,10 +21,9 @@ layout(set = 0, binding = eObjData, scalar) readonly buffer ObjectBuffer {
 } objectBuffer;
 
 layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inNormal;
+layout(location = 1) in vec2 inNormal;   // octahedral
 layout(location = 2) in vec2 inTexCoord;
-layout(location = 3) in vec3 inTangent;
-layout(location = 4) in vec3 inBitangent;
+layout(location = 3) in vec4 inTangent;  // octahedral xy, handedness w
 
 layout(location = 0) out vec3 fragNormal;
 layout(location = 1) out vec2 fragTexCoord;
@@ -37,10 +37,12 @@ void main() {
 
     gl_Position = globalUniform.global.proj * globalUniform.global.view * model * vec4(inPosition, 1.0);
     mat3 normalMatrix = mat3(transpose(inverse(model)));
-    fragNormal = normalMatrix * inNormal;
+    vec3 normal = octDecode(inNormal);
+    vec3 tangent = octDecode(inTangent.xy);
+    fragNormal = normalMatrix * normal;
     fragTexCoord = inTexCoord;
     fragPos = (model * vec4(inPosition, 1.0)).rgb;
 
-    fragTangent = normalMatrix * inTangent;
-    fragBitangent = normalMatrix * inBitangent;
+    fragTangent = normalMatrix * tangent;
+    fragBitangent = normalMatrix * decodeBitangent(normal, tangent, inTangent.w);
 }
\ No newline at end of file
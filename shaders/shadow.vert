@@ -24,10 +24,9 @@ layout(set = 1, binding = 2) uniform _ShadowUniform {
 };
 
 layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inNormal;
+layout(location = 1) in vec2 inNormal;   // octahedral
 layout(location = 2) in vec2 inTexCoord;
-layout(location = 3) in vec3 inTangent;
-layout(location = 4) in vec3 inBitangent;
+layout(location = 3) in vec4 inTangent;  // octahedral xy, handedness w
 
 layout(location = 0) out VS_OUT {
     vec2 fragCoord;
@@ -12,10 +12,9 @@ layout(set = 0, binding = eGlobals, scalar) uniform GlobalUnifrom {
 };
 
 layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inNormal;
+layout(location = 1) in vec2 inNormal;   // octahedral
 layout(location = 2) in vec2 inTexCoord;
-layout(location = 3) in vec3 inTangent;
-layout(location = 4) in vec3 inBitangent;
+layout(location = 3) in vec4 inTangent;  // octahedral xy, handedness w
 
 layout(location = 0) out vec3 fragCoord;
 
@@ -0,0 +1,39 @@
+#ifndef VERTEX_GLSL
+#define VERTEX_GLSL 1
+
+// Decoding of the packed Vertex from host_device.h
+
+vec3 octDecode(vec2 e)
+{
+    vec3 v = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    if(v.z < 0.0)
+    {
+        vec2 signs = vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+        v.xy = (1.0 - abs(v.yx)) * signs;
+    }
+    return normalize(v);
+}
+
+// tangent.xy is the octahedral tangent, tangent.w the bitangent handedness
+vec3 decodeBitangent(vec3 normal, vec3 tangent, float handedness)
+{
+    return cross(normal, tangent) * (handedness < 0.0 ? -1.0 : 1.0);
+}
+
+vec3 decodeNormal(Vertex v)
+{
+    return octDecode(unpackSnorm2x16(v.normal));
+}
+
+vec4 decodeTangent(Vertex v)
+{
+    vec4 t = unpackSnorm4x8(v.tangent);
+    return vec4(octDecode(t.xy), t.w);
+}
+
+vec2 decodeTexCoord(Vertex v)
+{
+    return unpackHalf2x16(v.texCoord);
+}
+
+#endif
@@ -18,8 +18,8 @@ const float CameraConstVariable::ZNEAR = 0.1f;
 const float CameraConstVariable::ZFAR = 100.0f;
 
 BaseCamera::BaseCamera(glm::vec3 position, glm::vec3 up, float yaw, float pitch, float roll) :
-	position{ position }, up{ up }, yaw{ yaw }, pitch{ pitch }, roll{ roll },
-	front{ CameraConstVariable::FRONT }, speed{ CameraConstVariable::SPEED }, sensitivity{ CameraConstVariable::SENSITIVITY }, zoom{ CameraConstVariable::ZOOM },
+	position{ position }, front{ CameraConstVariable::FRONT }, up{ up }, yaw{ yaw }, pitch{ pitch }, roll{ roll },
+	speed{ CameraConstVariable::SPEED }, sensitivity{ CameraConstVariable::SENSITIVITY }, zoom{ CameraConstVariable::ZOOM },
 	zNear{ CameraConstVariable::ZNEAR }, zFar{ CameraConstVariable::ZFAR }
 {
 	right = glm::normalize(glm::cross(front, up));
@@ -28,9 +28,9 @@ BaseCamera::BaseCamera(glm::vec3 position, glm::vec3 up, float yaw, float pitch,
 
 void BaseCamera::setOtherArgument(float speed, float sensitivity, float zoom)
 {
-	speed = speed;
-	sensitivity = sensitivity;
-	zoom = zoom;
+	this->speed = speed;
+	this->sensitivity = sensitivity;
+	this->zoom = zoom;
 }
 
 void BaseCamera::move(CameraDirection direction, float deltaTime)
@@ -46,7 +46,7 @@ void BaseCamera::move(CameraDirection direction, float deltaTime)
 	}
 }
 
-void BaseCamera::rotate(float dyaw, float dpitch, float droll)
+void BaseCamera::rotate(float /*dyaw*/, float /*dpitch*/, float /*droll*/)
 {
 
 }
@@ -0,0 +1,158 @@
+#include "GLTFConvert.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GLTF_CONVERT_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define GLTF_CONVERT_NEON
+#include <arm_neon.h>
+#endif
+
+void convertU8ToFloat(const uint8_t* src, float* dst, size_t count)
+{
+	size_t i = 0;
+#if defined(GLTF_CONVERT_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= count; i += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		__m128i lo = _mm_unpacklo_epi8(v, zero);
+		__m128i hi = _mm_unpackhi_epi8(v, zero);
+		_mm_storeu_ps(dst + i + 0, _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)));
+		_mm_storeu_ps(dst + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)));
+		_mm_storeu_ps(dst + i + 8, _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)));
+		_mm_storeu_ps(dst + i + 12, _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)));
+	}
+#elif defined(GLTF_CONVERT_NEON)
+	for (; i + 16 <= count; i += 16) {
+		uint8x16_t v = vld1q_u8(src + i);
+		uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+		uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+		vst1q_f32(dst + i + 0, vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))));
+		vst1q_f32(dst + i + 4, vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))));
+		vst1q_f32(dst + i + 8, vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))));
+		vst1q_f32(dst + i + 12, vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))));
+	}
+#endif
+	for (; i < count; ++i)
+		dst[i] = static_cast<float>(src[i]);
+}
+
+void convertI8ToFloat(const int8_t* src, float* dst, size_t count)
+{
+	size_t i = 0;
+#if defined(GLTF_CONVERT_SSE2)
+	for (; i + 16 <= count; i += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		// place each byte in the top of its lane, then shift back with sign extension
+		__m128i lo = _mm_unpacklo_epi8(v, v);
+		__m128i hi = _mm_unpackhi_epi8(v, v);
+		_mm_storeu_ps(dst + i + 0, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 24)));
+		_mm_storeu_ps(dst + i + 4, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 24)));
+		_mm_storeu_ps(dst + i + 8, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 24)));
+		_mm_storeu_ps(dst + i + 12, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 24)));
+	}
+#elif defined(GLTF_CONVERT_NEON)
+	for (; i + 16 <= count; i += 16) {
+		int8x16_t v = vld1q_s8(src + i);
+		int16x8_t lo = vmovl_s8(vget_low_s8(v));
+		int16x8_t hi = vmovl_s8(vget_high_s8(v));
+		vst1q_f32(dst + i + 0, vcvtq_f32_s32(vmovl_s16(vget_low_s16(lo))));
+		vst1q_f32(dst + i + 4, vcvtq_f32_s32(vmovl_s16(vget_high_s16(lo))));
+		vst1q_f32(dst + i + 8, vcvtq_f32_s32(vmovl_s16(vget_low_s16(hi))));
+		vst1q_f32(dst + i + 12, vcvtq_f32_s32(vmovl_s16(vget_high_s16(hi))));
+	}
+#endif
+	for (; i < count; ++i)
+		dst[i] = static_cast<float>(src[i]);
+}
+
+void convertU16ToFloat(const uint16_t* src, float* dst, size_t count)
+{
+	size_t i = 0;
+#if defined(GLTF_CONVERT_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 8 <= count; i += 8) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		_mm_storeu_ps(dst + i + 0, _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero)));
+		_mm_storeu_ps(dst + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero)));
+	}
+#elif defined(GLTF_CONVERT_NEON)
+	for (; i + 8 <= count; i += 8) {
+		uint16x8_t v = vld1q_u16(src + i);
+		vst1q_f32(dst + i + 0, vcvtq_f32_u32(vmovl_u16(vget_low_u16(v))));
+		vst1q_f32(dst + i + 4, vcvtq_f32_u32(vmovl_u16(vget_high_u16(v))));
+	}
+#endif
+	for (; i < count; ++i)
+		dst[i] = static_cast<float>(src[i]);
+}
+
+void convertI16ToFloat(const int16_t* src, float* dst, size_t count)
+{
+	size_t i = 0;
+#if defined(GLTF_CONVERT_SSE2)
+	for (; i + 8 <= count; i += 8) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		_mm_storeu_ps(dst + i + 0, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16)));
+		_mm_storeu_ps(dst + i + 4, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16)));
+	}
+#elif defined(GLTF_CONVERT_NEON)
+	for (; i + 8 <= count; i += 8) {
+		int16x8_t v = vld1q_s16(src + i);
+		vst1q_f32(dst + i + 0, vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))));
+		vst1q_f32(dst + i + 4, vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))));
+	}
+#endif
+	for (; i < count; ++i)
+		dst[i] = static_cast<float>(src[i]);
+}
+
+void convertU8ToU32(const uint8_t* src, uint32_t* dst, size_t count)
+{
+	size_t i = 0;
+#if defined(GLTF_CONVERT_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= count; i += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		__m128i lo = _mm_unpacklo_epi8(v, zero);
+		__m128i hi = _mm_unpackhi_epi8(v, zero);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 0), _mm_unpacklo_epi16(lo, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(lo, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpacklo_epi16(hi, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 12), _mm_unpackhi_epi16(hi, zero));
+	}
+#elif defined(GLTF_CONVERT_NEON)
+	for (; i + 16 <= count; i += 16) {
+		uint8x16_t v = vld1q_u8(src + i);
+		uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+		uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+		vst1q_u32(dst + i + 0, vmovl_u16(vget_low_u16(lo)));
+		vst1q_u32(dst + i + 4, vmovl_u16(vget_high_u16(lo)));
+		vst1q_u32(dst + i + 8, vmovl_u16(vget_low_u16(hi)));
+		vst1q_u32(dst + i + 12, vmovl_u16(vget_high_u16(hi)));
+	}
+#endif
+	for (; i < count; ++i)
+		dst[i] = src[i];
+}
+
+void convertU16ToU32(const uint16_t* src, uint32_t* dst, size_t count)
+{
+	size_t i = 0;
+#if defined(GLTF_CONVERT_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 8 <= count; i += 8) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 0), _mm_unpacklo_epi16(v, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(v, zero));
+	}
+#elif defined(GLTF_CONVERT_NEON)
+	for (; i + 8 <= count; i += 8) {
+		uint16x8_t v = vld1q_u16(src + i);
+		vst1q_u32(dst + i + 0, vmovl_u16(vget_low_u16(v)));
+		vst1q_u32(dst + i + 4, vmovl_u16(vget_high_u16(v)));
+	}
+#endif
+	for (; i < count; ++i)
+		dst[i] = src[i];
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Widening kernels for tightly packed accessor data.
+// count is the number of components, src may be unaligned.
+// Values are converted as-is, the normalized flag is not applied.
+
+void convertU8ToFloat(const uint8_t* src, float* dst, size_t count);
+void convertI8ToFloat(const int8_t* src, float* dst, size_t count);
+void convertU16ToFloat(const uint16_t* src, float* dst, size_t count);
+void convertI16ToFloat(const int16_t* src, float* dst, size_t count);
+
+void convertU8ToU32(const uint8_t* src, uint32_t* dst, size_t count);
+void convertU16ToU32(const uint16_t* src, uint32_t* dst, size_t count);
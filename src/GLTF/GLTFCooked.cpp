@@ -0,0 +1,418 @@
+#include "GLTFCooked.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+
+#include "Utils/Hash.h"
+#include "Utils/MappedFile.h"
+
+namespace {
+	const char COOKED_MAGIC[8] = { 'V', 'K', 'S', 'C', 'O', 'O', 'K', 'D' };
+
+	static_assert(std::is_trivially_copyable_v<Vertex>, "Vertex is written as raw bytes");
+	static_assert(std::is_trivially_copyable_v<GltfMaterial>, "GltfMaterial is written as raw bytes");
+	static_assert(std::is_trivially_copyable_v<TransformComponent>, "TransformComponent is written as raw bytes");
+	static_assert(std::is_trivially_copyable_v<MeshletBounds>, "MeshletBounds is written as raw bytes");
+	static_assert(std::is_trivially_copyable_v<ModelLight>, "ModelLight is written as raw bytes");
+
+	struct CookedHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t vertexSize;
+		uint32_t materialSize;
+		uint32_t transformSize;
+		uint64_t sourceStamp;
+		uint64_t sourceHash;
+		uint32_t geometryNum;
+		uint32_t modelNum;
+	};
+
+	CookedHeader makeHeader(uint64_t sourceStamp, uint64_t sourceHash, uint32_t geometryNum, uint32_t modelNum)
+	{
+		CookedHeader header{};
+		memcpy(header.magic, COOKED_MAGIC, sizeof(COOKED_MAGIC));
+		header.version = COOKED_GEOMETRY_VERSION;
+		header.vertexSize = sizeof(Vertex);
+		header.materialSize = sizeof(GltfMaterial);
+		header.transformSize = sizeof(TransformComponent);
+		header.sourceStamp = sourceStamp;
+		header.sourceHash = sourceHash;
+		header.geometryNum = geometryNum;
+		header.modelNum = modelNum;
+		return header;
+	}
+
+	// Reads the file straight into the arrays it fills. A mapping would be copied out of
+	// just the same, and its pages would add to the peak memory of the load.
+	class CookedReader
+	{
+	public:
+		explicit CookedReader(const std::string& filename) : in{ filename, std::ios::binary }
+		{
+			if (in.seekg(0, std::ios::end))
+				remaining = static_cast<size_t>(in.tellg());
+			in.seekg(0, std::ios::beg);
+		}
+
+		bool good() const { return in.good(); }
+		void close() { in.close(); }
+
+		bool read(void* dst, size_t size)
+		{
+			if (remaining < size || !in.read(reinterpret_cast<char*>(dst), size))
+				return false;
+			remaining -= size;
+			return true;
+		}
+
+		template<class T>
+		bool read(T& value) { return read(&value, sizeof(T)); }
+
+		template<class T>
+		bool readVector(std::vector<T>& vec)
+		{
+			uint64_t num;
+			if (!read(num) || num > remaining / sizeof(T))
+				return false;
+			vec.resize(num);
+			return read(vec.data(), num * sizeof(T));
+		}
+
+		bool readString(std::string& str)
+		{
+			uint32_t length;
+			if (!read(length) || length > remaining)
+				return false;
+			str.resize(length);
+			return read(str.data(), length);
+		}
+
+	private:
+		std::ifstream in;
+		size_t remaining{ 0 };
+	};
+
+	class CookedWriter
+	{
+	public:
+		explicit CookedWriter(const std::string& filename) : out{ filename, std::ios::binary | std::ios::trunc } {}
+
+		bool good() const { return out.good(); }
+
+		void write(const void* data, size_t size) { out.write(reinterpret_cast<const char*>(data), size); }
+
+		template<class T>
+		void write(const T& value) { write(&value, sizeof(T)); }
+
+		template<class T>
+		void writeVector(const std::vector<T>& vec)
+		{
+			write(uint64_t(vec.size()));
+			write(vec.data(), vec.size() * sizeof(T));
+		}
+
+		void writeString(const std::string& str)
+		{
+			write(uint32_t(str.size()));
+			write(str.data(), str.size());
+		}
+
+		void close() { out.close(); }
+
+	private:
+		std::ofstream out;
+	};
+
+	enum class EmbeddedKind : uint8_t
+	{
+		None,
+		FileRange,	// Offset and size in a buffer file of the source, mapped again on read
+		Bytes,		// Decoded data uri, stored in the cooked file
+	};
+
+	// Mappings of the buffer files embedded images are read from, each file is mapped once
+	using MappedFiles = std::unordered_map<std::string, std::shared_ptr<const MappedFile>>;
+
+	bool readEmbeddedImage(CookedReader& reader, const std::string& sourceDir, MappedFiles& files, EmbeddedImage& image)
+	{
+		EmbeddedKind kind;
+		if (!reader.read(kind))
+			return false;
+
+		if (kind == EmbeddedKind::Bytes) {
+			auto bytes = std::make_shared<std::vector<uint8_t>>();
+			if (!reader.readVector(*bytes))
+				return false;
+			image.data = bytes->data();
+			image.size = bytes->size();
+			image.owner = std::move(bytes);
+			return true;
+		}
+		if (kind != EmbeddedKind::FileRange)
+			return kind == EmbeddedKind::None;
+
+		uint8_t relative;
+		uint64_t size;
+		if (!reader.read(relative) || !reader.readString(image.file) || !reader.read(image.offset) || !reader.read(size))
+			return false;
+		image.file = relative ? sourceDir + image.file : image.file;
+
+		auto& file = files[image.file];
+		if (!file)
+			file = std::make_shared<MappedFile>(image.file);
+		if (!file->isOpen() || image.offset > file->getSize() || size > file->getSize() - image.offset)
+			return false;
+		image.owner = file;
+		image.data = file->getData() + image.offset;
+		image.size = static_cast<size_t>(size);
+		return true;
+	}
+
+	void writeEmbeddedImage(CookedWriter& writer, const std::string& sourceDir, const EmbeddedImage& image)
+	{
+		if (!image.data) {
+			writer.write(EmbeddedKind::None);
+		}
+		else if (image.file.empty()) {
+			writer.write(EmbeddedKind::Bytes);
+			writer.write(uint64_t(image.size));
+			writer.write(image.data, image.size);
+		}
+		else {
+			writer.write(EmbeddedKind::FileRange);
+			bool relative = image.file.compare(0, sourceDir.size(), sourceDir) == 0;
+			writer.write(uint8_t(relative));
+			writer.writeString(relative ? image.file.substr(sourceDir.size()) : image.file);
+			writer.write(image.offset);
+			writer.write(uint64_t(image.size));
+		}
+	}
+
+	bool readGeometry(CookedReader& reader, const std::string& sourceDir,
+		const std::unordered_map<std::string, std::string>& texturePaths, MappedFiles& files, MeshGeometry& geometry)
+	{
+		uint32_t lodNum;
+		auto& meshlets = geometry.meshlets;
+		if (!reader.readVector(geometry.vertices) || !reader.readVector(geometry.indices) || 
+			!reader.readVector(meshlets.meshlets) || !reader.readVector(meshlets.bounds) ||
+			!reader.readVector(meshlets.vertices) || !reader.readVector(meshlets.triangles) ||
+			!reader.read(geometry.mat) || !reader.read(lodNum) || lodNum > MESH_LOD_MAX_NUM)
+			return false;
+
+		geometry.lods.resize(lodNum);
+		for (auto& lod : geometry.lods) {
+			if (!reader.readVector(lod.indices) || !reader.read(lod.error))
+				return false;
+		}
+
+		uint32_t textureNum;
+		if (!reader.read(textureNum))
+			return false;
+
+		for (uint32_t i = 0; i < textureNum; ++i) {
+			uint32_t type;
+			uint8_t relative;
+			std::string path;
+			EmbeddedImage embedded{};
+			if (!reader.read(type) || !reader.read(relative) || !reader.readString(path) ||
+				!readEmbeddedImage(reader, sourceDir, files, embedded))
+				return false;
+			path = relative ? sourceDir + path : path;
+			auto mapped = texturePaths.find(path);
+			geometry.textures.push_back({ static_cast<TextureType>(type), mapped != texturePaths.end() ? mapped->second : path,
+				std::move(embedded) });
+		}
+		return true;
+	}
+
+	void writeGeometry(CookedWriter& writer, const std::string& sourceDir, const MeshGeometry& geometry)
+	{
+		writer.writeVector(geometry.vertices);
+		writer.writeVector(geometry.indices);
+		writer.writeVector(geometry.meshlets.meshlets);
+		writer.writeVector(geometry.meshlets.bounds);
+		writer.writeVector(geometry.meshlets.vertices);
+		writer.writeVector(geometry.meshlets.triangles);
+		writer.write(geometry.mat);
+
+		writer.write(uint32_t(geometry.lods.size()));
+		for (const auto& lod : geometry.lods) {
+			writer.writeVector(lod.indices);
+			writer.write(lod.error);
+		}
+
+		writer.write(uint32_t(geometry.textures.size()));
+		for (const auto& texture : geometry.textures) {
+			writer.write(uint32_t(texture.type));
+			bool relative = texture.path.compare(0, sourceDir.size(), sourceDir) == 0;
+			writer.write(uint8_t(relative));
+			writer.writeString(relative ? texture.path.substr(sourceDir.size()) : texture.path);
+			writeEmbeddedImage(writer, sourceDir, texture.embedded);
+		}
+	}
+}
+
+std::string getCookedGeometryPath(const std::string& filename, const std::string& cacheDir)
+{
+	if (cacheDir.empty())
+		return filename + ".cooked";
+
+	// Files of the same name from different directories get their own cooked file
+	auto name = std::filesystem::path(filename).filename().string();
+	auto source = std::filesystem::path(filename).lexically_normal().generic_string();
+	char suffix[24];
+	snprintf(suffix, sizeof(suffix), ".%016llx", static_cast<unsigned long long>(hashBytes(source.data(), source.size())));
+	return (std::filesystem::path(cacheDir) / (name + suffix + ".cooked")).string();
+}
+
+bool readCookedGeometry(const std::string& cookedFile, uint64_t sourceStamp, const std::function<uint64_t()>& hashSource,
+	const std::string& sourceDir, std::vector<Model*>& models, const std::unordered_map<std::string, std::string>& texturePaths)
+{
+	CookedReader reader{ cookedFile };
+	if (!reader.good())
+		return false;
+
+	CookedHeader header{};
+	CookedHeader expected = makeHeader(sourceStamp, 0, 0, 0);
+	if (!reader.read(header) || memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 ||
+		header.version != expected.version || header.vertexSize != expected.vertexSize ||
+		header.materialSize != expected.materialSize || header.transformSize != expected.transformSize)
+		return false;
+
+	// Files touched without being changed, e.g. by a checkout, only cost one hash:
+	// the new stamp is written back once the content turns out to match
+	bool restamp = false;
+	if (sourceStamp == 0 || header.sourceStamp != sourceStamp) {
+		uint64_t sourceHash = hashSource();
+		if (sourceHash == 0 || header.sourceHash != sourceHash)
+			return false;
+		restamp = sourceStamp != 0;
+	}
+
+	// Shared geometry table, meshes refer to it by index
+	std::vector<std::shared_ptr<const MeshGeometry>> geometries;
+	MappedFiles embeddedFiles;
+	bool ok = true;
+	for (uint32_t i = 0; ok && i < header.geometryNum; ++i) {
+		auto geometry = std::make_shared<MeshGeometry>();
+		ok = readGeometry(reader, sourceDir, texturePaths, embeddedFiles, *geometry);
+		geometries.push_back(std::move(geometry));
+	}
+
+	std::vector<Model*> result;
+	for (uint32_t i = 0; ok && i < header.modelNum; ++i) {
+		std::string name;
+		TransformComponent transComp{};
+		ModelLight light{};
+		int32_t parentIdx;
+		uint32_t meshNum;
+		ok = reader.readString(name) && reader.read(transComp) && reader.read(light) && reader.read(parentIdx) &&
+			reader.read(meshNum) && parentIdx >= -1 && parentIdx < int32_t(result.size());
+
+		std::vector<Mesh> meshes;
+		for (uint32_t j = 0; ok && j < meshNum; ++j) {
+			uint32_t geometryIdx;
+			TransformComponent meshTransComp{};
+			ok = reader.read(geometryIdx) && reader.read(meshTransComp) && geometryIdx < geometries.size();
+			if (ok)
+				meshes.emplace_back(nullptr, geometries[geometryIdx]).transComp = meshTransComp;
+		}
+
+		if (ok) {
+			auto model = new Model(name, std::move(meshes));
+			model->transComp = transComp;
+			model->light = light;
+			model->parent = parentIdx >= 0 ? result[parentIdx] : nullptr;
+			result.push_back(model);
+		}
+	}
+
+	if (!ok) {
+		for (auto model : result)
+			delete model;
+		return false;
+	}
+
+	models.insert(models.end(), result.begin(), result.end());
+	if (restamp) {
+		reader.close();
+		std::fstream out{ cookedFile, std::ios::binary | std::ios::in | std::ios::out };
+		out.seekp(offsetof(CookedHeader, sourceStamp));
+		out.write(reinterpret_cast<const char*>(&sourceStamp), sizeof(sourceStamp));
+	}
+	return true;
+}
+
+bool writeCookedGeometry(const std::string& cookedFile, uint64_t sourceStamp, uint64_t sourceHash,
+	const std::string& sourceDir, const std::vector<Model*>& models)
+{
+	// Models are stored with the index of their parent, which has to come first
+	std::unordered_map<const Model*, int32_t> modelIndices;
+	std::vector<int32_t> parentIndices;
+	for (auto model : models) {
+		auto parent = model->parent ? modelIndices.find(model->parent) : modelIndices.end();
+		if (model->parent && parent == modelIndices.end())
+			return false;
+		parentIndices.push_back(model->parent ? parent->second : -1);
+		modelIndices.emplace(model, int32_t(parentIndices.size() - 1));
+	}
+
+	std::error_code ec;
+	auto cookedDir = std::filesystem::path(cookedFile).parent_path();
+	if (!cookedDir.empty())
+		std::filesystem::create_directories(cookedDir, ec);
+
+	// Write aside and rename, a reader never sees a half written file
+	std::string tmpFile = cookedFile + ".tmp";
+	{
+		CookedWriter writer{ tmpFile };
+		if (!writer.good())
+			return false;
+
+		// Each shared geometry is written once, in first use order
+		std::unordered_map<const MeshGeometry*, uint32_t> geometryIndices;
+		std::vector<const MeshGeometry*> geometries;
+		for (auto model : models) {
+			for (const auto& mesh : model->getMeshes()) {
+				if (geometryIndices.emplace(mesh.geometry.get(), uint32_t(geometries.size())).second)
+					geometries.push_back(mesh.geometry.get());
+			}
+		}
+
+		writer.write(makeHeader(sourceStamp, sourceHash, static_cast<uint32_t>(geometries.size()), static_cast<uint32_t>(models.size())));
+		for (auto geometry : geometries)
+			writeGeometry(writer, sourceDir, *geometry);
+
+		for (size_t i = 0; i < models.size(); ++i) {
+			auto model = models[i];
+			writer.writeString(model->getName());
+			writer.write(model->transComp);
+			writer.write(model->light);
+			writer.write(parentIndices[i]);
+			writer.write(uint32_t(model->getMeshes().size()));
+
+			for (const auto& mesh : model->getMeshes()) {
+				writer.write(geometryIndices.at(mesh.geometry.get()));
+				writer.write(mesh.transComp);
+			}
+		}
+
+		writer.close();
+		if (!writer.good())
+			return false;
+	}
+
+	std::filesystem::rename(tmpFile, cookedFile, ec);
+	if (ec) {
+		std::filesystem::remove(tmpFile, ec);
+		return false;
+	}
+	return true;
+}
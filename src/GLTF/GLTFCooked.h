@@ -0,0 +1,36 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Model.h"
+
+// Cooked geometry: the Models decoded from a glTF file, stored as raw Vertex,
+// index, LOD, meshlet and GltfMaterial arrays so that a later load only reads them back
+// into place, without parsing or decoding anything.
+// Geometry shared by several nodes is stored once and referenced by index, every Model stores
+// the index of its parent Model and its KHR_lights_punctual light. Images embedded in a buffer
+// file are stored as their range in that file, which the reader maps again, data uris as their bytes.
+// The file is keyed by GltfDocument::stampSource and GltfDocument::hashSource: a matching stamp
+// is trusted as is, the content hash is only computed when the sizes or modification times differ.
+// Any change of the source files or of the struct layouts makes it stale.
+
+// Where the viewer and the tools keep cooked files, relative to the working directory
+constexpr const char* COOKED_CACHE_DIR = "cache";
+
+// Bump whenever the layout written by writeCookedGeometry changes
+constexpr uint32_t COOKED_GEOMETRY_VERSION = 10;
+
+// cacheDir may be empty, the cooked file then sits next to the source
+std::string getCookedGeometryPath(const std::string& filename, const std::string& cacheDir);
+
+// Returns false and leaves models empty if the file is missing, stale or damaged.
+// hashSource is only called when sourceStamp doesn't match the stamp the file was written with.
+// Texture paths are stored relative to sourceDir, those found in texturePaths are replaced by what they map to.
+bool readCookedGeometry(const std::string& cookedFile, uint64_t sourceStamp, const std::function<uint64_t()>& hashSource,
+	const std::string& sourceDir, std::vector<Model*>& models, const std::unordered_map<std::string, std::string>& texturePaths = {});
+
+bool writeCookedGeometry(const std::string& cookedFile, uint64_t sourceStamp, uint64_t sourceHash,
+	const std::string& sourceDir, const std::vector<Model*>& models);
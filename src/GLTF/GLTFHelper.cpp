@@ -1,95 +1,392 @@
 #include "GLTFHelper.h"
 
-void createNormals(const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, std::vector<glm::vec3>& normals) {
-	// Need to compute the normals
-	std::vector<glm::vec3> geonormal(positions.size());
-	for (size_t i = 0; i < indices.size(); i += 3)
-	{
-		uint32_t ind0 = indices[i + 0];
-		uint32_t ind1 = indices[i + 1];
-		uint32_t ind2 = indices[i + 2];
-		const auto& pos0 = positions[ind0];
-		const auto& pos1 = positions[ind1];
-		const auto& pos2 = positions[ind2];
-		const auto  v1 = glm::normalize(pos1 - pos0);  // Many normalize, but when objects are really small the
-		const auto  v2 = glm::normalize(pos2 - pos0);  // cross will go below nv_eps and the normal will be (0,0,0)
-		const auto  n = glm::cross(v1, v2);
-		geonormal[ind0] += n;
-		geonormal[ind1] += n;
-		geonormal[ind2] += n;
-	}
-	for (auto& n : geonormal)
-		n = glm::normalize(n);
-	normals.insert(normals.end(), geonormal.begin(), geonormal.end());
-}
+#include <algorithm>
 
-void createTangents(
-	const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals, 
-	const std::vector<glm::vec2>& texCoords, std::vector<glm::vec3>& tangents, std::vector<glm::vec3>& bitangents)
-{
-	for (size_t i = 0; i < indices.size(); i += 3)
+#include "Utils/ThreadPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GLTF_HELPER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+	// Work is cut into chunks of a fixed size, so the result doesn't depend on the thread count.
+	// Multiples of 4 keep the scalar tail of the SIMD loops at the end of the whole range.
+	constexpr size_t TRIANGLE_CHUNK_SIZE = 8192;
+	constexpr size_t VERTEX_CHUNK_SIZE = 8192;
+	constexpr size_t FACE_BLOCK_SIZE = 256;
+	constexpr size_t CORNER_CHUNK_SIZE = 3 * TRIANGLE_CHUNK_SIZE;
+
+	template<class Func>
+	void forEachChunk(ThreadPool* pool, size_t count, size_t chunkSize, Func&& func)
 	{
-		// local index
-		uint32_t i0 = indices[i + 0];
-		uint32_t i1 = indices[i + 1];
-		uint32_t i2 = indices[i + 2];
+		size_t chunkNum = (count + chunkSize - 1) / chunkSize;
+		auto runChunk = [&](size_t chunk) {
+			size_t begin = chunk * chunkSize;
+			func(begin, std::min(begin + chunkSize, count));
+		};
 
-		const auto& p0 = positions[i0];
-		const auto& p1 = positions[i1];
-		const auto& p2 = positions[i2];
+		if (pool && chunkNum > 1) {
+			pool->parallelFor(chunkNum, runChunk);
+		}
+		else {
+			for (size_t chunk = 0; chunk < chunkNum; ++chunk)
+				runChunk(chunk);
+		}
+	}
 
-		const auto& uv0 = texCoords[i0];
-		const auto& uv1 = texCoords[i1];
-		const auto& uv2 = texCoords[i2];
+	// Face values are added to the corners by one job per range of vertices. The corners are
+	// bucketed by range once with a stable counting sort, each job walks only its own bucket.
+	// Every vertex sees its triangles in index order, so the sums are those of a serial loop
+	// for any job count.
+	size_t getCornerJobNum(ThreadPool* pool, size_t vertexNum)
+	{
+		if (!pool)
+			return 1;
+		return std::max<size_t>(1, std::min<size_t>(pool->getThreadCount(), vertexNum / VERTEX_CHUNK_SIZE));
+	}
 
-		glm::vec3 e1 = p1 - p0;
-		glm::vec3 e2 = p2 - p0;
+	template<class Func>
+	void forEachCorner(ThreadPool* pool, size_t jobNum, const std::vector<uint32_t>& indices, size_t triangleNum,
+		size_t vertexNum, Func&& add)
+	{
+		size_t cornerNum = triangleNum * 3;
+		size_t rangeSize = (vertexNum + jobNum - 1) / jobNum;
+		size_t chunkNum = (cornerNum + CORNER_CHUNK_SIZE - 1) / CORNER_CHUNK_SIZE;
 
-		glm::vec2 duvE1 = uv1 - uv0;
-		glm::vec2 duvE2 = uv2 - uv0;
+		// Corners of each chunk in each range, then where the chunk writes its first corner of the range
+		std::vector<uint32_t> offsets(chunkNum * jobNum, 0);
+		forEachChunk(pool, cornerNum, CORNER_CHUNK_SIZE, [&](size_t begin, size_t end) {
+			uint32_t* counts = offsets.data() + begin / CORNER_CHUNK_SIZE * jobNum;
+			for (size_t i = begin; i < end; ++i) {
+				if (indices[i] < vertexNum)
+					++counts[indices[i] / rangeSize];
+			}
+		});
 
-		float r = 1.0f;
-		float a = duvE1.x * duvE2.y - duvE2.x * duvE1.y;
-		if (fabs(a) > 0)  // Catch degenerated UV
-		{
-			r = 1.0f / a;
+		std::vector<uint32_t> buckets(jobNum + 1);
+		uint32_t offset = 0;
+		for (size_t job = 0; job < jobNum; ++job) {
+			buckets[job] = offset;
+			for (size_t chunk = 0; chunk < chunkNum; ++chunk) {
+				uint32_t count = offsets[chunk * jobNum + job];
+				offsets[chunk * jobNum + job] = offset;
+				offset += count;
+			}
 		}
+		buckets[jobNum] = offset;
+
+		std::vector<uint32_t> corners(offset);
+		forEachChunk(pool, cornerNum, CORNER_CHUNK_SIZE, [&](size_t begin, size_t end) {
+			uint32_t* next = offsets.data() + begin / CORNER_CHUNK_SIZE * jobNum;
+			for (size_t i = begin; i < end; ++i) {
+				if (indices[i] < vertexNum)
+					corners[next[indices[i] / rangeSize]++] = static_cast<uint32_t>(i);
+			}
+		});
+
+		pool->parallelFor(jobNum, [&](size_t job) {
+			for (uint32_t c = buckets[job]; c < buckets[job + 1]; ++c)
+				add(indices[corners[c]], corners[c] / 3);
+		});
+	}
+
+#ifdef GLTF_HELPER_SSE2
+	// Four vec3 as structure of arrays. The helpers do the same float operations
+	// in the same order as glm, results match the scalar code bit for bit.
+	struct Vec3x4
+	{
+		__m128 x, y, z;
+	};
+
+	inline Vec3x4 gather(const glm::vec3* v, uint32_t i0, uint32_t i1, uint32_t i2, uint32_t i3)
+	{
+		return {
+			_mm_setr_ps(v[i0].x, v[i1].x, v[i2].x, v[i3].x),
+			_mm_setr_ps(v[i0].y, v[i1].y, v[i2].y, v[i3].y),
+			_mm_setr_ps(v[i0].z, v[i1].z, v[i2].z, v[i3].z) };
+	}
+
+	static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "vec3 arrays are loaded as packed floats");
 
-		glm::vec3 t = (e1 * duvE2.y - e2 * duvE1.y) * r;
-		glm::vec3 b = (e2 * duvE1.x - e1 * duvE2.x) * r;
+	// Four consecutive vec3, three loads and a transpose
+	inline Vec3x4 load4(const glm::vec3* v)
+	{
+		const float* f = &v[0].x;
+		__m128 m0 = _mm_loadu_ps(f);      // x0 y0 z0 x1
+		__m128 m1 = _mm_loadu_ps(f + 4);  // y1 z1 x2 y2
+		__m128 m2 = _mm_loadu_ps(f + 8);  // z2 x3 y3 z3
+		__m128 xy23 = _mm_shuffle_ps(m1, m2, _MM_SHUFFLE(2, 1, 3, 2));
+		__m128 yz01 = _mm_shuffle_ps(m0, m1, _MM_SHUFFLE(1, 0, 2, 1));
+		return {
+			_mm_shuffle_ps(m0, xy23, _MM_SHUFFLE(2, 0, 3, 0)),
+			_mm_shuffle_ps(yz01, xy23, _MM_SHUFFLE(3, 1, 2, 0)),
+			_mm_shuffle_ps(yz01, m2, _MM_SHUFFLE(3, 0, 3, 1)) };
+	}
+
+	inline void store4(glm::vec3* v, const Vec3x4& a)
+	{
+		__m128 xy01 = _mm_unpacklo_ps(a.x, a.y);
+		__m128 xy23 = _mm_unpackhi_ps(a.x, a.y);
+		__m128 z0x1 = _mm_shuffle_ps(a.z, a.x, _MM_SHUFFLE(1, 1, 0, 0));
+		__m128 y1z1 = _mm_shuffle_ps(a.y, a.z, _MM_SHUFFLE(1, 1, 1, 1));
+		__m128 z2x3 = _mm_shuffle_ps(a.z, xy23, _MM_SHUFFLE(2, 2, 2, 2));
+		__m128 y3z3 = _mm_shuffle_ps(xy23, a.z, _MM_SHUFFLE(3, 3, 3, 3));
+
+		float* f = &v[0].x;
+		_mm_storeu_ps(f, _mm_shuffle_ps(xy01, z0x1, _MM_SHUFFLE(2, 0, 1, 0)));
+		_mm_storeu_ps(f + 4, _mm_shuffle_ps(y1z1, xy23, _MM_SHUFFLE(1, 0, 2, 0)));
+		_mm_storeu_ps(f + 8, _mm_shuffle_ps(z2x3, y3z3, _MM_SHUFFLE(2, 0, 2, 0)));
+	}
 
+	inline Vec3x4 sub(const Vec3x4& a, const Vec3x4& b)
+	{
+		return { _mm_sub_ps(a.x, b.x), _mm_sub_ps(a.y, b.y), _mm_sub_ps(a.z, b.z) };
+	}
+
+	inline Vec3x4 mul(const Vec3x4& a, __m128 s)
+	{
+		return { _mm_mul_ps(a.x, s), _mm_mul_ps(a.y, s), _mm_mul_ps(a.z, s) };
+	}
 
-		tangents[i0] += t;
-		tangents[i1] += t;
-		tangents[i2] += t;
+	inline __m128 dot(const Vec3x4& a, const Vec3x4& b)
+	{
+		return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+	}
 
-		bitangents[i0] += b;
-		bitangents[i1] += b;
-		bitangents[i2] += b;
+	inline Vec3x4 cross(const Vec3x4& a, const Vec3x4& b)
+	{
+		return {
+			_mm_sub_ps(_mm_mul_ps(a.y, b.z), _mm_mul_ps(b.y, a.z)),
+			_mm_sub_ps(_mm_mul_ps(a.z, b.x), _mm_mul_ps(b.z, a.x)),
+			_mm_sub_ps(_mm_mul_ps(a.x, b.y), _mm_mul_ps(b.x, a.y)) };
 	}
 
-	for (size_t i = 0; i < normals.size(); ++i) {
-		auto& n = normals[i];
-		auto& t = tangents[i];
-		auto& b = bitangents[i];
+	// glm::normalize multiplies by 1 / sqrt, it doesn't divide by the length
+	inline Vec3x4 normalize(const Vec3x4& a)
+	{
+		return mul(a, _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(dot(a, a))));
+	}
 
-		// Gram-Schmidt orthogonalize
-		glm::vec3 otangent = glm::normalize(t - (glm::dot(n, t) * n));
+	inline __m128 select(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+#endif
 
-		// In case the tangent is invalid
-		if (otangent == glm::vec3(0, 0, 0))
-		{
-			if (abs(n.x) > abs(n.y))
-				otangent = glm::vec3(n.z, 0, -n.x) / sqrtf(n.x * n.x + n.z * n.z);
-			else
-				otangent = glm::vec3(0, -n.z, n.y) / sqrtf(n.y * n.y + n.z * n.z);
+	// faceNormals[0] belongs to triangle begin
+	void computeFaceNormals(const uint32_t* indices, const glm::vec3* positions, size_t begin, size_t end,
+		glm::vec3* faceNormals)
+	{
+		size_t tri = begin;
+#ifdef GLTF_HELPER_SSE2
+		for (; tri + 4 <= end; tri += 4) {
+			const uint32_t* ind = indices + tri * 3;
+			Vec3x4 pos0 = gather(positions, ind[0], ind[3], ind[6], ind[9]);
+			Vec3x4 pos1 = gather(positions, ind[1], ind[4], ind[7], ind[10]);
+			Vec3x4 pos2 = gather(positions, ind[2], ind[5], ind[8], ind[11]);
+			store4(faceNormals + (tri - begin), cross(normalize(sub(pos1, pos0)), normalize(sub(pos2, pos0))));
+		}
+#endif
+		for (; tri < end; ++tri) {
+			const auto& pos0 = positions[indices[tri * 3 + 0]];
+			const auto& pos1 = positions[indices[tri * 3 + 1]];
+			const auto& pos2 = positions[indices[tri * 3 + 2]];
+			const auto  v1 = glm::normalize(pos1 - pos0);  // Many normalize, but when objects are really small the
+			const auto  v2 = glm::normalize(pos2 - pos0);  // cross will go below nv_eps and the normal will be (0,0,0)
+			faceNormals[tri - begin] = glm::cross(v1, v2);
 		}
+	}
 
-		// Calculate handedness
-		float handedness = (glm::dot(glm::cross(n, t), b) < 0.f) ? 1.f : -1.f;
-		t = otangent;
-		b = glm::normalize(glm::cross(n, t) * handedness);
+	void normalizeRange(glm::vec3* v, size_t begin, size_t end)
+	{
+		size_t i = begin;
+#ifdef GLTF_HELPER_SSE2
+		for (; i + 4 <= end; i += 4)
+			store4(v + i, normalize(load4(v + i)));
+#endif
+		for (; i < end; ++i)
+			v[i] = glm::normalize(v[i]);
 	}
+
+	void computeFaceTangents(const uint32_t* indices, const glm::vec3* positions, const glm::vec2* texCoords,
+		size_t begin, size_t end, glm::vec3* faceTangents, glm::vec3* faceBitangents)
+	{
+		size_t tri = begin;
+#ifdef GLTF_HELPER_SSE2
+		for (; tri + 4 <= end; tri += 4) {
+			const uint32_t* ind = indices + tri * 3;
+			Vec3x4 p0 = gather(positions, ind[0], ind[3], ind[6], ind[9]);
+			Vec3x4 e1 = sub(gather(positions, ind[1], ind[4], ind[7], ind[10]), p0);
+			Vec3x4 e2 = sub(gather(positions, ind[2], ind[5], ind[8], ind[11]), p0);
+
+			auto uvComponent = [&](int corner, int c) {
+				return _mm_setr_ps(texCoords[ind[corner]][c], texCoords[ind[corner + 3]][c],
+					texCoords[ind[corner + 6]][c], texCoords[ind[corner + 9]][c]);
+			};
+			__m128 u0 = uvComponent(0, 0), v0 = uvComponent(0, 1);
+			__m128 duvE1x = _mm_sub_ps(uvComponent(1, 0), u0), duvE1y = _mm_sub_ps(uvComponent(1, 1), v0);
+			__m128 duvE2x = _mm_sub_ps(uvComponent(2, 0), u0), duvE2y = _mm_sub_ps(uvComponent(2, 1), v0);
+
+			// Catch degenerated UV, NaN fails the compare like fabs(a) > 0 does
+			__m128 a = _mm_sub_ps(_mm_mul_ps(duvE1x, duvE2y), _mm_mul_ps(duvE2x, duvE1y));
+			__m128 absA = _mm_andnot_ps(_mm_set1_ps(-0.f), a);
+			__m128 one = _mm_set1_ps(1.f);
+			__m128 r = select(_mm_cmpgt_ps(absA, _mm_setzero_ps()), _mm_div_ps(one, a), one);
+
+			store4(faceTangents + (tri - begin), mul(sub(mul(e1, duvE2y), mul(e2, duvE1y)), r));
+			store4(faceBitangents + (tri - begin), mul(sub(mul(e2, duvE1x), mul(e1, duvE2x)), r));
+		}
+#endif
+		for (; tri < end; ++tri) {
+			uint32_t i0 = indices[tri * 3 + 0];
+			uint32_t i1 = indices[tri * 3 + 1];
+			uint32_t i2 = indices[tri * 3 + 2];
+
+			glm::vec3 e1 = positions[i1] - positions[i0];
+			glm::vec3 e2 = positions[i2] - positions[i0];
+
+			glm::vec2 duvE1 = texCoords[i1] - texCoords[i0];
+			glm::vec2 duvE2 = texCoords[i2] - texCoords[i0];
+
+			float r = 1.0f;
+			float a = duvE1.x * duvE2.y - duvE2.x * duvE1.y;
+			if (fabs(a) > 0)  // Catch degenerated UV
+			{
+				r = 1.0f / a;
+			}
+
+			faceTangents[tri - begin] = (e1 * duvE2.y - e2 * duvE1.y) * r;
+			faceBitangents[tri - begin] = (e2 * duvE1.x - e1 * duvE2.x) * r;
+		}
+	}
+
+	// In case the Gram-Schmidt tangent is invalid
+	glm::vec3 fallbackTangent(const glm::vec3& n)
+	{
+		if (abs(n.x) > abs(n.y))
+			return glm::vec3(n.z, 0, -n.x) / sqrtf(n.x * n.x + n.z * n.z);
+		else
+			return glm::vec3(0, -n.z, n.y) / sqrtf(n.y * n.y + n.z * n.z);
+	}
+
+	void orthogonalizeRange(const glm::vec3* normals, glm::vec3* tangents, glm::vec3* bitangents, size_t begin, size_t end)
+	{
+		size_t i = begin;
+#ifdef GLTF_HELPER_SSE2
+		for (; i + 4 <= end; i += 4) {
+			Vec3x4 n = load4(normals + i);
+			Vec3x4 t = load4(tangents + i);
+			Vec3x4 b = load4(bitangents + i);
+
+			// Gram-Schmidt orthogonalize
+			Vec3x4 otangent = normalize(sub(t, mul(n, dot(n, t))));
+			__m128 handedness = select(_mm_cmplt_ps(dot(cross(n, t), b), _mm_setzero_ps()),
+				_mm_set1_ps(1.f), _mm_set1_ps(-1.f));
+
+			__m128 zero = _mm_setzero_ps();
+			int invalid = _mm_movemask_ps(_mm_and_ps(_mm_and_ps(_mm_cmpeq_ps(otangent.x, zero),
+				_mm_cmpeq_ps(otangent.y, zero)), _mm_cmpeq_ps(otangent.z, zero)));
+
+			store4(tangents + i, otangent);
+			if (invalid) {
+				for (int lane = 0; lane < 4; ++lane) {
+					if (invalid & (1 << lane))
+						tangents[i + lane] = fallbackTangent(normals[i + lane]);
+				}
+				otangent = load4(tangents + i);
+			}
+			store4(bitangents + i, normalize(mul(cross(n, otangent), handedness)));
+		}
+#endif
+		for (; i < end; ++i) {
+			const auto& n = normals[i];
+			auto& t = tangents[i];
+			auto& b = bitangents[i];
+
+			// Gram-Schmidt orthogonalize
+			glm::vec3 otangent = glm::normalize(t - (glm::dot(n, t) * n));
+			if (otangent == glm::vec3(0, 0, 0))
+				otangent = fallbackTangent(n);
+
+			// Calculate handedness
+			float handedness = (glm::dot(glm::cross(n, t), b) < 0.f) ? 1.f : -1.f;
+			t = otangent;
+			b = glm::normalize(glm::cross(n, t) * handedness);
+		}
+	}
+}
+
+void createNormals(const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, std::vector<glm::vec3>& normals,
+	ThreadPool* pool)
+{
+	size_t triangleNum = indices.size() / 3;
+	size_t firstNormal = normals.size();
+	normals.resize(firstNormal + positions.size(), glm::vec3(0.f));
+	glm::vec3* geonormal = normals.data() + firstNormal;
+
+	size_t jobNum = getCornerJobNum(pool, positions.size());
+	if (jobNum > 1) {
+		std::vector<glm::vec3> faceNormals(triangleNum);
+		forEachChunk(pool, triangleNum, TRIANGLE_CHUNK_SIZE, [&](size_t begin, size_t end) {
+			computeFaceNormals(indices.data(), positions.data(), begin, end, faceNormals.data() + begin);
+		});
+		forEachCorner(pool, jobNum, indices, triangleNum, positions.size(), [&](uint32_t vertex, size_t tri) {
+			geonormal[vertex] += faceNormals[tri];
+		});
+	}
+	else {
+		// A single job adds each block of face values while it is still in cache
+		glm::vec3 faceNormals[FACE_BLOCK_SIZE];
+		for (size_t begin = 0; begin < triangleNum; begin += FACE_BLOCK_SIZE) {
+			size_t end = std::min(begin + FACE_BLOCK_SIZE, triangleNum);
+			computeFaceNormals(indices.data(), positions.data(), begin, end, faceNormals);
+			for (size_t i = begin * 3; i < end * 3; ++i)
+				geonormal[indices[i]] += faceNormals[i / 3 - begin];
+		}
+	}
+
+	forEachChunk(pool, positions.size(), VERTEX_CHUNK_SIZE, [&](size_t begin, size_t end) {
+		normalizeRange(geonormal, begin, end);
+	});
+}
+
+void createTangents(
+	const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals, 
+	const std::vector<glm::vec2>& texCoords, std::vector<glm::vec3>& tangents, std::vector<glm::vec3>& bitangents,
+	ThreadPool* pool)
+{
+	size_t triangleNum = indices.size() / 3;
+
+	size_t jobNum = getCornerJobNum(pool, positions.size());
+	if (jobNum > 1) {
+		std::vector<glm::vec3> faceTangents(triangleNum);
+		std::vector<glm::vec3> faceBitangents(triangleNum);
+		forEachChunk(pool, triangleNum, TRIANGLE_CHUNK_SIZE, [&](size_t begin, size_t end) {
+			computeFaceTangents(indices.data(), positions.data(), texCoords.data(), begin, end,
+				faceTangents.data() + begin, faceBitangents.data() + begin);
+		});
+		forEachCorner(pool, jobNum, indices, triangleNum, positions.size(), [&](uint32_t vertex, size_t tri) {
+			tangents[vertex] += faceTangents[tri];
+			bitangents[vertex] += faceBitangents[tri];
+		});
+	}
+	else {
+		glm::vec3 faceTangents[FACE_BLOCK_SIZE];
+		glm::vec3 faceBitangents[FACE_BLOCK_SIZE];
+		for (size_t begin = 0; begin < triangleNum; begin += FACE_BLOCK_SIZE) {
+			size_t end = std::min(begin + FACE_BLOCK_SIZE, triangleNum);
+			computeFaceTangents(indices.data(), positions.data(), texCoords.data(), begin, end, faceTangents, faceBitangents);
+			for (size_t i = begin * 3; i < end * 3; ++i) {
+				tangents[indices[i]] += faceTangents[i / 3 - begin];
+				bitangents[indices[i]] += faceBitangents[i / 3 - begin];
+			}
+		}
+	}
+
+	forEachChunk(pool, normals.size(), VERTEX_CHUNK_SIZE, [&](size_t begin, size_t end) {
+		orthogonalizeRange(normals.data(), tangents.data(), bitangents.data(), begin, end);
+	});
 }
 
 void importGLTFMaterial(GltfMaterial& mat, const tinygltf::Material& tMat) {
@@ -1,14 +1,22 @@
 #pragma once
 
+#include <cstring>
+#include <type_traits>
+
 #include <tiny_gltf.h>
 
 #include "Rendering/VulkanResource.h"
+#include "GLTFLoader.h"
+#include "GLTFConvert.h"
+
+class ThreadPool;
 
 #define KHR_MATERIALS_PBRSPECULARGLOSSINESS_EXTENSION_NAME "KHR_materials_pbrSpecularGlossiness"
 #define KHR_MATERIALS_SPECULAR_EXTENSION_NAME "KHR_materials_specular"
 #define KHR_MATERIALS_CLEARCOAT_EXTENSION_NAME "KHR_materials_clearcoat"
 #define KHR_MATERIALS_TRANSMISSION_EXTENSION_NAME "KHR_materials_transmission"
 #define KHR_MATERIALS_IOR_EXTENSION_NAME "KHR_materials_ior"
+#define KHR_LIGHTS_PUNCTUAL_EXTENSION_NAME "KHR_lights_punctual"
 
 // Return a vector of data for a tinygltf::Value
 template <typename T>
@@ -76,8 +84,9 @@ inline void getTexId(const tinygltf::Value& value, const std::string& name, int&
     }
 }
 
+// Reference path: converts one component at a time, handles any stride and layout
 template<class T, class Component = float>
-bool getAccessorData(const tinygltf::Model& tModel, const tinygltf::Accessor& tAcces, std::vector<T>& attribVec)
+bool getAccessorDataPerElement(const GltfDocument& doc, const tinygltf::Accessor& tAcces, std::vector<T>& attribVec)
 {
 	size_t componentType = tAcces.componentType;
 	int componentNum = tinygltf::GetNumComponentsInType(tAcces.type);
@@ -85,9 +94,8 @@ bool getAccessorData(const tinygltf::Model& tModel, const tinygltf::Accessor& tA
 	size_t oldAttribVecSize = attribVec.size();
 	attribVec.resize(oldAttribVecSize + tAcces.count);
 
-	auto& tBufferView = tModel.bufferViews[tAcces.bufferView];
-	auto& tBuffer = tModel.buffers[tBufferView.buffer];
-	const uint8_t* data = &tBuffer.data[tBufferView.byteOffset + tAcces.byteOffset];
+	auto& tBufferView = doc.getModel().bufferViews[tAcces.bufferView];
+	const uint8_t* data = doc.getBuffer(tBufferView.buffer).data + tBufferView.byteOffset + tAcces.byteOffset;
 	const size_t dataStride = tAcces.ByteStride(tBufferView);
 
 	for (size_t attribIndex = oldAttribVecSize; attribIndex < attribVec.size(); ++attribIndex) {
@@ -127,7 +135,7 @@ bool getAccessorData(const tinygltf::Model& tModel, const tinygltf::Accessor& tA
 }
 
 template<class T>
-bool getAccessorDataScalar(const tinygltf::Model& tModel, const tinygltf::Accessor& tAcces, std::vector<T>& attribVec)
+bool getAccessorDataScalarPerElement(const GltfDocument& doc, const tinygltf::Accessor& tAcces, std::vector<T>& attribVec)
 {
 	size_t componentType = tAcces.componentType;
 	int componentNum = tinygltf::GetNumComponentsInType(tAcces.type);
@@ -135,9 +143,8 @@ bool getAccessorDataScalar(const tinygltf::Model& tModel, const tinygltf::Access
 	size_t oldAttribVecSize = attribVec.size();
 	attribVec.resize(oldAttribVecSize + tAcces.count);
 
-	auto& tBufferView = tModel.bufferViews[tAcces.bufferView];
-	auto& tBuffer = tModel.buffers[tBufferView.buffer];
-	const uint8_t* data = &tBuffer.data[tBufferView.byteOffset + tAcces.byteOffset];
+	auto& tBufferView = doc.getModel().bufferViews[tAcces.bufferView];
+	const uint8_t* data = doc.getBuffer(tBufferView.buffer).data + tBufferView.byteOffset + tAcces.byteOffset;
 	const size_t dataStride = tAcces.ByteStride(tBufferView);
 
 	for (size_t attribIndex = oldAttribVecSize; attribIndex < attribVec.size(); ++attribIndex) {
@@ -178,24 +185,111 @@ bool getAccessorDataScalar(const tinygltf::Model& tModel, const tinygltf::Access
 }
 
 template<class T, class Component = float>
-bool getAttribute(const tinygltf::Model& tModel, const tinygltf::Primitive& tPrimitive,
+bool getAccessorData(const GltfDocument& doc, const tinygltf::Accessor& tAcces, std::vector<T>& attribVec)
+{
+	int componentNum = tinygltf::GetNumComponentsInType(tAcces.type);
+	int componentSize = tinygltf::GetComponentSizeInBytes(tAcces.componentType);
+
+	auto& tBufferView = doc.getModel().bufferViews[tAcces.bufferView];
+	const size_t dataStride = tAcces.ByteStride(tBufferView);
+
+	// Tightly packed source into a T made of exactly componentNum floats: convert in bulk
+	if constexpr (std::is_same_v<Component, float>) {
+		if (sizeof(T) == sizeof(float) * componentNum && dataStride == size_t(componentSize) * componentNum) {
+			const uint8_t* data = doc.getBuffer(tBufferView.buffer).data + tBufferView.byteOffset + tAcces.byteOffset;
+			size_t count = tAcces.count * componentNum;
+
+			size_t oldAttribVecSize = attribVec.size();
+			attribVec.resize(oldAttribVecSize + tAcces.count);
+			float* dst = reinterpret_cast<float*>(attribVec.data() + oldAttribVecSize);
+
+			switch (tAcces.componentType)
+			{
+			case TINYGLTF_COMPONENT_TYPE_FLOAT:
+				memcpy(dst, data, count * sizeof(float));
+				return true;
+			case TINYGLTF_COMPONENT_TYPE_BYTE:
+				convertI8ToFloat(reinterpret_cast<const int8_t*>(data), dst, count);
+				return true;
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+				convertU8ToFloat(data, dst, count);
+				return true;
+			case TINYGLTF_COMPONENT_TYPE_SHORT:
+				convertI16ToFloat(reinterpret_cast<const int16_t*>(data), dst, count);
+				return true;
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+				convertU16ToFloat(reinterpret_cast<const uint16_t*>(data), dst, count);
+				return true;
+			default:
+				attribVec.resize(oldAttribVecSize);
+				break;
+			}
+		}
+	}
+
+	return getAccessorDataPerElement<T, Component>(doc, tAcces, attribVec);
+}
+
+template<class T>
+bool getAccessorDataScalar(const GltfDocument& doc, const tinygltf::Accessor& tAcces, std::vector<T>& attribVec)
+{
+	auto& tBufferView = doc.getModel().bufferViews[tAcces.bufferView];
+	const size_t dataStride = tAcces.ByteStride(tBufferView);
+
+	// Index buffers are the common case: packed unsigned integers into uint32_t
+	if constexpr (std::is_same_v<T, uint32_t>) {
+		if (dataStride == size_t(tinygltf::GetComponentSizeInBytes(tAcces.componentType))) {
+			const uint8_t* data = doc.getBuffer(tBufferView.buffer).data + tBufferView.byteOffset + tAcces.byteOffset;
+
+			size_t oldAttribVecSize = attribVec.size();
+			attribVec.resize(oldAttribVecSize + tAcces.count);
+			uint32_t* dst = attribVec.data() + oldAttribVecSize;
+
+			switch (tAcces.componentType)
+			{
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+				memcpy(dst, data, tAcces.count * sizeof(uint32_t));
+				return true;
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+				convertU16ToU32(reinterpret_cast<const uint16_t*>(data), dst, tAcces.count);
+				return true;
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+				convertU8ToU32(data, dst, tAcces.count);
+				return true;
+			default:
+				attribVec.resize(oldAttribVecSize);
+				break;
+			}
+		}
+	}
+
+	return getAccessorDataScalarPerElement(doc, tAcces, attribVec);
+}
+
+template<class T, class Component = float>
+bool getAttribute(const GltfDocument& doc, const tinygltf::Primitive& tPrimitive,
 	std::vector<T>& attribVec, const std::string& attribName)
 {
 	auto& tAttr = tPrimitive.attributes;
 	auto it = tAttr.find(attribName);
 	if (it != tAttr.end()) {
-		auto& tAcces = tModel.accessors[it->second];
-		return getAccessorData<T, Component>(tModel, tAcces, attribVec);
+		auto& tAcces = doc.getModel().accessors[it->second];
+		return getAccessorData<T, Component>(doc, tAcces, attribVec);
 	}
 	else {
 		return false;
 	}
 }
 
-void createNormals(const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, std::vector<glm::vec3>& normals);
+// Both spread large meshes over pool when given one. The result is the same for any
+// thread count and equal to summing the triangles of each vertex in index order.
+void createNormals(const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, std::vector<glm::vec3>& normals,
+	ThreadPool* pool = nullptr);
 
+// tangents and bitangents must hold one value per position, the triangle sums are added onto them
 void createTangents(
 	const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals,
-	const std::vector<glm::vec2>& texCoords, std::vector<glm::vec3>& tangents, std::vector<glm::vec3>& bitangents);
+	const std::vector<glm::vec2>& texCoords, std::vector<glm::vec3>& tangents, std::vector<glm::vec3>& bitangents,
+	ThreadPool* pool = nullptr);
 
 void importGLTFMaterial(GltfMaterial& mat, const tinygltf::Material& tMat);
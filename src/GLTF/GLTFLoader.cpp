@@ -0,0 +1,298 @@
+#include "GLTFLoader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+
+#include <json.hpp>
+
+#include "Utils/Hash.h"
+
+namespace {
+	constexpr uint32_t GLB_MAGIC = 0x46546C67;      // "glTF"
+	constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A; // "JSON"
+	constexpr uint32_t GLB_CHUNK_BIN = 0x004E4942;  // "BIN\0"
+
+	// Stands in for a buffer we serve from a mapping, tinygltf decodes it to a single byte
+	const char* PLACEHOLDER_BUFFER_URI = "data:application/octet-stream;base64,AA==";
+
+	uint32_t readU32(const uint8_t* p)
+	{
+		uint32_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	bool endsWith(const std::string& str, const std::string& suffix)
+	{
+		return str.size() >= suffix.size() &&
+			std::equal(suffix.rbegin(), suffix.rend(), str.rbegin(), [](char a, char b) { return std::tolower(a) == std::tolower(b); });
+	}
+
+	// Stands in for an image we slice from a mapped buffer
+	const char* PLACEHOLDER_IMAGE_URI = "data:image/png;base64,AA==";
+
+	struct ImageCapture
+	{
+		std::vector<bool> wanted;
+		std::vector<std::vector<uint8_t>> bytes;
+	};
+
+	// The images don't need to be decoded here, VulkanTexture does that.
+	// Only the encoded bytes of the wanted images, which have no file or mapping, are kept.
+	bool captureImageData(tinygltf::Image*, const int imageIdx, std::string*, std::string*, int, int,
+		const unsigned char* bytes, int size, void* userData)
+	{
+		auto& capture = *static_cast<ImageCapture*>(userData);
+		if (imageIdx >= 0 && size_t(imageIdx) < capture.wanted.size() && capture.wanted[imageIdx])
+			capture.bytes[imageIdx].assign(bytes, bytes + size);
+		return true;
+	}
+
+	// Splits a .gltf or .glb file into its JSON document and the GLB BIN chunk
+	bool parseJson(const std::string& filename, const MappedFile& file,
+		bool& isBinary, nlohmann::json& json, GltfBufferData& binChunk, std::string* error)
+	{
+		const uint8_t* bytes = file.getData();
+		const char* jsonBegin = reinterpret_cast<const char*>(bytes);
+		size_t jsonSize = file.getSize();
+
+		isBinary = endsWith(filename, ".glb") || (file.getSize() >= 4 && readU32(bytes) == GLB_MAGIC);
+		if (isBinary) {
+			// 12 byte header, then a JSON chunk optionally followed by a BIN chunk
+			if (file.getSize() < 20 || readU32(bytes) != GLB_MAGIC || readU32(bytes + 4) != 2) {
+				*error = filename + ": not a glTF 2.0 binary file";
+				return false;
+			}
+			size_t totalSize = std::min<size_t>(readU32(bytes + 8), file.getSize());
+			uint32_t jsonChunkSize = readU32(bytes + 12);
+			if (readU32(bytes + 16) != GLB_CHUNK_JSON || 20 + size_t(jsonChunkSize) > totalSize) {
+				*error = filename + ": invalid GLB JSON chunk";
+				return false;
+			}
+			jsonBegin = reinterpret_cast<const char*>(bytes + 20);
+			jsonSize = jsonChunkSize;
+
+			size_t binHeader = 20 + size_t(jsonChunkSize);
+			if (binHeader + 8 <= totalSize && readU32(bytes + binHeader + 4) == GLB_CHUNK_BIN) {
+				binChunk.data = bytes + binHeader + 8;
+				binChunk.size = std::min<size_t>(readU32(bytes + binHeader), totalSize - binHeader - 8);
+			}
+		}
+
+		try {
+			json = nlohmann::json::parse(jsonBegin, jsonBegin + jsonSize);
+		}
+		catch (const std::exception& e) {
+			*error = filename + ": " + e.what();
+			return false;
+		}
+
+		return true;
+	}
+
+	std::string getBaseDir(const std::string& filename)
+	{
+		auto slashpos = filename.find_last_of("/\\");
+		return slashpos == std::string::npos ? "" : filename.substr(0, slashpos + 1);
+	}
+}
+
+bool GltfDocument::load(const std::string& filename, std::string* error, std::string* warn)
+{
+	std::string baseDir = getBaseDir(filename);
+
+	auto file = std::make_shared<MappedFile>(filename);
+	if (!file->isOpen()) {
+		*error = "failed to open " + filename;
+		return false;
+	}
+
+	bool isBinary = false;
+	nlohmann::json json;
+	GltfBufferData binChunk{};
+	if (!parseJson(filename, *file, isBinary, json, binChunk, error))
+		return false;
+
+	size_t bufferNum = json.contains("buffers") ? json["buffers"].size() : 0;
+	buffers.assign(bufferNum, {});
+	bufferFiles.assign(bufferNum, nullptr);
+	bufferFileNames.assign(bufferNum, {});
+
+	for (size_t i = 0; i < bufferNum; ++i) {
+		auto& jBuffer = json["buffers"][i];
+		size_t byteLength = jBuffer.value("byteLength", size_t(0));
+		GltfBufferData data{};
+		std::shared_ptr<const MappedFile> bufferFile;
+		std::string bufferFileName;
+		if (!jBuffer.contains("uri")) {
+			if (!isBinary)
+				continue;
+			data = binChunk;
+			bufferFile = file;
+			bufferFileName = filename;
+		}
+		else {
+			auto uri = jBuffer["uri"].get<std::string>();
+			if (uri.rfind("data:", 0) == 0)
+				continue;
+
+			bufferFileName = baseDir + uri;
+			auto mappedFile = std::make_shared<MappedFile>(bufferFileName);
+			if (!mappedFile->isOpen())
+				continue; // let tinygltf report it
+			data = { mappedFile->getData(), mappedFile->getSize() };
+			bufferFile = std::move(mappedFile);
+		}
+
+		if (data.data == nullptr || data.size < byteLength) {
+			*error = filename + ": buffer " + std::to_string(i) + " is smaller than its byteLength";
+			return false;
+		}
+
+		buffers[i] = { data.data, byteLength };
+		bufferFiles[i] = std::move(bufferFile);
+		bufferFileNames[i] = std::move(bufferFileName);
+		jBuffer["uri"] = PLACEHOLDER_BUFFER_URI;
+		jBuffer["byteLength"] = 1;
+	}
+
+	// Images in a mapped buffer are slices of it, tinygltf would read them from the placeholder.
+	// Those in a data uri or a buffer tinygltf decodes are copied out of it by captureImageData.
+	size_t imageNum = json.contains("images") ? json["images"].size() : 0;
+	images.assign(imageNum, {});
+	ImageCapture capture;
+	capture.wanted.assign(imageNum, false);
+	capture.bytes.resize(imageNum);
+	for (size_t i = 0; i < imageNum; ++i) {
+		auto& jImage = json["images"][i];
+		if (!jImage.contains("bufferView")) {
+			capture.wanted[i] = jImage.value("uri", std::string()).rfind("data:", 0) == 0;
+			continue;
+		}
+
+		int viewIdx = jImage["bufferView"].get<int>();
+		if (viewIdx < 0 || !json.contains("bufferViews") || size_t(viewIdx) >= json["bufferViews"].size()) {
+			*error = filename + ": image " + std::to_string(i) + " has an invalid bufferView";
+			return false;
+		}
+		const auto& jView = json["bufferViews"][viewIdx];
+		int buffer = jView.value("buffer", -1);
+		if (buffer < 0 || size_t(buffer) >= bufferNum) {
+			*error = filename + ": bufferView " + std::to_string(viewIdx) + " has an invalid buffer";
+			return false;
+		}
+		if (!bufferFiles[buffer]) {
+			capture.wanted[i] = true;
+			continue;
+		}
+
+		size_t offset = jView.value("byteOffset", size_t(0));
+		size_t length = jView.value("byteLength", size_t(0));
+		if (offset > buffers[buffer].size || length > buffers[buffer].size - offset) {
+			*error = filename + ": image " + std::to_string(i) + " lies outside of its buffer";
+			return false;
+		}
+
+		auto& image = images[i];
+		image.owner = bufferFiles[buffer];
+		image.data = buffers[buffer].data + offset;
+		image.size = length;
+		image.file = bufferFileNames[buffer];
+		image.offset = static_cast<uint64_t>(image.data - bufferFiles[buffer]->getData());
+		jImage.erase("bufferView");
+		jImage["uri"] = PLACEHOLDER_IMAGE_URI;
+	}
+
+	tinygltf::TinyGLTF tContext;
+	tContext.SetImageLoader(captureImageData, &capture);
+
+	auto rewritten = json.dump();
+	if (!tContext.LoadASCIIFromString(&model, error, warn, rewritten.c_str(), static_cast<unsigned int>(rewritten.size()), baseDir))
+		return false;
+
+	for (size_t i = 0; i < bufferNum; ++i) {
+		if (!bufferFiles[i])
+			buffers[i] = { model.buffers[i].data.data(), model.buffers[i].data.size() };
+	}
+
+	for (size_t i = 0; i < imageNum; ++i) {
+		if (!capture.wanted[i] || capture.bytes[i].empty())
+			continue;
+		auto bytes = std::make_shared<std::vector<uint8_t>>(std::move(capture.bytes[i]));
+		images[i].data = bytes->data();
+		images[i].size = bytes->size();
+		images[i].owner = std::move(bytes);
+	}
+
+	return true;
+}
+
+std::vector<std::string> GltfDocument::getSourceFiles(const std::string& filename)
+{
+	MappedFile file{ filename };
+	if (!file.isOpen())
+		return {};
+
+	bool isBinary = false;
+	nlohmann::json json;
+	GltfBufferData binChunk{};
+	std::string error;
+	if (!parseJson(filename, file, isBinary, json, binChunk, &error))
+		return {};
+
+	std::vector<std::string> files{ filename };
+	if (json.contains("buffers")) {
+		std::string baseDir = getBaseDir(filename);
+		for (const auto& jBuffer : json["buffers"]) {
+			if (!jBuffer.contains("uri"))
+				continue;
+			auto uri = jBuffer["uri"].get<std::string>();
+			if (uri.rfind("data:", 0) != 0)
+				files.push_back(baseDir + uri);
+		}
+	}
+
+	return files;
+}
+
+uint64_t GltfDocument::hashSource(const std::string& filename)
+{
+	auto files = getSourceFiles(filename);
+	if (files.empty())
+		return 0;
+
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (const auto& sourceFile : files) {
+		MappedFile file{ sourceFile };
+		if (!file.isOpen())
+			return 0;
+		hash = hashBytes(file.getData(), file.getSize(), hash);
+	}
+
+	return hash;
+}
+
+uint64_t GltfDocument::stampSource(const std::string& filename)
+{
+	auto files = getSourceFiles(filename);
+	if (files.empty())
+		return 0;
+
+	uint64_t stamp = 0xcbf29ce484222325ull;
+	for (const auto& sourceFile : files) {
+		std::error_code ec;
+		uint64_t size = std::filesystem::file_size(sourceFile, ec);
+		if (ec)
+			return 0;
+		int64_t mtime = std::filesystem::last_write_time(sourceFile, ec).time_since_epoch().count();
+		if (ec)
+			return 0;
+		stamp = hashBytes(sourceFile.data(), sourceFile.size(), stamp);
+		stamp = hashBytes(&size, sizeof(size), stamp);
+		stamp = hashBytes(&mtime, sizeof(mtime), stamp);
+	}
+
+	return stamp;
+}
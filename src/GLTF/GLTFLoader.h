@@ -0,0 +1,54 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <tiny_gltf.h>
+
+#include "Utils/MappedFile.h"
+#include "Texture.h"
+
+// Bytes of one glTF buffer, owned either by tinygltf or by a file mapping
+struct GltfBufferData
+{
+	const uint8_t* data{ nullptr };
+	size_t size{ 0 };
+};
+
+// A parsed .gltf or .glb file.
+// External .bin files and the GLB BIN chunk are memory mapped and read in place, tinygltf only
+// decodes buffers given as data uris. Images stored in a buffer are slices of its mapping,
+// the mapping lives as long as the EmbeddedImage of any of them.
+class GltfDocument
+{
+public:
+	GltfDocument() = default;
+	GltfDocument(const GltfDocument&) = delete;
+	GltfDocument& operator=(const GltfDocument&) = delete;
+
+	bool load(const std::string& filename, std::string* error, std::string* warn);
+
+	const tinygltf::Model& getModel() const { return model; }
+	const GltfBufferData& getBuffer(int buffer) const { return buffers[buffer]; }
+	// Bytes of an image stored in a buffer or a data uri, data is null for an image file
+	const EmbeddedImage& getImage(int image) const { return images[image]; }
+
+	// Content hash of the file and every external buffer it references, 0 if any is missing
+	static uint64_t hashSource(const std::string& filename);
+	// Hash of the path, size and modification time of the same files, 0 if any is missing.
+	// Far cheaper than hashSource, only the JSON is parsed and no buffer is read.
+	static uint64_t stampSource(const std::string& filename);
+
+private:
+	// The file itself followed by its external buffers, empty if it can't be parsed
+	static std::vector<std::string> getSourceFiles(const std::string& filename);
+
+	tinygltf::Model model;
+
+	std::vector<GltfBufferData> buffers;
+	// Mapping and file name of each buffer served from a mapping
+	std::vector<std::shared_ptr<const MappedFile>> bufferFiles;
+	std::vector<std::string> bufferFileNames;
+	std::vector<EmbeddedImage> images;
+};
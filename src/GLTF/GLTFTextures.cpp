@@ -0,0 +1,338 @@
+#include "GLTFTextures.h"
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+
+#include <json.hpp>
+#include <stb_image.h>
+
+#include "GLTFHelper.h"
+#include "GLTFLoader.h"
+#include "Image/BlockCompression.h"
+#include "Image/MipChain.h"
+#include "Utils/Hash.h"
+#include "Utils/Ktx2.h"
+#include "Utils/MappedFile.h"
+#include "Utils/ThreadPool.h"
+
+namespace {
+	const char* MANIFEST_NAME = "manifest.json";
+
+	// VkFormat values written for each role
+	constexpr uint32_t FORMAT_BC4_UNORM = 139;
+	constexpr uint32_t FORMAT_BC5_UNORM = 141;
+	constexpr uint32_t FORMAT_BC7_UNORM = 145;
+
+	// How a role is stored. Color stays UNORM like the stb_image path, the shaders do not expect sRGB views.
+	struct RoleEncoding
+	{
+		BlockCodec codec;
+		uint32_t vkFormat;
+		MipFilter filter;
+		uint32_t channels[2];
+		const char* swizzle;
+	};
+
+	RoleEncoding getRoleEncoding(TextureRole role)
+	{
+		switch (role) {
+		case TextureRole::Color: return { BlockCodec::BC7, FORMAT_BC7_UNORM, MipFilter::Srgb, { 0, 0 }, "" };
+		case TextureRole::Normal: return { BlockCodec::BC5, FORMAT_BC5_UNORM, MipFilter::NormalMap, { 0, 1 }, "" };
+		case TextureRole::Occlusion: return { BlockCodec::BC4, FORMAT_BC4_UNORM, MipFilter::Linear, { 0, 0 }, "" };
+		case TextureRole::MetallicRoughness: return { BlockCodec::BC5, FORMAT_BC5_UNORM, MipFilter::Linear, { 1, 2 }, "0rg1" };
+		case TextureRole::Data: break;
+		}
+		return { BlockCodec::BC7, FORMAT_BC7_UNORM, MipFilter::Linear, { 0, 0 }, "" };
+	}
+
+	// Bit per TextureRole of every way the materials use each image
+	std::vector<uint32_t> findImageUses(const tinygltf::Model& tModel)
+	{
+		std::vector<uint32_t> uses(tModel.images.size(), 0);
+		for (const auto& tMat : tModel.materials) {
+			// importGLTFMaterial leaves the textures of missing extensions untouched
+			GltfMaterial mat{};
+			for (int* id : { &mat.khrDiffuseTexture, &mat.khrSpecularGlossinessTexture, &mat.clearcoatTexture,
+				&mat.clearcoatRoughnessTexture, &mat.clearcoatNormalTexture, &mat.transmissionTexture })
+				*id = -1;
+			importGLTFMaterial(mat, tMat);
+
+			auto use = [&](int textureId, TextureRole role) {
+				if (textureId < 0 || textureId >= int(tModel.textures.size()))
+					return;
+				int source = tModel.textures[textureId].source;
+				if (source >= 0 && source < int(uses.size()))
+					uses[source] |= 1u << uint32_t(role);
+			};
+			use(mat.pbrBaseColorTexture, TextureRole::Color);
+			use(mat.emissiveTexture, TextureRole::Color);
+			use(mat.khrDiffuseTexture, TextureRole::Color);
+			use(mat.khrSpecularGlossinessTexture, TextureRole::Color);
+			use(mat.normalTexture, TextureRole::Normal);
+			use(mat.clearcoatNormalTexture, TextureRole::Normal);
+			use(mat.occlusionTexture, TextureRole::Occlusion);
+			use(mat.pbrMetallicRoughnessTexture, TextureRole::MetallicRoughness);
+			use(mat.transmissionTexture, TextureRole::Data);
+			use(mat.clearcoatTexture, TextureRole::Data);
+			use(mat.clearcoatRoughnessTexture, TextureRole::Data);
+		}
+		return uses;
+	}
+
+	TextureRole pickRole(uint32_t uses)
+	{
+		for (auto role : { TextureRole::Color, TextureRole::Normal, TextureRole::Occlusion, TextureRole::MetallicRoughness }) {
+			if (uses == 1u << uint32_t(role))
+				return role;
+		}
+		// Packed occlusion-roughness-metallic and the like need every channel
+		return TextureRole::Data;
+	}
+
+	int64_t getWriteTime(const std::filesystem::path& path)
+	{
+		std::error_code ec;
+		auto time = std::filesystem::last_write_time(path, ec);
+		return ec ? 0 : int64_t(time.time_since_epoch().count());
+	}
+
+	// File name from the uri and its hash, images with the same name in different folders stay apart
+	std::string getCookedName(const std::string& uri)
+	{
+		char hash[17];
+		snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(hashBytes(uri.data(), uri.size())));
+		return std::filesystem::path(uri).stem().string() + "-" + std::string(hash, 8) + ".ktx2";
+	}
+
+	double getPsnr(const ImageLevel& source, const ImageLevel& decoded, const std::vector<uint32_t>& channels)
+	{
+		double squaredError = 0.0;
+		for (size_t t = 0; t < source.rgba.size(); t += 4) {
+			for (auto c : channels) {
+				double diff = double(source.rgba[t + c]) - double(decoded.rgba[t + c]);
+				squaredError += diff * diff;
+			}
+		}
+		double mse = squaredError / (double(source.rgba.size() / 4) * channels.size());
+		return mse == 0.0 ? 99.0 : 10.0 * std::log10(255.0 * 255.0 / mse);
+	}
+
+	bool writeFile(const std::filesystem::path& path, const void* data, size_t size)
+	{
+		// Write aside and rename, a reader never sees a half written file
+		auto tmpPath = path;
+		tmpPath += ".tmp";
+		{
+			std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+			out.write(static_cast<const char*>(data), size);
+			if (!out.good())
+				return false;
+		}
+
+		std::error_code ec;
+		std::filesystem::rename(tmpPath, path, ec);
+		if (ec) {
+			std::filesystem::remove(tmpPath, ec);
+			return false;
+		}
+		return true;
+	}
+
+	void cookTexture(const MappedFile& source, const std::filesystem::path& cookedPath,
+		ThreadPool& pool, bool measureError, TextureCookResult& result)
+	{
+		int width, height, channels;
+		stbi_uc* pixels = stbi_load_from_memory(source.getData(), static_cast<int>(source.getSize()),
+			&width, &height, &channels, STBI_rgb_alpha);
+		if (!pixels) {
+			result.error = "failed to load texture image!";
+			return;
+		}
+		auto encoding = getRoleEncoding(result.role);
+		auto mips = buildMipChain(pixels, uint32_t(width), uint32_t(height), encoding.filter);
+		stbi_image_free(pixels);
+
+		std::vector<std::vector<uint8_t>> levels(mips.size());
+		for (size_t i = 0; i < mips.size(); ++i)
+			levels[i] = compressLevel(mips[i], encoding.codec, encoding.channels, &pool);
+
+		if (measureError) {
+			auto decoded = decompressLevel(levels[0].data(), mips[0].width, mips[0].height, encoding.codec, encoding.channels);
+			std::vector<uint32_t> stored{ 0, 1, 2, 3 };
+			if (encoding.codec == BlockCodec::BC4)
+				stored = { encoding.channels[0] };
+			else if (encoding.codec == BlockCodec::BC5)
+				stored = { encoding.channels[0], encoding.channels[1] };
+			result.psnr = getPsnr(mips[0], decoded, stored);
+		}
+
+		auto ktx = writeKtx2(encoding.vkFormat, mips[0].width, mips[0].height, levels, encoding.swizzle);
+		if (!writeFile(cookedPath, ktx.data(), ktx.size())) {
+			result.error = "failed to write " + cookedPath.string() + "!";
+			return;
+		}
+		result.width = mips[0].width;
+		result.height = mips[0].height;
+		result.levelNum = uint32_t(mips.size());
+		result.cookedSize = ktx.size();
+	}
+
+	nlohmann::json readManifest(const std::filesystem::path& path)
+	{
+		std::ifstream in(path);
+		if (!in)
+			return {};
+		try {
+			auto manifest = nlohmann::json::parse(in);
+			if (manifest.value("version", 0u) != COOKED_TEXTURES_VERSION || !manifest["textures"].is_array())
+				return {};
+			return manifest;
+		}
+		catch (const nlohmann::json::exception&) {
+			return {};
+		}
+	}
+}
+
+const char* getTextureRoleName(TextureRole role)
+{
+	switch (role) {
+	case TextureRole::Color: return "color";
+	case TextureRole::Normal: return "normal";
+	case TextureRole::Occlusion: return "occlusion";
+	case TextureRole::MetallicRoughness: return "metallic-roughness";
+	case TextureRole::Data: return "data";
+	}
+	return "unknown";
+}
+
+std::string getCookedTextureDir(const std::string& filename, const std::string& cacheDir)
+{
+	if (cacheDir.empty())
+		return filename + ".textures";
+	auto name = std::filesystem::path(filename).filename().string();
+	return (std::filesystem::path(cacheDir) / (name + ".textures")).string();
+}
+
+std::vector<TextureCookResult> cookGltfTextures(const std::string& filename, const std::string& textureDir,
+	const TextureCookOptions& options)
+{
+	GltfDocument doc;
+	std::string warn, error;
+	if (!doc.load(filename, &error, &warn))
+		throw std::runtime_error("failed to load " + filename + ": " + error);
+	const auto& tModel = doc.getModel();
+
+	// Texture paths are built the same way as Scene::loadGLTFFile builds them
+	std::string sourceDir = filename.substr(0, filename.find_last_of('/') + 1);
+	std::filesystem::path outDir{ textureDir };
+	std::filesystem::create_directories(outDir);
+
+	// Previous hashes by source uri
+	std::unordered_map<std::string, std::pair<uint64_t, std::string>> previous;
+	auto oldManifest = readManifest(outDir / MANIFEST_NAME);
+	if (!oldManifest.is_null()) {
+		for (const auto& entry : oldManifest["textures"])
+			previous[entry.value("source", "")] = { entry.value("hash", uint64_t(0)), entry.value("cooked", "") };
+	}
+
+	// Images embedded in a buffer or a data uri are not files the loader could swap out
+	// Several images may share a file, their uses are merged
+	auto uses = findImageUses(tModel);
+	std::vector<std::string> uris;
+	std::unordered_map<std::string, uint32_t> uriUses;
+	for (size_t i = 0; i < tModel.images.size(); ++i) {
+		const auto& uri = tModel.images[i].uri;
+		if (uri.empty() || uri.compare(0, 5, "data:") == 0 || uses[i] == 0)
+			continue;
+		if (uriUses.find(uri) == uriUses.end())
+			uris.push_back(uri);
+		uriUses[uri] |= uses[i];
+	}
+
+	std::vector<TextureCookResult> results(uris.size());
+	std::vector<uint64_t> hashes(uris.size(), 0);
+	for (size_t i = 0; i < uris.size(); ++i) {
+		auto& result = results[i];
+		result.source = uris[i];
+		result.cooked = getCookedName(uris[i]);
+		result.role = pickRole(uriUses[uris[i]]);
+		result.vkFormat = getRoleEncoding(result.role).vkFormat;
+	}
+
+	ThreadPool pool{ options.threadCount };
+	pool.parallelFor(results.size(), [&](size_t i) {
+		auto& result = results[i];
+		auto sourcePath = std::filesystem::path(sourceDir + result.source);
+		auto cookedPath = outDir / result.cooked;
+
+		MappedFile source{ sourcePath.string() };
+		if (!source.isOpen()) {
+			result.error = "failed to open file!";
+			return;
+		}
+		// The role is part of the hash, a texture used in another way is cooked again
+		hashes[i] = hashBytes(source.getData(), source.getSize(),
+			(uint64_t(COOKED_TEXTURES_VERSION) << 32) | uint32_t(result.role));
+
+		auto old = previous.find(result.source);
+		if (!options.force && old != previous.end() && old->second.first == hashes[i] &&
+			old->second.second == result.cooked && std::filesystem::exists(cookedPath)) {
+			result.skipped = true;
+			return;
+		}
+		cookTexture(source, cookedPath, pool, options.measureError, result);
+	});
+
+	nlohmann::json entries = nlohmann::json::array();
+	for (size_t i = 0; i < results.size(); ++i) {
+		const auto& result = results[i];
+		if (!result.error.empty())
+			continue;
+
+		std::error_code ec;
+		auto sourcePath = std::filesystem::path(sourceDir + result.source);
+		entries.push_back({
+			{ "source", result.source },
+			{ "cooked", result.cooked },
+			{ "role", getTextureRoleName(result.role) },
+			{ "hash", hashes[i] },
+			{ "size", uint64_t(std::filesystem::file_size(sourcePath, ec)) },
+			{ "mtime", getWriteTime(sourcePath) },
+		});
+	}
+	nlohmann::json manifest{ { "version", COOKED_TEXTURES_VERSION }, { "textures", entries } };
+	auto text = manifest.dump(1, '\t');
+	if (!writeFile(outDir / MANIFEST_NAME, text.data(), text.size()))
+		throw std::runtime_error("failed to write texture manifest!");
+	return results;
+}
+
+std::unordered_map<std::string, std::string> readCookedTextures(const std::string& textureDir, const std::string& sourceDir)
+{
+	std::unordered_map<std::string, std::string> cooked;
+	std::filesystem::path dir{ textureDir };
+	auto manifest = readManifest(dir / MANIFEST_NAME);
+	if (manifest.is_null())
+		return cooked;
+
+	try {
+		for (const auto& entry : manifest["textures"]) {
+			std::string source = sourceDir + entry.at("source").get<std::string>();
+			auto cookedPath = dir / entry.at("cooked").get<std::string>();
+
+			// Size and write time stand in for the hash, hashing every image would cost more than it saves
+			std::error_code ec;
+			auto size = std::filesystem::file_size(source, ec);
+			if (ec || size != entry.at("size").get<uint64_t>() || getWriteTime(source) != entry.at("mtime").get<int64_t>() ||
+				!std::filesystem::exists(cookedPath, ec))
+				continue;
+			cooked.emplace(source, cookedPath.generic_string());
+		}
+	}
+	catch (const nlohmann::json::exception&) {
+		cooked.clear();
+	}
+	return cooked;
+}
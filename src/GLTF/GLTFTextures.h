@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Cooked textures: the images of a glTF file converted offline (see Tools/TextureCook.cpp)
+// into KTX2 files that hold the whole mip chain, block compressed by how the materials sample them.
+// manifest.json in the texture directory lists them with the size and write time of their source,
+// the loader only takes a cooked file while its source is unchanged.
+
+// Bump whenever the cooked output changes, every texture is cooked again
+constexpr uint32_t COOKED_TEXTURES_VERSION = 1;
+
+enum class TextureRole
+{
+	Color,				// Base color, emissive, diffuse, specular-glossiness: BC7, mips filtered in linear light
+	Normal,				// Tangent space XY in BC5, the shader rebuilds Z
+	Occlusion,			// R in BC4
+	MetallicRoughness,	// G and B in BC5, swizzled back into G and B
+	Data,				// Used in several ways or read from other channels: BC7
+};
+
+const char* getTextureRoleName(TextureRole role);
+
+// cacheDir may be empty, the directory then sits next to the source
+std::string getCookedTextureDir(const std::string& filename, const std::string& cacheDir);
+
+struct TextureCookOptions
+{
+	// Worker threads, 0 picks the hardware concurrency
+	uint32_t threadCount{ 0 };
+	// Cook every texture, even those whose source is unchanged
+	bool force{ false };
+	// Decode the base level again and compare it with the source, fills TextureCookResult::psnr
+	bool measureError{ false };
+};
+
+struct TextureCookResult
+{
+	std::string source;		// uri in the glTF file
+	std::string cooked;		// File name in the texture directory
+	TextureRole role{ TextureRole::Data };
+	uint32_t vkFormat{ 0 };
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	uint32_t levelNum{ 0 };
+	size_t cookedSize{ 0 };
+	bool skipped{ false };	// Source hash unchanged since the last cook
+	double psnr{ 0.0 };		// Of the stored channels of the base level, with measureError
+	std::string error;		// Not cooked, the loader keeps using the source
+};
+
+// Cooks every image the glTF file references by uri into textureDir and rewrites the manifest.
+// Images are cooked in parallel, each one also compresses its blocks in parallel.
+// Throws std::runtime_error if the glTF file cannot be loaded, a failed image only sets its error.
+std::vector<TextureCookResult> cookGltfTextures(const std::string& filename, const std::string& textureDir,
+	const TextureCookOptions& options = {});
+
+// Maps sourceDir + uri of every cooked image whose source is unchanged to the path of its KTX2 file.
+// Empty if there is no manifest or it was written by another version.
+std::unordered_map<std::string, std::string> readCookedTextures(const std::string& textureDir, const std::string& sourceDir);
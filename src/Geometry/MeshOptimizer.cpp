@@ -0,0 +1,323 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+#include "Utils/Hash.h"
+
+namespace {
+	// Triangles using each vertex, stored as one flat list with per-vertex offsets
+	struct TriangleAdjacency
+	{
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> triangles;
+	};
+
+	TriangleAdjacency buildAdjacency(const std::vector<uint32_t>& indices, size_t vertexNum)
+	{
+		TriangleAdjacency adjacency;
+		adjacency.offsets.assign(vertexNum + 1, 0);
+		for (auto index : indices)
+			adjacency.offsets[index + 1]++;
+		for (size_t v = 0; v < vertexNum; ++v)
+			adjacency.offsets[v + 1] += adjacency.offsets[v];
+
+		std::vector<uint32_t> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+		adjacency.triangles.resize(indices.size());
+		for (size_t i = 0; i < indices.size(); ++i)
+			adjacency.triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		return adjacency;
+	}
+
+	// FIFO cache built on timestamps: a vertex is resident while fewer than
+	// cacheSize other vertices were inserted after it. Advancing time by
+	// cacheSize + 1 flushes the whole cache.
+	class FifoCache
+	{
+	public:
+		FifoCache(size_t vertexNum, uint32_t cacheSize) :
+			cacheTime(vertexNum, 0), cacheSize{ cacheSize }, time{ cacheSize + 1 } {}
+
+		// Returns true on a miss
+		bool access(uint32_t vertex)
+		{
+			if (time - cacheTime[vertex] <= cacheSize)
+				return false;
+			cacheTime[vertex] = time++;
+			return true;
+		}
+
+		uint32_t age(uint32_t vertex) const { return time - cacheTime[vertex]; }
+
+		void flush() { time += cacheSize + 1; }
+
+	private:
+		std::vector<uint32_t> cacheTime;
+		uint32_t cacheSize;
+		uint32_t time;
+	};
+
+	void checkIndices(const std::vector<uint32_t>& indices, size_t vertexNum)
+	{
+		for (auto index : indices) {
+			if (index >= vertexNum)
+				throw std::runtime_error("MeshOptimizer: index out of range");
+		}
+	}
+}
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexNum, uint32_t cacheSize)
+{
+	VertexCacheStats stats{};
+	if (indices.empty())
+		return stats;
+	checkIndices(indices, vertexNum);
+
+	FifoCache cache{ vertexNum, cacheSize };
+	std::vector<uint8_t> referenced(vertexNum, 0);
+	uint32_t referencedNum = 0;
+	for (auto index : indices) {
+		stats.misses += cache.access(index);
+		referencedNum += !referenced[index];
+		referenced[index] = 1;
+	}
+
+	stats.acmr = float(stats.misses) / float(indices.size() / 3);
+	stats.atvr = float(stats.misses) / float(referencedNum);
+	return stats;
+}
+
+size_t weldVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	const size_t vertexNum = vertices.size();
+	if (vertexNum < 2)
+		return 0;
+	checkIndices(indices, vertexNum);
+
+	// Open addressing table of indices into the compacted vertex array, at most half full
+	const uint32_t EMPTY = UINT32_MAX;
+	size_t tableSize = 1;
+	while (tableSize < vertexNum * 2)
+		tableSize <<= 1;
+	std::vector<uint32_t> table(tableSize, EMPTY);
+
+	std::vector<uint32_t> remap(vertexNum);
+	uint32_t uniqueNum = 0;
+	for (size_t i = 0; i < vertexNum; ++i) {
+		const Vertex& vertex = vertices[i];
+		size_t slot = hashBytes(&vertex, sizeof(Vertex)) & (tableSize - 1);
+		while (table[slot] != EMPTY && memcmp(&vertices[table[slot]], &vertex, sizeof(Vertex)) != 0)
+			slot = (slot + 1) & (tableSize - 1);
+
+		if (table[slot] == EMPTY) {
+			// Survivors move down in place, every slot below i is already final
+			vertices[uniqueNum] = vertex;
+			table[slot] = uniqueNum++;
+		}
+		remap[i] = table[slot];
+	}
+
+	for (auto& index : indices)
+		index = remap[index];
+
+	vertices.resize(uniqueNum);
+	return vertexNum - uniqueNum;
+}
+
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexNum, uint32_t cacheSize)
+{
+	const size_t triangleNum = indices.size() / 3;
+	if (triangleNum < 2 || indices.size() % 3 != 0)
+		return;
+	checkIndices(indices, vertexNum);
+
+	auto adjacency = buildAdjacency(indices, vertexNum);
+	std::vector<uint32_t> live(vertexNum);
+	for (size_t v = 0; v < vertexNum; ++v)
+		live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+
+	FifoCache cache{ vertexNum, cacheSize };
+	std::vector<uint8_t> emitted(triangleNum, 0);
+	std::vector<uint32_t> deadEnd;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> result;
+	deadEnd.reserve(indices.size());
+	result.reserve(indices.size());
+
+	size_t cursor = 0;
+	int64_t fanning = indices[0];
+	while (fanning >= 0) {
+		// Emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (uint32_t i = adjacency.offsets[fanning]; i < adjacency.offsets[fanning + 1]; ++i) {
+			uint32_t triangle = adjacency.triangles[i];
+			if (emitted[triangle])
+				continue;
+			emitted[triangle] = 1;
+
+			for (uint32_t k = 0; k < 3; ++k) {
+				uint32_t v = indices[triangle * 3 + k];
+				result.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				cache.access(v);
+			}
+		}
+
+		// Prefer the oldest candidate that will still be resident once all of its triangles are emitted
+		int64_t next = -1;
+		int64_t bestPriority = -1;
+		for (auto v : candidates) {
+			if (live[v] == 0)
+				continue;
+			int64_t priority = 0;
+			if (cache.age(v) + 2 * live[v] <= cacheSize)
+				priority = cache.age(v);
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				next = v;
+			}
+		}
+
+		// Dead end: go back to a recently used vertex, then to any vertex left
+		while (next < 0 && !deadEnd.empty()) {
+			uint32_t v = deadEnd.back();
+			deadEnd.pop_back();
+			if (live[v] > 0)
+				next = v;
+		}
+		if (next < 0) {
+			while (cursor < vertexNum && live[cursor] == 0)
+				++cursor;
+			if (cursor < vertexNum)
+				next = static_cast<int64_t>(cursor);
+		}
+		fanning = next;
+	}
+
+	indices.swap(result);
+}
+
+void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold)
+{
+	const size_t triangleNum = indices.size() / 3;
+	if (triangleNum < 2 || indices.size() % 3 != 0)
+		return;
+	checkIndices(indices, vertices.size());
+
+	// Hard boundaries: a triangle missing all three vertices starts from a cold cache anyway
+	std::vector<uint32_t> hardClusters;
+	{
+		FifoCache cache{ vertices.size(), VERTEX_CACHE_SIZE };
+		for (size_t t = 0; t < triangleNum; ++t) {
+			uint32_t misses = 0;
+			for (uint32_t k = 0; k < 3; ++k)
+				misses += cache.access(indices[t * 3 + k]);
+			if (t == 0 || misses == 3)
+				hardClusters.push_back(static_cast<uint32_t>(t));
+		}
+		hardClusters.push_back(static_cast<uint32_t>(triangleNum));
+	}
+
+	// Soft boundaries: close a cluster as soon as its ACMR from a cold cache stays
+	// within threshold of the hard cluster it belongs to, so any draw order is bounded
+	std::vector<uint32_t> clusters;
+	{
+		FifoCache cache{ vertices.size(), VERTEX_CACHE_SIZE };
+		for (size_t h = 0; h + 1 < hardClusters.size(); ++h) {
+			uint32_t begin = hardClusters[h], end = hardClusters[h + 1];
+
+			cache.flush();
+			uint32_t hardMisses = 0;
+			for (uint32_t t = begin; t < end; ++t)
+				for (uint32_t k = 0; k < 3; ++k)
+					hardMisses += cache.access(indices[t * 3 + k]);
+			float limit = float(hardMisses) / float(end - begin) * threshold;
+
+			cache.flush();
+			uint32_t start = begin, misses = 0;
+			clusters.push_back(begin);
+			for (uint32_t t = begin; t < end; ++t) {
+				if (t > start && float(misses) / float(t - start) <= limit) {
+					clusters.push_back(t);
+					cache.flush();
+					start = t;
+					misses = 0;
+				}
+				for (uint32_t k = 0; k < 3; ++k)
+					misses += cache.access(indices[t * 3 + k]);
+			}
+		}
+		clusters.push_back(static_cast<uint32_t>(triangleNum));
+	}
+
+	const size_t clusterNum = clusters.size() - 1;
+	if (clusterNum < 2)
+		return;
+
+	// Area weighted centroid and normal of every cluster
+	std::vector<glm::vec3> centroids(clusterNum, glm::vec3(0.0f));
+	std::vector<glm::vec3> normals(clusterNum, glm::vec3(0.0f));
+	std::vector<float> areas(clusterNum, 0.0f);
+	glm::vec3 meshCentroid{ 0.0f };
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < clusterNum; ++c) {
+		for (uint32_t t = clusters[c]; t < clusters[c + 1]; ++t) {
+			const glm::vec3& p0 = vertices[indices[t * 3 + 0]].pos;
+			const glm::vec3& p1 = vertices[indices[t * 3 + 1]].pos;
+			const glm::vec3& p2 = vertices[indices[t * 3 + 2]].pos;
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float area = glm::length(normal);
+
+			centroids[c] += (p0 + p1 + p2) * (area / 3.0f);
+			normals[c] += normal;
+			areas[c] += area;
+		}
+		meshCentroid += centroids[c];
+		meshArea += areas[c];
+	}
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	// Clusters facing away from the center are likely in front, draw them first
+	std::vector<float> sortKeys(clusterNum, 0.0f);
+	for (size_t c = 0; c < clusterNum; ++c) {
+		if (areas[c] <= 0.0f)
+			continue;
+		glm::vec3 centroid = centroids[c] / areas[c];
+		float normalLength = glm::length(normals[c]);
+		if (normalLength > 0.0f)
+			sortKeys[c] = glm::dot(centroid - meshCentroid, normals[c] / normalLength);
+	}
+
+	std::vector<uint32_t> order(clusterNum);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	for (auto c : order)
+		result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+	indices.swap(result);
+}
+
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	checkIndices(indices, vertices.size());
+
+	const uint32_t UNUSED = UINT32_MAX;
+	std::vector<uint32_t> remap(vertices.size(), UNUSED);
+	std::vector<Vertex> result;
+	result.reserve(vertices.size());
+	for (auto& index : indices) {
+		if (remap[index] == UNUSED) {
+			remap[index] = static_cast<uint32_t>(result.size());
+			result.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices.swap(result);
+}
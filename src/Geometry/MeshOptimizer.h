@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Vertex.h"
+
+// CPU side preprocessing of decoded primitives, run once at import time.
+// The usual order is weld, vertex cache, overdraw, then vertex fetch.
+
+// Post-transform cache size the optimizers and the statistics assume
+constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+struct VertexCacheStats
+{
+	uint32_t misses{ 0 };
+	// Average cache miss ratio, transformed vertices per triangle (0.5 .. 3)
+	float acmr{ 0.0f };
+	// Average transform to vertex ratio, transformed vertices per referenced vertex (1 is ideal)
+	float atvr{ 0.0f };
+};
+
+// Simulates a FIFO post-transform cache over the triangle list
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexNum, 
+	uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+// Merges bitwise identical vertices and remaps the indices onto the survivors.
+// The first occurrence of a vertex keeps its relative order.
+// Returns the number of vertices that were removed.
+size_t weldVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+// Reorders triangles for post-transform cache reuse (Tipsify, Sander et al. 2007).
+// Triangles are kept intact, so the winding does not change.
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexNum, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+// Splits a cache optimized triangle list into clusters and draws the clusters that
+// face outwards first, so that they occlude the rest. threshold bounds the ACMR
+// increase allowed by the extra cluster splits (1.05 = at most 5% worse).
+void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold = 1.05f);
+
+// Sorts vertices by first use in the index buffer and drops unreferenced ones
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
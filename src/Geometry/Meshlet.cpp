@@ -0,0 +1,234 @@
+#include "Meshlet.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "Utils/Hash.h"
+
+namespace {
+	constexpr uint32_t NO_LOCAL_INDEX = UINT32_MAX;
+
+	// Ritter's bounding sphere: start from the most distant pair of axis extremes, then grow
+	void computeSphere(const std::vector<glm::vec3>& points, glm::vec3& center, float& radius)
+	{
+		std::array<size_t, 3> minIdx{}, maxIdx{};
+		for (size_t i = 0; i < points.size(); ++i) {
+			for (int axis = 0; axis < 3; ++axis) {
+				if (points[i][axis] < points[minIdx[axis]][axis])
+					minIdx[axis] = i;
+				if (points[i][axis] > points[maxIdx[axis]][axis])
+					maxIdx[axis] = i;
+			}
+		}
+
+		int widest = 0;
+		float widestDist = -1.0f;
+		for (int axis = 0; axis < 3; ++axis) {
+			float dist = glm::dot(points[maxIdx[axis]] - points[minIdx[axis]], points[maxIdx[axis]] - points[minIdx[axis]]);
+			if (dist > widestDist) {
+				widestDist = dist;
+				widest = axis;
+			}
+		}
+
+		center = (points[minIdx[widest]] + points[maxIdx[widest]]) * 0.5f;
+		radius = std::sqrt(widestDist) * 0.5f;
+		for (const auto& p : points) {
+			float dist = glm::length(p - center);
+			if (dist > radius) {
+				float grow = (dist - radius) * 0.5f;
+				center += (p - center) * (grow / dist);
+				radius += grow;
+			}
+		}
+	}
+}
+
+MeshletData buildMeshlets(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices,
+	uint32_t maxVertices, uint32_t maxTriangles)
+{
+	if (maxVertices < 3 || maxVertices > 256 || maxTriangles < 1)
+		throw std::runtime_error("buildMeshlets: invalid meshlet limits");
+	for (auto index : indices) {
+		if (index >= vertices.size())
+			throw std::runtime_error("buildMeshlets: index out of range");
+	}
+
+	MeshletData data;
+	std::vector<uint32_t> localIndex(vertices.size(), NO_LOCAL_INDEX);
+	Meshlet current{};
+
+	auto finish = [&]() {
+		if (current.triangleCount == 0)
+			return;
+		for (uint32_t i = 0; i < current.vertexCount; ++i)
+			localIndex[data.vertices[current.vertexOffset + i]] = NO_LOCAL_INDEX;
+		data.meshlets.push_back(current);
+		current = {};
+		current.vertexOffset = static_cast<uint32_t>(data.vertices.size());
+		current.triangleOffset = static_cast<uint32_t>(data.triangles.size());
+	};
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		const uint32_t* tri = &indices[i];
+		uint32_t newVertices = (localIndex[tri[0]] == NO_LOCAL_INDEX) + 
+			(localIndex[tri[1]] == NO_LOCAL_INDEX && tri[1] != tri[0]) +
+			(localIndex[tri[2]] == NO_LOCAL_INDEX && tri[2] != tri[0] && tri[2] != tri[1]);
+		if (current.vertexCount + newVertices > maxVertices || current.triangleCount + 1 > maxTriangles)
+			finish();
+
+		for (int k = 0; k < 3; ++k) {
+			auto& local = localIndex[tri[k]];
+			if (local == NO_LOCAL_INDEX) {
+				local = current.vertexCount++;
+				data.vertices.push_back(tri[k]);
+			}
+			data.triangles.push_back(static_cast<uint8_t>(local));
+		}
+		current.triangleCount++;
+	}
+	finish();
+
+	data.bounds.reserve(data.meshlets.size());
+	for (const auto& meshlet : data.meshlets)
+		data.bounds.push_back(computeMeshletBounds(data, meshlet, vertices));
+	return data;
+}
+
+MeshletBounds computeMeshletBounds(const MeshletData& data, const Meshlet& meshlet, const std::vector<Vertex>& vertices)
+{
+	MeshletBounds bounds{};
+	if (meshlet.vertexCount == 0)
+		return bounds;
+
+	std::vector<glm::vec3> points(meshlet.vertexCount);
+	for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+		points[i] = vertices[data.vertices[meshlet.vertexOffset + i]].pos;
+
+	bounds.aabbMin = bounds.aabbMax = points[0];
+	for (const auto& p : points) {
+		bounds.aabbMin = glm::min(bounds.aabbMin, p);
+		bounds.aabbMax = glm::max(bounds.aabbMax, p);
+	}
+	computeSphere(points, bounds.center, bounds.radius);
+
+	// Normal cone over the triangle face normals, degenerate triangles do not vote
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec3> corners;
+	normals.reserve(meshlet.triangleCount);
+	corners.reserve(meshlet.triangleCount);
+	glm::vec3 axis{ 0.0f };
+	for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+		const uint8_t* tri = &data.triangles[meshlet.triangleOffset + t * 3];
+		glm::vec3 n = glm::cross(points[tri[1]] - points[tri[0]], points[tri[2]] - points[tri[0]]);
+		float area = glm::length(n);
+		if (area == 0.0f)
+			continue;
+		normals.push_back(n / area);
+		corners.push_back(points[tri[0]]);
+		axis += normals.back();
+	}
+
+	bounds.coneCutoff = 1.0f;
+	float axisLength = glm::length(axis);
+	if (normals.empty() || axisLength == 0.0f)
+		return bounds;
+	axis /= axisLength;
+
+	float minDot = 1.0f;
+	for (const auto& n : normals)
+		minDot = std::min(minDot, glm::dot(axis, n));
+	// Beyond ~84 degrees the cone would almost never cull anything
+	if (minDot <= 0.1f)
+		return bounds;
+
+	// Move the apex back far enough that every triangle plane is in front of it
+	float maxT = 0.0f;
+	for (size_t i = 0; i < normals.size(); ++i) {
+		float t = glm::dot(bounds.center - corners[i], normals[i]) / glm::dot(axis, normals[i]);
+		maxT = std::max(maxT, t);
+	}
+
+	bounds.coneAxis = axis;
+	bounds.coneApex = bounds.center - axis * maxT;
+	bounds.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+	return bounds;
+}
+
+std::string validateMeshlets(const MeshletData& data, const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices,
+	uint32_t maxVertices, uint32_t maxTriangles)
+{
+	if (data.bounds.size() != data.meshlets.size())
+		return "bounds and meshlets differ in count";
+
+	// Triangles are compared as sorted vertex triples, each source triangle has to come out once
+	using Triangle = std::array<uint32_t, 3>;
+	struct TriangleHash
+	{
+		size_t operator()(const Triangle& tri) const { return static_cast<size_t>(hashBytes(tri.data(), sizeof(tri))); }
+	};
+	auto makeTriangle = [](uint32_t a, uint32_t b, uint32_t c) {
+		Triangle tri{ a, b, c };
+		std::sort(tri.begin(), tri.end());
+		return tri;
+	};
+
+	std::unordered_map<Triangle, int, TriangleHash> remaining;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		remaining[makeTriangle(indices[i], indices[i + 1], indices[i + 2])]++;
+
+	for (size_t m = 0; m < data.meshlets.size(); ++m) {
+		const auto& meshlet = data.meshlets[m];
+		const auto& bounds = data.bounds[m];
+		std::string prefix = "meshlet " + std::to_string(m) + ": ";
+
+		if (meshlet.vertexCount > maxVertices || meshlet.triangleCount > maxTriangles || meshlet.triangleCount == 0)
+			return prefix + "size limits violated";
+		if (size_t(meshlet.vertexOffset) + meshlet.vertexCount > data.vertices.size() ||
+			size_t(meshlet.triangleOffset) + meshlet.triangleCount * 3 > data.triangles.size())
+			return prefix + "out of range";
+
+		for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+			uint32_t tri[3];
+			for (int k = 0; k < 3; ++k) {
+				uint8_t local = data.triangles[meshlet.triangleOffset + t * 3 + k];
+				if (local >= meshlet.vertexCount)
+					return prefix + "local index out of range";
+				tri[k] = data.vertices[meshlet.vertexOffset + local];
+			}
+			auto it = remaining.find(makeTriangle(tri[0], tri[1], tri[2]));
+			if (it == remaining.end() || it->second == 0)
+				return prefix + "triangle not in the mesh or duplicated";
+			it->second--;
+
+			// Every face normal has to lie inside the cone
+			const auto& p0 = vertices[tri[0]].pos;
+			glm::vec3 n = glm::cross(vertices[tri[1]].pos - p0, vertices[tri[2]].pos - p0);
+			if (bounds.coneCutoff < 1.0f && glm::length(n) > 0.0f &&
+				glm::dot(glm::normalize(n), bounds.coneAxis) < std::sqrt(1.0f - bounds.coneCutoff * bounds.coneCutoff) - 1e-3f)
+				return prefix + "face normal outside the normal cone";
+		}
+
+		// Relative tolerance, the sphere is grown in float
+		float eps = 1e-4f * std::max(1.0f, bounds.radius);
+		for (uint32_t i = 0; i < meshlet.vertexCount; ++i) {
+			uint32_t index = data.vertices[meshlet.vertexOffset + i];
+			if (index >= vertices.size())
+				return prefix + "vertex index out of range";
+			const auto& p = vertices[index].pos;
+			if (glm::length(p - bounds.center) > bounds.radius + eps)
+				return prefix + "vertex outside the bounding sphere";
+			if (glm::any(glm::lessThan(p, bounds.aabbMin - eps)) || glm::any(glm::greaterThan(p, bounds.aabbMax + eps)))
+				return prefix + "vertex outside the bounding box";
+		}
+	}
+
+	for (const auto& [tri, count] : remaining) {
+		if (count != 0)
+			return "a triangle is not covered by any meshlet";
+	}
+	return {};
+}
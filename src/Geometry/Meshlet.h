@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Vertex.h"
+
+// Splits a triangle list into small clusters (meshlets) for cluster level
+// frustum, backface and occlusion culling.
+
+constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+// 124 instead of 128 keeps the local triangle list of a full meshlet a multiple of 4 bytes
+constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+struct Meshlet
+{
+	// Offsets into MeshletData::vertices and MeshletData::triangles (in bytes, 3 per triangle)
+	uint32_t vertexOffset;
+	uint32_t triangleOffset;
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+};
+
+// Plain floats only, the array is uploaded as is and read with the scalar layout
+struct MeshletBounds
+{
+	glm::vec3 center;
+	float radius;
+
+	glm::vec3 aabbMin;
+	glm::vec3 aabbMax;
+
+	// The whole meshlet faces away from a viewer at camera when
+	// dot(normalize(coneApex - camera), coneAxis) >= coneCutoff.
+	// coneCutoff is 1 when the triangles spread too far to ever cull.
+	glm::vec3 coneApex;
+	glm::vec3 coneAxis;
+	float coneCutoff;
+};
+
+struct MeshletData
+{
+	std::vector<Meshlet> meshlets;
+	std::vector<MeshletBounds> bounds;
+	// Mesh vertex index of every meshlet vertex
+	std::vector<uint32_t> vertices;
+	// Meshlet local vertex indices, 3 per triangle
+	std::vector<uint8_t> triangles;
+};
+
+// Greedily fills meshlets in index buffer order, so a cache optimized index buffer
+// gives meshlets with few shared vertices. The result only depends on the input.
+MeshletData buildMeshlets(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices,
+	uint32_t maxVertices = MESHLET_MAX_VERTICES, uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
+
+MeshletBounds computeMeshletBounds(const MeshletData& data, const Meshlet& meshlet, const std::vector<Vertex>& vertices);
+
+// Checks that every triangle of indices is in exactly one meshlet, the limits hold
+// and the bounds enclose the meshlet. Returns an empty string if all is fine.
+std::string validateMeshlets(const MeshletData& data, const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices,
+	uint32_t maxVertices = MESHLET_MAX_VERTICES, uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
@@ -0,0 +1,300 @@
+#include "Simplify.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "MeshOptimizer.h"
+#include "Utils/Hash.h"
+
+namespace {
+	// Symmetric 4x4 matrix of the weighted squared plane distances
+	struct Quadric
+	{
+		double a2{ 0 }, b2{ 0 }, c2{ 0 }, d2{ 0 };
+		double ab{ 0 }, ac{ 0 }, ad{ 0 }, bc{ 0 }, bd{ 0 }, cd{ 0 };
+		double weight{ 0 };
+
+		void addPlane(const glm::vec3& n, float d, float weight)
+		{
+			double a = n.x, b = n.y, c = n.z;
+			a2 += a * a * weight; b2 += b * b * weight; c2 += c * c * weight; d2 += double(d) * d * weight;
+			ab += a * b * weight; ac += a * c * weight; ad += a * d * weight;
+			bc += b * c * weight; bd += b * d * weight; cd += c * d * weight;
+			this->weight += weight;
+		}
+
+		void add(const Quadric& q)
+		{
+			a2 += q.a2; b2 += q.b2; c2 += q.c2; d2 += q.d2;
+			ab += q.ab; ac += q.ac; ad += q.ad; bc += q.bc; bd += q.bd; cd += q.cd;
+			weight += q.weight;
+		}
+
+		// Weighted mean squared distance of p to the planes
+		double error(const glm::vec3& p) const
+		{
+			if (weight <= 0.0)
+				return 0.0;
+			double x = p.x, y = p.y, z = p.z;
+			double e = a2 * x * x + b2 * y * y + c2 * z * z + d2 +
+				2.0 * (ab * x * y + ac * x * z + bc * y * z + ad * x + bd * y + cd * z);
+			return std::max(e / weight, 0.0);
+		}
+	};
+
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		double cost;
+	};
+
+	uint64_t edgeKey(uint32_t a, uint32_t b)
+	{
+		return a < b ? (uint64_t(a) << 32 | b) : (uint64_t(b) << 32 | a);
+	}
+
+	// Lowest index of every bitwise identical position
+	std::vector<uint32_t> buildPositionRemap(const std::vector<Vertex>& vertices)
+	{
+		std::vector<uint32_t> remap(vertices.size());
+		std::unordered_map<uint64_t, std::vector<uint32_t>> buckets;
+		for (uint32_t i = 0; i < vertices.size(); ++i) {
+			auto& bucket = buckets[hashBytes(&vertices[i].pos, sizeof(glm::vec3))];
+			remap[i] = i;
+			for (auto other : bucket) {
+				if (memcmp(&vertices[other].pos, &vertices[i].pos, sizeof(glm::vec3)) == 0) {
+					remap[i] = other;
+					break;
+				}
+			}
+			if (remap[i] == i)
+				bucket.push_back(i);
+		}
+		return remap;
+	}
+
+	glm::vec3 triangleNormal(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2)
+	{
+		return glm::cross(p1 - p0, p2 - p0);
+	}
+
+	// Edge collapse state. run() can be called with falling targets, each call
+	// continues from the previous result with the quadrics gathered so far.
+	class Simplifier
+	{
+	public:
+		Simplifier(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices);
+
+		void run(size_t targetIndexNum, float targetError);
+
+		const std::vector<uint32_t>& getResult() const { return result; }
+		float getError() const { return static_cast<float>(std::sqrt(maxError)); }
+
+	private:
+		const std::vector<Vertex>& vertices;
+		std::vector<uint32_t> result;
+		std::vector<uint32_t> positionRemap;
+		std::vector<uint8_t> locked;
+		std::vector<Quadric> quadrics;
+		double maxError{ 0.0 };
+	};
+
+	Simplifier::Simplifier(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices) :
+		vertices{ vertices }, result(indices.begin(), indices.end() - indices.size() % 3)
+	{
+		for (auto index : result) {
+			if (index >= vertices.size())
+				throw std::runtime_error("simplifyMesh: index out of range");
+		}
+
+		const size_t vertexNum = vertices.size();
+		positionRemap = buildPositionRemap(vertices);
+
+		// Seams: a position shared by several vertices. Borders: an edge used by a single triangle.
+		locked.assign(vertexNum, 0);
+		std::vector<uint32_t> positionUses(vertexNum, 0);
+		for (size_t v = 0; v < vertexNum; ++v)
+			positionUses[positionRemap[v]]++;
+		for (size_t v = 0; v < vertexNum; ++v)
+			locked[v] = positionUses[positionRemap[v]] > 1;
+
+		std::unordered_map<uint64_t, uint32_t> edgeUses;
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (int k = 0; k < 3; ++k)
+				edgeUses[edgeKey(positionRemap[result[i + k]], positionRemap[result[i + (k + 1) % 3]])]++;
+		}
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (int k = 0; k < 3; ++k) {
+				uint32_t a = result[i + k], b = result[i + (k + 1) % 3];
+				if (edgeUses[edgeKey(positionRemap[a], positionRemap[b])] == 1)
+					locked[a] = locked[b] = 1;
+			}
+		}
+
+		// Area weighted plane quadrics
+		quadrics.resize(vertexNum);
+		for (size_t i = 0; i < result.size(); i += 3) {
+			const glm::vec3& p0 = vertices[result[i]].pos;
+			glm::vec3 n = triangleNormal(p0, vertices[result[i + 1]].pos, vertices[result[i + 2]].pos);
+			float area = glm::length(n);
+			if (area == 0.0f)
+				continue;
+			n /= area;
+			for (int k = 0; k < 3; ++k)
+				quadrics[result[i + k]].addPlane(n, -glm::dot(n, p0), area * 0.5f);
+		}
+	}
+
+	void Simplifier::run(size_t targetIndexNum, float targetError)
+	{
+		const size_t vertexNum = vertices.size();
+		const double errorLimit = double(targetError) * targetError;
+		std::vector<uint32_t> remap(vertexNum);
+		std::vector<uint8_t> dirty(vertexNum);
+		std::vector<Collapse> collapses;
+		std::vector<uint32_t> offsets, triangles;
+
+		// Each pass collapses an independent set of the cheapest edges, then rebuilds the index list
+		while (result.size() > targetIndexNum) {
+			const size_t triangleNum = result.size() / 3;
+
+			offsets.assign(vertexNum + 1, 0);
+			for (auto index : result)
+				offsets[index + 1]++;
+			for (size_t v = 0; v < vertexNum; ++v)
+				offsets[v + 1] += offsets[v];
+			std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+			triangles.resize(result.size());
+			for (size_t i = 0; i < result.size(); ++i)
+				triangles[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+
+			collapses.clear();
+			for (size_t i = 0; i < result.size(); i += 3) {
+				for (int k = 0; k < 3; ++k) {
+					uint32_t a = result[i + k], b = result[i + (k + 1) % 3];
+					for (auto [from, to] : { std::pair{ a, b }, std::pair{ b, a } }) {
+						if (locked[from])
+							continue;
+						Quadric q = quadrics[from];
+						q.add(quadrics[to]);
+						double cost = q.error(vertices[to].pos);
+						if (cost <= errorLimit)
+							collapses.push_back({ from, to, cost });
+					}
+				}
+			}
+			if (collapses.empty())
+				break;
+			// Ties are broken by index so the result never depends on the sort implementation
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) {
+				return x.cost != y.cost ? x.cost < y.cost : x.from != y.from ? x.from < y.from : x.to < y.to;
+			});
+
+			for (uint32_t v = 0; v < vertexNum; ++v)
+				remap[v] = v;
+			std::fill(dirty.begin(), dirty.end(), 0);
+
+			size_t removed = 0;
+			const size_t removeTarget = triangleNum - targetIndexNum / 3;
+			for (const auto& collapse : collapses) {
+				if (removed >= removeTarget)
+					break;
+				uint32_t from = collapse.from, to = collapse.to;
+				if (dirty[from] || dirty[to])
+					continue;
+
+				// Reject collapses that flip or degenerate a surviving triangle
+				bool flips = false;
+				size_t collapsedTriangles = 0;
+				for (uint32_t i = offsets[from]; i < offsets[from + 1] && !flips; ++i) {
+					const uint32_t* tri = &result[triangles[i] * 3];
+					if (tri[0] == to || tri[1] == to || tri[2] == to) {
+						collapsedTriangles++;
+						continue;
+					}
+					glm::vec3 p[3], q[3];
+					for (int k = 0; k < 3; ++k) {
+						p[k] = vertices[tri[k]].pos;
+						q[k] = tri[k] == from ? vertices[to].pos : p[k];
+					}
+					glm::vec3 before = triangleNormal(p[0], p[1], p[2]);
+					glm::vec3 after = triangleNormal(q[0], q[1], q[2]);
+					flips = glm::dot(before, after) <= 0.0f;
+				}
+				if (flips)
+					continue;
+
+				remap[from] = to;
+				quadrics[to].add(quadrics[from]);
+				maxError = std::max(maxError, collapse.cost);
+				removed += collapsedTriangles;
+				for (uint32_t i = offsets[from]; i < offsets[from + 1]; ++i) {
+					const uint32_t* tri = &result[triangles[i] * 3];
+					dirty[tri[0]] = dirty[tri[1]] = dirty[tri[2]] = 1;
+				}
+			}
+
+			std::vector<uint32_t> next;
+			next.reserve(result.size());
+			for (size_t i = 0; i < result.size(); i += 3) {
+				uint32_t a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+				uint32_t pa = positionRemap[a], pb = positionRemap[b], pc = positionRemap[c];
+				if (pa != pb && pb != pc && pa != pc)
+					next.insert(next.end(), { a, b, c });
+			}
+			if (next.size() == result.size())
+				break;
+			result.swap(next);
+		}
+	}
+}
+
+std::vector<uint32_t> simplifyMesh(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices,
+	size_t targetIndexNum, float targetError, float* resultError)
+{
+	Simplifier simplifier{ indices, vertices };
+	simplifier.run(targetIndexNum, targetError);
+	if (resultError)
+		*resultError = simplifier.getError();
+	return simplifier.getResult();
+}
+
+std::vector<MeshLod> generateLods(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices,
+	float maxRelativeError)
+{
+	std::vector<MeshLod> lods;
+	if (indices.size() / 3 < MESH_LOD_MIN_TRIANGLES || vertices.empty())
+		return lods;
+
+	glm::vec3 minPos = vertices[0].pos, maxPos = vertices[0].pos;
+	for (const auto& vertex : vertices) {
+		minPos = glm::min(minPos, vertex.pos);
+		maxPos = glm::max(maxPos, vertex.pos);
+	}
+	glm::vec3 extent = maxPos - minPos;
+	float maxError = std::max(extent.x, std::max(extent.y, extent.z)) * maxRelativeError;
+
+	// Each level continues from the previous one, the quadrics keep the error relative to the source
+	Simplifier simplifier{ indices, vertices };
+	size_t previousNum = indices.size();
+	for (uint32_t level = 1; level <= MESH_LOD_MAX_NUM; ++level) {
+		size_t target = (indices.size() >> level) / 3 * 3;
+		if (target / 3 < MESH_LOD_MIN_TRIANGLES / 4)
+			break;
+
+		simplifier.run(target, maxError);
+		MeshLod lod{ simplifier.getResult(), simplifier.getError() };
+		// A level less than 25% smaller than the last one is not worth a draw path
+		if (lod.indices.empty() || lod.indices.size() * 4 > previousNum * 3)
+			break;
+
+		optimizeVertexCache(lod.indices, vertices.size());
+		previousNum = lod.indices.size();
+		lods.push_back(std::move(lod));
+	}
+	return lods;
+}
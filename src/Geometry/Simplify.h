@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Vertex.h"
+
+// Quadric error mesh simplification (Garland and Heckbert 1997) and LOD chains built on it.
+// Vertices are never moved or created, a simplified index list references the
+// vertices of the source mesh, so every LOD can share one vertex buffer.
+
+// Extra levels generated after the full resolution mesh
+constexpr uint32_t MESH_LOD_MAX_NUM = 4;
+// Meshes below this are not worth a LOD chain
+constexpr uint32_t MESH_LOD_MIN_TRIANGLES = 256;
+
+struct MeshLod
+{
+	std::vector<uint32_t> indices;
+	// Object space distance the simplified surface may deviate from the source
+	float error;
+};
+
+// Collapses edges in order of quadric error until at most targetIndexNum indices
+// remain or the next collapse would exceed targetError (object space distance).
+// Vertices on open borders and on attribute seams stay where they are.
+// resultError receives the largest error of the accepted collapses.
+std::vector<uint32_t> simplifyMesh(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices,
+	size_t targetIndexNum, float targetError, float* resultError = nullptr);
+
+// Halves the triangle count per level until MESH_LOD_MAX_NUM levels exist or a level
+// stops shrinking. maxRelativeError bounds the error relative to the mesh extent.
+// Each level is reordered for the post-transform cache.
+std::vector<MeshLod> generateLods(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices,
+	float maxRelativeError = 0.05f);
@@ -0,0 +1,395 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "Utils/ThreadPool.h"
+
+namespace {
+	// BC7 interpolation weights for 4-bit indices, out of 64
+	const int BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	class BitWriter
+	{
+	public:
+		explicit BitWriter(uint8_t* data) : data{ data } { memset(data, 0, 16); }
+
+		void write(uint32_t value, uint32_t bits)
+		{
+			for (uint32_t i = 0; i < bits; ++i, ++position) {
+				if (value & (1u << i))
+					data[position >> 3] |= uint8_t(1u << (position & 7));
+			}
+		}
+
+	private:
+		uint8_t* data;
+		uint32_t position{ 0 };
+	};
+
+	class BitReader
+	{
+	public:
+		explicit BitReader(const uint8_t* data) : data{ data } {}
+
+		uint32_t read(uint32_t bits)
+		{
+			uint32_t value = 0;
+			for (uint32_t i = 0; i < bits; ++i, ++position)
+				value |= uint32_t((data[position >> 3] >> (position & 7)) & 1) << i;
+			return value;
+		}
+
+	private:
+		const uint8_t* data;
+		uint32_t position{ 0 };
+	};
+
+	// BC7 endpoint, 7 bits per channel plus the shared p-bit
+	struct Bc7Endpoint
+	{
+		int channels[4];
+		int pbit;
+
+		int value(int c) const { return (channels[c] << 1) | pbit; }
+	};
+
+	Bc7Endpoint quantizeBc7(const float* color, int pbit)
+	{
+		Bc7Endpoint endpoint{ {}, pbit };
+		for (int c = 0; c < 4; ++c)
+			endpoint.channels[c] = std::clamp(static_cast<int>(std::lround((color[c] - pbit) * 0.5f)), 0, 127);
+		return endpoint;
+	}
+
+	// Picks the best index for every texel, returns the squared error
+	float assignBc7Indices(const float texels[16][4], const Bc7Endpoint& e0, const Bc7Endpoint& e1, int indices[16])
+	{
+		float palette[16][4];
+		for (int i = 0; i < 16; ++i) {
+			for (int c = 0; c < 4; ++c)
+				palette[i][c] = float(((64 - BC7_WEIGHTS4[i]) * e0.value(c) + BC7_WEIGHTS4[i] * e1.value(c) + 32) >> 6);
+		}
+
+		float total = 0.f;
+		for (int t = 0; t < 16; ++t) {
+			float best = 1e30f;
+			for (int i = 0; i < 16; ++i) {
+				float error = 0.f;
+				for (int c = 0; c < 4; ++c) {
+					float d = texels[t][c] - palette[i][c];
+					error += d * d;
+				}
+				if (error < best) {
+					best = error;
+					indices[t] = i;
+				}
+			}
+			total += best;
+		}
+		return total;
+	}
+
+	// Tries every p-bit pair for the float endpoints, keeps the best one found so far.
+	// Opaque blocks only take p-bit 1, the only way for alpha to decode to exactly 255.
+	void fitBc7Endpoints(const float texels[16][4], const float lo[4], const float hi[4], bool opaque,
+		Bc7Endpoint& bestE0, Bc7Endpoint& bestE1, int bestIndices[16], float& bestError)
+	{
+		int firstPbit = opaque ? 1 : 0;
+		for (int p0 = firstPbit; p0 < 2; ++p0) {
+			for (int p1 = firstPbit; p1 < 2; ++p1) {
+				Bc7Endpoint e0 = quantizeBc7(lo, p0);
+				Bc7Endpoint e1 = quantizeBc7(hi, p1);
+				int indices[16];
+				float error = assignBc7Indices(texels, e0, e1, indices);
+				if (error < bestError) {
+					bestError = error;
+					bestE0 = e0;
+					bestE1 = e1;
+					std::copy(indices, indices + 16, bestIndices);
+				}
+			}
+		}
+	}
+
+	// BC4 palette of the 8 value mode, red0 > red1
+	void getBc4Palette(int red0, int red1, int palette[8])
+	{
+		palette[0] = red0;
+		palette[1] = red1;
+		if (red0 > red1) {
+			for (int i = 1; i < 7; ++i)
+				palette[i + 1] = ((7 - i) * red0 + i * red1) / 7;
+		}
+		else {
+			for (int i = 1; i < 5; ++i)
+				palette[i + 1] = ((5 - i) * red0 + i * red1) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	void gatherBlock(const ImageLevel& level, uint32_t blockX, uint32_t blockY, uint8_t* rgba)
+	{
+		for (uint32_t y = 0; y < 4; ++y) {
+			uint32_t srcY = std::min(blockY * 4 + y, level.height - 1);
+			for (uint32_t x = 0; x < 4; ++x) {
+				uint32_t srcX = std::min(blockX * 4 + x, level.width - 1);
+				memcpy(rgba + (y * 4 + x) * 4, &level.rgba[(size_t(srcY) * level.width + srcX) * 4], 4);
+			}
+		}
+	}
+}
+
+size_t getBlockBytes(BlockCodec codec)
+{
+	return codec == BlockCodec::BC4 ? 8 : 16;
+}
+
+void encodeBC4Block(const uint8_t* rgba, uint32_t channel, uint8_t* block)
+{
+	int minValue = 255, maxValue = 0;
+	for (int t = 0; t < 16; ++t) {
+		minValue = std::min<int>(minValue, rgba[t * 4 + channel]);
+		maxValue = std::max<int>(maxValue, rgba[t * 4 + channel]);
+	}
+
+	// A flat block uses the 6 value mode with every index on red0
+	int palette[8];
+	getBc4Palette(maxValue, minValue, palette);
+
+	memset(block, 0, 8);
+	block[0] = uint8_t(maxValue);
+	block[1] = uint8_t(minValue);
+	uint64_t bits = 0;
+	for (int t = 0; t < 16; ++t) {
+		int value = rgba[t * 4 + channel];
+		int best = 0;
+		for (int i = 1; i < 8; ++i) {
+			if (std::abs(palette[i] - value) < std::abs(palette[best] - value))
+				best = i;
+		}
+		bits |= uint64_t(best) << (t * 3);
+	}
+	for (int i = 0; i < 6; ++i)
+		block[2 + i] = uint8_t(bits >> (i * 8));
+}
+
+void encodeBC5Block(const uint8_t* rgba, uint32_t channelX, uint32_t channelY, uint8_t* block)
+{
+	encodeBC4Block(rgba, channelX, block);
+	encodeBC4Block(rgba, channelY, block + 8);
+}
+
+void encodeBC7Block(const uint8_t* rgba, uint8_t* block)
+{
+	float texels[16][4];
+	float mean[4] = {};
+	bool opaque = true;
+	for (int t = 0; t < 16; ++t) {
+		for (int c = 0; c < 4; ++c) {
+			texels[t][c] = rgba[t * 4 + c];
+			mean[c] += texels[t][c] / 16.f;
+		}
+		opaque = opaque && rgba[t * 4 + 3] == 255;
+	}
+
+	float covariance[4][4] = {};
+	for (int t = 0; t < 16; ++t) {
+		for (int i = 0; i < 4; ++i) {
+			for (int j = 0; j < 4; ++j)
+				covariance[i][j] += (texels[t][i] - mean[i]) * (texels[t][j] - mean[j]);
+		}
+	}
+
+	// Principal axis by power iteration, starting along the widest channel
+	float axis[4] = { 1.f, 1.f, 1.f, 1.f };
+	for (int i = 0; i < 4; ++i)
+		axis[i] = covariance[i][i] + 1e-3f;
+	for (int iteration = 0; iteration < 8; ++iteration) {
+		float next[4] = {};
+		for (int i = 0; i < 4; ++i) {
+			for (int j = 0; j < 4; ++j)
+				next[i] += covariance[i][j] * axis[j];
+		}
+		float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+		if (length < 1e-6f)
+			break;
+		for (int i = 0; i < 4; ++i)
+			axis[i] = next[i] / length;
+	}
+
+	float minT = 0.f, maxT = 0.f;
+	for (int t = 0; t < 16; ++t) {
+		float projection = 0.f;
+		for (int c = 0; c < 4; ++c)
+			projection += (texels[t][c] - mean[c]) * axis[c];
+		minT = std::min(minT, projection);
+		maxT = std::max(maxT, projection);
+	}
+
+	float lo[4], hi[4];
+	for (int c = 0; c < 4; ++c) {
+		lo[c] = std::clamp(mean[c] + minT * axis[c], 0.f, 255.f);
+		hi[c] = std::clamp(mean[c] + maxT * axis[c], 0.f, 255.f);
+	}
+
+	Bc7Endpoint e0{}, e1{};
+	int indices[16] = {};
+	float error = 1e30f;
+	fitBc7Endpoints(texels, lo, hi, opaque, e0, e1, indices, error);
+
+	// Least squares endpoints for the chosen indices
+	for (int iteration = 0; iteration < 2 && error > 0.f; ++iteration) {
+		float aa = 0.f, ab = 0.f, bb = 0.f;
+		float ax[4] = {}, bx[4] = {};
+		for (int t = 0; t < 16; ++t) {
+			float w = BC7_WEIGHTS4[indices[t]] / 64.f;
+			aa += (1.f - w) * (1.f - w);
+			ab += (1.f - w) * w;
+			bb += w * w;
+			for (int c = 0; c < 4; ++c) {
+				ax[c] += (1.f - w) * texels[t][c];
+				bx[c] += w * texels[t][c];
+			}
+		}
+		float det = aa * bb - ab * ab;
+		if (std::fabs(det) < 1e-6f)
+			break;
+		for (int c = 0; c < 4; ++c) {
+			lo[c] = std::clamp((ax[c] * bb - bx[c] * ab) / det, 0.f, 255.f);
+			hi[c] = std::clamp((bx[c] * aa - ax[c] * ab) / det, 0.f, 255.f);
+		}
+		fitBc7Endpoints(texels, lo, hi, opaque, e0, e1, indices, error);
+	}
+
+	// The first index is stored with 3 bits, its top bit has to be 0
+	if (indices[0] >= 8) {
+		std::swap(e0, e1);
+		for (int& index : indices)
+			index = 15 - index;
+	}
+
+	BitWriter writer{ block };
+	writer.write(1u << 6, 7);
+	for (int c = 0; c < 4; ++c) {
+		writer.write(e0.channels[c], 7);
+		writer.write(e1.channels[c], 7);
+	}
+	writer.write(e0.pbit, 1);
+	writer.write(e1.pbit, 1);
+	writer.write(indices[0], 3);
+	for (int t = 1; t < 16; ++t)
+		writer.write(indices[t], 4);
+}
+
+void decodeBC4Block(const uint8_t* block, uint8_t* values)
+{
+	int palette[8];
+	getBc4Palette(block[0], block[1], palette);
+	uint64_t bits = 0;
+	for (int i = 0; i < 6; ++i)
+		bits |= uint64_t(block[2 + i]) << (i * 8);
+	for (int t = 0; t < 16; ++t)
+		values[t] = uint8_t(palette[(bits >> (t * 3)) & 7]);
+}
+
+bool decodeBC7Block(const uint8_t* block, uint8_t* rgba)
+{
+	BitReader reader{ block };
+	if (reader.read(7) != (1u << 6)) {
+		memset(rgba, 0, 64);
+		return false;
+	}
+
+	int endpoints[2][4];
+	for (int c = 0; c < 4; ++c) {
+		endpoints[0][c] = int(reader.read(7)) << 1;
+		endpoints[1][c] = int(reader.read(7)) << 1;
+	}
+	int p0 = int(reader.read(1));
+	int p1 = int(reader.read(1));
+	for (int c = 0; c < 4; ++c) {
+		endpoints[0][c] |= p0;
+		endpoints[1][c] |= p1;
+	}
+
+	for (int t = 0; t < 16; ++t) {
+		int index = int(reader.read(t == 0 ? 3 : 4));
+		int w = BC7_WEIGHTS4[index];
+		for (int c = 0; c < 4; ++c)
+			rgba[t * 4 + c] = uint8_t(((64 - w) * endpoints[0][c] + w * endpoints[1][c] + 32) >> 6);
+	}
+	return true;
+}
+
+std::vector<uint8_t> compressLevel(const ImageLevel& level, BlockCodec codec, const uint32_t channels[2], ThreadPool* pool)
+{
+	uint32_t blocksX = (level.width + 3) / 4;
+	uint32_t blocksY = (level.height + 3) / 4;
+	size_t blockBytes = getBlockBytes(codec);
+	std::vector<uint8_t> blocks(size_t(blocksX) * blocksY * blockBytes);
+
+	auto compressRow = [&](size_t blockY) {
+		uint8_t rgba[64];
+		for (uint32_t blockX = 0; blockX < blocksX; ++blockX) {
+			gatherBlock(level, blockX, static_cast<uint32_t>(blockY), rgba);
+			uint8_t* block = &blocks[(blockY * blocksX + blockX) * blockBytes];
+			switch (codec)
+			{
+			case BlockCodec::BC4: encodeBC4Block(rgba, channels[0], block); break;
+			case BlockCodec::BC5: encodeBC5Block(rgba, channels[0], channels[1], block); break;
+			case BlockCodec::BC7: encodeBC7Block(rgba, block); break;
+			}
+		}
+	};
+
+	if (pool)
+		pool->parallelFor(blocksY, compressRow);
+	else {
+		for (uint32_t blockY = 0; blockY < blocksY; ++blockY)
+			compressRow(blockY);
+	}
+	return blocks;
+}
+
+ImageLevel decompressLevel(const uint8_t* blocks, uint32_t width, uint32_t height, BlockCodec codec, const uint32_t channels[2])
+{
+	ImageLevel level{ width, height, std::vector<uint8_t>(size_t(width) * height * 4, 0) };
+	for (size_t i = 3; i < level.rgba.size(); i += 4)
+		level.rgba[i] = 255;
+
+	uint32_t blocksX = (width + 3) / 4;
+	uint32_t blocksY = (height + 3) / 4;
+	size_t blockBytes = getBlockBytes(codec);
+	for (uint32_t blockY = 0; blockY < blocksY; ++blockY) {
+		for (uint32_t blockX = 0; blockX < blocksX; ++blockX) {
+			const uint8_t* block = blocks + (size_t(blockY) * blocksX + blockX) * blockBytes;
+			uint8_t rgba[64];
+			memset(rgba, 0, sizeof(rgba));
+			if (codec == BlockCodec::BC7)
+				decodeBC7Block(block, rgba);
+			else {
+				uint8_t values[16];
+				int channelNum = codec == BlockCodec::BC4 ? 1 : 2;
+				for (int i = 0; i < channelNum; ++i) {
+					decodeBC4Block(block + i * 8, values);
+					for (int t = 0; t < 16; ++t)
+						rgba[t * 4 + channels[i]] = values[t];
+				}
+				for (int t = 0; t < 16; ++t) {
+					if (channels[0] != 3 && (channelNum == 1 || channels[1] != 3))
+						rgba[t * 4 + 3] = 255;
+				}
+			}
+
+			for (uint32_t y = 0; y < 4 && blockY * 4 + y < height; ++y) {
+				for (uint32_t x = 0; x < 4 && blockX * 4 + x < width; ++x) {
+					memcpy(&level.rgba[((size_t(blockY) * 4 + y) * width + blockX * 4 + x) * 4], rgba + (y * 4 + x) * 4, 4);
+				}
+			}
+		}
+	}
+	return level;
+}
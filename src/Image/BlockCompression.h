@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MipChain.h"
+
+class ThreadPool;
+
+// CPU encoders of the block compressed formats texture cooking writes.
+// A block is 4x4 texels, passed in as 16 RGBA8 texels in row order.
+
+enum class BlockCodec
+{
+	BC4,	// One channel, 8 bytes per block
+	BC5,	// Two channels, 16 bytes per block
+	BC7,	// RGBA, 16 bytes per block
+};
+
+size_t getBlockBytes(BlockCodec codec);
+
+// channel picks the RGBA channel that is stored
+void encodeBC4Block(const uint8_t* rgba, uint32_t channel, uint8_t* block);
+void encodeBC5Block(const uint8_t* rgba, uint32_t channelX, uint32_t channelY, uint8_t* block);
+// Mode 6 only: a single RGBA endpoint pair with 16 interpolation steps.
+// The endpoints are fit along the principal axis and refined by least squares.
+void encodeBC7Block(const uint8_t* rgba, uint8_t* block);
+
+// Writes 16 values
+void decodeBC4Block(const uint8_t* block, uint8_t* values);
+// Writes 16 RGBA8 texels, returns false for the modes encodeBC7Block never writes
+bool decodeBC7Block(const uint8_t* block, uint8_t* rgba);
+
+// Blocks of a whole level, row by row. Texels past the right and bottom edge repeat the last ones.
+// channels[0] is stored by BC4, channels[0] and [1] by BC5, BC7 ignores them.
+std::vector<uint8_t> compressLevel(const ImageLevel& level, BlockCodec codec, const uint32_t channels[2],
+	ThreadPool* pool = nullptr);
+
+// Inverse of compressLevel, the channels that were not stored come out as 0 (alpha as 255)
+ImageLevel decompressLevel(const uint8_t* blocks, uint32_t width, uint32_t height, BlockCodec codec, const uint32_t channels[2]);
@@ -0,0 +1,155 @@
+#include "MipChain.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace {
+	struct FloatImage
+	{
+		uint32_t width;
+		uint32_t height;
+		std::vector<float> texels;	// RGBA
+	};
+
+	// Weights of the source texels covering each destination texel of a 1D resample
+	struct Tap
+	{
+		uint32_t first;
+		std::vector<float> weights;
+	};
+
+	std::vector<Tap> computeTaps(uint32_t srcSize, uint32_t dstSize)
+	{
+		std::vector<Tap> taps(dstSize);
+		double scale = double(srcSize) / dstSize;
+		for (uint32_t d = 0; d < dstSize; ++d) {
+			double begin = d * scale;
+			double end = (d + 1) * scale;
+			auto& tap = taps[d];
+			tap.first = static_cast<uint32_t>(begin);
+			for (uint32_t s = tap.first; s < srcSize && s < end; ++s) {
+				double overlap = std::min<double>(s + 1, end) - std::max<double>(s, begin);
+				tap.weights.push_back(static_cast<float>(overlap / scale));
+			}
+		}
+		return taps;
+	}
+
+	FloatImage downsample(const FloatImage& src)
+	{
+		FloatImage dst{ std::max(1u, src.width >> 1), std::max(1u, src.height >> 1), {} };
+		auto tapsX = computeTaps(src.width, dst.width);
+		auto tapsY = computeTaps(src.height, dst.height);
+
+		// Horizontal pass into rows of the source height
+		std::vector<float> rows(size_t(dst.width) * src.height * 4, 0.f);
+		for (uint32_t y = 0; y < src.height; ++y) {
+			const float* srcRow = &src.texels[size_t(y) * src.width * 4];
+			float* row = &rows[size_t(y) * dst.width * 4];
+			for (uint32_t x = 0; x < dst.width; ++x) {
+				const auto& tap = tapsX[x];
+				for (size_t i = 0; i < tap.weights.size(); ++i) {
+					for (int c = 0; c < 4; ++c)
+						row[x * 4 + c] += srcRow[(tap.first + i) * 4 + c] * tap.weights[i];
+				}
+			}
+		}
+
+		dst.texels.assign(size_t(dst.width) * dst.height * 4, 0.f);
+		for (uint32_t y = 0; y < dst.height; ++y) {
+			const auto& tap = tapsY[y];
+			float* dstRow = &dst.texels[size_t(y) * dst.width * 4];
+			for (size_t i = 0; i < tap.weights.size(); ++i) {
+				const float* row = &rows[size_t(tap.first + i) * dst.width * 4];
+				for (uint32_t x = 0; x < dst.width * 4; ++x)
+					dstRow[x] += row[x] * tap.weights[i];
+			}
+		}
+		return dst;
+	}
+
+	void normalizeNormals(FloatImage& image)
+	{
+		for (size_t i = 0; i < image.texels.size(); i += 4) {
+			float* n = &image.texels[i];
+			float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			if (length > 1e-6f) {
+				n[0] /= length;
+				n[1] /= length;
+				n[2] /= length;
+			}
+			else {
+				n[0] = 0.f;
+				n[1] = 0.f;
+				n[2] = 1.f;
+			}
+		}
+	}
+
+	uint8_t toUnorm8(float value)
+	{
+		return static_cast<uint8_t>(std::lround(std::clamp(value, 0.f, 1.f) * 255.f));
+	}
+
+	FloatImage toFloat(const uint8_t* rgba, uint32_t width, uint32_t height, MipFilter filter)
+	{
+		std::array<float, 256> srgbTable{};
+		for (int i = 0; i < 256; ++i)
+			srgbTable[i] = srgbToLinear(i / 255.f);
+
+		FloatImage image{ width, height, std::vector<float>(size_t(width) * height * 4) };
+		for (size_t i = 0; i < image.texels.size(); ++i) {
+			bool color = (i & 3) != 3;
+			float value = rgba[i] / 255.f;
+			if (filter == MipFilter::Srgb && color)
+				value = srgbTable[rgba[i]];
+			else if (filter == MipFilter::NormalMap && color)
+				value = value * 2.f - 1.f;
+			image.texels[i] = value;
+		}
+		if (filter == MipFilter::NormalMap)
+			normalizeNormals(image);
+		return image;
+	}
+
+	ImageLevel toLevel(const FloatImage& image, MipFilter filter)
+	{
+		ImageLevel level{ image.width, image.height, std::vector<uint8_t>(image.texels.size()) };
+		for (size_t i = 0; i < image.texels.size(); ++i) {
+			bool color = (i & 3) != 3;
+			float value = image.texels[i];
+			if (filter == MipFilter::Srgb && color)
+				value = linearToSrgb(value);
+			else if (filter == MipFilter::NormalMap && color)
+				value = value * 0.5f + 0.5f;
+			level.rgba[i] = toUnorm8(value);
+		}
+		return level;
+	}
+}
+
+float srgbToLinear(float value)
+{
+	return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+float linearToSrgb(float value)
+{
+	return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+}
+
+std::vector<ImageLevel> buildMipChain(const uint8_t* rgba, uint32_t width, uint32_t height, MipFilter filter)
+{
+	std::vector<ImageLevel> levels;
+	levels.push_back({ width, height, std::vector<uint8_t>(rgba, rgba + size_t(width) * height * 4) });
+
+	FloatImage image = toFloat(rgba, width, height, filter);
+	while (image.width > 1 || image.height > 1) {
+		image = downsample(image);
+		if (filter == MipFilter::NormalMap)
+			normalizeNormals(image);
+		levels.push_back(toLevel(image, filter));
+	}
+	return levels;
+}
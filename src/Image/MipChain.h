@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Mip chains for offline texture cooking. Each level is box filtered from the float
+// level above it, in linear light, with weights that also cover odd sizes.
+// Level sizes follow the Vulkan rule max(1, size >> level).
+
+struct ImageLevel
+{
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	// 4 bytes per texel, rows top to bottom
+	std::vector<uint8_t> rgba;
+};
+
+enum class MipFilter
+{
+	Srgb,		// RGB is sRGB encoded and averaged in linear light, alpha is linear
+	Linear,		// Every channel is plain data
+	NormalMap,	// RGB is a tangent space normal, renormalized on every level
+};
+
+// levels[0] is the source itself, the last level is 1x1
+std::vector<ImageLevel> buildMipChain(const uint8_t* rgba, uint32_t width, uint32_t height, MipFilter filter);
+
+float srgbToLinear(float value);
+float linearToSrgb(float value);
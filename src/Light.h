@@ -9,6 +9,8 @@
 std::vector<glm::vec4> getFrustumCornersWorldSpace(const glm::mat4& proj, const glm::mat4& view);
 
 const int MAX_CSM_LEVEL = 6;
+// Lights of each kind the renderer uploads, the light buffers have room for no more
+const uint32_t MAX_LIGHT_NUM = 16;
 
 struct DirLight {
     glm::vec3 direction;
@@ -1,6 +1,12 @@
 #include "Mesh.h"
 #include "Model.h"
 
+Mesh::Mesh(Model* parent, std::shared_ptr<const MeshGeometry> geometry) :
+	parent{ parent }, geometry{ std::move(geometry) }
+{
+	setupMesh();
+}
+
 Mesh::Mesh(
 	Model* parent, 
 	const std::vector<Vertex>& vertices, 
@@ -8,7 +14,20 @@ Mesh::Mesh(
 	const std::vector<Texture>& textures, 
 	const GltfMaterial& mat
 ) :
-	parent{ parent }, vertices{ vertices }, indices{ indices }, textures{ textures }, mat{ mat }
+	parent{ parent }, geometry{ std::make_shared<MeshGeometry>(MeshGeometry{ vertices, indices, textures, mat }) }
+{
+	setupMesh();
+}
+
+Mesh::Mesh(
+	Model* parent,
+	std::vector<Vertex>&& vertices,
+	std::vector<unsigned int>&& indices,
+	std::vector<Texture>&& textures,
+	const GltfMaterial& mat
+) :
+	parent{ parent }, 
+	geometry{ std::make_shared<MeshGeometry>(MeshGeometry{ std::move(vertices), std::move(indices), std::move(textures), mat }) }
 {
 	setupMesh();
 }
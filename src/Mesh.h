@@ -1,28 +1,46 @@
 #pragma once
 
+#include <memory>
+
 #include "Vulkan/VulkanCommon.h"
 #include "Vulkan/Rendering/VulkanResource.h"
 
 #include "Vertex.h"
 #include "Texture.h"
 #include "Component/TransformComponent.h"
+#include "Geometry/Meshlet.h"
+#include "Geometry/Simplify.h"
 
 class Model;
 
+// Decoded vertices, indices and material of one primitive.
+// Every node instancing the same glTF mesh points to the same MeshGeometry.
+struct MeshGeometry
+{
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<Texture> textures;
+    GltfMaterial mat{};
+    // Coarser versions of indices over the same vertices, finest first
+    std::vector<MeshLod> lods{};
+    // Clusters of the triangles above for cluster level culling, CPU side only until a pass reads them
+    MeshletData meshlets{};
+};
+
 class Mesh
 {
 public:
     Model* parent;
 
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
-    std::vector<Texture> textures;
-    GltfMaterial mat;
+    std::shared_ptr<const MeshGeometry> geometry;
 
     TransformComponent transComp{};
 
+    Mesh(Model* parent, std::shared_ptr<const MeshGeometry> geometry);
     Mesh(Model* parent, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, 
         const std::vector<Texture>& textures, const GltfMaterial& mat);
+    Mesh(Model* parent, std::vector<Vertex>&& vertices, std::vector<unsigned int>&& indices,
+        std::vector<Texture>&& textures, const GltfMaterial& mat);
 private:
     void setupMesh();
 };
\ No newline at end of file
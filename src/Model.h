@@ -1,11 +1,30 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 
 #include "Vertex.h"
 #include "Texture.h"
 #include "Mesh.h"
 #include "Component/TransformComponent.h"
+#include "SceneGraph.h"
+
+// 32 bits wide, so ModelLight has no padding in the cooked file
+enum class ModelLightType : uint32_t
+{
+	None,
+	Point,
+	Directional
+};
+
+// KHR_lights_punctual light of a glTF node. Point lights sit at the origin of the node,
+// directional ones shine down its -Z. Intensities are in engine units, as Scene uses them.
+struct ModelLight
+{
+	ModelLightType type{ ModelLightType::None };
+	glm::vec3 color{ 1.0f };
+	float intensity{ 1.0f };
+};
 
 class Model
 {
@@ -14,7 +33,14 @@ public:
 	Model(std::string name, std::vector<Mesh>&& meshes);
 	~Model();
 
+	// Local transform relative to parent, push changes with Scene::setModelTransform
 	TransformComponent transComp{};
+	// Parent node in the file hierarchy, null for roots
+	Model* parent{ nullptr };
+	// Node in the Scene graph once the model is added to a Scene
+	NodeID node{ INVALID_NODE };
+	// Scene::addModelsFromGltfFile adds it to the lights of the scene
+	ModelLight light{};
 
 	const std::vector<Mesh>& getMeshes() const;
 	const std::string getName() const { return name; }
@@ -32,7 +32,7 @@ VkExtent2D GlfwWindow::getExtent() {
 
 GLFWwindow* GlfwWindow::getHandle() const { return window; }
 
-void GlfwWindow::framebufferResizeCallback(GLFWwindow* window, int width, int height) {
+void GlfwWindow::framebufferResizeCallback(GLFWwindow* window, int /*width*/, int /*height*/) {
 	auto app = reinterpret_cast<VulkanApplication*>(glfwGetWindowUserPointer(window));
 	app->framebufferResized = true;
 }
\ No newline at end of file
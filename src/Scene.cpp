@@ -1,6 +1,8 @@
 #include "Scene.h"
 
+#include <atomic>
 #include <cmath>
+#include <cstdint>
 #include <string>
 #include <filesystem>
 
@@ -8,6 +10,13 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "GLTF/GLTFHelper.h"
+#include "GLTF/GLTFCooked.h"
+#include "GLTF/GLTFTextures.h"
+#include "Geometry/MeshOptimizer.h"
+#include "Geometry/Meshlet.h"
+#include "Geometry/Simplify.h"
+#include "Utils/PhaseClock.h"
+#include "Utils/ThreadPool.h"
 
 Scene::Scene() :
 	activeCamera{ nullptr }
@@ -23,137 +32,277 @@ Scene::~Scene()
 {
 }
 
-std::vector<Model*> Scene::loadGLTFFile(const char* filename)
-{
-	std::vector<Model*> models;
+namespace {
+	// Only reads from tModel, so primitives can be decoded concurrently.
+	// Large primitives also spread their normal and tangent generation over pool.
+	void decodePrimitive(const GltfDocument& doc, const tinygltf::Primitive& tPrim,
+		const char* filename, const std::string& filepath, bool optimize, ThreadPool& pool, MeshGeometry& prim,
+		GltfImportTimings& timings)
+	{
+		PhaseClock clock;
+		const auto& tModel = doc.getModel();
+		auto& indices = prim.indices;
+		auto& vertices = prim.vertices;
+		auto& textures = prim.textures;
+		auto& mat = prim.mat;
+
+		/* Indices */
+		if (tPrim.indices >= 0) {
+			getAccessorDataScalar(doc, tModel.accessors[tPrim.indices], indices);
+		}
+		else {
+			const auto& tAcces = tModel.accessors[tPrim.attributes.find("POSITION")->second];
+			for (uint32_t i = 0; i < tAcces.count; i++)
+				indices.push_back(i);
+		}
 
-	tinygltf::Model tModel;
-	tinygltf::TinyGLTF tContext;
-	std::string warn, error;
+		/* Vertices Begin */
 
-	if (!tContext.LoadASCIIFromFile(&tModel, &error, &warn, filename))
-		assert(!"Error while loading scene");
+		/* Positions */
+		std::vector<glm::vec3> positions;
+		if (!getAttribute(doc, tPrim, positions, "POSITION")) {
+			throw std::runtime_error(std::string() + filename + ": a GLTF primitive with NO POSITION!");
+		}
+		vertices.resize(positions.size());
+		for (size_t i = 0; i < vertices.size(); ++i) {
+			vertices[i].pos = positions[i];
+		}
 
-	auto slashpos = std::string(filename).find_last_of('/');
-	std::string filepath = std::string(filename).substr(0, slashpos + 1);
+		/* Normals */
+		std::vector<glm::vec3> normals;
+		if (!getAttribute(doc, tPrim, normals, "NORMAL")) {
+			// Need to compute the normals
+			clock.lap(timings.accessors);
+			createNormals(indices, positions, normals, &pool);
+			clock.lap(timings.normals);
+		}
+		for (size_t i = 0; i < vertices.size(); ++i) {
+			vertices[i].normal = normals[i];
+		}
 
-	for (auto& tNode : tModel.nodes) {
-		if (tNode.mesh < 0) {
-			continue;
+		/* TexCoords */
+		std::vector<glm::vec2> texCoords{};
+		bool texcoordCreated = getAttribute(doc, tPrim, texCoords, "TEXCOORD_0");
+		if (!texcoordCreated) {
+			texcoordCreated = getAttribute(doc, tPrim, texCoords, "TEXCOORD");
+		}
+		if (!texcoordCreated) {
+			texCoords.insert(texCoords.end(), vertices.size(), glm::vec2(0.f));
+		}
+		for (size_t i = 0; i < vertices.size(); ++i) {
+			vertices[i].texCoord = texCoords[i];
 		}
 
-		auto& tMesh = tModel.meshes[tNode.mesh];
-		std::vector<Mesh> meshes{};
-		meshes.reserve(tMesh.primitives.size());
-		for (auto& tPrim : tMesh.primitives) {
-			std::vector<uint32_t> indices{};
-			std::vector<Vertex> vertices{};
-			std::vector<Texture> textures{};
-			GltfMaterial mat{};
-
-			/* Indices */
-			if (tPrim.indices >= 0) {
-				getAccessorDataScalar(tModel, tModel.accessors[tPrim.indices], indices);
+		/* Tangent and BiTangent */
+		std::vector<glm::vec3> tangents;
+		std::vector<glm::vec3> bitangents;
+
+		std::vector<glm::vec4> gltfTangents;
+		if (!getAttribute(doc, tPrim, gltfTangents, "TANGENT")) {
+			tangents.resize(vertices.size(), glm::vec3(0.f));
+			bitangents.resize(vertices.size(), glm::vec3(0.f));
+			clock.lap(timings.accessors);
+			createTangents(indices, positions, normals, texCoords, tangents, bitangents, &pool);
+			clock.lap(timings.tangents);
+		}
+		else {
+			for (size_t i = 0; i < vertices.size(); ++i) {
+				auto& gt = gltfTangents[i];
+				auto& n = normals[i];
+				glm::vec3 t = gt;
+				glm::vec3 b = glm::normalize(glm::cross(n, t)) * gt.w;
+				tangents.push_back(t);
+				bitangents.push_back(b);
 			}
-			else {
-				const auto& tAcces = tModel.accessors[tPrim.attributes.find("POSITION")->second];
-				for (auto i = 0; i < tAcces.count; i++)
-					indices.push_back(i);
+		}
+		for (size_t i = 0; i < vertices.size(); ++i) {
+			vertices[i].tangent = tangents[i];
+			vertices[i].bitangent = bitangents[i];
+		}
+		/* Vertices are filled */
+		clock.lap(timings.accessors);
+
+		// Unindexed primitives and split attributes repeat vertices, merge them
+		weldVertices(vertices, indices);
+		if (optimize) {
+			optimizeVertexCache(indices, vertices.size());
+			optimizeOverdraw(indices, vertices);
+			optimizeVertexFetch(vertices, indices);
+			prim.lods = generateLods(indices, vertices);
+		}
+		clock.lap(timings.optimize);
+		prim.meshlets = buildMeshlets(indices, vertices);
+		clock.lap(timings.meshlets);
+
+		/* Material and Textures */
+		auto& tMat = tModel.materials[tPrim.material];
+		importGLTFMaterial(mat, tMat);
+		// deal with textures
+		auto setTexture = [&](int& textureId)
+		{
+			if (textureId > -1) {
+				auto& tTex = tModel.textures[textureId];
+				auto& tImage = tModel.images[tTex.source];
+				const auto& embedded = doc.getImage(tTex.source);
+				// Embedded images are decoded from memory, the path only names them
+				Texture texture{ TextureType::DIFFUSE,
+					embedded.data ? std::string(filename) + "#image" + std::to_string(tTex.source) : filepath + tImage.uri,
+					embedded };
+				textures.push_back(std::move(texture));
+				textureId = textures.size() - 1;
 			}
+		};
+		{
+			setTexture(mat.pbrBaseColorTexture);
+			setTexture(mat.pbrMetallicRoughnessTexture);
+			setTexture(mat.normalTexture);
+			setTexture(mat.occlusionTexture);
+			setTexture(mat.emissiveTexture);
+			setTexture(mat.transmissionTexture);
+			setTexture(mat.khrDiffuseTexture);
+			setTexture(mat.khrSpecularGlossinessTexture);
+			setTexture(mat.clearcoatTexture);
+			setTexture(mat.clearcoatRoughnessTexture);
+			setTexture(mat.clearcoatNormalTexture);
+		}
+	}
 
-			/* Vertices Begin */
+	// Spot lights have no counterpart in the renderer and are left out
+	ModelLight getModelLight(const tinygltf::Model& tModel, const tinygltf::Node& tNode)
+	{
+		ModelLight light{};
+		auto ext = tNode.extensions.find(KHR_LIGHTS_PUNCTUAL_EXTENSION_NAME);
+		if (ext == tNode.extensions.end() || !ext->second.Has("light"))
+			return light;
+		int lightIdx = ext->second.Get("light").GetNumberAsInt();
+		if (lightIdx < 0 || lightIdx >= static_cast<int>(tModel.lights.size()))
+			return light;
+
+		const auto& tLight = tModel.lights[lightIdx];
+		if (tLight.type == "point")
+			light.type = ModelLightType::Point;
+		else if (tLight.type == "directional")
+			light.type = ModelLightType::Directional;
+		if (tLight.color.size() == 3)
+			light.color = { tLight.color[0], tLight.color[1], tLight.color[2] };
+		light.intensity = static_cast<float>(tLight.intensity);
+		return light;
+	}
+}
 
-			/* Positions */
-			std::vector<glm::vec3> positions;
-			if (!getAttribute(tModel, tPrim, positions, "POSITION")) {
-				throw std::runtime_error(std::string() + filename + ": a GLTF primitive with NO POSITION!");
-			}
-			vertices.resize(positions.size());
-			for (size_t i = 0; i < vertices.size(); ++i) {
-				vertices[i].pos = positions[i];
-			}
+std::vector<Model*> Scene::loadGLTFFile(const char* filename, const GltfImportOptions& options)
+{
+	std::vector<Model*> models;
+	GltfImportTimings timings{};
+	PhaseClock clock;
 
-			/* Normals */
-			std::vector<glm::vec3> normals;
-			if (!getAttribute(tModel, tPrim, normals, "NORMAL")) {
-				// Need to compute the normals
-				createNormals(indices, positions, normals);
-			}
-			for (size_t i = 0; i < vertices.size(); ++i) {
-				vertices[i].normal = normals[i];
-			}
+	auto slashpos = std::string(filename).find_last_of('/');
+	std::string filepath = std::string(filename).substr(0, slashpos + 1);
 
-			/* TexCoords */
-			std::vector<glm::vec2> texCoords{};
-			bool texcoordCreated = getAttribute(tModel, tPrim, texCoords, "TEXCOORD_0");
-			if (!texcoordCreated) {
-				texcoordCreated = getAttribute(tModel, tPrim, texCoords, "TEXCOORD");
-			}
-			if (!texcoordCreated) {
-				texCoords.insert(texCoords.end(), vertices.size(), glm::vec2(0.f));
-			}
-			for (size_t i = 0; i < vertices.size(); ++i) {
-				vertices[i].texCoord = texCoords[i];
-			}
+	std::unordered_map<std::string, std::string> cookedTextures;
+	if (options.useCookedTextures)
+		cookedTextures = readCookedTextures(getCookedTextureDir(filename, options.cookedCacheDir), filepath);
+
+	// A valid cooked file replaces all of the decoding below
+	bool useCookedCache = options.useCookedCache && options.optimizeMeshes;
+	std::string cookedFile{};
+	uint64_t sourceStamp = 0;
+	uint64_t sourceHash = 0;
+	if (useCookedCache) {
+		// Only hashed when the sizes or modification times changed since the file was written
+		sourceStamp = GltfDocument::stampSource(filename);
+		cookedFile = getCookedGeometryPath(filename, options.cookedCacheDir);
+		auto hashSource = [&]() { return sourceHash = GltfDocument::hashSource(filename); };
+		if (readCookedGeometry(cookedFile, sourceStamp, hashSource, filepath, models, cookedTextures)) {
+			clock.lap(timings.cacheRead);
+			timings.cached = true;
+			if (options.timings)
+				*options.timings = timings;
+			return models;
+		}
+	}
+	clock.lap(timings.cacheRead);
 
-			/* Tangent and BiTangent */
-			std::vector<glm::vec3> tangents;
-			std::vector<glm::vec3> bitangents;
+	GltfDocument doc;
+	std::string warn, error;
 
-			std::vector<glm::vec4> gltfTangents;
-			if (!getAttribute(tModel, tPrim, gltfTangents, "TANGENT")) {
-				tangents.resize(vertices.size(), glm::vec3(0.f));
-				bitangents.resize(vertices.size(), glm::vec3(0.f));
-				createTangents(indices, positions, normals, texCoords, tangents, bitangents);
-			}
-			else {
-				for (size_t i = 0; i < vertices.size(); ++i) {
-					auto& gt = gltfTangents[i];
-					auto& n = normals[i];
-					glm::vec3 t = gt;
-					glm::vec3 b = glm::normalize(glm::cross(n, t)) * gt.w;
-					tangents.push_back(t);
-					bitangents.push_back(b);
-				}
-			}
-			for (size_t i = 0; i < vertices.size(); ++i) {
-				vertices[i].tangent = tangents[i];
-				vertices[i].bitangent = bitangents[i];
-			}
-			/* Vertices are filled */
-
-			/* Material and Textures */
-			auto& tMat = tModel.materials[tPrim.material];
-			importGLTFMaterial(mat, tMat);
-			// deal with textures
-			auto setTexture = [&](int& textureId)
-			{
-				if (textureId > -1) {
-					auto& tTex = tModel.textures[textureId];
-					auto& tImage = tModel.images[tTex.source];
-					Texture texture{ TextureType::DIFFUSE, filepath + tImage.uri};
-					textures.push_back(texture);
-					textureId = textures.size() - 1;
-				}
-			};
-			{
-				setTexture(mat.pbrBaseColorTexture);
-				setTexture(mat.pbrMetallicRoughnessTexture);
-				setTexture(mat.normalTexture);
-				setTexture(mat.occlusionTexture);
-				setTexture(mat.emissiveTexture);
-				setTexture(mat.transmissionTexture);
-				setTexture(mat.khrDiffuseTexture);
-				setTexture(mat.khrSpecularGlossinessTexture);
-				setTexture(mat.clearcoatTexture);
-				setTexture(mat.clearcoatRoughnessTexture);
-				setTexture(mat.clearcoatNormalTexture);
-			}
+	// .gltf and .glb are both accepted, buffers are read from mapped files
+	if (!doc.load(filename, &error, &warn))
+		throw std::runtime_error(std::string() + "Error while loading scene " + filename + ": " + error);
+	const auto& tModel = doc.getModel();
+	clock.lap(timings.parse);
+
+	// Flatten the primitives of every mesh referenced by a node into a job list.
+	// A mesh is decoded once however many nodes instance it, each job owns its
+	// output slot, so the models come out in file order regardless of scheduling.
+	struct PrimitiveJob
+	{
+		const tinygltf::Primitive* tPrim;
+		std::shared_ptr<MeshGeometry> geometry;
+		GltfImportTimings timings;
+	};
+	std::vector<PrimitiveJob> jobs;
+	std::vector<size_t> meshFirstJob(tModel.meshes.size(), SIZE_MAX);
+	for (const auto& tNode : tModel.nodes) {
+		if (tNode.mesh < 0 || meshFirstJob[tNode.mesh] != SIZE_MAX) {
+			continue;
+		}
+
+		meshFirstJob[tNode.mesh] = jobs.size();
+		for (auto& tPrim : tModel.meshes[tNode.mesh].primitives)
+			jobs.push_back({ &tPrim, std::make_shared<MeshGeometry>(), {} });
+	}
+
+	ThreadPool pool{ options.threadCount };
+	std::atomic<size_t> decodedNum{ 0 };
+	pool.parallelFor(jobs.size(), [&](size_t i) {
+		decodePrimitive(doc, *jobs[i].tPrim, filename, filepath, options.optimizeMeshes, pool, *jobs[i].geometry, jobs[i].timings);
+		if (options.onPrimitiveDecoded)
+			options.onPrimitiveDecoded(++decodedNum, jobs.size());
+	});
+	clock.lap(timings.decode);
+	for (const auto& job : jobs) {
+		timings.accessors += job.timings.accessors;
+		timings.normals += job.timings.normals;
+		timings.tangents += job.timings.tangents;
+		timings.optimize += job.timings.optimize;
+		timings.meshlets += job.timings.meshlets;
+	}
+
+	// Nodes no other node lists as a child are roots
+	std::vector<uint8_t> isChild(tModel.nodes.size(), 0);
+	for (const auto& tNode : tModel.nodes) {
+		for (auto child : tNode.children)
+			isChild[child] = 1;
+	}
 
-			meshes.emplace_back(nullptr, vertices, indices, textures, mat);
+	// Depth-first, parents come before their children as SceneGraph expects.
+	// Every node becomes a Model, nodes without a mesh only carry a transform.
+	std::vector<uint8_t> visited(tModel.nodes.size(), 0);
+	std::vector<std::pair<int, Model*>> stack;
+	for (size_t rootIdx = tModel.nodes.size(); rootIdx-- > 0;) {
+		if (!isChild[rootIdx])
+			stack.emplace_back(static_cast<int>(rootIdx), nullptr);
+	}
+	while (!stack.empty()) {
+		auto [nodeIdx, parent] = stack.back();
+		stack.pop_back();
+		// A broken file could list a node under two parents or in a cycle
+		if (visited[nodeIdx])
+			continue;
+		visited[nodeIdx] = 1;
+		auto& tNode = tModel.nodes[nodeIdx];
+
+		std::vector<Mesh> meshes{};
+		if (tNode.mesh >= 0) {
+			auto& tMesh = tModel.meshes[tNode.mesh];
+			meshes.reserve(tMesh.primitives.size());
+			for (size_t primIdx = 0; primIdx < tMesh.primitives.size(); ++primIdx)
+				meshes.emplace_back(nullptr, jobs[meshFirstJob[tNode.mesh] + primIdx].geometry);
 		}
 
 		auto model = new Model(tNode.name, std::move(meshes));
+		model->parent = parent;
 		if (!tNode.translation.empty())
 			model->transComp.translate = { tNode.translation[0], tNode.translation[1], tNode.translation[2] };
 		if (!tNode.scale.empty())
@@ -174,33 +323,80 @@ std::vector<Model*> Scene::loadGLTFFile(const char* filename)
 
 		if (!tNode.matrix.empty())
 			model->transComp.transform = glm::make_mat4(tNode.matrix.data());
+		model->light = getModelLight(tModel, tNode);
 		models.push_back(model);
+
+		for (auto child = tNode.children.rbegin(); child != tNode.children.rend(); ++child)
+			stack.emplace_back(*child, model);
 	}
 
+	// The cache is only an optimization, a failed write just means decoding again next time
+	if (useCookedCache) {
+		clock.lap(timings.decode);
+		if (sourceHash == 0)
+			sourceHash = GltfDocument::hashSource(filename);
+		if (sourceStamp != 0 && sourceHash != 0)
+			writeCookedGeometry(cookedFile, sourceStamp, sourceHash, filepath, models);
+		clock.lap(timings.cacheWrite);
+	}
+
+	// Only now, the cooked geometry keeps the source paths in case the cooked textures go stale
+	for (auto& job : jobs) {
+		for (auto& texture : job.geometry->textures) {
+			auto cooked = cookedTextures.find(texture.path);
+			if (cooked != cookedTextures.end())
+				texture.path = cooked->second;
+		}
+	}
+
+	if (options.timings)
+		*options.timings = timings;
 	return models;
 }
 
-std::vector<Model*> Scene::addModelsFromGltfFile(const char* filename)
+std::vector<Model*> Scene::addModelsFromGltfFile(const char* filename, const GltfImportOptions& options)
 {
-	auto models = loadGLTFFile(filename);
+	auto models = loadGLTFFile(filename, options);
+	// Parents precede children in models, so the parent node already exists
+	bool hasLights = false;
 	for (auto model : models) {
-		if (modelMap.find(model->getName()) == modelMap.end())
-			modelMap.emplace(model->getName(), model);
-		else {
-			for (int i = 1;; ++i) {
-				std::string name = model->getName() + "_" + std::to_string(i);
-				if (modelMap.find(name) == modelMap.end()) {
-					model->setName(name);
-					modelMap.emplace(name, model);
-					break;
-				}
-			}
-		}
+		addModel(std::unique_ptr<Model>(model));
+		hasLights |= model->light.type != ModelLightType::None;
 	}
 
+	// Lights are placed by the world transforms of their nodes
+	if (hasLights) {
+		updateTransforms();
+		for (auto model : models) {
+			const auto& light = model->light;
+			glm::mat4 world = graph.getWorldTransform(model->node);
+			if (light.type == ModelLightType::Point)
+				addPointLight(model->getName().c_str(), glm::vec3(world[3]), light.color, light.intensity);
+			else if (light.type == ModelLightType::Directional)
+				addDirLight(model->getName().c_str(), glm::normalize(glm::vec3(world * glm::vec4(0.0f, 0.0f, -1.0f, 0.0f))),
+					light.color, light.intensity);
+		}
+	}
 	return models;
 }
 
+Model* Scene::addModel(std::unique_ptr<Model> model)
+{
+	model->node = graph.addNode(model->parent ? model->parent->node : INVALID_NODE,
+		model->transComp.getTransformMatrix());
+
+	if (modelMap.find(model->getName()) != modelMap.end()) {
+		auto& suffix = modelNameSuffixes[model->getName()];
+		std::string name;
+		do {
+			name = model->getName() + "_" + std::to_string(++suffix);
+		} while (modelMap.find(name) != modelMap.end());
+		model->setName(name);
+	}
+	auto name = model->getName();
+	return modelMap.emplace(name, std::move(model)).first->second.get();
+}
+
 Model* Scene::addModel(const char* modelName, const char* objFilename)
 {
 	auto model = new Model(objFilename);
@@ -209,6 +405,18 @@ Model* Scene::addModel(const char* modelName, const char* objFilename)
 	return model;
 }
 
+void Scene::setModelTransform(Model* model, const TransformComponent& transComp)
+{
+	model->transComp = transComp;
+	if (model->node != INVALID_NODE)
+		graph.setLocalTransform(model->node, transComp.getTransformMatrix());
+}
+
+size_t Scene::updateTransforms()
+{
+	return graph.update();
+}
+
 Model* Scene::getModel(const char* modelName)
 {
 	return modelMap[modelName].get();
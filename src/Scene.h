@@ -2,6 +2,7 @@
 
 #include <string>
 #include <memory>
+#include <functional>
 #include <unordered_map>
 
 #include <tiny_gltf.h>
@@ -9,6 +10,51 @@
 #include "Camera.h"
 #include "Model.h"
 #include "Light.h"
+#include "SceneGraph.h"
+
+// Seconds loadGLTFFile spent in each phase. The per-primitive phases run on the decoding
+// threads and add up the time of every thread, so together they can exceed decode.
+struct GltfImportTimings
+{
+	double cacheRead{ 0.0 };	// Hashing the source, reading the cooked geometry and texture manifest
+	double parse{ 0.0 };		// JSON and buffers
+	double decode{ 0.0 };		// Wall time of all primitives and the node hierarchy
+	double accessors{ 0.0 };
+	double normals{ 0.0 };		// Generated for primitives without NORMAL
+	double tangents{ 0.0 };		// Generated for primitives without TANGENT
+	double optimize{ 0.0 };		// Welding, reordering and LODs
+	double meshlets{ 0.0 };
+	double cacheWrite{ 0.0 };
+	bool cached{ false };		// Loaded from the cooked geometry, nothing was parsed or decoded
+};
+
+struct GltfImportOptions
+{
+	// Worker threads used to decode primitives, 0 picks the hardware concurrency
+	uint32_t threadCount{ 0 };
+
+	// Reorder triangles and vertices for the post-transform cache, overdraw and
+	// vertex fetch (see Geometry/MeshOptimizer.h), and generate LODs (see Geometry/Simplify.h)
+	bool optimizeMeshes{ true };
+
+	// Read and write cooked geometry (see GLTF/GLTFCooked.h).
+	// Only used with optimizeMeshes, the cooked file always holds optimized meshes.
+	// Off by default, a plain load never writes anything.
+	bool useCookedCache{ false };
+	// Where cooked files go, empty puts them next to the source file
+	std::string cookedCacheDir{};
+
+	// Load the KTX2 files texture_cook wrote into cookedCacheDir in place of the source images
+	// that are unchanged since (see GLTF/GLTFTextures.h)
+	bool useCookedTextures{ true };
+
+	// Called on the decoding threads after each primitive, with the number decoded so far.
+	// Not called when the cooked cache is used.
+	std::function<void(size_t done, size_t total)> onPrimitiveDecoded{};
+
+	// Filled with the phase times of the load when set
+	GltfImportTimings* timings{ nullptr };
+};
 
 class Scene
 {
@@ -16,12 +62,24 @@ public:
 	Scene();
 	~Scene();
 
-	std::vector<Model*> loadGLTFFile(const char* filename);
-	std::vector<Model*> addModelsFromGltfFile(const char* filename);
+	// Models come out in depth-first order of the node hierarchy, parents first.
+	// The caller owns them, nothing is added to the scene graph.
+	std::vector<Model*> loadGLTFFile(const char* filename, const GltfImportOptions& options = {});
+	// Loads and adds the models and their hierarchy to the scene graph, and the KHR_lights_punctual lights
+	std::vector<Model*> addModelsFromGltfFile(const char* filename, const GltfImportOptions& options = {});
 	Model* addModel(const char* modelName, const char* objFilename);
+	// Adds a model built by the caller to the scene graph, under the node of its parent if it has one.
+	// A name already in use gets a numeric suffix.
+	Model* addModel(std::unique_ptr<Model> model);
 	Model* getModel(const char* modelName);
 	std::unordered_map<std::string, std::unique_ptr<Model>>& getModelMap();
 
+	// Sets the local transform of a model and marks its subtree for updateTransforms
+	void setModelTransform(Model* model, const TransformComponent& transComp);
+	// Propagates changed local transforms to world transforms, returns the number of nodes touched
+	size_t updateTransforms();
+	const SceneGraph& getGraph() const { return graph; }
+
 	BaseCamera* addBaseCamera(const char* cameraName);
 	FPSCamera* addFPSCamera(const char* cameraName);
 	BaseCamera* getCamera(const char* cameraName);
@@ -47,6 +105,9 @@ private:
 
 	std::unordered_map<std::string, std::unique_ptr<BaseCamera>> cameraMap;
 	std::unordered_map<std::string, std::unique_ptr<Model>> modelMap;
+	// Last suffix given to a duplicate of each model name, probing for a free one starts after it
+	std::unordered_map<std::string, uint32_t> modelNameSuffixes;
+	SceneGraph graph;
 
 	std::unordered_map<std::string, std::unique_ptr<DirLight>> dirLightMap;
 	std::unordered_map<std::string, std::unique_ptr<PointLight>> pointLightMap;
@@ -0,0 +1,62 @@
+#include "SceneGraph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+NodeID SceneGraph::addNode(NodeID parent, const glm::mat4& localTransform)
+{
+	NodeID node = static_cast<NodeID>(parents.size());
+	if (parent != INVALID_NODE && (parent >= node || subtreeEnds[parent] != node))
+		throw std::runtime_error("SceneGraph: nodes have to be added in depth-first order");
+
+	localTransforms.push_back(localTransform);
+	worldTransforms.push_back(localTransform);
+	parents.push_back(parent);
+	subtreeEnds.push_back(node + 1);
+	dirty.push_back(0);
+
+	// Every ancestor's subtree now ends after the new node
+	for (NodeID p = parent; p != INVALID_NODE; p = parents[p])
+		subtreeEnds[p] = node + 1;
+
+	setLocalTransform(node, localTransform);
+	return node;
+}
+
+void SceneGraph::setLocalTransform(NodeID node, const glm::mat4& localTransform)
+{
+	localTransforms[node] = localTransform;
+	if (!dirty[node]) {
+		dirty[node] = 1;
+		dirtyNodes.push_back(node);
+	}
+}
+
+size_t SceneGraph::update()
+{
+	changedRanges.clear();
+	if (dirtyNodes.empty())
+		return 0;
+
+	// Sorted, a dirty node inside an already walked subtree is covered by it
+	std::sort(dirtyNodes.begin(), dirtyNodes.end());
+	size_t updated = 0;
+	NodeID walkedEnd = 0;
+	for (auto root : dirtyNodes) {
+		dirty[root] = 0;
+		if (root < walkedEnd)
+			continue;
+
+		NodeID end = subtreeEnds[root];
+		for (NodeID node = root; node < end; ++node) {
+			NodeID parent = parents[node];
+			worldTransforms[node] = parent == INVALID_NODE ? 
+				localTransforms[node] : worldTransforms[parent] * localTransforms[node];
+		}
+		changedRanges.emplace_back(root, end);
+		updated += end - root;
+		walkedEnd = end;
+	}
+	dirtyNodes.clear();
+	return updated;
+}
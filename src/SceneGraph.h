@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+using NodeID = uint32_t;
+constexpr NodeID INVALID_NODE = UINT32_MAX;
+
+// Transform hierarchy with local and world matrices in flat arrays.
+// Nodes are stored in depth-first order, so the subtree of a node is the
+// contiguous range [node, getSubtreeEnd(node)) and a parent always comes
+// before its children. update() only walks the subtrees of dirty nodes.
+class SceneGraph
+{
+public:
+	// parent has to be INVALID_NODE or lie on the path to the last added node,
+	// which is what a depth-first traversal of a hierarchy produces
+	NodeID addNode(NodeID parent, const glm::mat4& localTransform);
+
+	void setLocalTransform(NodeID node, const glm::mat4& localTransform);
+	const glm::mat4& getLocalTransform(NodeID node) const { return localTransforms[node]; }
+	// Valid after update() for nodes changed since the last update
+	const glm::mat4& getWorldTransform(NodeID node) const { return worldTransforms[node]; }
+
+	NodeID getParent(NodeID node) const { return parents[node]; }
+	NodeID getSubtreeEnd(NodeID node) const { return subtreeEnds[node]; }
+	size_t getNodeNum() const { return parents.size(); }
+
+	// Propagates world transforms through the dirty subtrees. Returns the number of nodes updated.
+	size_t update();
+
+	// Node ranges [first, second) whose world transforms changed in the last update, in order
+	const std::vector<std::pair<NodeID, NodeID>>& getChangedRanges() const { return changedRanges; }
+
+private:
+	std::vector<glm::mat4> localTransforms;
+	std::vector<glm::mat4> worldTransforms;
+	std::vector<NodeID> parents;
+	std::vector<NodeID> subtreeEnds;
+
+	std::vector<uint8_t> dirty;
+	std::vector<NodeID> dirtyNodes;
+	std::vector<std::pair<NodeID, NodeID>> changedRanges;
+};
@@ -0,0 +1,544 @@
+#include "StressScene.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <json.hpp>
+
+#include "Scene.h"
+
+namespace {
+	// glTF requires the mime type of an image in a bufferView, it is told by the magic bytes
+	const char* getImageMimeType(const uint8_t* data, size_t size)
+	{
+		static const uint8_t pngMagic[4] = { 0x89, 'P', 'N', 'G' };
+		static const uint8_t ktx2Magic[8] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB };
+		if (size >= sizeof(pngMagic) && std::equal(pngMagic, pngMagic + sizeof(pngMagic), data))
+			return "image/png";
+		if (size >= sizeof(ktx2Magic) && std::equal(ktx2Magic, ktx2Magic + sizeof(ktx2Magic), data))
+			return "image/ktx2";
+		return "image/jpeg";
+	}
+
+	// An asset as loaded from its file, models keep the order of the file with parents first.
+	// Models without a mesh anywhere below them (cameras, lights) are dropped.
+	struct StressAsset
+	{
+		std::string name;
+		std::vector<std::unique_ptr<Model>> models;
+		std::vector<int> parents;	// Index into models, -1 for roots
+		size_t meshNum{ 0 };
+		uint64_t triangleNum{ 0 };
+		glm::vec3 boundsMin{ FLT_MAX };
+		glm::vec3 boundsMax{ -FLT_MAX };
+	};
+
+	struct StressInstance
+	{
+		uint32_t asset;
+		bool unique;
+		glm::mat4 transform;
+	};
+
+	struct StressLight
+	{
+		bool point;
+		glm::vec3 vector;	// Position of point lights, direction of directional ones
+		glm::vec3 color;
+		float intensity;
+	};
+
+	std::vector<StressAsset> loadAssets(const StressSceneOptions& options, bool useCookedTextures)
+	{
+		if (options.assets.empty())
+			throw std::runtime_error("failed to generate a stress scene without assets!");
+
+		GltfImportOptions importOptions;
+		importOptions.threadCount = options.threadCount;
+		importOptions.useCookedTextures = useCookedTextures;
+
+		Scene loader;
+		std::vector<StressAsset> assets(options.assets.size());
+		for (size_t a = 0; a < assets.size(); ++a) {
+			auto& asset = assets[a];
+			asset.name = std::filesystem::path(options.assets[a]).stem().string();
+
+			std::vector<std::unique_ptr<Model>> models;
+			for (auto model : loader.loadGLTFFile(options.assets[a].c_str(), importOptions))
+				models.emplace_back(model);
+			std::unordered_map<const Model*, size_t> indices;
+			for (size_t i = 0; i < models.size(); ++i)
+				indices.emplace(models[i].get(), i);
+
+			// Children come after their parents, so walking backwards reaches the parent last
+			std::vector<uint8_t> keep(models.size(), 0);
+			for (size_t i = models.size(); i-- > 0;) {
+				if (!models[i]->getMeshes().empty())
+					keep[i] = 1;
+				if (keep[i] && models[i]->parent)
+					keep[indices[models[i]->parent]] = 1;
+			}
+
+			std::vector<glm::mat4> worlds(models.size());
+			std::vector<int> keptIndices(models.size(), -1);
+			for (size_t i = 0; i < models.size(); ++i) {
+				auto& model = models[i];
+				int parent = model->parent ? static_cast<int>(indices[model->parent]) : -1;
+				worlds[i] = (parent < 0 ? glm::mat4(1.0f) : worlds[parent]) * model->transComp.getTransformMatrix();
+				if (!keep[i])
+					continue;
+
+				for (const auto& mesh : model->getMeshes()) {
+					glm::mat4 transform = worlds[i] * mesh.transComp.getTransformMatrix();
+					for (const auto& vertex : mesh.geometry->vertices) {
+						glm::vec3 pos = transform * glm::vec4(vertex.pos, 1.0f);
+						asset.boundsMin = glm::min(asset.boundsMin, pos);
+						asset.boundsMax = glm::max(asset.boundsMax, pos);
+					}
+					asset.triangleNum += mesh.geometry->indices.size() / 3;
+				}
+				asset.meshNum += model->getMeshes().size();
+
+				keptIndices[i] = static_cast<int>(asset.models.size());
+				asset.parents.push_back(parent < 0 ? -1 : keptIndices[parent]);
+				asset.models.push_back(std::move(model));
+			}
+
+			if (asset.meshNum == 0)
+				throw std::runtime_error("failed to find a mesh in " + options.assets[a] + "!");
+		}
+		return assets;
+	}
+
+	float getSpacing(const StressSceneOptions& options, const std::vector<StressAsset>& assets)
+	{
+		if (options.spacing > 0.0f)
+			return options.spacing;
+
+		// Instances turn around Y, the diagonal keeps them apart at any angle
+		float extent = 0.0f;
+		for (const auto& asset : assets) {
+			glm::vec2 size{ asset.boundsMax.x - asset.boundsMin.x, asset.boundsMax.z - asset.boundsMin.z };
+			extent = std::max(extent, glm::length(size));
+		}
+		return std::max(1.0f, extent * 1.1f);
+	}
+
+	uint32_t getGridSide(const StressSceneOptions& options)
+	{
+		return std::max(1u, static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(options.instanceNum)))));
+	}
+
+	std::vector<StressInstance> layoutInstances(const StressSceneOptions& options, const std::vector<StressAsset>& assets)
+	{
+		float spacing = getSpacing(options, assets);
+		uint32_t side = getGridSide(options);
+		float half = (side - 1) * spacing * 0.5f;
+		double uniqueRatio = std::clamp(static_cast<double>(options.uniqueRatio), 0.0, 1.0);
+
+		std::mt19937 rng{ options.seed };
+		std::uniform_real_distribution<float> yaw{ 0.0f, 360.0f };
+
+		std::vector<StressInstance> instances(options.instanceNum);
+		for (uint32_t i = 0; i < options.instanceNum; ++i) {
+			auto& instance = instances[i];
+			instance.asset = i % static_cast<uint32_t>(assets.size());
+			// Evenly spread, exactly floor(instanceNum * uniqueRatio) of them
+			instance.unique = static_cast<uint64_t>((i + 1) * uniqueRatio) != static_cast<uint64_t>(i * uniqueRatio);
+
+			// Each asset stands on the ground, centered in its cell
+			const auto& asset = assets[instance.asset];
+			glm::vec3 cell{ (i % side) * spacing - half, 0.0f, (i / side) * spacing - half };
+			glm::vec3 pivot{ (asset.boundsMin.x + asset.boundsMax.x) * 0.5f, asset.boundsMin.y, (asset.boundsMin.z + asset.boundsMax.z) * 0.5f };
+			instance.transform = glm::translate(glm::mat4(1.0f), cell) *
+				glm::rotate(glm::mat4(1.0f), glm::radians(yaw(rng)), glm::vec3(0.0f, 1.0f, 0.0f)) *
+				glm::translate(glm::mat4(1.0f), -pivot);
+		}
+		return instances;
+	}
+
+	std::vector<StressLight> layoutLights(const StressSceneOptions& options, const std::vector<StressAsset>& assets)
+	{
+		float spacing = getSpacing(options, assets);
+		float half = getGridSide(options) * spacing * 0.5f;
+
+		// Seeded apart from the instances, the light count does not change their layout
+		std::mt19937 rng{ options.seed ^ 0x9e3779b9u };
+		std::uniform_real_distribution<float> unit{ 0.0f, 1.0f };
+
+		std::vector<StressLight> lights;
+		lights.reserve(options.pointLightNum + options.dirLightNum);
+		for (uint32_t i = 0; i < options.pointLightNum; ++i) {
+			glm::vec3 position{ (unit(rng) * 2.0f - 1.0f) * half, spacing, (unit(rng) * 2.0f - 1.0f) * half };
+			glm::vec3 color{ 0.3f + 0.7f * unit(rng), 0.3f + 0.7f * unit(rng), 0.3f + 0.7f * unit(rng) };
+			lights.push_back({ true, position, color, 80.0f });
+		}
+		for (uint32_t i = 0; i < options.dirLightNum; ++i) {
+			glm::vec3 direction = glm::normalize(glm::vec3(unit(rng) * 2.0f - 1.0f, -1.0f, unit(rng) * 2.0f - 1.0f));
+			lights.push_back({ false, direction, glm::vec3(1.0f), 1.0f });
+		}
+		return lights;
+	}
+
+	// Lights past MAX_LIGHT_NUM of a kind in the scene are not added, the renderer has no room for them
+	void addLights(Scene& scene, const std::vector<StressLight>& lights, StressSceneStats& stats)
+	{
+		for (const auto& light : lights) {
+			if (light.point) {
+				if (scene.getPointLightMap().size() >= MAX_LIGHT_NUM)
+					continue;
+				std::string name = "stress_point_" + std::to_string(stats.pointLights++);
+				scene.addPointLight(name.c_str(), light.vector, light.color, light.intensity);
+			}
+			else {
+				if (scene.getDirLightMap().size() >= MAX_LIGHT_NUM)
+					continue;
+				std::string name = "stress_dir_" + std::to_string(stats.dirLights++);
+				scene.addDirLight(name.c_str(), light.vector, light.color, light.intensity);
+			}
+		}
+	}
+
+	void countInstances(const std::vector<StressAsset>& assets, const std::vector<StressInstance>& instances, StressSceneStats& stats)
+	{
+		std::vector<uint8_t> shared(assets.size(), 0);
+		for (const auto& instance : instances) {
+			const auto& asset = assets[instance.asset];
+			++stats.instances;
+			stats.models += asset.models.size() + 1;
+			stats.meshes += asset.meshNum;
+			stats.triangles += asset.triangleNum;
+			if (instance.unique) {
+				++stats.uniqueInstances;
+				stats.geometries += asset.meshNum;
+			}
+			else if (!shared[instance.asset]) {
+				shared[instance.asset] = 1;
+				stats.geometries += asset.meshNum;
+			}
+		}
+	}
+
+	std::ostream& writeMatrix(std::ostream& out, const glm::mat4& m)
+	{
+		out << "[";
+		for (int i = 0; i < 16; ++i)
+			out << (i ? "," : "") << m[i / 4][i % 4];
+		return out << "]";
+	}
+
+	nlohmann::json toJson(const glm::vec3& v)
+	{
+		return nlohmann::json::array({ v.x, v.y, v.z });
+	}
+}
+
+StressSceneStats addStressScene(Scene& scene, const StressSceneOptions& options)
+{
+	auto assets = loadAssets(options, true);
+	auto instances = layoutInstances(options, assets);
+
+	StressSceneStats stats{};
+	countInstances(assets, instances, stats);
+
+	for (uint32_t i = 0; i < instances.size(); ++i) {
+		const auto& instance = instances[i];
+		const auto& asset = assets[instance.asset];
+
+		std::string rootName = asset.name + "_" + std::to_string(i);
+		auto root = std::make_unique<Model>(rootName, std::vector<Mesh>{});
+		root->transComp.transform = instance.transform;
+		Model* rootModel = scene.addModel(std::move(root));
+
+		std::vector<Model*> copies(asset.models.size());
+		for (size_t k = 0; k < asset.models.size(); ++k) {
+			const auto& source = *asset.models[k];
+			std::vector<Mesh> meshes = source.getMeshes();
+			if (instance.unique) {
+				for (auto& mesh : meshes)
+					mesh.geometry = std::make_shared<MeshGeometry>(*mesh.geometry);
+			}
+
+			auto model = std::make_unique<Model>(rootName + "/" + source.getName(), std::move(meshes));
+			model->transComp = source.transComp;
+			model->parent = asset.parents[k] < 0 ? rootModel : copies[asset.parents[k]];
+			copies[k] = scene.addModel(std::move(model));
+		}
+	}
+	scene.updateTransforms();
+
+	addLights(scene, layoutLights(options, assets), stats);
+	return stats;
+}
+
+StressSceneStats writeStressScene(const std::string& filename, const StressSceneOptions& options)
+{
+	// Source images, the cooked ones are found again when the written scene is loaded
+	auto assets = loadAssets(options, false);
+	auto instances = layoutInstances(options, assets);
+	auto lights = layoutLights(options, assets);
+
+	StressSceneStats stats{};
+	countInstances(assets, instances, stats);
+
+	std::filesystem::path path{ filename };
+	std::filesystem::path directory = std::filesystem::absolute(path).parent_path();
+	std::filesystem::path binPath = std::filesystem::path(path).replace_extension(".bin");
+
+	std::ofstream bin{ binPath, std::ios::binary };
+	if (!bin)
+		throw std::runtime_error("failed to open " + binPath.string() + "!");
+
+	// Every geometry of the assets once, vertex attributes and indices in views of their own
+	auto accessors = nlohmann::json::array();
+	auto bufferViews = nlohmann::json::array();
+	auto materials = nlohmann::json::array();
+	auto textures = nlohmann::json::array();
+	auto images = nlohmann::json::array();
+	std::unordered_map<std::string, int> imageIndices;
+	size_t binSize = 0;
+
+	auto addAccessor = [&](const void* data, size_t count, size_t elementSize, int componentType, const char* type, int target) {
+		bin.write(static_cast<const char*>(data), count * elementSize);
+		bufferViews.push_back({ { "buffer", 0 }, { "byteOffset", binSize }, { "byteLength", count * elementSize }, { "target", target } });
+		binSize += count * elementSize;
+		accessors.push_back({ { "bufferView", bufferViews.size() - 1 }, { "componentType", componentType }, { "count", count }, { "type", type } });
+		return accessors.size() - 1;
+	};
+	auto addTexture = [&](const Texture& texture) {
+		const auto& texturePath = texture.path;
+		auto it = imageIndices.find(texturePath);
+		if (it == imageIndices.end()) {
+			if (texture.embedded.data) {
+				// An image embedded in the asset moves into the bin, the views after it stay 4 byte aligned
+				const auto& embedded = texture.embedded;
+				bin.write(reinterpret_cast<const char*>(embedded.data), embedded.size);
+				bufferViews.push_back({ { "buffer", 0 }, { "byteOffset", binSize }, { "byteLength", embedded.size } });
+				binSize += embedded.size;
+				static const char padding[4]{};
+				size_t paddingSize = (4 - binSize % 4) % 4;
+				bin.write(padding, paddingSize);
+				binSize += paddingSize;
+				images.push_back({ { "bufferView", bufferViews.size() - 1 }, { "mimeType", getImageMimeType(embedded.data, embedded.size) } });
+			}
+			else {
+				auto uri = std::filesystem::absolute(texturePath).lexically_proximate(directory).generic_string();
+				images.push_back({ { "uri", uri } });
+			}
+			textures.push_back({ { "source", images.size() - 1 } });
+			it = imageIndices.emplace(texturePath, static_cast<int>(textures.size() - 1)).first;
+		}
+		return it->second;
+	};
+
+	// Primitives of the mesh of each model that has one, shared by every instance of the asset
+	std::vector<std::vector<std::string>> assetMeshes(assets.size());
+	for (size_t a = 0; a < assets.size(); ++a) {
+		for (const auto& model : assets[a].models) {
+			if (model->getMeshes().empty()) {
+				assetMeshes[a].emplace_back();
+				continue;
+			}
+
+			auto primitives = nlohmann::json::array();
+			for (const auto& mesh : model->getMeshes()) {
+				const auto& geometry = *mesh.geometry;
+				const auto& mat = geometry.mat;
+				size_t vertexNum = geometry.vertices.size();
+
+				std::vector<glm::vec3> positions(vertexNum), normals(vertexNum);
+				std::vector<glm::vec2> texCoords(vertexNum);
+				std::vector<glm::vec4> tangents(vertexNum);
+				glm::vec3 posMin{ FLT_MAX }, posMax{ -FLT_MAX };
+				for (size_t i = 0; i < vertexNum; ++i) {
+					const auto& vertex = geometry.vertices[i];
+					positions[i] = vertex.pos;
+					normals[i] = vertex.normal;
+					texCoords[i] = vertex.texCoord;
+					float handedness = glm::dot(glm::cross(vertex.normal, vertex.tangent), vertex.bitangent) < 0.0f ? -1.0f : 1.0f;
+					tangents[i] = glm::vec4(vertex.tangent, handedness);
+					posMin = glm::min(posMin, vertex.pos);
+					posMax = glm::max(posMax, vertex.pos);
+				}
+
+				nlohmann::json attributes;
+				attributes["POSITION"] = addAccessor(positions.data(), vertexNum, sizeof(glm::vec3), 5126, "VEC3", 34962);
+				accessors.back()["min"] = toJson(posMin);
+				accessors.back()["max"] = toJson(posMax);
+				attributes["NORMAL"] = addAccessor(normals.data(), vertexNum, sizeof(glm::vec3), 5126, "VEC3", 34962);
+				attributes["TEXCOORD_0"] = addAccessor(texCoords.data(), vertexNum, sizeof(glm::vec2), 5126, "VEC2", 34962);
+				attributes["TANGENT"] = addAccessor(tangents.data(), vertexNum, sizeof(glm::vec4), 5126, "VEC4", 34962);
+				auto indices = addAccessor(geometry.indices.data(), geometry.indices.size(), sizeof(uint32_t), 5125, "SCALAR", 34963);
+
+				auto textureInfo = [&](int texture) {
+					return nlohmann::json{ { "index", addTexture(geometry.textures[texture]) } };
+				};
+				nlohmann::json pbr{
+					{ "baseColorFactor", { mat.pbrBaseColorFactor.x, mat.pbrBaseColorFactor.y, mat.pbrBaseColorFactor.z, mat.pbrBaseColorFactor.w } },
+					{ "metallicFactor", mat.pbrMetallicFactor },
+					{ "roughnessFactor", mat.pbrRoughnessFactor } };
+				if (mat.pbrBaseColorTexture >= 0)
+					pbr["baseColorTexture"] = textureInfo(mat.pbrBaseColorTexture);
+				if (mat.pbrMetallicRoughnessTexture >= 0)
+					pbr["metallicRoughnessTexture"] = textureInfo(mat.pbrMetallicRoughnessTexture);
+				nlohmann::json material{ { "pbrMetallicRoughness", pbr }, { "emissiveFactor", toJson(mat.emissiveFactor) }, { "doubleSided", mat.doubleSided != 0 } };
+				if (mat.alphaMode == 1) {
+					material["alphaMode"] = "MASK";
+					material["alphaCutoff"] = mat.alphaCutoff;
+				}
+				else if (mat.alphaMode == 2)
+					material["alphaMode"] = "BLEND";
+				if (mat.normalTexture >= 0) {
+					material["normalTexture"] = textureInfo(mat.normalTexture);
+					material["normalTexture"]["scale"] = mat.normalTextureScale;
+				}
+				if (mat.occlusionTexture >= 0) {
+					material["occlusionTexture"] = textureInfo(mat.occlusionTexture);
+					material["occlusionTexture"]["strength"] = mat.occlusionTextureStrength;
+				}
+				if (mat.emissiveTexture >= 0)
+					material["emissiveTexture"] = textureInfo(mat.emissiveTexture);
+				materials.push_back(material);
+
+				primitives.push_back({ { "attributes", attributes }, { "indices", indices }, { "material", materials.size() - 1 } });
+			}
+			assetMeshes[a].push_back(nlohmann::json{ { "primitives", primitives } }.dump());
+		}
+	}
+	bin.close();
+	if (!bin)
+		throw std::runtime_error("failed to write " + binPath.string() + "!");
+
+	// Shared meshes first, then one copy per unique instance in the order of the nodes
+	std::vector<std::vector<size_t>> sharedMeshIndices(assets.size());
+	std::vector<const std::string*> meshes;
+	for (size_t a = 0; a < assets.size(); ++a) {
+		for (const auto& mesh : assetMeshes[a]) {
+			sharedMeshIndices[a].push_back(meshes.size());
+			if (!mesh.empty())
+				meshes.push_back(&mesh);
+		}
+	}
+
+	std::vector<std::vector<std::vector<size_t>>> children(assets.size());
+	for (size_t a = 0; a < assets.size(); ++a) {
+		// Last entry lists the roots of the asset
+		children[a].resize(assets[a].models.size() + 1);
+		for (size_t k = 0; k < assets[a].models.size(); ++k) {
+			int parent = assets[a].parents[k];
+			children[a][parent < 0 ? assets[a].models.size() : parent].push_back(k);
+		}
+	}
+
+	std::ofstream out{ path };
+	if (!out)
+		throw std::runtime_error("failed to open " + filename + "!");
+	out << std::setprecision(9);
+
+	// Streamed, a million nodes as json values would not fit in memory
+	out << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"stress_scene\"},\"scene\":0,\"nodes\":[";
+	size_t nodeNum = 0;
+	std::vector<size_t> rootNodes;
+	rootNodes.reserve(instances.size() + lights.size());
+	for (uint32_t i = 0; i < instances.size(); ++i) {
+		const auto& instance = instances[i];
+		const auto& asset = assets[instance.asset];
+		const auto& assetChildren = children[instance.asset];
+		size_t base = nodeNum + 1;
+		auto writeChildren = [&](const std::vector<size_t>& list) {
+			if (list.empty())
+				return;
+			out << ",\"children\":[";
+			for (size_t c = 0; c < list.size(); ++c)
+				out << (c ? "," : "") << base + list[c];
+			out << "]";
+		};
+
+		std::string rootName = asset.name + "_" + std::to_string(i);
+		rootNodes.push_back(nodeNum);
+		out << (nodeNum ? "," : "") << "{\"name\":" << nlohmann::json(rootName).dump() << ",\"matrix\":";
+		writeMatrix(out, instance.transform);
+		writeChildren(assetChildren.back());
+		out << "}";
+
+		for (size_t k = 0; k < asset.models.size(); ++k) {
+			const auto& model = *asset.models[k];
+			out << ",{\"name\":" << nlohmann::json(rootName + "/" + model.getName()).dump() << ",\"matrix\":";
+			writeMatrix(out, model.transComp.getTransformMatrix());
+			if (!assetMeshes[instance.asset][k].empty()) {
+				size_t mesh = sharedMeshIndices[instance.asset][k];
+				if (instance.unique) {
+					mesh = meshes.size();
+					meshes.push_back(&assetMeshes[instance.asset][k]);
+				}
+				out << ",\"mesh\":" << mesh;
+			}
+			writeChildren(assetChildren[k]);
+			out << "}";
+		}
+		nodeNum = base + asset.models.size();
+	}
+
+	auto lightArray = nlohmann::json::array();
+	for (const auto& light : lights) {
+		rootNodes.push_back(nodeNum);
+		nlohmann::json node{ { "extensions", { { "KHR_lights_punctual", { { "light", lightArray.size() } } } } } };
+		if (light.point) {
+			node["name"] = "stress_point_" + std::to_string(stats.pointLights++);
+			node["translation"] = toJson(light.vector);
+		}
+		else {
+			// Directional lights shine down their local -Z
+			node["name"] = "stress_dir_" + std::to_string(stats.dirLights++);
+			glm::vec3 forward{ 0.0f, 0.0f, -1.0f };
+			glm::vec3 axis = glm::cross(forward, light.vector);
+			glm::quat rotation = glm::length(axis) < 1e-6f ?
+				glm::angleAxis(glm::dot(forward, light.vector) > 0.0f ? 0.0f : glm::pi<float>(), glm::vec3(0.0f, 1.0f, 0.0f)) :
+				glm::angleAxis(std::acos(std::clamp(glm::dot(forward, light.vector), -1.0f, 1.0f)), glm::normalize(axis));
+			node["rotation"] = { rotation.x, rotation.y, rotation.z, rotation.w };
+		}
+		// Engine units, not candela and lux
+		lightArray.push_back({ { "type", light.point ? "point" : "directional" }, { "color", toJson(light.color) }, { "intensity", light.intensity } });
+		out << (nodeNum ? "," : "") << node.dump();
+		++nodeNum;
+	}
+	out << "]";
+
+	out << ",\"scenes\":[{\"nodes\":[";
+	for (size_t i = 0; i < rootNodes.size(); ++i)
+		out << (i ? "," : "") << rootNodes[i];
+	out << "]}]";
+
+	out << ",\"meshes\":[";
+	for (size_t i = 0; i < meshes.size(); ++i)
+		out << (i ? "," : "") << *meshes[i];
+	out << "]";
+
+	out << ",\"accessors\":" << accessors.dump() << ",\"bufferViews\":" << bufferViews.dump()
+		<< ",\"buffers\":[{\"byteLength\":" << binSize << ",\"uri\":" << nlohmann::json(binPath.filename().string()).dump() << "}]"
+		<< ",\"materials\":" << materials.dump();
+	if (!images.empty())
+		out << ",\"textures\":" << textures.dump() << ",\"images\":" << images.dump();
+	if (!lightArray.empty()) {
+		out << ",\"extensionsUsed\":[\"KHR_lights_punctual\"],\"extensions\":"
+			<< nlohmann::json{ { "KHR_lights_punctual", { { "lights", lightArray } } } }.dump();
+	}
+	out << "}\n";
+
+	out.close();
+	if (!out)
+		throw std::runtime_error("failed to write " + filename + "!");
+	return stats;
+}
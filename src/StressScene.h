@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Scene;
+
+// Procedural scenes for scaling tests: a grid of instances of the bundled glTF assets plus
+// point and directional lights. The layout only depends on the options, so a scene written
+// to glTF and the same options fed to a Scene give the same instances and lights.
+struct StressSceneOptions
+{
+	// glTF files placed over the grid, instance i is assets[i % size]
+	std::vector<std::string> assets{ "assets/models/cube/cube.gltf", "assets/models/cbox/cornellBox.gltf" };
+	uint32_t instanceNum{ 1000 };
+	// Fraction of the instances with their own copy of the geometry, spread evenly over the grid.
+	// The others share the geometry of their asset, so the renderer uploads it once.
+	float uniqueRatio{ 0.0f };
+	// A Scene takes lights up to MAX_LIGHT_NUM of each kind (see Light.h), a written scene all of them
+	uint32_t pointLightNum{ 16 };
+	uint32_t dirLightNum{ 1 };
+	// Distance between neighbouring instances, 0 derives it from the largest asset
+	float spacing{ 0.0f };
+	uint32_t seed{ 1 };
+	// Worker threads used to load the assets, 0 picks the hardware concurrency
+	uint32_t threadCount{ 0 };
+};
+
+struct StressSceneStats
+{
+	uint32_t instances{ 0 };
+	uint32_t uniqueInstances{ 0 };
+	size_t models{ 0 };			// Scene graph nodes or glTF nodes, lights excluded
+	size_t meshes{ 0 };
+	size_t geometries{ 0 };		// Distinct vertex and index data
+	uint64_t triangles{ 0 };	// Over every instance
+	uint32_t pointLights{ 0 };
+	uint32_t dirLights{ 0 };
+};
+
+// Adds the instances as models of scene and the lights.
+// Throws std::runtime_error if an asset cannot be loaded.
+StressSceneStats addStressScene(Scene& scene, const StressSceneOptions& options);
+
+// Writes the scene to filename (.gltf) and its geometry to a .bin file next to it.
+// Instances of an asset share one glTF mesh, unique ones get a mesh of their own that the importer
+// decodes separately. Images are referenced where the assets keep them, lights use KHR_lights_punctual.
+// Only the metallic-roughness material fields are written.
+// Throws std::runtime_error if an asset cannot be loaded or the files cannot be written.
+StressSceneStats writeStressScene(const std::string& filename, const StressSceneOptions& options);
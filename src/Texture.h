@@ -1,4 +1,6 @@
 #pragma once
+#include <cstdint>
+#include <memory>
 #include <string>
 
 enum class TextureType
@@ -8,8 +10,23 @@ enum class TextureType
 	NORMAL
 };
 
+// Encoded bytes of an image that has no file of its own: a bufferView of a .glb or .bin file,
+// or a data uri. owner keeps data alive, the mapping of the buffer file or the decoded uri.
+struct EmbeddedImage
+{
+	std::shared_ptr<const void> owner;
+	const uint8_t* data{ nullptr };
+	size_t size{ 0 };
+	// Mapped file data points into and its offset there, empty for a decoded data uri
+	std::string file;
+	uint64_t offset{ 0 };
+};
+
 struct Texture
 {
 	TextureType type;
+	// File of the image. An embedded image gets a name of its own the texture cache keys on.
 	std::string path;
-};
\ No newline at end of file
+	// Decoded from memory instead of path when data is set
+	EmbeddedImage embedded{};
+};
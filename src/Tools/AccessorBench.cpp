@@ -0,0 +1,156 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+
+#include "GLTF/GLTFHelper.h"
+
+// Compares the bulk/SIMD accessor paths against the per-element switch.
+// Without arguments it runs on synthetic packed data, given a glTF file it
+// also decodes every primitive attribute and index accessor of that file.
+// usage: gltf_accessor_bench [file.gltf] [iterations]
+
+namespace {
+	template<class Func>
+	double bestMs(int iterations, Func&& func)
+	{
+		double best = 0.0;
+		for (int i = 0; i < iterations; ++i) {
+			auto start = std::chrono::high_resolution_clock::now();
+			func();
+			auto end = std::chrono::high_resolution_clock::now();
+			double ms = std::chrono::duration<double, std::milli>(end - start).count();
+			if (i == 0 || ms < best)
+				best = ms;
+		}
+		return best;
+	}
+
+	void printRow(const std::string& name, double perElement, double fast, bool match)
+	{
+		std::cout << std::left << std::setw(28) << name << std::right
+			<< std::setw(14) << std::fixed << std::setprecision(3) << perElement
+			<< std::setw(12) << fast
+			<< std::setw(9) << std::setprecision(2) << perElement / fast << "x"
+			<< (match ? "" : "  MISMATCH") << std::endl;
+	}
+
+	// Same shape as the per-element accessor loop: a switch on the component type for every value
+	template<class Dst>
+	void convertPerElement(int componentType, const uint8_t* data, size_t stride, Dst* dst, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i) {
+			switch (componentType)
+			{
+			case TINYGLTF_COMPONENT_TYPE_BYTE:
+				dst[i] = static_cast<Dst>(*reinterpret_cast<const int8_t*>(data)); break;
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+				dst[i] = static_cast<Dst>(*reinterpret_cast<const uint8_t*>(data)); break;
+			case TINYGLTF_COMPONENT_TYPE_SHORT:
+				dst[i] = static_cast<Dst>(*reinterpret_cast<const int16_t*>(data)); break;
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+				dst[i] = static_cast<Dst>(*reinterpret_cast<const uint16_t*>(data)); break;
+			default:
+				break;
+			}
+			data += stride;
+		}
+	}
+
+	template<class Src, class Dst, class Kernel>
+	void benchKernel(const std::string& name, int componentType, Kernel kernel, size_t count, int iterations)
+	{
+		std::vector<Src> src(count);
+		std::mt19937 rng{ 42 };
+		for (auto& v : src)
+			v = static_cast<Src>(rng());
+
+		std::vector<Dst> reference(count), result(count);
+		auto bytes = reinterpret_cast<const uint8_t*>(src.data());
+		double perElement = bestMs(iterations, [&]() { convertPerElement(componentType, bytes, sizeof(Src), reference.data(), count); });
+		double fast = bestMs(iterations, [&]() { kernel(src.data(), result.data(), count); });
+		printRow(name, perElement, fast, reference == result);
+	}
+
+	void benchDocument(const char* filename, int iterations)
+	{
+		GltfDocument doc;
+		std::string error, warn;
+		if (!doc.load(filename, &error, &warn))
+			throw std::runtime_error(error);
+
+		const auto& tModel = doc.getModel();
+		double perElementTotal = 0.0, fastTotal = 0.0;
+		bool match = true;
+
+		auto benchVec = [&](const tinygltf::Accessor& tAcces, auto tag) {
+			using T = decltype(tag);
+			std::vector<T> reference, result;
+			perElementTotal += bestMs(iterations, [&]() { reference.clear(); getAccessorDataPerElement(doc, tAcces, reference); });
+			fastTotal += bestMs(iterations, [&]() { result.clear(); getAccessorData(doc, tAcces, result); });
+			match &= reference == result;
+		};
+
+		for (const auto& tMesh : tModel.meshes) {
+			for (const auto& tPrim : tMesh.primitives) {
+				for (const auto& [name, accessor] : tPrim.attributes) {
+					const auto& tAcces = tModel.accessors[accessor];
+					switch (tAcces.type)
+					{
+					case TINYGLTF_TYPE_VEC2: benchVec(tAcces, glm::vec2{}); break;
+					case TINYGLTF_TYPE_VEC3: benchVec(tAcces, glm::vec3{}); break;
+					case TINYGLTF_TYPE_VEC4: benchVec(tAcces, glm::vec4{}); break;
+					default: break;
+					}
+				}
+
+				if (tPrim.indices >= 0) {
+					const auto& tAcces = tModel.accessors[tPrim.indices];
+					std::vector<uint32_t> reference, result;
+					perElementTotal += bestMs(iterations, [&]() { reference.clear(); getAccessorDataScalarPerElement(doc, tAcces, reference); });
+					fastTotal += bestMs(iterations, [&]() { result.clear(); getAccessorDataScalar(doc, tAcces, result); });
+					match &= reference == result;
+				}
+			}
+		}
+
+		printRow(filename, perElementTotal, fastTotal, match);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const char* filename = argc > 1 ? argv[1] : nullptr;
+	int iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 10;
+	const size_t count = 1 << 22;
+
+	try {
+		std::cout << std::left << std::setw(28) << "case" << std::right
+			<< std::setw(14) << "per-elem ms" << std::setw(12) << "fast ms" << std::setw(10) << "speedup" << std::endl;
+
+		benchKernel<uint8_t, float>("u8 -> float", TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE, convertU8ToFloat, count, iterations);
+		benchKernel<int8_t, float>("i8 -> float", TINYGLTF_COMPONENT_TYPE_BYTE, convertI8ToFloat, count, iterations);
+		benchKernel<uint16_t, float>("u16 -> float", TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT, convertU16ToFloat, count, iterations);
+		benchKernel<int16_t, float>("i16 -> float", TINYGLTF_COMPONENT_TYPE_SHORT, convertI16ToFloat, count, iterations);
+		benchKernel<uint8_t, uint32_t>("u8 -> u32 indices", TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE, convertU8ToU32, count, iterations);
+		benchKernel<uint16_t, uint32_t>("u16 -> u32 indices", TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT, convertU16ToU32, count, iterations);
+
+		if (filename != nullptr)
+			benchDocument(filename, iterations);
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
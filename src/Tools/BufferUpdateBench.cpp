@@ -0,0 +1,138 @@
+#include <iostream>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+
+#include <json.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "VulkanInclude.h"
+#include "VulkanCommon.h"
+#include "VulkanApplication.h"
+
+// The TINYGLTF and STB implementations come from VulkanApplication.cpp
+
+namespace
+{
+	struct UpdateTimings
+	{
+		double objectBuffer{ 0.0 };		// One storage buffer of every object matrix, as GlobalSubpass writes it
+		double uniformUpdates{ 0.0 };	// One update call per object into a uniform buffer of its own
+		bool coherent{ true };
+	};
+
+	template<typename Frame>
+	double secondsPerFrame(uint32_t frames, Frame&& frame)
+	{
+		// The first frame pays for page faults on the fresh mapping
+		frame(0);
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t i = 1; i <= frames; ++i)
+			frame(i);
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / frames;
+	}
+
+	// The buffers of one run are destroyed before the next, so a persistent mapping of a
+	// memory block never makes the on demand maps of another run cheap
+	UpdateTimings runUpdates(const VulkanDevice& device, BufferMapping mapping, std::vector<ObjectData>& objects, uint32_t frames)
+	{
+		constexpr VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		VkDeviceSize objectBytes = sizeof(ObjectData) * objects.size();
+		VulkanBuffer objectBuffer(device, objectBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, false, mapping);
+		std::vector<std::unique_ptr<VulkanBuffer>> uniformBuffers;
+		uniformBuffers.reserve(objects.size());
+		for (size_t i = 0; i < objects.size(); ++i)
+			uniformBuffers.push_back(std::make_unique<VulkanBuffer>(device, sizeof(ObjectData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, hostVisible, false, mapping));
+
+		// Objects move every frame, so each frame writes new matrices
+		auto animate = [&objects](uint32_t frame) {
+			for (size_t i = 0; i < objects.size(); ++i)
+				objects[i].model[3][1] = static_cast<float>(frame);
+		};
+
+		UpdateTimings timings;
+		timings.coherent = objectBuffer.isCoherent();
+		timings.objectBuffer = secondsPerFrame(frames, [&](uint32_t frame) {
+			animate(frame);
+			auto* data = reinterpret_cast<ObjectData*>(objectBuffer.map());
+			for (size_t i = 0; i < objects.size(); ++i)
+				data[i].model = objects[i].model;
+			objectBuffer.flush(0, objectBytes);
+			objectBuffer.unmap();
+		});
+		timings.uniformUpdates = secondsPerFrame(frames, [&](uint32_t frame) {
+			animate(frame);
+			for (size_t i = 0; i < objects.size(); ++i)
+				uniformBuffers[i]->update(&objects[i], sizeof(ObjectData));
+		});
+		return timings;
+	}
+
+	nlohmann::json toJson(const UpdateTimings& timings)
+	{
+		return { { "objectBuffer", timings.objectBuffer }, { "uniformUpdates", timings.uniformUpdates } };
+	}
+}
+
+// Times the per-frame host side of object updates on a headless Vulkan device: buffers mapped
+// on every update, as VulkanBuffer did before persistent mapping, against persistently mapped
+// ones. Prints the seconds per frame of both as JSON. Runs on software drivers such as lavapipe.
+// usage: buffer_update_bench [--objects <count>] [--frames <count>]
+int main(int argc, char** argv)
+{
+	uint32_t objectCount = 10000, frames = 200;
+	bool validArgs = true;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--objects") == 0 && i + 1 < argc)
+			objectCount = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			frames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		else
+			validArgs = false;
+	}
+	if (!validArgs || objectCount == 0 || frames == 0) {
+		std::cerr << "usage: buffer_update_bench [--objects <count>] [--frames <count>]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	nlohmann::json report;
+	try {
+		volkInitialize();
+		VulkanInstance instance({}, {});
+
+		// Swap chain support is what a window needs, nothing here presents
+		std::vector<const char*> headlessExtensions;
+		for (const char* extension : deviceExtensions) {
+			if (strcmp(extension, VK_KHR_SWAPCHAIN_EXTENSION_NAME) != 0)
+				headlessExtensions.push_back(extension);
+		}
+		VulkanPhysicalDevice& gpu = instance.getSuitableGPU(VK_NULL_HANDLE, headlessExtensions);
+		VulkanDevice device(gpu, VK_NULL_HANDLE, headlessExtensions, {});
+
+		std::vector<ObjectData> objects(objectCount);
+		for (uint32_t i = 0; i < objectCount; ++i)
+			objects[i].model = glm::translate(glm::mat4(1.0f), glm::vec3(static_cast<float>(i % 100), 0.0f, static_cast<float>(i / 100)));
+
+		auto onDemand = runUpdates(device, BufferMapping::OnDemand, objects, frames);
+		auto persistent = runUpdates(device, BufferMapping::Persistent, objects, frames);
+
+		report["device"] = gpu.getProperties().deviceName;
+		report["objects"] = objectCount;
+		report["frames"] = frames;
+		report["coherent"] = persistent.coherent;
+		report["secondsPerFrame"] = { { "onDemand", toJson(onDemand) }, { "persistent", toJson(persistent) } };
+		report["speedup"] = {
+			{ "objectBuffer", onDemand.objectBuffer / persistent.objectBuffer },
+			{ "uniformUpdates", onDemand.uniformUpdates / persistent.uniformUpdates } };
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << report.dump(2) << std::endl;
+	return EXIT_SUCCESS;
+}
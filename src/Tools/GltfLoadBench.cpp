@@ -0,0 +1,84 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+
+#include "Scene.h"
+#include "GLTF/GLTFCooked.h"
+#include "Utils/ThreadPool.h"
+
+// Loads a glTF file with 1, 2, 4 ... N decode threads and prints the best
+// wall time of each run, N being the hardware concurrency. The last row
+// loads from the cooked geometry cache instead.
+// usage: gltf_load_bench <file.gltf> [iterations]
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		std::cerr << "usage: " << argv[0] << " <file.gltf> [iterations]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const char* filename = argv[1];
+	int iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 3;
+
+	std::vector<uint32_t> threadCounts{};
+	uint32_t maxThreads = ThreadPool::getDefaultThreadCount();
+	for (uint32_t n = 1; n < maxThreads; n *= 2)
+		threadCounts.push_back(n);
+	threadCounts.push_back(maxThreads);
+
+	try {
+		double baseline = 0.0;
+		std::cout << std::setw(8) << "threads" << std::setw(12) << "best ms" << std::setw(10) << "speedup" << std::endl;
+		auto run = [&](const char* label, const GltfImportOptions& options) {
+			double best = 0.0;
+			for (int i = 0; i < iterations; ++i) {
+				Scene scene{};
+				auto start = std::chrono::high_resolution_clock::now();
+				auto models = scene.loadGLTFFile(filename, options);
+				auto end = std::chrono::high_resolution_clock::now();
+
+				for (auto model : models)
+					delete model;
+
+				double ms = std::chrono::duration<double, std::milli>(end - start).count();
+				if (i == 0 || ms < best)
+					best = ms;
+			}
+
+			if (baseline == 0.0)
+				baseline = best;
+			std::cout << std::setw(8) << label
+				<< std::setw(12) << std::fixed << std::setprecision(2) << best
+				<< std::setw(9) << std::setprecision(2) << baseline / best << "x" << std::endl;
+		};
+
+		for (auto threadCount : threadCounts) {
+			GltfImportOptions options{};
+			options.threadCount = threadCount;
+			options.useCookedCache = false;
+			run(std::to_string(threadCount).c_str(), options);
+		}
+
+		// the first load writes the cooked file, the timed ones read it
+		GltfImportOptions cookedOptions{};
+		cookedOptions.useCookedCache = true;
+		cookedOptions.cookedCacheDir = COOKED_CACHE_DIR;
+		for (auto model : Scene{}.loadGLTFFile(filename, cookedOptions))
+			delete model;
+		run("cooked", cookedOptions);
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
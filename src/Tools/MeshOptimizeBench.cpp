@@ -0,0 +1,120 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <cstdlib>
+
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+
+#include "Scene.h"
+#include "Geometry/MeshOptimizer.h"
+
+// Runs the mesh optimizer passes over every unique primitive of a glTF file and
+// prints ACMR / ATVR (FIFO cache of VERTEX_CACHE_SIZE) before and after each one.
+// usage: mesh_optimize_bench <file.gltf> [-v]
+namespace {
+	struct Row
+	{
+		size_t triangles{ 0 };
+		uint64_t missesBefore{ 0 }, missesCache{ 0 }, missesFinal{ 0 };
+		size_t vertices{ 0 };
+		double ms{ 0.0 };
+	};
+
+	void printHeader()
+	{
+		std::cout << std::left << std::setw(16) << "primitive" << std::right
+			<< std::setw(10) << "tris"
+			<< std::setw(10) << "acmr in" << std::setw(10) << "cache" << std::setw(10) << "final"
+			<< std::setw(10) << "atvr in" << std::setw(10) << "final"
+			<< std::setw(10) << "ms" << std::endl;
+	}
+
+	void printRow(const std::string& name, const Row& row)
+	{
+		auto triangles = double(row.triangles), vertices = double(row.vertices);
+		std::cout << std::left << std::setw(16) << name << std::right
+			<< std::setw(10) << row.triangles << std::fixed << std::setprecision(3)
+			<< std::setw(10) << row.missesBefore / triangles
+			<< std::setw(10) << row.missesCache / triangles
+			<< std::setw(10) << row.missesFinal / triangles
+			<< std::setw(10) << row.missesBefore / vertices
+			<< std::setw(10) << row.missesFinal / vertices
+			<< std::setw(10) << std::setprecision(2) << row.ms << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		std::cerr << "usage: " << argv[0] << " <file.gltf> [-v]" << std::endl;
+		return EXIT_FAILURE;
+	}
+	bool verbose = argc > 2 && std::string(argv[2]) == "-v";
+
+	try {
+		GltfImportOptions options{};
+		options.optimizeMeshes = false;
+		options.useCookedCache = false;
+
+		Scene scene{};
+		auto models = scene.loadGLTFFile(argv[1], options);
+
+		std::unordered_set<const MeshGeometry*> visited;
+		Row total{};
+		size_t primitiveIdx = 0;
+		printHeader();
+		for (auto model : models) {
+			for (const auto& mesh : model->getMeshes()) {
+				if (!visited.insert(mesh.geometry.get()).second || mesh.geometry->indices.size() < 3)
+					continue;
+
+				auto vertices = mesh.geometry->vertices;
+				auto indices = mesh.geometry->indices;
+
+				Row row{};
+				row.triangles = indices.size() / 3;
+				row.missesBefore = analyzeVertexCache(indices, vertices.size()).misses;
+
+				auto start = std::chrono::high_resolution_clock::now();
+				optimizeVertexCache(indices, vertices.size());
+				auto cacheEnd = std::chrono::high_resolution_clock::now();
+				row.missesCache = analyzeVertexCache(indices, vertices.size()).misses;
+
+				auto overdrawStart = std::chrono::high_resolution_clock::now();
+				optimizeOverdraw(indices, vertices);
+				optimizeVertexFetch(vertices, indices);
+				auto end = std::chrono::high_resolution_clock::now();
+				row.missesFinal = analyzeVertexCache(indices, vertices.size()).misses;
+				row.vertices = vertices.size();
+				row.ms = std::chrono::duration<double, std::milli>((cacheEnd - start) + (end - overdrawStart)).count();
+
+				if (verbose)
+					printRow("#" + std::to_string(primitiveIdx), row);
+				++primitiveIdx;
+
+				total.triangles += row.triangles;
+				total.missesBefore += row.missesBefore;
+				total.missesCache += row.missesCache;
+				total.missesFinal += row.missesFinal;
+				total.vertices += row.vertices;
+				total.ms += row.ms;
+			}
+		}
+		if (total.triangles > 0)
+			printRow("total", total);
+
+		for (auto model : models)
+			delete model;
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+
+#include "Scene.h"
+#include "Geometry/Meshlet.h"
+
+// Loads glTF files, checks that the meshlets of every unique primitive cover each
+// triangle exactly once and that their bounds and cones hold, then loads again on
+// a single thread and checks that the meshlets come out identical.
+// usage: meshlet_check <file.gltf> [more.gltf ...]
+// Exits with EXIT_FAILURE on the first problem.
+namespace {
+	std::vector<Model*> load(const char* filename, uint32_t threadCount)
+	{
+		GltfImportOptions options{};
+		options.threadCount = threadCount;
+		options.useCookedCache = false;
+
+		Scene scene{};
+		return scene.loadGLTFFile(filename, options);
+	}
+
+	std::vector<const MeshGeometry*> uniqueGeometries(const std::vector<Model*>& models)
+	{
+		std::unordered_set<const MeshGeometry*> visited;
+		std::vector<const MeshGeometry*> geometries;
+		for (auto model : models) {
+			for (const auto& mesh : model->getMeshes()) {
+				if (visited.insert(mesh.geometry.get()).second)
+					geometries.push_back(mesh.geometry.get());
+			}
+		}
+		return geometries;
+	}
+
+	bool sameMeshlets(const MeshletData& a, const MeshletData& b)
+	{
+		return a.meshlets.size() == b.meshlets.size() && a.vertices == b.vertices && a.triangles == b.triangles &&
+			memcmp(a.meshlets.data(), b.meshlets.data(), a.meshlets.size() * sizeof(Meshlet)) == 0 &&
+			memcmp(a.bounds.data(), b.bounds.data(), a.bounds.size() * sizeof(MeshletBounds)) == 0;
+	}
+
+	bool check(const char* filename)
+	{
+		auto models = load(filename, 0);
+		auto serialModels = load(filename, 1);
+		auto geometries = uniqueGeometries(models);
+		auto serialGeometries = uniqueGeometries(serialModels);
+
+		bool ok = geometries.size() == serialGeometries.size();
+		size_t meshletNum = 0, triangleNum = 0, vertexNum = 0, coneNum = 0;
+		for (size_t i = 0; ok && i < geometries.size(); ++i) {
+			const auto& geometry = *geometries[i];
+			auto error = validateMeshlets(geometry.meshlets, geometry.indices, geometry.vertices);
+			if (!error.empty()) {
+				std::cerr << filename << ": primitive #" << i << ": " << error << std::endl;
+				ok = false;
+			}
+			else if (!sameMeshlets(geometry.meshlets, serialGeometries[i]->meshlets)) {
+				std::cerr << filename << ": primitive #" << i << ": meshlets differ between thread counts" << std::endl;
+				ok = false;
+			}
+
+			meshletNum += geometry.meshlets.meshlets.size();
+			triangleNum += geometry.indices.size() / 3;
+			vertexNum += geometry.meshlets.vertices.size();
+			for (const auto& bounds : geometry.meshlets.bounds)
+				coneNum += bounds.coneCutoff < 1.0f;
+		}
+
+		if (ok) {
+			double meshlets = double(std::max<size_t>(meshletNum, 1));
+			std::cout << std::left << std::setw(40) << filename << std::right
+				<< std::setw(8) << geometries.size() << " primitives"
+				<< std::setw(8) << meshletNum << " meshlets" << std::fixed << std::setprecision(1)
+				<< std::setw(8) << triangleNum / meshlets << " tris"
+				<< std::setw(8) << vertexNum / meshlets << " verts"
+				<< std::setw(8) << 100.0 * coneNum / meshlets << "% cones" << std::endl;
+		}
+
+		for (auto model : models)
+			delete model;
+		for (auto model : serialModels)
+			delete model;
+		return ok;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		std::cerr << "usage: " << argv[0] << " <file.gltf> [more.gltf ...]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	try {
+		for (int i = 1; i < argc; ++i) {
+			if (!check(argv[i]))
+				return EXIT_FAILURE;
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
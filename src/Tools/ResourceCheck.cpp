@@ -0,0 +1,284 @@
+#include <iostream>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdlib>
+#include <cstring>
+
+#include "VulkanInclude.h"
+#include "VulkanCommon.h"
+#include "VulkanApplication.h"
+
+// The TINYGLTF and STB implementations come from VulkanApplication.cpp
+
+// Checks the bookkeeping of VulkanResourceManager, its geometry arenas and defragmentation on a headless device,
+// software drivers such as lavapipe will do.
+// usage: resource_check
+// Exits with EXIT_FAILURE on the first problem.
+namespace
+{
+	bool expect(bool condition, const char* check, const char* what)
+	{
+		if (!condition)
+			std::cerr << check << ": " << what << std::endl;
+		return condition;
+	}
+
+	// Ranges freed in the middle of a block are reused, neighbouring free ranges merge into one
+	bool checkArena(const VulkanDevice& device)
+	{
+		const char* name = "arena";
+		VulkanGeometryArena arena(device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 256, 1024);
+
+		auto a = arena.allocate(256);
+		auto b = arena.allocate(256);
+		auto c = arena.allocate(200);
+		if (!expect(a.offset == 0 && b.offset == 256 && c.offset == 512, name, "ranges are not packed in order") ||
+			!expect(a.buffer == b.buffer && b.buffer == c.buffer, name, "ranges of one block got several buffers"))
+			return false;
+
+		arena.free(b);
+		auto stats = arena.getStats();
+		if (!expect(stats.ranges == 2 && stats.usedBytes == 456 && stats.freeRanges == 2, name, "free did not return the range"))
+			return false;
+
+		auto reused = arena.allocate(100);
+		if (!expect(reused.buffer == a.buffer && reused.offset == 256, name, "the freed range is not reused"))
+			return false;
+
+		// [0, 512) is one range once both halves are free, it fits 512 bytes without a new block
+		arena.free(a);
+		arena.free(reused);
+		if (!expect(arena.getStats().freeRanges == 2, name, "neighbouring free ranges did not merge"))
+			return false;
+		auto merged = arena.allocate(512);
+		if (!expect(merged.buffer == a.buffer && merged.offset == 0 && arena.getStats().blocks == 1, name,
+			"the merged range is not reused"))
+			return false;
+
+		arena.free(merged);
+		arena.free(c);
+		stats = arena.getStats();
+		return expect(stats.ranges == 0 && stats.usedBytes == 0 && stats.freeRanges == 1, name,
+			"the emptied block is not a single free range");
+	}
+
+	// The last release of a texture frees its slot and drops it from the cache,
+	// releasing a geometry releases the textures its material acquired
+	bool checkTextures(const VulkanDevice& device)
+	{
+		const char* name = "textures";
+		const char* path = "assets/textures/white.jpg";
+		VulkanCommandPool commandPool(device, device.getGraphicsQueue().getFamilyIndex());
+		VulkanResourceManager resManager(device, commandPool);
+		VkSampler sampler = resManager.getDefaultSampler();
+		const auto& stats = resManager.getTextureCacheStats();
+
+		TextureID first = resManager.acquireTexture(path, sampler);
+		TextureID second = resManager.acquireTexture(path, sampler);
+		// Nothing may copy into an image destroyed below
+		resManager.flushUploads();
+		if (!expect(first == second && stats.pathHits == 1 && stats.textures == 1, name, "the second acquire is not a cache hit"))
+			return false;
+
+		resManager.releaseTexture(first);
+		if (!expect(resManager.getTextures()[first] != nullptr, name, "a referenced texture was destroyed"))
+			return false;
+		resManager.releaseTexture(second);
+		if (!expect(resManager.getTextures()[first] == nullptr && stats.textures == 0, name, "the last release kept the texture"))
+			return false;
+
+		TextureID other = resManager.acquireTexture("assets/textures/black.jpg", sampler);
+		uint32_t hits = stats.pathHits + stats.contentHits;
+		TextureID again = resManager.acquireTexture(path, sampler);
+		resManager.flushUploads();
+		if (!expect(other == first, name, "the released slot is not reused") ||
+			!expect(again != other && stats.pathHits + stats.contentHits == hits, name, "the released texture is still cached"))
+			return false;
+		resManager.releaseTexture(other);
+		resManager.releaseTexture(again);
+
+		// One texture in two slots of the material
+		std::vector<Vertex> vertices(3, Vertex{});
+		vertices[1].pos.x = 1.0f;
+		vertices[2].pos.y = 1.0f;
+		GltfMaterial mat{};
+		mat.pbrBaseColorTexture = 0;
+		mat.occlusionTexture = 0;
+		auto geometryID = resManager.requireRenderGeometry(vertices, { 0, 1, 2 }, mat, { { TextureType::DIFFUSE, path, sampler } });
+		resManager.flushUploads();
+		auto textures = resManager.getRenderGeometry(geometryID).textures;
+		if (!expect(textures.size() == 1 && stats.textures == 1, name, "the geometry does not hold its texture once"))
+			return false;
+
+		resManager.releaseRenderGeometry(geometryID);
+		return expect(resManager.getTextures()[textures[0]] == nullptr && stats.textures == 0, name,
+			"releasing the geometry kept its texture") &&
+			expect(resManager.getGeometryArenaStats().ranges == 0, name, "releasing the geometry kept its ranges");
+	}
+
+	// requireTexture of a texture streamed with its coarse levels hands out one that stays,
+	// however often streaming runs after it
+	bool checkPinnedTexture(const VulkanDevice& device)
+	{
+		const char* name = "pinned texture";
+		const char* path = "assets/textures/viking_room.png";
+		VulkanCommandPool commandPool(device, device.getGraphicsQueue().getFamilyIndex());
+		VulkanResourceManager resManager(device, commandPool);
+		VkSampler sampler = resManager.getDefaultSampler();
+
+		TextureID id = resManager.acquireTexture(path, sampler);
+		const VulkanTexture* coarse = resManager.getTextures()[id].get();
+		if (!expect(resManager.requireTexture(path, sampler) == id, name, "requireTexture returned another texture"))
+			return false;
+		const VulkanTexture* pinned = resManager.getTextures()[id].get();
+		if (!expect(pinned != coarse, name, "the coarse texture was handed out"))
+			return false;
+
+		bool reported = false;
+		for (int i = 0; i < 4; ++i) {
+			auto streamed = resManager.updateTextureStreaming(glm::mat4{ 1.0f }, glm::vec3{ 0.0f }, 1.0f);
+			reported |= std::find(streamed.begin(), streamed.end(), id) != streamed.end();
+			resManager.flushUploads();
+		}
+		bool ok = expect(reported, name, "the replacement was not reported for its descriptors") &&
+			expect(resManager.getTextures()[id].get() == pinned, name, "streaming replaced the pinned texture");
+
+		resManager.releaseTexture(id);
+		resManager.releaseTexture(id);
+		return ok;
+	}
+
+	// Defragments buffers with holes between them. While its pass is open a moved buffer's old handle
+	// keeps the bytes, afterwards the buffer has them under its new handle and device address.
+	bool checkDefragmentation(const VulkanDevice& device)
+	{
+		const char* name = "defragmentation";
+		// Large enough for VMA to spread the buffers over more than one memory block
+		constexpr VkDeviceSize size = 4ull << 20;
+		constexpr uint32_t bufferNum = 24;
+		auto& allocator = device.getAllocator();
+		const auto& queue = device.getGraphicsQueue();
+		VulkanCommandPool commandPool(device, queue.getFamilyIndex());
+
+		VulkanBuffer staging(device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		VulkanBuffer readback(device, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+		auto copy = [&](VkBuffer src, VkBuffer dst) {
+			auto commandBuffer = commandPool.beginSingleTimeCommands();
+			VkBufferCopy region{ 0, 0, size };
+			vkCmdCopyBuffer(commandBuffer->getHandle(), src, dst, 1, &region);
+			commandPool.endSingleTimeCommands(*commandBuffer, queue);
+		};
+		// Words of buffer i
+		std::vector<uint32_t> pattern(size / sizeof(uint32_t));
+		auto makePattern = [&pattern](uint32_t i) {
+			for (size_t word = 0; word < pattern.size(); ++word)
+				pattern[word] = i * 2654435761u + toU32(word);
+		};
+		auto holds = [&](VkBuffer buffer, uint32_t i) {
+			copy(buffer, readback.getHandle());
+			readback.invalidate();
+			makePattern(i);
+			return memcmp(readback.getMappedData(), pattern.data(), size) == 0;
+		};
+
+		std::vector<std::unique_ptr<VulkanBuffer>> buffers;
+		for (uint32_t i = 0; i < bufferNum; ++i) {
+			buffers.push_back(std::make_unique<VulkanBuffer>(device, size,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true));
+			makePattern(i);
+			staging.update(pattern.data(), size);
+			copy(staging.getHandle(), buffers[i]->getHandle());
+		}
+		// Every other buffer leaves a hole
+		for (uint32_t i = 1; i < bufferNum; i += 2)
+			buffers[i].reset();
+
+		std::vector<VulkanBufferMove> moves;
+		for (uint32_t pass = 0; ; ++pass) {
+			if (!expect(pass < 64, name, "defragmentation does not finish"))
+				return false;
+
+			std::vector<VkBuffer> handles(bufferNum, VK_NULL_HANDLE);
+			std::vector<VkDeviceAddress> addresses(bufferNum, 0);
+			for (uint32_t i = 0; i < bufferNum; i += 2) {
+				handles[i] = buffers[i]->getHandle();
+				addresses[i] = getBufferDeviceAddress(device.getHandle(), handles[i]);
+			}
+
+			size_t firstMove = moves.size();
+			if (!allocator.beginDefragmentationPass(commandPool, queue, moves))
+				break;
+
+			std::vector<bool> moved(bufferNum, false);
+			for (size_t m = firstMove; m < moves.size(); ++m) {
+				const auto& move = moves[m];
+				auto it = std::find_if(buffers.begin(), buffers.end(),
+					[&move](const auto& buffer) { return buffer.get() == move.buffer; });
+				if (!expect(it != buffers.end(), name, "a buffer that is not movable was moved"))
+					return false;
+				uint32_t i = toU32(it - buffers.begin());
+				moved[i] = true;
+				if (!expect(move.oldBuffer == handles[i] && move.buffer->getHandle() != handles[i], name,
+					"the move does not replace the old handle") ||
+					!expect(holds(move.oldBuffer, i), name, "the old buffer lost its bytes before the pass ended"))
+					return false;
+			}
+			allocator.endDefragmentationPass();
+
+			for (uint32_t i = 0; i < bufferNum; i += 2) {
+				VkDeviceAddress address = getBufferDeviceAddress(device.getHandle(), buffers[i]->getHandle());
+				if (!expect(holds(buffers[i]->getHandle(), i), name, "a buffer lost its bytes") ||
+					!expect((address != addresses[i]) == moved[i], name, "the device address does not follow the move"))
+					return false;
+			}
+		}
+
+		const auto& stats = allocator.getDefragmentationStats();
+		return expect(!moves.empty(), name, "nothing was moved") &&
+			expect(stats.movedBuffers == moves.size() && stats.movedBytes == moves.size() * size, name,
+				"the stats do not count the moves") &&
+			expect(!allocator.isDefragmenting(), name, "defragmentation did not end");
+	}
+}
+
+int main()
+{
+	try {
+		volkInitialize();
+		VulkanInstance instance({}, {});
+
+		// Swap chain support is what a window needs, nothing here presents
+		std::vector<const char*> headlessExtensions;
+		for (const char* extension : deviceExtensions) {
+			if (strcmp(extension, VK_KHR_SWAPCHAIN_EXTENSION_NAME) != 0)
+				headlessExtensions.push_back(extension);
+		}
+		auto& gpu = instance.getSuitableGPU(VK_NULL_HANDLE, headlessExtensions);
+		VulkanDevice device(gpu, VK_NULL_HANDLE, headlessExtensions, {});
+
+		if (!checkArena(device))
+			return EXIT_FAILURE;
+		std::cout << "arena ok" << std::endl;
+		if (!checkTextures(device))
+			return EXIT_FAILURE;
+		std::cout << "textures ok" << std::endl;
+		if (!checkPinnedTexture(device))
+			return EXIT_FAILURE;
+		std::cout << "pinned texture ok" << std::endl;
+		if (!checkDefragmentation(device))
+			return EXIT_FAILURE;
+		std::cout << "defragmentation ok" << std::endl;
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,276 @@
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include <json.hpp>
+
+#include "Scene.h"
+#include "GLTF/GLTFCooked.h"
+#include "Utils/ThreadPool.h"
+#include "Utils/PhaseClock.h"
+#include "VulkanInclude.h"
+#include "VulkanCommon.h"
+#include "VulkanApplication.h"
+
+// The TINYGLTF and STB implementations come from VulkanApplication.cpp
+
+namespace
+{
+	size_t getPeakResidentBytes()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters{};
+		GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+		return counters.PeakWorkingSetSize;
+#else
+		rusage usage{};
+		getrusage(RUSAGE_SELF, &usage);
+		return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+	}
+
+	// Usage of every device local heap, null without VK_EXT_memory_budget
+	nlohmann::json getHeapUsage(VkPhysicalDevice gpu, bool budgetSupported)
+	{
+		if (!budgetSupported)
+			return nullptr;
+
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT };
+		VkPhysicalDeviceMemoryProperties2 properties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2 };
+		properties.pNext = &budget;
+		vkGetPhysicalDeviceMemoryProperties2(gpu, &properties);
+
+		nlohmann::json heaps = nlohmann::json::array();
+		for (uint32_t i = 0; i < properties.memoryProperties.memoryHeapCount; ++i) {
+			if (properties.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+				heaps.push_back({ { "heap", i }, { "usage", budget.heapUsage[i] }, { "budget", budget.heapBudget[i] } });
+		}
+		return heaps;
+	}
+}
+
+// Loads a glTF scene into a headless Vulkan device the way VulkanApplication::createScene and
+// buildAccelerationStructures do, and prints the seconds of each phase, peak RSS and GPU memory as JSON.
+// No window or swap chain is created, so it also runs on software drivers such as lavapipe.
+// --mode serial decodes on one thread, parallel on all cores, both without the cooked cache.
+// cooked loads once to fill the cooked cache, then times a second load from it.
+// usage: scene_load_bench <file.gltf> [--mode cooked|parallel|serial] [--no-rt]
+int main(int argc, char** argv)
+{
+	std::string filename, mode = "parallel";
+	bool useRayTracing = true;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc)
+			mode = argv[++i];
+		else if (strcmp(argv[i], "--no-rt") == 0)
+			useRayTracing = false;
+		else if (filename.empty())
+			filename = argv[i];
+		else {
+			filename.clear();
+			break;
+		}
+	}
+	if (filename.empty() || (mode != "cooked" && mode != "parallel" && mode != "serial")) {
+		std::cerr << "usage: scene_load_bench <file.gltf> [--mode cooked|parallel|serial] [--no-rt]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	GltfImportOptions options;
+	options.cookedCacheDir = COOKED_CACHE_DIR;
+	if (mode == "cooked")
+		options.useCookedCache = true;
+	else {
+		options.useCookedCache = false;
+		options.useCookedTextures = false;
+		options.threadCount = mode == "serial" ? 1 : 0;
+	}
+
+	nlohmann::json report;
+	try {
+		volkInitialize();
+		VulkanInstance instance({}, {});
+
+		// Swap chain support is what a window needs, nothing here presents
+		std::vector<const char*> headlessExtensions;
+		for (const char* extension : deviceExtensions) {
+			if (strcmp(extension, VK_KHR_SWAPCHAIN_EXTENSION_NAME) != 0)
+				headlessExtensions.push_back(extension);
+		}
+
+		VulkanPhysicalDevice* gpu;
+		auto requiredExtensions = headlessExtensions;
+		if (useRayTracing)
+			requiredExtensions.insert(requiredExtensions.end(), rtExtensions.begin(), rtExtensions.end());
+		try {
+			gpu = &instance.getSuitableGPU(VK_NULL_HANDLE, requiredExtensions);
+		}
+		catch (const std::exception&) {
+			if (!useRayTracing)
+				throw;
+			useRayTracing = false;
+			requiredExtensions = headlessExtensions;
+			gpu = &instance.getSuitableGPU(VK_NULL_HANDLE, requiredExtensions);
+		}
+		// Enables VK_EXT_memory_budget by itself where the GPU has it
+		VulkanDevice device(*gpu, VK_NULL_HANDLE, requiredExtensions, {});
+
+		if (mode == "cooked") {
+			// Writes the cooked geometry the timed load reads
+			Scene warmup;
+			warmup.addModelsFromGltfFile(filename.c_str(), options);
+		}
+
+		GltfImportTimings sceneTimings;
+		options.timings = &sceneTimings;
+		double textureSeconds = 0.0, bufferSeconds = 0.0, blasSeconds = 0.0, tlasSeconds = 0.0;
+		auto start = std::chrono::steady_clock::now();
+
+		VulkanCommandPool commandPool(device, device.getGraphicsQueue().getFamilyIndex());
+		VulkanResourceManager resManager(device, commandPool);
+		resManager.requireTexture("assets/textures/black.jpg", resManager.getDefaultSampler());
+
+		Scene scene;
+		scene.addModelsFromGltfFile(filename.c_str(), options);
+		scene.updateTransforms();
+		const auto& graph = scene.getGraph();
+
+		PhaseClock clock;
+		std::unordered_set<const MeshGeometry*> uniqueGeometries;
+		for (const auto& [name, model] : scene.getModelMap()) {
+			for (auto& mesh : model->getMeshes())
+				uniqueGeometries.insert(mesh.geometry.get());
+		}
+
+		VkSampler sampler = resManager.createSampler();
+		{
+			std::vector<Texture> textures;
+			for (const auto* geometry : uniqueGeometries) {
+				for (const auto& texture : geometry->textures)
+					textures.push_back(texture);
+			}
+			ThreadPool pool(mode == "serial" ? 1 : ThreadPool::getDefaultThreadCount());
+			resManager.loadTextures(textures, sampler, pool);
+		}
+		// The phases take until their uploads are done on the GPU
+		resManager.flushUploads();
+		clock.lap(textureSeconds);
+
+		std::unordered_map<const MeshGeometry*, RenderGeometryID> renderGeometries;
+		std::vector<std::pair<const Mesh*, RenderMeshID>> renderMeshes;
+		for (const auto& [name, model] : scene.getModelMap()) {
+			for (auto& mesh : model->getMeshes()) {
+				auto it = renderGeometries.find(mesh.geometry.get());
+				if (it == renderGeometries.end()) {
+					const auto& geometry = *mesh.geometry;
+					std::vector<RenderTexture> textures;
+					for (const auto& texture : geometry.textures)
+						textures.push_back({ texture.type, texture.path.c_str(), sampler, &texture.embedded });
+					auto geometryID = resManager.requireRenderGeometry(geometry.vertices, geometry.indices, geometry.mat, textures, geometry.lods);
+					it = renderGeometries.emplace(&geometry, geometryID).first;
+				}
+				auto id = resManager.requireRenderMesh(it->second);
+				resManager.getRenderMesh(id).tranformMatrix = graph.getWorldTransform(model->node) * mesh.transComp.getTransformMatrix();
+				renderMeshes.emplace_back(&mesh, id);
+			}
+		}
+		resManager.flushUploads();
+		clock.lap(bufferSeconds);
+
+		std::unique_ptr<VulkanRayTracingBuilder> rtBuilder;
+		if (useRayTracing) {
+			rtBuilder = std::make_unique<VulkanRayTracingBuilder>(device, resManager);
+
+			std::vector<BlasInput> allBlas;
+			allBlas.reserve(resManager.getRenderGeometryNum());
+			for (RenderGeometryID id = 0; id < resManager.getRenderGeometryNum(); ++id)
+				allBlas.emplace_back(resManager.requireBlasInput(resManager.getRenderGeometry(id)));
+			rtBuilder->buildBlas(allBlas, VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR);
+			clock.lap(blasSeconds);
+
+			std::vector<VkAccelerationStructureInstanceKHR> tlas;
+			tlas.reserve(renderMeshes.size());
+			for (const auto& [p_mesh, id] : renderMeshes) {
+				VkAccelerationStructureInstanceKHR rayInst{};
+				rayInst.transform = toTransformMatrixKHR(resManager.getRenderMesh(id).tranformMatrix);
+				rayInst.instanceCustomIndex = id;
+				rayInst.accelerationStructureReference = rtBuilder->getBlasDeviceAddress(toU32(resManager.getRenderMesh(id).geometry));
+				rayInst.mask = 0xFF;
+				tlas.emplace_back(rayInst);
+			}
+			rtBuilder->buildTlas(tlas,
+				VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR);
+			clock.lap(tlasSeconds);
+		}
+		device.waitIdle();
+		double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		report["gpuMemory"]["heaps"] = getHeapUsage(gpu->getHandle(), device.getFeatures().memoryBudget);
+
+		const auto& textureTimings = resManager.getTextureLoadTimings();
+		report["file"] = filename;
+		report["mode"] = mode;
+		report["device"] = gpu->getProperties().deviceName;
+		report["rayTracing"] = useRayTracing;
+		report["geometries"] = renderGeometries.size();
+		report["meshes"] = renderMeshes.size();
+		report["seconds"] = {
+			{ "scene", {
+				{ "cached", sceneTimings.cached },
+				{ "cacheRead", sceneTimings.cacheRead },
+				{ "parse", sceneTimings.parse },
+				{ "decode", sceneTimings.decode },
+				{ "accessors", sceneTimings.accessors },
+				{ "normals", sceneTimings.normals },
+				{ "tangents", sceneTimings.tangents },
+				{ "optimize", sceneTimings.optimize },
+				{ "meshlets", sceneTimings.meshlets },
+				{ "cacheWrite", sceneTimings.cacheWrite } } },
+			{ "textures", {
+				{ "total", textureSeconds },
+				{ "read", textureTimings.read },
+				{ "decode", textureTimings.decode },
+				{ "mips", textureTimings.mips },
+				{ "upload", textureTimings.upload } } },
+			{ "buffers", bufferSeconds },
+			{ "blas", useRayTracing ? nlohmann::json(blasSeconds) : nlohmann::json(nullptr) },
+			{ "tlas", useRayTracing ? nlohmann::json(tlasSeconds) : nlohmann::json(nullptr) },
+			{ "total", totalSeconds } };
+		const auto& uploadStats = resManager.getUploadStats();
+		report["uploads"] = {
+			{ "batches", uploadStats.batches },
+			{ "stagedBytes", uploadStats.stagedBytes },
+			{ "stalls", uploadStats.stalls },
+			{ "transferQueue", uploadStats.transferQueue } };
+		report["peakResidentBytes"] = getPeakResidentBytes();
+		report["gpuMemory"]["bufferBytes"] = resManager.getBufferMemorySize();
+		report["gpuMemory"]["textureBytes"] = resManager.getTextureCacheStats().residentBytes;
+		const auto arenaStats = resManager.getGeometryArenaStats();
+		report["gpuMemory"]["geometryBytes"] = arenaStats.usedBytes;
+		report["gpuMemory"]["geometryBuffers"] = arenaStats.blocks;
+		const auto allocatorStats = device.getAllocator().getStats(true);
+		report["gpuMemory"]["allocations"] = allocatorStats.allocations;
+		report["gpuMemory"]["blocks"] = allocatorStats.blocks;
+		report["gpuMemory"]["allocatedBytes"] = allocatorStats.allocatedBytes;
+		report["gpuMemory"]["blockBytes"] = allocatorStats.blockBytes;
+		report["gpuMemory"]["fragmentation"] = allocatorStats.fragmentation;
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << report.dump(2) << std::endl;
+	return EXIT_SUCCESS;
+}
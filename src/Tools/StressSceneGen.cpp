@@ -0,0 +1,76 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+
+#include "StressScene.h"
+
+// Writes a procedural stress scene as glTF: a grid of instances of the assets with lights above them.
+// Load it like any other scene, dropping it on the window works. The lights come back through
+// KHR_lights_punctual.
+// usage: stress_scene <out.gltf> [--instances n] [--unique ratio] [--point-lights n] [--dir-lights n]
+//        [--spacing s] [--seed s] [--threads n] [--asset file.gltf]...
+// --asset replaces the default cube and Cornell box, repeat it for several assets.
+int main(int argc, char** argv)
+{
+	std::string filename;
+	StressSceneOptions options{};
+	std::vector<std::string> assets;
+	for (int i = 1; i < argc; ++i) {
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--instances") == 0 && hasValue)
+			options.instanceNum = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		else if (strcmp(argv[i], "--unique") == 0 && hasValue)
+			options.uniqueRatio = std::strtof(argv[++i], nullptr);
+		else if (strcmp(argv[i], "--point-lights") == 0 && hasValue)
+			options.pointLightNum = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		else if (strcmp(argv[i], "--dir-lights") == 0 && hasValue)
+			options.dirLightNum = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		else if (strcmp(argv[i], "--spacing") == 0 && hasValue)
+			options.spacing = std::strtof(argv[++i], nullptr);
+		else if (strcmp(argv[i], "--seed") == 0 && hasValue)
+			options.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		else if (strcmp(argv[i], "--threads") == 0 && hasValue)
+			options.threadCount = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		else if (strcmp(argv[i], "--asset") == 0 && hasValue)
+			assets.push_back(argv[++i]);
+		else if (filename.empty())
+			filename = argv[i];
+		else {
+			filename.clear();
+			break;
+		}
+	}
+	if (filename.empty()) {
+		std::cerr << "usage: stress_scene <out.gltf> [--instances n] [--unique ratio] [--point-lights n] [--dir-lights n]"
+			" [--spacing s] [--seed s] [--threads n] [--asset file.gltf]..." << std::endl;
+		return EXIT_FAILURE;
+	}
+	if (!assets.empty())
+		options.assets = assets;
+
+	StressSceneStats stats;
+	auto start = std::chrono::high_resolution_clock::now();
+	try {
+		stats = writeStressScene(filename, options);
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+
+	std::cout << stats.instances << " instances (" << stats.uniqueInstances << " unique), "
+		<< stats.models << " nodes, " << stats.meshes << " meshes, " << stats.geometries << " geometries, "
+		<< stats.triangles << " triangles, " << stats.pointLights << " point and " << stats.dirLights << " directional lights" << std::endl;
+	std::cout << "written to " << filename << " in " << std::fixed << std::setprecision(1)
+		<< std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,233 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+
+#include "GLTF/GLTFHelper.h"
+#include "Utils/ThreadPool.h"
+
+// Times createNormals and createTangents against the serial scatter loops they replaced,
+// on a generated torus, and checks that every thread count gives the same bits.
+// usage: tangent_bench [triangles] [iterations]
+
+namespace {
+	template<class Func>
+	double bestMs(int iterations, Func&& func)
+	{
+		double best = 0.0;
+		for (int i = 0; i < iterations; ++i) {
+			auto start = std::chrono::high_resolution_clock::now();
+			func();
+			auto end = std::chrono::high_resolution_clock::now();
+			double ms = std::chrono::duration<double, std::milli>(end - start).count();
+			if (i == 0 || ms < best)
+				best = ms;
+		}
+		return best;
+	}
+
+	bool sameBits(const std::vector<glm::vec3>& a, const std::vector<glm::vec3>& b)
+	{
+		return a.size() == b.size() && memcmp(a.data(), b.data(), a.size() * sizeof(glm::vec3)) == 0;
+	}
+
+	void printRow(const std::string& name, double serial, double ms, bool match)
+	{
+		std::cout << std::left << std::setw(24) << name << std::right
+			<< std::setw(12) << std::fixed << std::setprecision(3) << ms
+			<< std::setw(9) << std::setprecision(2) << serial / ms << "x"
+			<< (match ? "" : "  MISMATCH") << std::endl;
+	}
+
+	// The serial implementations createNormals and createTangents had before
+	void createNormalsSerial(const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, std::vector<glm::vec3>& normals)
+	{
+		std::vector<glm::vec3> geonormal(positions.size());
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			uint32_t ind0 = indices[i + 0];
+			uint32_t ind1 = indices[i + 1];
+			uint32_t ind2 = indices[i + 2];
+			const auto& pos0 = positions[ind0];
+			const auto& pos1 = positions[ind1];
+			const auto& pos2 = positions[ind2];
+			const auto  v1 = glm::normalize(pos1 - pos0);
+			const auto  v2 = glm::normalize(pos2 - pos0);
+			const auto  n = glm::cross(v1, v2);
+			geonormal[ind0] += n;
+			geonormal[ind1] += n;
+			geonormal[ind2] += n;
+		}
+		for (auto& n : geonormal)
+			n = glm::normalize(n);
+		normals.insert(normals.end(), geonormal.begin(), geonormal.end());
+	}
+
+	void createTangentsSerial(
+		const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals,
+		const std::vector<glm::vec2>& texCoords, std::vector<glm::vec3>& tangents, std::vector<glm::vec3>& bitangents)
+	{
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			uint32_t i0 = indices[i + 0];
+			uint32_t i1 = indices[i + 1];
+			uint32_t i2 = indices[i + 2];
+
+			glm::vec3 e1 = positions[i1] - positions[i0];
+			glm::vec3 e2 = positions[i2] - positions[i0];
+
+			glm::vec2 duvE1 = texCoords[i1] - texCoords[i0];
+			glm::vec2 duvE2 = texCoords[i2] - texCoords[i0];
+
+			float r = 1.0f;
+			float a = duvE1.x * duvE2.y - duvE2.x * duvE1.y;
+			if (fabs(a) > 0)
+			{
+				r = 1.0f / a;
+			}
+
+			glm::vec3 t = (e1 * duvE2.y - e2 * duvE1.y) * r;
+			glm::vec3 b = (e2 * duvE1.x - e1 * duvE2.x) * r;
+
+			tangents[i0] += t;
+			tangents[i1] += t;
+			tangents[i2] += t;
+
+			bitangents[i0] += b;
+			bitangents[i1] += b;
+			bitangents[i2] += b;
+		}
+
+		for (size_t i = 0; i < normals.size(); ++i) {
+			auto& n = normals[i];
+			auto& t = tangents[i];
+			auto& b = bitangents[i];
+
+			glm::vec3 otangent = glm::normalize(t - (glm::dot(n, t) * n));
+			if (otangent == glm::vec3(0, 0, 0))
+			{
+				if (abs(n.x) > abs(n.y))
+					otangent = glm::vec3(n.z, 0, -n.x) / sqrtf(n.x * n.x + n.z * n.z);
+				else
+					otangent = glm::vec3(0, -n.z, n.y) / sqrtf(n.y * n.y + n.z * n.z);
+			}
+
+			float handedness = (glm::dot(glm::cross(n, t), b) < 0.f) ? 1.f : -1.f;
+			t = otangent;
+			b = glm::normalize(glm::cross(n, t) * handedness);
+		}
+	}
+
+	struct TestMesh
+	{
+		std::vector<uint32_t> indices;
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec2> texCoords;
+	};
+
+	// Torus with a UV seam, a few degenerate UV triangles and the triangles shuffled,
+	// so the vertex sums see the scattered access order of real meshes
+	TestMesh makeTorus(size_t triangleNum)
+	{
+		uint32_t rings = std::max<uint32_t>(4, static_cast<uint32_t>(std::sqrt(triangleNum / 8.0)));
+		uint32_t sides = std::max<uint32_t>(4, static_cast<uint32_t>(triangleNum / (2 * rings)));
+
+		TestMesh mesh;
+		for (uint32_t i = 0; i <= rings; ++i) {
+			for (uint32_t j = 0; j <= sides; ++j) {
+				float u = float(i) / rings, v = float(j) / sides;
+				float a = u * 6.2831853f, b = v * 6.2831853f;
+				float r = 1.f + 0.35f * std::cos(b);
+				mesh.positions.push_back({ r * std::cos(a), 0.35f * std::sin(b), r * std::sin(a) });
+				mesh.texCoords.push_back({ u * 4.f, (j % 97 == 0) ? 0.f : v });
+			}
+		}
+
+		std::vector<uint32_t> quads;
+		for (uint32_t i = 0; i < rings; ++i) {
+			for (uint32_t j = 0; j < sides; ++j)
+				quads.push_back(i * (sides + 1) + j);
+		}
+		uint32_t state = 1;
+		for (size_t i = quads.size(); i > 1; --i) {
+			state = state * 1664525u + 1013904223u;
+			std::swap(quads[i - 1], quads[state % i]);
+		}
+		for (auto q : quads) {
+			uint32_t next = q + sides + 1;
+			mesh.indices.insert(mesh.indices.end(), { q, next, q + 1, q + 1, next, next + 1 });
+		}
+		return mesh;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t triangleNum = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+	int iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 5;
+
+	TestMesh mesh = makeTorus(triangleNum);
+	std::cout << mesh.indices.size() / 3 << " triangles, " << mesh.positions.size() << " vertices" << std::endl;
+
+	std::vector<glm::vec3> normalsRef;
+	createNormalsSerial(mesh.indices, mesh.positions, normalsRef);
+	std::vector<glm::vec3> tangentsRef(mesh.positions.size(), glm::vec3(0.f));
+	std::vector<glm::vec3> bitangentsRef(mesh.positions.size(), glm::vec3(0.f));
+	createTangentsSerial(mesh.indices, mesh.positions, normalsRef, mesh.texCoords, tangentsRef, bitangentsRef);
+
+	std::vector<glm::vec3> normals, tangents, bitangents;
+	auto runNormals = [&](ThreadPool* pool) {
+		normals.clear();
+		createNormals(mesh.indices, mesh.positions, normals, pool);
+	};
+	auto runTangents = [&](ThreadPool* pool) {
+		tangents.assign(mesh.positions.size(), glm::vec3(0.f));
+		bitangents.assign(mesh.positions.size(), glm::vec3(0.f));
+		createTangents(mesh.indices, mesh.positions, normalsRef, mesh.texCoords, tangents, bitangents, pool);
+	};
+
+	double normalsSerial = bestMs(iterations, [&]() {
+		normals.clear();
+		createNormalsSerial(mesh.indices, mesh.positions, normals);
+	});
+	double tangentsSerial = bestMs(iterations, [&]() {
+		tangents.assign(mesh.positions.size(), glm::vec3(0.f));
+		bitangents.assign(mesh.positions.size(), glm::vec3(0.f));
+		createTangentsSerial(mesh.indices, mesh.positions, normalsRef, mesh.texCoords, tangents, bitangents);
+	});
+
+	std::cout << std::left << std::setw(24) << "" << std::right << std::setw(12) << "ms" << std::setw(10) << "speedup" << std::endl;
+	printRow("normals serial", normalsSerial, normalsSerial, true);
+	printRow("tangents serial", tangentsSerial, tangentsSerial, true);
+
+	bool allMatch = true;
+	auto report = [&](const std::string& label, ThreadPool* pool) {
+		double normalsMs = bestMs(iterations, [&]() { runNormals(pool); });
+		bool normalsMatch = sameBits(normals, normalsRef);
+		double tangentsMs = bestMs(iterations, [&]() { runTangents(pool); });
+		bool tangentsMatch = sameBits(tangents, tangentsRef) && sameBits(bitangents, bitangentsRef);
+		printRow("normals " + label, normalsSerial, normalsMs, normalsMatch);
+		printRow("tangents " + label, tangentsSerial, tangentsMs, tangentsMatch);
+		allMatch = allMatch && normalsMatch && tangentsMatch;
+	};
+
+	report("no pool", nullptr);
+	for (uint32_t threads = 1; ; threads = std::min(threads * 2, ThreadPool::getDefaultThreadCount())) {
+		ThreadPool pool{ threads };
+		report(std::to_string(threads) + " threads", &pool);
+		if (threads == ThreadPool::getDefaultThreadCount())
+			break;
+	}
+
+	std::cout << (allMatch ? "all results match the serial implementation" : "results differ from the serial implementation") << std::endl;
+	return allMatch ? EXIT_SUCCESS : EXIT_FAILURE;
+}
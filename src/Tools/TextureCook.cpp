@@ -0,0 +1,81 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+
+#include "GLTF/GLTFCooked.h"
+#include "GLTF/GLTFTextures.h"
+
+// Converts every image a glTF file references into a KTX2 file with its whole mip chain,
+// BC7 for color, BC5 for normal and metallic-roughness maps, BC4 for occlusion,
+// and writes the manifest Scene::loadGLTFFile picks them up with.
+// Images whose source is unchanged since the last run are skipped.
+// usage: texture_cook <file.gltf> [--out dir] [--threads n] [--force]
+// --out is the cookedCacheDir the scene is loaded with, COOKED_CACHE_DIR by default like the viewer.
+// Exits with EXIT_FAILURE if any image failed.
+int main(int argc, char** argv)
+{
+	std::string filename, cacheDir = COOKED_CACHE_DIR;
+	TextureCookOptions options{};
+	options.measureError = true;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+			cacheDir = argv[++i];
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			options.threadCount = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		else if (strcmp(argv[i], "--force") == 0)
+			options.force = true;
+		else if (filename.empty())
+			filename = argv[i];
+		else {
+			filename.clear();
+			break;
+		}
+	}
+	if (filename.empty()) {
+		std::cerr << "usage: texture_cook <file.gltf> [--out dir] [--threads n] [--force]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::vector<TextureCookResult> results;
+	std::string textureDir = getCookedTextureDir(filename, cacheDir);
+	auto start = std::chrono::high_resolution_clock::now();
+	try {
+		results = cookGltfTextures(filename, textureDir, options);
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+
+	size_t cookedNum = 0, skippedNum = 0, failedNum = 0;
+	for (const auto& result : results) {
+		std::cout << std::left << std::setw(40) << result.source << std::setw(20) << getTextureRoleName(result.role) << std::right;
+		if (!result.error.empty()) {
+			std::cout << "FAILED " << result.error << std::endl;
+			++failedNum;
+		}
+		else if (result.skipped) {
+			std::cout << "unchanged" << std::endl;
+			++skippedNum;
+		}
+		else {
+			std::cout << result.width << "x" << result.height << ", " << result.levelNum << " levels, "
+				<< result.cookedSize / 1024 << " KiB, " << std::fixed << std::setprecision(2) << result.psnr << " dB" << std::endl;
+			++cookedNum;
+		}
+	}
+
+	std::cout << cookedNum << " cooked, " << skippedNum << " unchanged, " << failedNum << " failed in "
+		<< std::fixed << std::setprecision(1) << std::chrono::duration<double, std::milli>(end - start).count() << " ms"
+		<< " into " << textureDir << std::endl;
+	return failedNum == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// Fast non-cryptographic 64-bit hash, reads 8 bytes per step.
+// Chain calls by passing the previous result as seed.
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull)
+{
+	auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+	uint64_t h = seed ^ (size * 0x9E3779B97F4A7C15ull);
+
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t w;
+		memcpy(&w, p + i, sizeof(w));
+		h ^= w * 0x9E3779B97F4A7C15ull;
+		h = rotl(h, 31) * 0xBF58476D1CE4E5B9ull;
+	}
+
+	uint64_t tail = 0;
+	for (size_t shift = 0; i < size; ++i, shift += 8)
+		tail |= uint64_t(p[i]) << shift;
+	h ^= tail * 0x9E3779B97F4A7C15ull;
+
+	// splitmix64 finalizer
+	h ^= h >> 30;
+	h *= 0xBF58476D1CE4E5B9ull;
+	h ^= h >> 27;
+	h *= 0x94D049BB133111EBull;
+	h ^= h >> 31;
+	return h;
+}
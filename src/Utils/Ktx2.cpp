@@ -0,0 +1,227 @@
+#include "Ktx2.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+	const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	// Identifier, header and index, the level index follows
+	constexpr size_t KTX2_HEADER_SIZE = 80;
+	constexpr size_t KTX2_LEVEL_INDEX_SIZE = 24;
+
+	template<class T>
+	T read(const uint8_t* p)
+	{
+		T value;
+		memcpy(&value, p, sizeof(T));
+		return value;
+	}
+
+	template<class T>
+	void write(std::vector<uint8_t>& out, size_t offset, T value)
+	{
+		memcpy(out.data() + offset, &value, sizeof(T));
+	}
+
+	// Finds KTXswizzle in the key/value data, every entry is padded to 4 bytes
+	std::string readSwizzle(const uint8_t* p, size_t size, uint32_t kvdOffset, uint32_t kvdLength)
+	{
+		if (kvdLength == 0 || kvdOffset > size || kvdLength > size - kvdOffset)
+			return {};
+
+		const uint8_t* cur = p + kvdOffset;
+		const uint8_t* end = cur + kvdLength;
+		while (end - cur >= 4) {
+			uint32_t length = read<uint32_t>(cur);
+			cur += 4;
+			if (length > size_t(end - cur))
+				break;
+
+			std::string entry(reinterpret_cast<const char*>(cur), length);
+			size_t keyEnd = entry.find('\0');
+			if (keyEnd != std::string::npos && entry.compare(0, keyEnd, "KTXswizzle") == 0)
+				return std::string(entry.c_str() + keyEnd + 1).substr(0, 4);
+			cur += (length + 3) & ~3u;
+		}
+		return {};
+	}
+
+	// What the data format descriptor needs to know about a format
+	struct Ktx2Format
+	{
+		uint32_t vkFormat;
+		uint8_t colorModel;
+		bool srgb;
+		uint32_t blockSize;		// Texels along each side of a block
+		uint32_t blockBytes;
+		uint32_t sampleNum;
+	};
+
+	// VkFormat values, KHR_DF_MODEL_RGBSDA / BC4 / BC5 / BC7
+	const Ktx2Format KTX2_FORMATS[] = {
+		{ 37, 1, false, 1, 4, 4 },		// R8G8B8A8_UNORM
+		{ 43, 1, true, 1, 4, 4 },		// R8G8B8A8_SRGB
+		{ 139, 131, false, 4, 8, 1 },	// BC4_UNORM_BLOCK
+		{ 141, 132, false, 4, 16, 2 },	// BC5_UNORM_BLOCK
+		{ 145, 134, false, 4, 16, 1 },	// BC7_UNORM_BLOCK
+		{ 146, 134, true, 4, 16, 1 },	// BC7_SRGB_BLOCK
+	};
+
+	std::vector<uint8_t> makeDataFormatDescriptor(const Ktx2Format& format)
+	{
+		uint32_t blockLength = 24 + 16 * format.sampleNum;
+		std::vector<uint8_t> dfd(4 + blockLength, 0);
+		write<uint32_t>(dfd, 0, uint32_t(dfd.size()));
+		// Khronos vendor, basic descriptor type, version 1.3
+		write<uint32_t>(dfd, 4, 0);
+		write<uint32_t>(dfd, 8, 2u | (blockLength << 16));
+		dfd[12] = format.colorModel;
+		dfd[13] = 1;	// BT709 primaries
+		dfd[14] = format.srgb ? 2 : 1;
+		dfd[15] = 0;	// Straight alpha
+		dfd[16] = uint8_t(format.blockSize - 1);
+		dfd[17] = uint8_t(format.blockSize - 1);
+		dfd[20] = uint8_t(format.blockBytes);
+
+		for (uint32_t i = 0; i < format.sampleNum; ++i) {
+			size_t sample = 28 + 16 * size_t(i);
+			if (format.blockSize == 1) {
+				// One byte per channel, alpha is never sRGB encoded
+				bool alpha = i == 3;
+				write<uint16_t>(dfd, sample, uint16_t(8 * i));
+				dfd[sample + 2] = 7;
+				dfd[sample + 3] = uint8_t(alpha ? (15 | (format.srgb ? 0x10 : 0)) : i);
+				write<uint32_t>(dfd, sample + 12, 255);
+			}
+			else {
+				// The whole block, or one half per channel for BC5
+				uint32_t bits = format.blockBytes * 8 / format.sampleNum;
+				write<uint16_t>(dfd, sample, uint16_t(bits * i));
+				dfd[sample + 2] = uint8_t(bits - 1);
+				dfd[sample + 3] = uint8_t(i);
+				write<uint32_t>(dfd, sample + 12, 0xFFFFFFFFu);
+			}
+		}
+		return dfd;
+	}
+
+	void appendKeyValue(std::vector<uint8_t>& kvd, const std::string& key, const std::string& value)
+	{
+		uint32_t length = uint32_t(key.size() + 1 + value.size() + 1);
+		size_t offset = kvd.size();
+		kvd.resize(offset + 4 + ((length + 3) & ~3u), 0);
+		write<uint32_t>(kvd, offset, length);
+		memcpy(kvd.data() + offset + 4, key.c_str(), key.size() + 1);
+		memcpy(kvd.data() + offset + 4 + key.size() + 1, value.c_str(), value.size() + 1);
+	}
+
+	size_t alignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+bool isKtx2(const void* data, size_t size)
+{
+	return size >= sizeof(KTX2_IDENTIFIER) && memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0;
+}
+
+Ktx2Texture parseKtx2(const void* data, size_t size)
+{
+	if (!isKtx2(data, size) || size < KTX2_HEADER_SIZE)
+		throw std::runtime_error("not a KTX2 file!");
+
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+	Ktx2Texture texture{};
+	texture.vkFormat = read<uint32_t>(p + 12);
+	texture.width = read<uint32_t>(p + 20);
+	texture.height = read<uint32_t>(p + 24);
+	uint32_t depth = read<uint32_t>(p + 28);
+	uint32_t layerCount = read<uint32_t>(p + 32);
+	uint32_t faceCount = read<uint32_t>(p + 36);
+	uint32_t levelCount = read<uint32_t>(p + 40);
+	uint32_t supercompression = read<uint32_t>(p + 44);
+
+	if (texture.vkFormat == 0 || supercompression != 0)
+		throw std::runtime_error("KTX2 Basis Universal and supercompressed textures are not supported!");
+	if (texture.width == 0 || texture.height == 0 || depth > 1 || layerCount > 1 || faceCount != 1)
+		throw std::runtime_error("only 2D KTX2 textures are supported!");
+
+	// 0 asks the loader to generate the mips, only the base level is stored then
+	levelCount = levelCount == 0 ? 1 : levelCount;
+	if (levelCount > 32 || KTX2_HEADER_SIZE + size_t(levelCount) * KTX2_LEVEL_INDEX_SIZE > size)
+		throw std::runtime_error("damaged KTX2 level index!");
+
+	for (uint32_t i = 0; i < levelCount; ++i) {
+		const uint8_t* entry = p + KTX2_HEADER_SIZE + i * KTX2_LEVEL_INDEX_SIZE;
+		Ktx2Level level{ read<uint64_t>(entry), read<uint64_t>(entry + 8) };
+		if (level.size == 0 || level.offset > size || level.size > size - level.offset)
+			throw std::runtime_error("damaged KTX2 level index!");
+		texture.levels.push_back(level);
+	}
+	texture.swizzle = readSwizzle(p, size, read<uint32_t>(p + 56), read<uint32_t>(p + 60));
+	return texture;
+}
+
+std::vector<uint8_t> writeKtx2(uint32_t vkFormat, uint32_t width, uint32_t height,
+	const std::vector<std::vector<uint8_t>>& levels, const std::string& swizzle)
+{
+	auto format = std::find_if(std::begin(KTX2_FORMATS), std::end(KTX2_FORMATS),
+		[vkFormat](const Ktx2Format& f) { return f.vkFormat == vkFormat; });
+	if (format == std::end(KTX2_FORMATS))
+		throw std::runtime_error("KTX2 writer does not support format " + std::to_string(vkFormat) + "!");
+	if (levels.empty() || levels.size() > 32)
+		throw std::runtime_error("KTX2 texture needs 1 to 32 levels!");
+
+	auto dfd = makeDataFormatDescriptor(*format);
+	std::vector<uint8_t> kvd;
+	// Keys are sorted by their bytes
+	if (!swizzle.empty())
+		appendKeyValue(kvd, "KTXswizzle", swizzle);
+	appendKeyValue(kvd, "KTXwriter", "vulkan_study texture_cook");
+
+	size_t levelIndexOffset = KTX2_HEADER_SIZE;
+	size_t dfdOffset = levelIndexOffset + levels.size() * KTX2_LEVEL_INDEX_SIZE;
+	size_t kvdOffset = dfdOffset + dfd.size();
+
+	// Level data starts from the smallest level, each one aligned to lcm(block bytes, 4)
+	size_t alignment = std::max<size_t>(format->blockBytes, 4);
+	std::vector<size_t> levelOffsets(levels.size());
+	size_t end = kvdOffset + kvd.size();
+	for (size_t i = levels.size(); i-- > 0;) {
+		levelOffsets[i] = alignUp(end, alignment);
+		end = levelOffsets[i] + levels[i].size();
+	}
+
+	std::vector<uint8_t> out(end, 0);
+	memcpy(out.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	write<uint32_t>(out, 12, vkFormat);
+	write<uint32_t>(out, 16, 1);	// typeSize, bytes of the data type
+	write<uint32_t>(out, 20, width);
+	write<uint32_t>(out, 24, height);
+	write<uint32_t>(out, 28, 0);
+	write<uint32_t>(out, 32, 0);
+	write<uint32_t>(out, 36, 1);
+	write<uint32_t>(out, 40, uint32_t(levels.size()));
+	write<uint32_t>(out, 44, 0);
+	write<uint32_t>(out, 48, uint32_t(dfdOffset));
+	write<uint32_t>(out, 52, uint32_t(dfd.size()));
+	write<uint32_t>(out, 56, kvd.empty() ? 0 : uint32_t(kvdOffset));
+	write<uint32_t>(out, 60, uint32_t(kvd.size()));
+	write<uint64_t>(out, 64, 0);
+	write<uint64_t>(out, 72, 0);
+
+	for (size_t i = 0; i < levels.size(); ++i) {
+		size_t entry = levelIndexOffset + i * KTX2_LEVEL_INDEX_SIZE;
+		write<uint64_t>(out, entry, levelOffsets[i]);
+		write<uint64_t>(out, entry + 8, levels[i].size());
+		write<uint64_t>(out, entry + 16, levels[i].size());
+		memcpy(out.data() + levelOffsets[i], levels[i].data(), levels[i].size());
+	}
+	memcpy(out.data() + dfdOffset, dfd.data(), dfd.size());
+	if (!kvd.empty())
+		memcpy(out.data() + kvdOffset, kvd.data(), kvd.size());
+	return out;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Reader and writer of KTX 2.0 texture containers (https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html).
+// Only plain 2D textures are understood: one layer, one face, no supercompression.
+// The format is kept as the VkFormat value of the header, the caller decides what it supports.
+
+struct Ktx2Level
+{
+	uint64_t offset;	// From the start of the file
+	uint64_t size;
+};
+
+struct Ktx2Texture
+{
+	uint32_t vkFormat{ 0 };
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	// levels[0] is the full resolution image, every further level halves the size
+	std::vector<Ktx2Level> levels;
+	// KTXswizzle value, like "rg01". Empty when the channels are read as they are stored.
+	std::string swizzle;
+};
+
+bool isKtx2(const void* data, size_t size);
+
+// Throws std::runtime_error if the file is damaged or uses a feature that is not supported
+Ktx2Texture parseKtx2(const void* data, size_t size);
+
+// Builds a KTX2 file from the levels, levels[0] is the full resolution image.
+// vkFormat must be one of R8G8B8A8, BC4, BC5 or BC7 in UNORM or SRGB, the data format descriptor is made for it.
+// Throws std::runtime_error for other formats.
+std::vector<uint8_t> writeKtx2(uint32_t vkFormat, uint32_t width, uint32_t height,
+	const std::vector<std::vector<uint8_t>>& levels, const std::string& swizzle = "");
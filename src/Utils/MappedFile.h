@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. The pages are only touched
+// when they are read, so large files cost no heap memory.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	explicit MappedFile(const std::string& filename);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	bool isOpen() const { return data != nullptr; }
+	const uint8_t* getData() const { return data; }
+	size_t getSize() const { return size; }
+
+	static bool exists(const std::string& filename);
+
+private:
+	const uint8_t* data{ nullptr };
+	size_t size{ 0 };
+
+#ifdef _WIN32
+	void* fileHandle{ nullptr };
+	void* mappingHandle{ nullptr };
+#endif
+
+	void close();
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <chrono>
+
+// Splits a stretch of work into phases, each lap adds the seconds since the previous lap to a total
+class PhaseClock
+{
+public:
+	PhaseClock() : last{ std::chrono::steady_clock::now() } {}
+
+	void lap(double& seconds)
+	{
+		auto now = std::chrono::steady_clock::now();
+		seconds += std::chrono::duration<double>(now - last).count();
+		last = now;
+	}
+
+private:
+	std::chrono::steady_clock::time_point last;
+};
@@ -0,0 +1,128 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+ThreadPool::ThreadPool(uint32_t threadCount) :
+	threadCount{ threadCount == 0 ? getDefaultThreadCount() : threadCount }
+{
+	workers.reserve(this->threadCount - 1);
+	for (uint32_t i = 1; i < this->threadCount; ++i)
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	condition.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+}
+
+namespace {
+	// Shared with the queued helper tasks, a helper may only get to run after
+	// the parallelFor that queued it has returned
+	struct ParallelForState
+	{
+		const std::function<void(size_t)>* func{ nullptr };
+		size_t count{ 0 };
+		std::atomic<size_t> next{ 0 };
+		std::exception_ptr error;
+
+		std::mutex mutex;
+		std::condition_variable done;
+		size_t active{ 0 };
+		bool closed{ false };
+	};
+
+	void runParallelFor(ParallelForState& state)
+	{
+		for (size_t i = state.next++; i < state.count; i = state.next++) {
+			try {
+				(*state.func)(i);
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock(state.mutex);
+				if (!state.error)
+					state.error = std::current_exception();
+			}
+		}
+	}
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& func)
+{
+	if (count == 0)
+		return;
+
+	if (workers.empty() || count == 1) {
+		for (size_t i = 0; i < count; ++i)
+			func(i);
+		return;
+	}
+
+	auto state = std::make_shared<ParallelForState>();
+	state->func = &func;
+	state->count = count;
+
+	size_t helperNum = std::min(workers.size(), count - 1);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t i = 0; i < helperNum; ++i) {
+			tasks.emplace([state]() {
+				{
+					std::lock_guard<std::mutex> stateLock(state->mutex);
+					if (state->closed)
+						return;
+					++state->active;
+				}
+				runParallelFor(*state);
+				std::lock_guard<std::mutex> stateLock(state->mutex);
+				if (--state->active == 0)
+					state->done.notify_one();
+			});
+		}
+	}
+	condition.notify_all();
+
+	runParallelFor(*state);
+
+	// Every index is taken once the calling thread gets here. Helpers that did not
+	// start yet are dropped instead of waited for, workers busy with the job that
+	// called a nested parallelFor can't block it.
+	{
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->closed = true;
+		state->done.wait(lock, [&]() { return state->active == 0; });
+	}
+
+	if (state->error)
+		std::rethrow_exception(state->error);
+}
+
+uint32_t ThreadPool::getDefaultThreadCount()
+{
+	uint32_t count = std::thread::hardware_concurrency();
+	return count == 0 ? 1 : count;
+}
+
+void ThreadPool::workerLoop()
+{
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+			if (stopping && tasks.empty())
+				return;
+			task = std::move(tasks.front());
+			tasks.pop();
+		}
+		task();
+	}
+}
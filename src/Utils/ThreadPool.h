@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Fixed-size worker pool. The calling thread takes part in parallelFor,
+// so a pool created with threadCount = 1 runs everything inline.
+class ThreadPool
+{
+public:
+	// threadCount = 0 picks the hardware concurrency
+	explicit ThreadPool(uint32_t threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	uint32_t getThreadCount() const { return threadCount; }
+
+	// Runs func(i) for every i in [0, count) and blocks until all of them are done.
+	// The first exception thrown by a job is rethrown on the calling thread.
+	// Jobs may call parallelFor on the same pool, the nested call runs on the
+	// calling thread plus whatever workers are idle.
+	void parallelFor(size_t count, const std::function<void(size_t)>& func);
+
+	static uint32_t getDefaultThreadCount();
+
+private:
+	uint32_t threadCount;
+
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()>> tasks;
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping{ false };
+
+	void workerLoop();
+};
@@ -1,41 +1,77 @@
 #include "Vertex.h"
 
-VkVertexInputBindingDescription Vertex::getBindingDescription() {
+#include <glm/gtc/packing.hpp>
+
+namespace {
+    // Maps a direction onto the octahedron and unfolds it into [-1, 1]^2
+    glm::vec2 octEncode(glm::vec3 n)
+    {
+        float sum = glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z);
+        if (sum == 0.0f)
+            return glm::vec2(0.0f);
+
+        n /= sum;
+        glm::vec2 p{ n.x, n.y };
+        if (n.z < 0.0f) {
+            glm::vec2 signs{ p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f };
+            p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * signs;
+        }
+        return p;
+    }
+}
+
+PackedVertex PackedVertex::pack(const Vertex& vertex)
+{
+    // The bitangent is rebuilt as cross(normal, tangent) * handedness
+    float handedness = glm::dot(glm::cross(vertex.normal, vertex.tangent), vertex.bitangent) < 0.0f ? -1.0f : 1.0f;
+
+    PackedVertex packed{};
+    packed.pos = vertex.pos;
+    packed.normal = glm::packSnorm2x16(octEncode(vertex.normal));
+    packed.tangent = glm::packSnorm4x8(glm::vec4(octEncode(vertex.tangent), 0.0f, handedness));
+    packed.texCoord = glm::packHalf2x16(vertex.texCoord);
+    return packed;
+}
+
+std::vector<PackedVertex> packVertices(const std::vector<Vertex>& vertices)
+{
+    std::vector<PackedVertex> packed(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i)
+        packed[i] = PackedVertex::pack(vertices[i]);
+    return packed;
+}
+
+VkVertexInputBindingDescription PackedVertex::getBindingDescription() {
     VkVertexInputBindingDescription bindingDescription{};
     bindingDescription.binding = 0;
-    bindingDescription.stride = sizeof(Vertex);
+    bindingDescription.stride = sizeof(PackedVertex);
     bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
     return bindingDescription;
 }
 
-std::vector<VkVertexInputAttributeDescription> Vertex::getAttributeDescriptions() {
-    std::vector<VkVertexInputAttributeDescription> attributeDescriptions{ 5 };
+std::vector<VkVertexInputAttributeDescription> PackedVertex::getAttributeDescriptions() {
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions{ 4 };
 
     attributeDescriptions[0].binding = 0;
     attributeDescriptions[0].location = 0;
     attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[0].offset = offsetof(Vertex, pos);
+    attributeDescriptions[0].offset = offsetof(PackedVertex, pos);
 
     attributeDescriptions[1].binding = 0;
     attributeDescriptions[1].location = 1;
-    attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[1].offset = offsetof(Vertex, normal);
+    attributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM;
+    attributeDescriptions[1].offset = offsetof(PackedVertex, normal);
 
     attributeDescriptions[2].binding = 0;
     attributeDescriptions[2].location = 2;
-    attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-    attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
+    attributeDescriptions[2].format = VK_FORMAT_R16G16_SFLOAT;
+    attributeDescriptions[2].offset = offsetof(PackedVertex, texCoord);
 
     attributeDescriptions[3].binding = 0;
     attributeDescriptions[3].location = 3;
-    attributeDescriptions[3].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[3].offset = offsetof(Vertex, tangent);
-
-    attributeDescriptions[4].binding = 0;
-    attributeDescriptions[4].location = 4;
-    attributeDescriptions[4].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[4].offset = offsetof(Vertex, bitangent);
+    attributeDescriptions[3].format = VK_FORMAT_R8G8B8A8_SNORM;
+    attributeDescriptions[3].offset = offsetof(PackedVertex, tangent);
 
     return attributeDescriptions;
 }
\ No newline at end of file
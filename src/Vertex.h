@@ -2,17 +2,32 @@
 
 #include <glm/glm.hpp>
 
+#include <cstdint>
 #include <vector>
 #include <volk.h>
 
+// Full precision vertex the importer and the mesh processing passes work on
 struct Vertex {
     glm::vec3 pos;
     glm::vec3 normal;
     glm::vec2 texCoord;
     glm::vec3 tangent;
     glm::vec3 bitangent;
+};
+
+// Vertex as stored in GPU buffers, 24 bytes instead of 56.
+// Matches Vertex in shaders/host_device.h, decoded by shaders/vertex.glsl.
+struct PackedVertex {
+    glm::vec3 pos;
+    uint32_t normal;    // octahedral, 2x snorm16
+    uint32_t tangent;   // octahedral xy, handedness w, 4x snorm8
+    uint32_t texCoord;  // 2x half
+
+    static PackedVertex pack(const Vertex& vertex);
 
     static VkVertexInputBindingDescription getBindingDescription();
 
     static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
-};
\ No newline at end of file
+};
+
+std::vector<PackedVertex> packVertices(const std::vector<Vertex>& vertices);
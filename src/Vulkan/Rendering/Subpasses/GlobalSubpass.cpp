@@ -22,7 +22,8 @@ GlobalSubpass::GlobalSubpass(const VulkanDevice& device, VulkanResourceManager&
 
     fragShader.addShaderResourceUniform(ShaderResourceType::StorageBuffer, 0, 2, 1,
         VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR);
-    fragShader.addShaderResourceUniform(ShaderResourceType::Sampler, 0, 3, resManager.getTextureNum(),
+    textureSlotNum = resManager.getTextureNum();
+    fragShader.addShaderResourceUniform(ShaderResourceType::Sampler, 0, 3, toU32(textureSlotNum),
         VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR);
     fragShader.addShaderResourceUniform(ShaderResourceType::Sampler, 0, 4, 1,
         VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR);
@@ -58,23 +59,13 @@ void GlobalSubpass::prepare(
         }
     );
 
-    const auto& renderMeshes = resManager.getRenderMeshes();
-    std::vector<ObjDesc> objDescs{ renderMeshes.size() };
-    for (size_t i = 0; i < renderMeshes.size(); ++i) {
-        auto& od = objDescs[i];
-        auto& mesh = renderMeshes[i];
-        od.vertexAddress = getBufferDeviceAddress(device.getHandle(), mesh.vertexBuffer.buffer) + mesh.vertexBuffer.offset;
-        od.indexAddress = getBufferDeviceAddress(device.getHandle(), mesh.indexBuffer.buffer) + mesh.indexBuffer.offset;
-        od.materialAddress = getBufferDeviceAddress(device.getHandle(), mesh.matBuffer.buffer) + mesh.matBuffer.offset;
-        od.materialIndexAddress = getBufferDeviceAddress(device.getHandle(), mesh.matIndicesBuffer.buffer) + mesh.matIndicesBuffer.offset;
-    }
-    for (uint32_t i = 0; i < globalData.uniformBuffers.size(); ++i) {
-        globalData.updateData(i, 2, objDescs.data(), sizeof(ObjDesc) * objDescs.size());
-    }
+    updateObjDescs();
 
+    // Released texture slots show the first texture until they are reused
+    const auto& textures = resManager.getTextures();
     std::vector<VkDescriptorImageInfo> imageInfos{ resManager.getTextureNum() };
-    std::transform(resManager.getTextures().begin(), resManager.getTextures().end(), imageInfos.begin(),
-        [](const auto& tex) { return tex->getImageInfo(); });
+    std::transform(textures.begin(), textures.end(), imageInfos.begin(),
+        [&](const auto& tex) { return (tex ? tex : textures.front())->getImageInfo(); });
 
     auto skyboxCubeMapImageInfo = resManager.getCubeMapTextures()[resManager.getSkybox().cubeMap]->getImageInfo();
 
@@ -86,13 +77,12 @@ void GlobalSubpass::prepare(
 
     lightData = resManager.requireSceneData(*renderPipeline->getDescriptorSetLayouts()[1], 1,
         {
-            {0, {device.getGPU().pad_uniform_buffer_size(sizeof(DirLight) * 16), 1}},
-            {1, {device.getGPU().pad_uniform_buffer_size(sizeof(PointLight) * 16), 1}},
+            {0, {device.getGPU().pad_uniform_buffer_size(sizeof(DirLight) * MAX_LIGHT_NUM), 1}},
+            {1, {device.getGPU().pad_uniform_buffer_size(sizeof(PointLight) * MAX_LIGHT_NUM), 1}},
             {2, {device.getGPU().pad_uniform_buffer_size(sizeof(ShadowData)), 1}},
         }
     );
 
-    VkSamplerCreateInfo shadowSamplerInfo{};
     auto shadowSampler = resManager.createSampler();
 
     std::vector<VkDescriptorImageInfo> dirShadowImageInfos{};
@@ -112,7 +102,25 @@ void GlobalSubpass::prepare(
     lightData.update();
 }
 
-void GlobalSubpass::update(float deltaTime, const Scene* scene)
+void GlobalSubpass::updateObjDescs()
+{
+    const auto& renderMeshes = resManager.getRenderMeshes();
+    std::vector<ObjDesc> objDescs{ renderMeshes.size() };
+    for (size_t i = 0; i < renderMeshes.size(); ++i) {
+        auto& od = objDescs[i];
+        auto& mesh = renderMeshes[i];
+        od.vertexAddress = getBufferDeviceAddress(device.getHandle(), mesh.vertexBuffer.buffer) + mesh.vertexBuffer.offset;
+        od.indexAddress = getBufferDeviceAddress(device.getHandle(), mesh.indexBuffer.buffer) + mesh.indexBuffer.offset;
+        od.indexSize = mesh.indexType == VK_INDEX_TYPE_UINT16 ? 2 : 4;
+        od.materialAddress = getBufferDeviceAddress(device.getHandle(), mesh.matBuffer.buffer) + mesh.matBuffer.offset;
+        od.materialIndexAddress = getBufferDeviceAddress(device.getHandle(), mesh.matIndicesBuffer.buffer) + mesh.matIndicesBuffer.offset;
+    }
+    for (uint32_t i = 0; i < globalData.uniformBuffers.size(); ++i) {
+        globalData.updateData(i, 2, objDescs.data(), sizeof(ObjDesc) * objDescs.size());
+    }
+}
+
+void GlobalSubpass::update(float /*deltaTime*/, const Scene* scene)
 {
     uint32_t currentImage = 0;
     const auto& camera = scene->getActiveCamera();
@@ -127,30 +135,58 @@ void GlobalSubpass::update(float deltaTime, const Scene* scene)
 
     globalData.uniformBuffers[currentImage][0]->update(&ubo, sizeof(ubo));
 
+    // Scene data buffers stay mapped, the matrices are written straight into the storage buffer
     auto& buffer = globalData.uniformBuffers[currentImage][1];
-    ObjectData* objData = reinterpret_cast<ObjectData*>(buffer->map());
+    ObjectData* objData = reinterpret_cast<ObjectData*>(buffer->getMappedData());
     for (size_t i = 0; i < resManager.getRenderMeshNum(); ++i) {
         objData[i].model = resManager.getRenderMesh(i).tranformMatrix;
     }
-    buffer->unmap();
+    buffer->flush(0, sizeof(ObjectData) * resManager.getRenderMeshNum());
 
-    // Light Data
+    float projScale = getLodProjScale(glm::radians(camera->zoom), extent.height);
+    meshLods.resize(resManager.getRenderMeshNum());
+    for (size_t i = 0; i < meshLods.size(); ++i) {
+        const auto& renderMesh = resManager.getRenderMesh(i);
+        meshLods[i] = selectRenderLod(resManager.getRenderGeometry(renderMesh.geometry), renderMesh.tranformMatrix,
+            camera->position, projScale, lodBias);
+    }
+
+    // The frame fence has been waited for, nothing samples the textures streaming replaces
+    auto streamed = resManager.updateTextureStreaming(ubo.proj * ubo.view, camera->position, projScale);
+    if (!streamed.empty()) {
+        const auto& textures = resManager.getTextures();
+        for (auto& dset : globalData.descriptorSets) {
+            for (TextureID id : streamed) {
+                if (id < textureSlotNum && textures[id])
+                    dset->addWrite(3, textures[id]->getImageInfo(), toU32(id));
+            }
+        }
+        globalData.update();
+    }
+
+    // Light Data, lights past MAX_LIGHT_NUM of a kind are left out
     std::vector<DirLight> dirLights;
     for (const auto& [name, light] : scene->getDirLightMap()) {
+        if (dirLights.size() == MAX_LIGHT_NUM)
+            break;
         light->update(*camera, (float)extent.width / (float)extent.height);
         dirLights.push_back(*light);
     }
+    assert(dirLights.size() <= MAX_LIGHT_NUM);
     lightData.updateData(currentImage, 0, dirLights.data(), sizeof(DirLight) * dirLights.size());
 
     std::vector<PointLight> pointLights;
     for (const auto& [name, light] : scene->getPointLightMap()) {
+        if (pointLights.size() == MAX_LIGHT_NUM)
+            break;
         light->update();
         pointLights.push_back(*light);
     }
+    assert(pointLights.size() <= MAX_LIGHT_NUM);
     lightData.updateData(currentImage, 1, pointLights.data(), sizeof(PointLight) * pointLights.size());
 
-    pushConstants.dirLightNum = scene->getDirLightMap().size();
-    pushConstants.pointLightNum = scene->getPointLightMap().size();
+    pushConstants.dirLightNum = toU32(dirLights.size());
+    pushConstants.pointLightNum = toU32(pointLights.size());
     pushConstants.viewPos = camera->position;
 }
 
@@ -161,7 +197,7 @@ void GlobalSubpass::update(float deltaTime, const Scene* scene, ShadowData shado
     lightData.updateData(currentImage, 2, &shadowData, sizeof(shadowData));
 }
 
-void GlobalSubpass::draw(VulkanCommandBuffer& cmdBuf, const std::vector<VulkanDescriptorSet*>& globalSets)
+void GlobalSubpass::draw(VulkanCommandBuffer& cmdBuf, const std::vector<VulkanDescriptorSet*>& /*globalSets*/)
 {
     cmdBuf.bindPipeline(renderPipeline->getGraphicsPipeline());
 
@@ -177,6 +213,9 @@ void GlobalSubpass::draw(VulkanCommandBuffer& cmdBuf, const std::vector<VulkanDe
         renderPipeline->getPipelineLayout().getHandle(),
         1, 1, &lightDescriptorSetHandle, 0, nullptr);
 
+    // Meshes share the arena buffers, which are bound again only when the next mesh lives in another one
+    VkBuffer boundVertexBuffer = VK_NULL_HANDLE, boundIndexBuffer = VK_NULL_HANDLE;
+    VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
     for (size_t i = 0; i < resManager.getRenderMeshNum(); ++i) {
         const auto& renderMesh = resManager.getRenderMesh(i);
         pushConstants.objId = i;
@@ -185,11 +224,19 @@ void GlobalSubpass::draw(VulkanCommandBuffer& cmdBuf, const std::vector<VulkanDe
         vkCmdPushConstants(cmdBuf.getHandle(), pipelineLayout.getHandle(),
             pipelineLayout.getPushConstantRanges()[0].stageFlags, 0, sizeof(PushConstantRaster), &pushConstants);
 
-        vkCmdBindVertexBuffers(cmdBuf.getHandle(), 0, 1, &renderMesh.vertexBuffer.buffer, &renderMesh.vertexBuffer.offset);
-
-        vkCmdBindIndexBuffer(cmdBuf.getHandle(), renderMesh.indexBuffer.buffer, renderMesh.indexBuffer.offset, renderMesh.indexType);
-
+        if (renderMesh.vertexBuffer.buffer != boundVertexBuffer) {
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(cmdBuf.getHandle(), 0, 1, &renderMesh.vertexBuffer.buffer, &offset);
+            boundVertexBuffer = renderMesh.vertexBuffer.buffer;
+        }
+        if (renderMesh.indexBuffer.buffer != boundIndexBuffer || renderMesh.indexType != boundIndexType) {
+            vkCmdBindIndexBuffer(cmdBuf.getHandle(), renderMesh.indexBuffer.buffer, 0, renderMesh.indexType);
+            boundIndexBuffer = renderMesh.indexBuffer.buffer;
+            boundIndexType = renderMesh.indexType;
+        }
 
-        cmdBuf.drawIndexed(renderMesh.indexNum, 1, 0, 0, 0);
+        const auto& lods = resManager.getRenderGeometry(renderMesh.geometry).lods;
+        const auto& lod = lods[i < meshLods.size() ? meshLods[i] : 0];
+        cmdBuf.drawIndexed(lod.indexNum, 1, renderMesh.firstIndex + lod.firstIndex, renderMesh.vertexOffset, 0);
     }
 }
@@ -14,6 +14,8 @@ public:
     void prepare(
         const std::vector<std::unique_ptr<VulkanImageView>>& dirLightShadowMaps,
         const std::vector<std::unique_ptr<VulkanImageView>>& pointLightShadowMaps);
+    // Writes the device addresses of every RenderMesh again, after their ranges moved
+    void updateObjDescs();
 
     void update(float deltaTime, const Scene* scene) override;
     void update(float deltaTime, const Scene* scene, ShadowData shadowData);
@@ -22,9 +24,18 @@ public:
     constexpr const SceneData& getGlobalData() const { return globalData; }
     constexpr const SceneData& getLightData() const { return lightData; }
 
+    void setLodBias(float bias) { lodBias = bias; }
+
 private:
     SceneData globalData;
     SceneData lightData;
 
+    // LOD drawn for every RenderMesh, chosen in update (see selectRenderLod)
+    std::vector<uint32_t> meshLods;
+    float lodBias{ 0.0f };
+
+    // Size of the texture array, streamed textures are written into it in update
+    size_t textureSlotNum{ 0 };
+
     PushConstantRaster pushConstants{};
 };
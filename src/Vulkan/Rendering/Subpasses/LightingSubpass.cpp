@@ -39,10 +39,11 @@ void LightingSubpass::prepare(const std::vector<const VulkanImageView*>& gBuffer
     defferedData.update();
 }
 
-void LightingSubpass::update(float deltaTime, const Scene* scene)
+void LightingSubpass::update(float /*deltaTime*/, const Scene* scene)
 {
-    pushConstants.dirLightNum = scene->getDirLightMap().size();
-    pushConstants.pointLightNum = scene->getPointLightMap().size();
+    // As many as GlobalSubpass uploads
+    pushConstants.dirLightNum = std::min(MAX_LIGHT_NUM, toU32(scene->getDirLightMap().size()));
+    pushConstants.pointLightNum = std::min(MAX_LIGHT_NUM, toU32(scene->getPointLightMap().size()));
     pushConstants.viewPos = scene->getActiveCamera()->position;
 }
 
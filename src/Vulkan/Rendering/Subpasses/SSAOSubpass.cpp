@@ -104,7 +104,7 @@ void SSAOSubpass::prepare(const std::vector<const VulkanImageView*>& gBuffers)
 	ssaoSceneData.update();
 }
 
-void SSAOSubpass::update(float deltaTime, const Scene* scene)
+void SSAOSubpass::update(float /*deltaTime*/, const Scene* scene)
 {
 	const auto& camera = scene->getActiveCamera();
 
@@ -117,7 +117,7 @@ void SSAOSubpass::update(float deltaTime, const Scene* scene)
 	ssaoSceneData.updateData(0, 0, &ssaoData, sizeof(ssaoData));
 }
 
-void SSAOSubpass::draw(VulkanCommandBuffer& cmdBuf, const std::vector<VulkanDescriptorSet*>& globalSets)
+void SSAOSubpass::draw(VulkanCommandBuffer& cmdBuf, const std::vector<VulkanDescriptorSet*>& /*globalSets*/)
 {
 	cmdBuf.bindPipeline(renderPipeline->getGraphicsPipeline());
 
@@ -172,11 +172,11 @@ void SSAOBlurSubpass::prepare(const std::vector<VulkanImageView>& frameBufferIma
 	sceneData.update();
 }
 
-void SSAOBlurSubpass::update(float deltaTime, const Scene* scene)
+void SSAOBlurSubpass::update(float /*deltaTime*/, const Scene* /*scene*/)
 {
 }
 
-void SSAOBlurSubpass::draw(VulkanCommandBuffer& cmdBuf, const std::vector<VulkanDescriptorSet*>& globalSets)
+void SSAOBlurSubpass::draw(VulkanCommandBuffer& cmdBuf, const std::vector<VulkanDescriptorSet*>& /*globalSets*/)
 {
 	cmdBuf.bindPipeline(renderPipeline->getGraphicsPipeline());
 	std::vector<VkDescriptorSet> descSets = { sceneData.descriptorSets[0]->getHandle() };
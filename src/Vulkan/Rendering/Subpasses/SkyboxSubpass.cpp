@@ -22,7 +22,7 @@ SkyboxSubpass::~SkyboxSubpass()
 {
 }
 
-void SkyboxSubpass::update(float deltaTime, const Scene* scene)
+void SkyboxSubpass::update(float /*deltaTime*/, const Scene* /*scene*/)
 {
 }
 
@@ -0,0 +1,116 @@
+#include "VulkanGeometryArena.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+    VkDeviceSize alignUp(VkDeviceSize offset, VkDeviceSize alignment)
+    {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+}
+
+VulkanGeometryArena::VulkanGeometryArena(const VulkanDevice& device, VkBufferUsageFlags usage, VkDeviceSize alignment,
+    VkDeviceSize blockSize) :
+    device{ device }, usage{ usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT }, alignment{ std::max<VkDeviceSize>(alignment, 1) },
+    blockSize{ blockSize }
+{
+}
+
+VkDescriptorBufferInfo VulkanGeometryArena::allocate(VkDeviceSize size)
+{
+    VkDescriptorBufferInfo range{};
+    range.range = size;
+
+    for (auto& block : blocks) {
+        if (allocateFrom(block, size, range.offset)) {
+            range.buffer = block.buffer->getHandle();
+            return range;
+        }
+    }
+
+    Block block{};
+    VkDeviceSize newBlockSize = std::max(blockSize, alignUp(size, alignment));
+    // Defragmentation may move blocks, VulkanResourceManager points the ranges at the new handles
+    block.buffer = std::make_unique<VulkanBuffer>(device, newBlockSize, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true);
+    block.freeRanges[0] = newBlockSize;
+    allocateFrom(block, size, range.offset);
+    range.buffer = block.buffer->getHandle();
+    blocks.push_back(std::move(block));
+    return range;
+}
+
+bool VulkanGeometryArena::allocateFrom(Block& block, VkDeviceSize size, VkDeviceSize& offset)
+{
+    for (auto it = block.freeRanges.begin(); it != block.freeRanges.end(); ++it) {
+        VkDeviceSize freeOffset = it->first, freeEnd = it->first + it->second;
+        VkDeviceSize alignedOffset = alignUp(freeOffset, alignment);
+        if (alignedOffset + size > freeEnd)
+            continue;
+
+        // Padding in front of the range stays free, as does the rest after it
+        block.freeRanges.erase(it);
+        if (alignedOffset > freeOffset)
+            block.freeRanges[freeOffset] = alignedOffset - freeOffset;
+        if (alignedOffset + size < freeEnd)
+            block.freeRanges[alignedOffset + size] = freeEnd - alignedOffset - size;
+
+        ++block.ranges;
+        block.usedBytes += size;
+        offset = alignedOffset;
+        return true;
+    }
+    return false;
+}
+
+void VulkanGeometryArena::free(const VkDescriptorBufferInfo& range)
+{
+    auto& block = findBlock(range.buffer);
+    VkDeviceSize offset = range.offset, size = range.range;
+
+    auto next = block.freeRanges.lower_bound(offset);
+    if (next != block.freeRanges.end() && offset + size == next->first) {
+        size += next->second;
+        next = block.freeRanges.erase(next);
+    }
+    if (next != block.freeRanges.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            size += prev->second;
+            block.freeRanges.erase(prev);
+        }
+    }
+    block.freeRanges[offset] = size;
+
+    --block.ranges;
+    block.usedBytes -= range.range;
+}
+
+VulkanBuffer& VulkanGeometryArena::getBuffer(VkBuffer handle)
+{
+    return *findBlock(handle).buffer;
+}
+
+GeometryArenaStats VulkanGeometryArena::getStats() const
+{
+    GeometryArenaStats stats{};
+    stats.blocks = toU32(blocks.size());
+    for (const auto& block : blocks) {
+        stats.ranges += block.ranges;
+        stats.freeRanges += toU32(block.freeRanges.size());
+        stats.usedBytes += block.usedBytes;
+        stats.blockBytes += block.buffer->getSize();
+    }
+    return stats;
+}
+
+VulkanGeometryArena::Block& VulkanGeometryArena::findBlock(VkBuffer handle)
+{
+    auto it = std::find_if(blocks.begin(), blocks.end(),
+        [handle](const Block& block) { return block.buffer->getHandle() == handle; });
+    if (it == blocks.end()) {
+        throw std::runtime_error("failed to find geometry arena block!");
+    }
+    return *it;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "VulkanCommon.h"
+#include "VulkanBuffer.h"
+
+// Size of each shared buffer of a VulkanGeometryArena, a larger range gets a buffer of its own
+constexpr VkDeviceSize GEOMETRY_ARENA_BLOCK_SIZE = 64ull << 20;
+
+struct GeometryArenaStats
+{
+    uint32_t ranges{ 0 };
+    uint32_t freeRanges{ 0 };   // Gaps between ranges and the rest of each block
+    uint32_t blocks{ 0 };
+    VkDeviceSize usedBytes{ 0 };
+    VkDeviceSize blockBytes{ 0 };
+};
+
+// Sub-allocates ranges of a few large device local buffers, so geometry needs no buffers of its own
+// and meshes of one block share a single vertex or index buffer binding.
+// Each block keeps its free ranges sorted by offset: first fit on allocate, neighbours merge on free.
+class VulkanGeometryArena
+{
+public:
+    // Every range starts at a multiple of alignment, which need not be a power of two.
+    // A vertex arena aligned to the vertex size can draw with vertexOffset = offset / vertex size.
+    VulkanGeometryArena(const VulkanDevice& device, VkBufferUsageFlags usage, VkDeviceSize alignment,
+        VkDeviceSize blockSize = GEOMETRY_ARENA_BLOCK_SIZE);
+
+    VulkanGeometryArena(const VulkanGeometryArena&) = delete;
+
+    // Buffer and offset of a free range of size bytes, adds a block when no block has one
+    VkDescriptorBufferInfo allocate(VkDeviceSize size);
+    // range must come from allocate of this arena, and the GPU must be done with it
+    void free(const VkDescriptorBufferInfo& range);
+
+
+    VulkanBuffer& getBuffer(VkBuffer handle);
+    VkDeviceSize getAlignment() const { return alignment; }
+    GeometryArenaStats getStats() const;
+
+private:
+    struct Block
+    {
+        std::unique_ptr<VulkanBuffer> buffer;
+        std::map<VkDeviceSize, VkDeviceSize> freeRanges;    // Offset to size
+        uint32_t ranges{ 0 };
+        VkDeviceSize usedBytes{ 0 };
+    };
+
+    const VulkanDevice& device;
+    VkBufferUsageFlags usage;
+    VkDeviceSize alignment;
+    VkDeviceSize blockSize;
+
+    std::vector<Block> blocks;
+
+    Block& findBlock(VkBuffer handle);
+    bool allocateFrom(Block& block, VkDeviceSize size, VkDeviceSize& offset);
+};
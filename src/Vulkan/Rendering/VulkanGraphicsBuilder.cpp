@@ -88,6 +88,11 @@ void VulkanGraphicsBuilder::update(float deltaTime, const Scene* scene)
     lightingPass->update(deltaTime, scene);
 }
 
+void VulkanGraphicsBuilder::updateObjDescs()
+{
+    globalPass->updateObjDescs();
+}
+
 void VulkanGraphicsBuilder::draw(VulkanCommandBuffer& cmdBuf, glm::vec4 clearColor)
 {
     dirShadowPass->draw(cmdBuf, *(getGlobalData().descriptorSets[0]), *(getLightData().descriptorSets[0]));
@@ -308,10 +313,16 @@ ShadowRenderPass::ShadowRenderPass(const VulkanDevice& device, VulkanResourceMan
 {
 }
 
-void ShadowRenderPass::update(float deltaTime, const Scene* scene)
+void ShadowRenderPass::update(float /*deltaTime*/, const Scene* scene)
 {
     pushConstants.dirLightNum = std::min(maxLightNum, toU32(scene->getDirLightMap().size()));
     pushConstants.pointLightNum = std::min(maxLightNum, toU32(scene->getPointLightMap().size()));
+
+    meshLods.resize(resManager.getRenderMeshNum());
+    for (size_t i = 0; i < meshLods.size(); ++i) {
+        const auto& renderMesh = resManager.getRenderMesh(i);
+        meshLods[i] = selectLod(scene, resManager.getRenderGeometry(renderMesh.geometry), renderMesh.tranformMatrix);
+    }
 }
 
 void ShadowRenderPass::draw(VulkanCommandBuffer& cmdBuf, const VulkanDescriptorSet& globalSet, const VulkanDescriptorSet& lightSet)
@@ -336,6 +347,9 @@ void ShadowRenderPass::draw(VulkanCommandBuffer& cmdBuf, const VulkanDescriptorS
         renderPipeline->getPipelineLayout().getHandle(),
         1, 1, &lightDescriptorSetHandle, 0, nullptr);
 
+    // Meshes share the arena buffers, which are bound again only when the next mesh lives in another one
+    VkBuffer boundVertexBuffer = VK_NULL_HANDLE, boundIndexBuffer = VK_NULL_HANDLE;
+    VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
     for (size_t i = 0; i < resManager.getRenderMeshNum(); ++i) {
         const auto& renderMesh = resManager.getRenderMesh(i);
         pushConstants.objId = i;
@@ -344,12 +358,20 @@ void ShadowRenderPass::draw(VulkanCommandBuffer& cmdBuf, const VulkanDescriptorS
         vkCmdPushConstants(cmdBuf.getHandle(), pipelineLayout.getHandle(),
             pipelineLayout.getPushConstantRanges()[0].stageFlags, 0, sizeof(PushConstantRaster), &pushConstants);
 
-        vkCmdBindVertexBuffers(cmdBuf.getHandle(), 0, 1, &renderMesh.vertexBuffer.buffer, &renderMesh.vertexBuffer.offset);
-
-        vkCmdBindIndexBuffer(cmdBuf.getHandle(), renderMesh.indexBuffer.buffer, renderMesh.indexBuffer.offset, renderMesh.indexType);
-
-
-        cmdBuf.drawIndexed(renderMesh.indexNum, 1, 0, 0, 0);
+        if (renderMesh.vertexBuffer.buffer != boundVertexBuffer) {
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(cmdBuf.getHandle(), 0, 1, &renderMesh.vertexBuffer.buffer, &offset);
+            boundVertexBuffer = renderMesh.vertexBuffer.buffer;
+        }
+        if (renderMesh.indexBuffer.buffer != boundIndexBuffer || renderMesh.indexType != boundIndexType) {
+            vkCmdBindIndexBuffer(cmdBuf.getHandle(), renderMesh.indexBuffer.buffer, 0, renderMesh.indexType);
+            boundIndexBuffer = renderMesh.indexBuffer.buffer;
+            boundIndexType = renderMesh.indexType;
+        }
+
+        const auto& lods = resManager.getRenderGeometry(renderMesh.geometry).lods;
+        const auto& lod = lods[i < meshLods.size() ? meshLods[i] : 0];
+        cmdBuf.drawIndexed(lod.indexNum, 1, renderMesh.firstIndex + lod.firstIndex, renderMesh.vertexOffset, 0);
     }
 
 
@@ -405,6 +427,19 @@ DirShadowRenderPass::DirShadowRenderPass(
     renderPipeline->recreatePipeline(extent, *renderPass);
 }
 
+uint32_t DirShadowRenderPass::selectLod(const Scene* scene, const RenderGeometry& geometry, const glm::mat4& transform) const
+{
+    uint32_t lod = toU32(std::max<size_t>(geometry.lods.size(), 1) - 1);
+    uint32_t lightNum = 0;
+    for (const auto& [name, light] : scene->getDirLightMap()) {
+        if (lightNum++ == maxLightNum)
+            break;
+        for (int level = 0; level < std::min(light->csmLevel, int(maxCSMLevel)); ++level)
+            lod = std::min(lod, selectShadowLod(geometry, transform, light->lightSpace[level], extent, lodBias));
+    }
+    return lod;
+}
+
 PointShadowRenderPass::PointShadowRenderPass(const VulkanDevice& device, VulkanResourceManager& resManager, VkExtent2D extent, 
     const std::vector<VulkanShaderResource> shaderRes, uint32_t maxLightNum) :
     ShadowRenderPass(device, resManager, extent, shaderRes, maxLightNum)
@@ -452,3 +487,16 @@ PointShadowRenderPass::PointShadowRenderPass(const VulkanDevice& device, VulkanR
     renderPipeline->prepare();
     renderPipeline->recreatePipeline(extent, *renderPass);
 }
+
+uint32_t PointShadowRenderPass::selectLod(const Scene* scene, const RenderGeometry& geometry, const glm::mat4& transform) const
+{
+    float projScale = getLodProjScale(glm::radians(90.0f), extent.height);
+    uint32_t lod = toU32(std::max<size_t>(geometry.lods.size(), 1) - 1);
+    uint32_t lightNum = 0;
+    for (const auto& [name, light] : scene->getPointLightMap()) {
+        if (lightNum++ == maxLightNum)
+            break;
+        lod = std::min(lod, selectRenderLod(geometry, transform, light->position, projScale, lodBias));
+    }
+    return lod;
+}
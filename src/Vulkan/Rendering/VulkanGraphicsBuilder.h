@@ -86,9 +86,21 @@ public:
 
     constexpr const std::vector<std::unique_ptr<VulkanImageView>>& getShadowDepths() const { return shadowDepths; }
 
+    void setLodBias(float bias) { lodBias = bias; }
+
 protected:
     uint32_t maxLightNum;
 
+    // LOD drawn for every RenderMesh. One draw renders a mesh into the maps of every light, so it
+    // gets the finest LOD any light needs, measured in shadow map texels from the light and not
+    // from the camera: a caster far from the camera can still cover many texels.
+    // Shadow maps tolerate coarser geometry than the G-buffer, hence the larger bias.
+    std::vector<uint32_t> meshLods;
+    float lodBias{ 2.0f };
+
+    // Finest LOD the lights of this pass need for a mesh, the coarsest LOD if none reaches it
+    virtual uint32_t selectLod(const Scene* scene, const RenderGeometry& geometry, const glm::mat4& transform) const = 0;
+
     std::vector<std::unique_ptr<VulkanImageView>> shadowDepths;
 
     PushConstantRaster pushConstants{};
@@ -99,6 +111,11 @@ class DirShadowRenderPass : public ShadowRenderPass
 public:
     DirShadowRenderPass(const VulkanDevice& device, VulkanResourceManager& resManager, VkExtent2D extent, 
         const std::vector<VulkanShaderResource> shaderRes, uint32_t maxLightNum, uint32_t maxCSMLevel);
+
+protected:
+    // The finest cascade the bounds reach decides
+    virtual uint32_t selectLod(const Scene* scene, const RenderGeometry& geometry, const glm::mat4& transform) const override;
+
 private:
     uint32_t maxCSMLevel;
 };
@@ -108,6 +125,10 @@ class PointShadowRenderPass : public ShadowRenderPass
 public:
     PointShadowRenderPass(const VulkanDevice& device, VulkanResourceManager& resManager, VkExtent2D extent,
         const std::vector<VulkanShaderResource> shaderRes, uint32_t maxLightNum);
+
+protected:
+    // Cube faces are 90 degree perspective views from the light position
+    virtual uint32_t selectLod(const Scene* scene, const RenderGeometry& geometry, const glm::mat4& transform) const override;
 };
 
 class VulkanGraphicsBuilder
@@ -119,6 +140,8 @@ public:
     void recreateGraphicsBuilder(const VkExtent2D extent);
 
     void update(float deltaTime, const Scene* scene);
+    // After a geometry defragmentation pass, see VulkanResourceManager::beginGeometryDefragmentationPass
+    void updateObjDescs();
     void draw(VulkanCommandBuffer& cmdBuf, glm::vec4 clearColor);
 
     constexpr const VulkanImageView* getOffscreenColor() const { return offscreenColor; }
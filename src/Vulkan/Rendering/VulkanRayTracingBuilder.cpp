@@ -2,9 +2,8 @@
 
 #include <cstring>
 
-VulkanRayTracingBuilder::VulkanRayTracingBuilder(
-	const VulkanDevice& device, VulkanResourceManager& resManager, const VulkanImageView& offscreenColor) :
-	device{ device }, resManager{ resManager }, offscreenColor{ &offscreenColor }
+VulkanRayTracingBuilder::VulkanRayTracingBuilder(const VulkanDevice& device, VulkanResourceManager& resManager) :
+	device{ device }, resManager{ resManager }
 {
 }
 
@@ -35,10 +34,13 @@ void VulkanRayTracingBuilder::recreateRayTracingBuilder(const VulkanImageView& o
 }
 
 void VulkanRayTracingBuilder::createRayTracingPipeline(
+	const VulkanImageView& offscreenColor,
 	const std::vector<VulkanShaderModule>& rtShaders, 
 	const VulkanDescriptorSetLayout& globalDescSetLayout,
 	const VulkanDescriptorSetLayout& lightDescSetLayout)
 {
+	this->offscreenColor = &offscreenColor;
+
 	std::vector<VulkanShaderResource> shaderResources{};
 	for (const auto& shader : rtShaders) {
 		shaderResources.insert(shaderResources.end(), shader.getShaderResources().begin(), shader.getShaderResources().end());
@@ -56,7 +58,7 @@ void VulkanRayTracingBuilder::createRayTracingPipeline(
 	VkWriteDescriptorSetAccelerationStructureKHR descASInfo{ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR };
 	descASInfo.accelerationStructureCount = 1;
 	descASInfo.pAccelerationStructures = &tlas.handle;
-	VkDescriptorImageInfo imageInfo{ {}, offscreenColor->getHandle(), VK_IMAGE_LAYOUT_GENERAL };
+	VkDescriptorImageInfo imageInfo{ {}, this->offscreenColor->getHandle(), VK_IMAGE_LAYOUT_GENERAL };
 
 	rtDescriptorSet = &resManager.requireDescriptorSet(*rtDescriptorSetLayouts[0], {}, {});
 	rtDescriptorSet->addWrite(0, &descASInfo);
@@ -149,8 +151,8 @@ void VulkanRayTracingBuilder::createRtShaderBindingTable()
 	// Helper to retrieve the handle data
 	auto getHandle = [&](int i) { return handles.data() + i * handleSize; };
 
-	// Map the SBT buffer and write in the handles.
-	auto* pSBTBuffer = rtSBTBuffer->map();
+	// The SBT buffer is persistently mapped, write in the handles.
+	auto* pSBTBuffer = rtSBTBuffer->getMappedData();
 	uint8_t* pData{ nullptr };
 	uint32_t handleIdx{ 0 };
 
@@ -174,7 +176,7 @@ void VulkanRayTracingBuilder::createRtShaderBindingTable()
 		pData += hitRegion.stride;
 	}
 
-	rtSBTBuffer->unmap();
+	rtSBTBuffer->flush();
 }
 
 void VulkanRayTracingBuilder::raytrace(
@@ -244,8 +246,10 @@ void VulkanRayTracingBuilder::buildBlas(const std::vector<BlasInput>& input, VkB
 	std::vector<uint32_t> indices;  // Indices of the BLAS to create
 	VkDeviceSize batchSize{ 0 };
 	VkDeviceSize batchLimit{ 256'000'000 };  // 256 MB
-	auto& commandPool = device.getCommandPool();
+	auto& commandPool = resManager.getCommandPool();
 	auto& queue = device.getGraphicsQueue();
+	// The geometry may still be uploading, the builds have to come after it on the queue
+	resManager.acquireUploads();
 	for (uint32_t i = 0; i < blasNum; i++)
 	{
 		indices.push_back(i);
@@ -378,7 +382,7 @@ void VulkanRayTracingBuilder::buildTlas(
 	uint32_t countInstance = toU32(instances.size());
 
 	// Command buffer to create the TLAS
-	auto& commandPool = device.getCommandPool();
+	auto& commandPool = resManager.getCommandPool();
 	auto commandBuffer = commandPool.beginSingleTimeCommands(); //begin cmdbuffer
 
 	// Create a buffer holding the actual instance data (matrices++) for use by the AS builder
@@ -402,7 +406,8 @@ void VulkanRayTracingBuilder::buildTlas(
 	VulkanBuffer* scratchBuffer = nullptr;
 	cmdCreateTlas(commandBuffer->getHandle(), countInstance, instBufferAddr, scratchBuffer, flags, update, motion);
 
-	// Finalizing and destroying temporary data
+	// Finalizing and destroying temporary data, the upload of the instances goes first
+	resManager.acquireUploads();
 	commandPool.endSingleTimeCommands(*commandBuffer, device.getGraphicsQueue());  // end cmdbuffer
 
 	resManager.destroyBuffer(scratchBuffer);
@@ -415,7 +420,7 @@ void VulkanRayTracingBuilder::cmdCreateTlas(
 	VkDeviceAddress instBufferAddr, 
 	VulkanBuffer*& scratchBuffer, 
 	VkBuildAccelerationStructureFlagsKHR flags, 
-	bool update, bool motion)
+	bool update, bool /*motion*/)
 {
 	// Wraps a device pointer to the above uploaded instances.
 	VkAccelerationStructureGeometryInstancesDataKHR instancesVk{ VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR };
@@ -42,12 +42,15 @@ struct PushConstantRayTracing {
 class VulkanRayTracingBuilder
 {
 public:
-	VulkanRayTracingBuilder(const VulkanDevice& device, VulkanResourceManager& resManager, const VulkanImageView& offscreenColor);
+	// Builds on the command pool of resManager, so a loading thread can build the acceleration structures
+	// of its scene. The pipeline is created later, with the image it traces into.
+	VulkanRayTracingBuilder(const VulkanDevice& device, VulkanResourceManager& resManager);
 	~VulkanRayTracingBuilder();
 
 	void recreateRayTracingBuilder(const VulkanImageView& offscreenColor);
 
 	void createRayTracingPipeline(
+		const VulkanImageView& offscreenColor,
 		const std::vector<VulkanShaderModule>& rtShaders, 
 		const VulkanDescriptorSetLayout& globalDescSetLayout,
 		const VulkanDescriptorSetLayout& lightDescSetLayout);
@@ -90,7 +93,7 @@ public:
 private:
 	const VulkanDevice& device;
 	VulkanResourceManager& resManager;
-	const VulkanImageView* offscreenColor;
+	const VulkanImageView* offscreenColor{ nullptr };
 
 	std::vector<VulkanAccelerationStructure> blasList;
 	VulkanAccelerationStructure tlas;
@@ -100,6 +100,11 @@ void VulkanRenderContext::waitFrame() {
 	getActiveFrame().wait();
 }
 
+void VulkanRenderContext::waitFrames() {
+	for (auto& frameSyncObject : frameSyncObjects)
+		frameSyncObject.inFlightFences.wait();
+}
+
 void VulkanRenderContext::handleSurfaceChange() {
 
 	VkSurfaceCapabilitiesKHR surface_properties{};
@@ -38,6 +38,9 @@ public:
 
 	void waitFrame();
 
+	// Waits for every submitted frame, work on other queues keeps running
+	void waitFrames();
+
 	void handleSurfaceChange();
 
 	void recreateSwapChain(const VkExtent2D& extent);
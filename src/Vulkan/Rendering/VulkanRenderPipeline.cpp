@@ -48,8 +48,8 @@ void VulkanRenderPipeline::prepare()
     state.pipelineLayout = pipelineLayout.get();
     state.subpass = 0;
     state.stageInfos = stageInfos;
-    state.vertexBindingDescriptions = { Vertex::getBindingDescription() };
-    state.vertexAttributeDescriptions = Vertex::getAttributeDescriptions();
+    state.vertexBindingDescriptions = { PackedVertex::getBindingDescription() };
+    state.vertexAttributeDescriptions = PackedVertex::getAttributeDescriptions();
 }
 
 void VulkanRenderPipeline::recreatePipeline(const VkExtent2D extent, const VulkanRenderPass& renderPass)
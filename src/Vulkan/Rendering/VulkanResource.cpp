@@ -1,6 +1,178 @@
 #include "VulkanResource.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
+#include <queue>
+#include <set>
+#include <unordered_map>
+
+#include "Utils/Hash.h"
+#include "Utils/PhaseClock.h"
+#include "Utils/ThreadPool.h"
+
+namespace {
+    // Shaders read geometry through buffer references, which assume 16 byte aligned addresses
+    constexpr VkDeviceSize BUFFER_REFERENCE_ALIGNMENT = 16;
+
+    // 16-bit indices whenever vertexNum fits, 32-bit otherwise.
+    // 0xFFFF is the primitive restart value of UINT16 buffers and never an ordinary index.
+    std::vector<uint8_t> packIndices(const std::vector<uint32_t>& indices, size_t vertexNum, VkIndexType& indexType)
+    {
+        std::vector<uint8_t> bytes;
+        if (vertexNum <= UINT16_MAX) {
+            std::vector<uint16_t> indices16(indices.begin(), indices.end());
+            // Shaders fetch 16-bit indices in pairs, keep the last pair inside the buffer
+            if (indices16.size() % 2 != 0)
+                indices16.push_back(0);
+            indexType = VK_INDEX_TYPE_UINT16;
+            bytes.resize(indices16.size() * sizeof(uint16_t));
+            memcpy(bytes.data(), indices16.data(), bytes.size());
+        }
+        else {
+            indexType = VK_INDEX_TYPE_UINT32;
+            bytes.resize(indices.size() * sizeof(uint32_t));
+            memcpy(bytes.data(), indices.data(), bytes.size());
+        }
+        return bytes;
+    }
+
+    VkDeviceSize getIndexSize(VkIndexType indexType)
+    {
+        return indexType == VK_INDEX_TYPE_UINT16 ? 2 : 4;
+    }
+
+    // Encoded bytes of a texture, in memory or read into fileBytes
+    struct TextureBytes
+    {
+        const char* ptr{ nullptr };
+        size_t length{ 0 };
+
+        const char* data() const { return ptr; }
+        size_t size() const { return length; }
+    };
+
+    TextureBytes getTextureBytes(const char* filename, const EmbeddedImage* embedded, std::vector<char>& fileBytes)
+    {
+        if (embedded && embedded->data)
+            return { reinterpret_cast<const char*>(embedded->data), embedded->size };
+        fileBytes = readFile(filename);
+        return { fileBytes.data(), fileBytes.size() };
+    }
+
+    // Absolute, with . and .. and symlinks of existing parents resolved
+    std::string normalizeTexturePath(const char* filename)
+    {
+        std::error_code ec;
+        auto path = std::filesystem::weakly_canonical(filename, ec);
+        if (ec)
+            path = std::filesystem::path(filename).lexically_normal();
+        return path.generic_string();
+    }
+
+    void computeBounds(const std::vector<Vertex>& vertices, glm::vec3& center, float& radius)
+    {
+        center = glm::vec3(0.0f);
+        radius = 0.0f;
+        if (vertices.empty())
+            return;
+
+        glm::vec3 minPos = vertices[0].pos, maxPos = vertices[0].pos;
+        for (const auto& vertex : vertices) {
+            minPos = glm::min(minPos, vertex.pos);
+            maxPos = glm::max(maxPos, vertex.pos);
+        }
+        center = (minPos + maxPos) * 0.5f;
+        for (const auto& vertex : vertices)
+            radius = std::max(radius, glm::length(vertex.pos - center));
+    }
+
+    float computeUvDensity(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+    {
+        double area = 0.0, uvArea = 0.0;
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            const auto& a = vertices[indices[i]];
+            const auto& b = vertices[indices[i + 1]];
+            const auto& c = vertices[indices[i + 2]];
+            area += glm::length(glm::cross(b.pos - a.pos, c.pos - a.pos));
+            glm::vec2 uv1 = b.texCoord - a.texCoord, uv2 = c.texCoord - a.texCoord;
+            uvArea += std::abs(uv1.x * uv2.y - uv1.y * uv2.x);
+        }
+        return area > 0.0 ? static_cast<float>(std::sqrt(uvArea / area)) : 0.0f;
+    }
+
+    float getMaxScale(const glm::mat4& transform)
+    {
+        return std::max(glm::length(glm::vec3(transform[0])),
+            std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+    }
+
+    // Left, right, bottom and top planes of the frustum, they meet at the eye so nothing behind it passes
+    bool isSphereInFrustum(const glm::mat4& viewProj, const glm::vec3& center, float radius)
+    {
+        glm::vec4 w{ viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3] };
+        for (int axis = 0; axis < 2; ++axis) {
+            glm::vec4 row{ viewProj[0][axis], viewProj[1][axis], viewProj[2][axis], viewProj[3][axis] };
+            for (const auto& plane : { w + row, w - row }) {
+                if (glm::dot(glm::vec3(plane), center) + plane.w < -radius * glm::length(glm::vec3(plane)))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // First level at most TEXTURE_STREAMING_COARSE_SIZE texels wide and high
+    uint32_t getCoarseLevel(const TextureMipChain& chain)
+    {
+        uint32_t level = 0;
+        while (level + 1 < chain.levels.size() &&
+            std::max(chain.extent.width >> level, chain.extent.height >> level) > TEXTURE_STREAMING_COARSE_SIZE)
+            ++level;
+        return level;
+    }
+}
+
+uint32_t selectRenderLod(const RenderGeometry& geometry, const glm::mat4& transform, 
+    const glm::vec3& viewPos, float projScale, float lodBias)
+{
+    if (geometry.lods.size() < 2)
+        return 0;
+
+    float scale = getMaxScale(transform);
+    glm::vec3 center = transform * glm::vec4(geometry.boundsCenter, 1.0f);
+    float distance = glm::length(center - viewPos) - geometry.boundsRadius * scale;
+    if (distance <= 0.0f)
+        return 0;
+
+    float maxError = LOD_PIXEL_ERROR * std::exp2(lodBias) * distance / (projScale * scale);
+    uint32_t lod = 0;
+    while (lod + 1 < geometry.lods.size() && geometry.lods[lod + 1].error <= maxError)
+        ++lod;
+    return lod;
+}
+
+uint32_t selectShadowLod(const RenderGeometry& geometry, const glm::mat4& transform,
+    const glm::mat4& lightSpace, VkExtent2D extent, float lodBias)
+{
+    float scale = getMaxScale(transform);
+    glm::vec3 center = transform * glm::vec4(geometry.boundsCenter, 1.0f);
+    if (!isSphereInFrustum(lightSpace, center, geometry.boundsRadius * scale))
+        return UINT32_MAX;
+    if (geometry.lods.size() < 2)
+        return 0;
+
+    // Clip space spans 2 units across the map
+    float texelsPerUnit = 0.5f * std::max(
+        extent.width * glm::length(glm::vec3(lightSpace[0][0], lightSpace[1][0], lightSpace[2][0])),
+        extent.height * glm::length(glm::vec3(lightSpace[0][1], lightSpace[1][1], lightSpace[2][1])));
+    float maxError = LOD_PIXEL_ERROR * std::exp2(lodBias) / (texelsPerUnit * scale);
+    uint32_t lod = 0;
+    while (lod + 1 < geometry.lods.size() && geometry.lods[lod + 1].error <= maxError)
+        ++lod;
+    return lod;
+}
 
 VulkanResourceManager::VulkanResourceManager(const VulkanDevice& device, VulkanCommandPool& commandPool):
     device{device}, commandPool{commandPool}
@@ -21,16 +193,37 @@ VulkanResourceManager::VulkanResourceManager(const VulkanDevice& device, VulkanC
     requireDescriptorPool(poolSizes, 1000);
 
     defaultSampler = createSampler();
+
+    uploads = std::make_unique<VulkanUploadContext>(device);
+
+    VkBufferUsageFlags geometryFlags = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    VkBufferUsageFlags rayTracingFlags = // used also for building acceleration structures
+        geometryFlags | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+    // Whole vertices, so draws can pass the offset as vertexOffset
+    vertexArena = std::make_unique<VulkanGeometryArena>(device, rayTracingFlags | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        std::lcm<VkDeviceSize>(sizeof(PackedVertex), BUFFER_REFERENCE_ALIGNMENT));
+    // A multiple of both index sizes, for firstIndex
+    indexArena = std::make_unique<VulkanGeometryArena>(device, rayTracingFlags | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        BUFFER_REFERENCE_ALIGNMENT);
+    dataArena = std::make_unique<VulkanGeometryArena>(device, geometryFlags, BUFFER_REFERENCE_ALIGNMENT);
 }
 
 VulkanResourceManager::~VulkanResourceManager()
 {
+    // Waits for the copies into the resources below
+    uploads.reset();
+
     descriptorSetSet.clear();
 
     descriptorPools.clear();
 
     bufferSet.clear();
+    vertexArena.reset();
+    indexArena.reset();
+    dataArena.reset();
 
+    pendingTextures.clear();
+    retiredTextures.clear();
     textureMap.clear();
     cubeMapTextureMap.clear();
 
@@ -48,25 +241,31 @@ RenderMeshID VulkanResourceManager::requireRenderMesh(
     mesh.pipeline = pipeline;
     mesh.descSetLayout = &descSetLayout;
 
-    VkBufferUsageFlags flag = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
-    VkBufferUsageFlags rayTracingFlags = // used also for building acceleration structures 
-        flag | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    auto packedVertices = packVertices(vertices);
+    auto packedIndices = packIndices(indices, vertices.size(), mesh.indexType);
+    uploadToArenas({
+        { vertexArena.get(), packedVertices.data(), sizeof(PackedVertex) * packedVertices.size(), &mesh.vertexBuffer },
+        { indexArena.get(), packedIndices.data(), packedIndices.size(), &mesh.indexBuffer },
+        { dataArena.get(), &mat, sizeof(mat), &mesh.matBuffer } });
 
-    auto& vertexBuffer = requireBufferWithData(vertices, 
-        rayTracingFlags | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    auto& indexBuffer = requireBufferWithData(indices, 
-        rayTracingFlags | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    auto& matBuffer = requireBufferWithData(&mat, sizeof(mat),
-        flag | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    mesh.vertexBuffer = vertexBuffer.getBufferInfo();
     mesh.vertexNum = toU32(vertices.size());
-
-    mesh.indexBuffer = indexBuffer.getBufferInfo();
     mesh.indexNum = toU32(indices.size());
-    mesh.indexType = VK_INDEX_TYPE_UINT32;
-
-    mesh.matBuffer = matBuffer.getBufferInfo();
+    mesh.vertexOffset = static_cast<int32_t>(mesh.vertexBuffer.offset / sizeof(PackedVertex));
+    mesh.firstIndex = toU32(mesh.indexBuffer.offset / getIndexSize(mesh.indexType));
+
+    RenderGeometry geometry{};
+    geometry.indexType = mesh.indexType;
+    geometry.indexNum = mesh.indexNum;
+    geometry.vertexNum = mesh.vertexNum;
+    geometry.vertexBuffer = mesh.vertexBuffer;
+    geometry.indexBuffer = mesh.indexBuffer;
+    geometry.matBuffer = mesh.matBuffer;
+    geometry.vertexOffset = mesh.vertexOffset;
+    geometry.firstIndex = mesh.firstIndex;
+    geometry.lods = { { 0, geometry.indexNum, 0.0f } };
+    computeBounds(vertices, geometry.boundsCenter, geometry.boundsRadius);
+    geometries.emplace_back(geometry);
+    mesh.geometry = geometries.size() - 1;
 
     VkDeviceSize uniformBufferSize = 0;
     for (const auto& [binding, bufferSizeInfo] : bufferSizeInfos) {
@@ -96,10 +295,13 @@ RenderMeshID VulkanResourceManager::requireRenderMesh(
         }
     }
 
+    // The references go to the geometry, releaseRenderGeometry drops them
     for (const auto& [binding, textureInfos] : textureInfosMap) {
         mesh.textures[binding] = {};
         for (const auto& [arrayIndex, info] : textureInfos) {
-            mesh.textures[binding].emplace(arrayIndex, &requireTexture(info.filepath, info.sampler));
+            TextureID id = requireTexture(info.filepath, info.sampler, info.embedded);
+            addGeometryTexture(geometries[mesh.geometry], id);
+            mesh.textures[binding].emplace(arrayIndex, textureMap[id].get());
         }
     }
 
@@ -126,15 +328,26 @@ RenderMeshID VulkanResourceManager::requireRenderMesh(
     const GltfMaterial& mat, 
     const std::vector<RenderTexture>& textures)
 {
-    RenderMesh mesh{};
+    return requireRenderMesh(requireRenderGeometry(vertices, indices, mat, textures));
+}
+
+RenderGeometryID VulkanResourceManager::requireRenderGeometry(
+    const std::vector<Vertex>& vertices,
+    const std::vector<uint32_t>& indices,
+    const GltfMaterial& mat,
+    const std::vector<RenderTexture>& textures,
+    const std::vector<MeshLod>& lods)
+{
+    RenderGeometry geometry{};
 
     auto texturedMat = mat;
     auto setTexture = [&](int& textureId)
     {
         if (textureId > -1) {
             auto& tex = textures[textureId];
-            requireTexture(tex.filepath, tex.sampler);
-            textureId = textureMap.size() - 1;
+            TextureID id = acquireTexture(tex.filepath, tex.sampler, tex.embedded);
+            addGeometryTexture(geometry, id);
+            textureId = static_cast<int>(id);
         }
     };
     {
@@ -153,43 +366,108 @@ RenderMeshID VulkanResourceManager::requireRenderMesh(
 
     std::vector<int32_t> matIndices(indices.size() / 3, 0);
 
-    VkBufferUsageFlags flag = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
-    VkBufferUsageFlags rayTracingFlags = // used also for building acceleration structures 
-        flag | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    // One index buffer for all LODs, the full resolution range first for ray tracing
+    geometry.lods = { { 0, toU32(indices.size()), 0.0f } };
+    std::vector<uint32_t> lodIndices{};
+    const std::vector<uint32_t>* allIndices = &indices;
+    if (!lods.empty()) {
+        lodIndices = indices;
+        for (const auto& lod : lods) {
+            geometry.lods.push_back({ toU32(lodIndices.size()), toU32(lod.indices.size()), lod.error });
+            lodIndices.insert(lodIndices.end(), lod.indices.begin(), lod.indices.end());
+        }
+        allIndices = &lodIndices;
+    }
+    computeBounds(vertices, geometry.boundsCenter, geometry.boundsRadius);
+    geometry.uvDensity = computeUvDensity(vertices, indices);
+
+    auto packedVertices = packVertices(vertices);
+    auto packedIndices = packIndices(*allIndices, vertices.size(), geometry.indexType);
+    std::vector<ArenaUpload> arenaUploads{
+        { vertexArena.get(), packedVertices.data(), sizeof(PackedVertex) * packedVertices.size(), &geometry.vertexBuffer },
+        { indexArena.get(), packedIndices.data(), packedIndices.size(), &geometry.indexBuffer },
+        { dataArena.get(), &texturedMat, sizeof(texturedMat), &geometry.matBuffer },
+        { dataArena.get(), matIndices.data(), sizeof(int32_t) * matIndices.size(), &geometry.matIndicesBuffer } };
+
+    uploadToArenas(arenaUploads);
+
+    geometry.vertexNum = toU32(vertices.size());
+    geometry.indexNum = toU32(indices.size());
+    geometry.vertexOffset = static_cast<int32_t>(geometry.vertexBuffer.offset / sizeof(PackedVertex));
+    geometry.firstIndex = toU32(geometry.indexBuffer.offset / getIndexSize(geometry.indexType));
+
+    geometries.emplace_back(geometry);
+    return geometries.size() - 1;
+}
 
-    auto& vertexBuffer = requireBufferWithData(vertices,
-        rayTracingFlags | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    auto& indexBuffer = requireBufferWithData(indices,
-        rayTracingFlags | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    auto& matBuffer = requireBufferWithData(&texturedMat, sizeof(texturedMat), 
-        flag | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    auto& matIndicesBuffer = requireBufferWithData(matIndices,
-        flag | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+RenderMeshID VulkanResourceManager::requireRenderMesh(RenderGeometryID geometryID)
+{
+    const auto& geometry = geometries[geometryID];
 
-    mesh.vertexBuffer = vertexBuffer.getBufferInfo();
-    mesh.vertexNum = toU32(vertices.size());
+    RenderMesh mesh{};
+    mesh.geometry = geometryID;
 
-    mesh.indexBuffer = indexBuffer.getBufferInfo();
-    mesh.indexNum = toU32(indices.size());
-    mesh.indexType = VK_INDEX_TYPE_UINT32;
+    mesh.vertexBuffer = geometry.vertexBuffer;
+    mesh.vertexNum = geometry.vertexNum;
 
-    mesh.matBuffer = matBuffer.getBufferInfo();
-    mesh.matIndicesBuffer = matIndicesBuffer.getBufferInfo();
+    mesh.indexBuffer = geometry.indexBuffer;
+    mesh.indexNum = geometry.indexNum;
+    mesh.indexType = geometry.indexType;
+
+    mesh.matBuffer = geometry.matBuffer;
+    mesh.matIndicesBuffer = geometry.matIndicesBuffer;
+    mesh.vertexOffset = geometry.vertexOffset;
+    mesh.firstIndex = geometry.firstIndex;
 
     meshes.emplace_back(std::move(mesh));
     return meshes.size() - 1;
 }
 
+void VulkanResourceManager::releaseRenderGeometry(RenderGeometryID id)
+{
+    auto& geometry = geometries[id];
+
+    // The legacy meshes have no triangle material indices
+    std::pair<VulkanGeometryArena*, VkDescriptorBufferInfo*> ranges[] = {
+        { vertexArena.get(), &geometry.vertexBuffer },
+        { indexArena.get(), &geometry.indexBuffer },
+        { dataArena.get(), &geometry.matBuffer },
+        { dataArena.get(), &geometry.matIndicesBuffer } };
+    for (auto& [arena, range] : ranges) {
+        if (range->buffer != VK_NULL_HANDLE)
+            arena->free(*range);
+        *range = {};
+    }
+
+    for (TextureID texture : geometry.textures)
+        releaseTexture(texture);
+    geometry.textures.clear();
+
+    geometry.indexNum = 0;
+    geometry.vertexNum = 0;
+    geometry.lods.clear();
+}
+
+void VulkanResourceManager::addGeometryTexture(RenderGeometry& geometry, TextureID id)
+{
+    // A texture in several slots of the material is listed, and referenced, once
+    if (std::find(geometry.textures.begin(), geometry.textures.end(), id) == geometry.textures.end())
+        geometry.textures.push_back(id);
+    else
+        releaseTexture(id);
+}
+
 Skybox& VulkanResourceManager::requireSkybox(
     const std::vector<Vertex>& vertices, 
     const std::vector<uint32_t>& indices, 
     const std::vector<std::string>& filenames, 
     VkSampler sampler)
 {
-    auto& vertexBuffer = requireBufferWithData(vertices,
+    auto& vertexBuffer = requireBufferWithData(packVertices(vertices),
         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    auto& indexBuffer = requireBufferWithData(indices,
-        VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VkIndexType indexType;
+    auto& indexBuffer = requireIndexBuffer(indices, vertices.size(),
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexType);
     auto& cubeMap = requireCubeMapTexture(filenames, sampler);
 
     skybox = std::make_unique<Skybox>();
@@ -200,7 +478,7 @@ Skybox& VulkanResourceManager::requireSkybox(
     
     skybox->indexBuffer = indexBuffer.getBufferInfo();
     skybox->indexNum = toU32(indices.size());
-    skybox->indexType = VK_INDEX_TYPE_UINT32;
+    skybox->indexType = indexType;
 
     return *skybox;
 }
@@ -278,16 +556,78 @@ SceneData VulkanResourceManager::requireSceneData(const VulkanDescriptorSetLayou
 
 VulkanBuffer& VulkanResourceManager::requireBufferWithData(const void* data, VkDeviceSize bufferSize, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties)
 {
-    auto stagingBuffer = std::make_unique<VulkanBuffer>(device, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-    stagingBuffer->update(data, bufferSize);
     auto& buffer = requireBuffer(bufferSize, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties);
-    commandPool.copyBuffer(*stagingBuffer, buffer, bufferSize, device.getGraphicsQueue());
+    uploads->uploadBuffer(data, bufferSize, buffer);
 
     return buffer;
 }
 
+VulkanBuffer& VulkanResourceManager::requireIndexBuffer(const std::vector<uint32_t>& indices, size_t vertexNum, 
+    VkBufferUsageFlags usage, VkIndexType& indexType)
+{
+    return requireBufferWithData(packIndices(indices, vertexNum, indexType), usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+void VulkanResourceManager::uploadToArenas(const std::vector<ArenaUpload>& arenaUploads)
+{
+    for (const auto& upload : arenaUploads) {
+        *upload.range = upload.arena->allocate(upload.size);
+        uploads->uploadBuffer(upload.data, upload.size, upload.arena->getBuffer(upload.range->buffer), upload.range->offset);
+    }
+}
+
+uint64_t VulkanResourceManager::submitUploads()
+{
+    return uploads->submit();
+}
+
+void VulkanResourceManager::acquireUploads()
+{
+    uploads->acquire(uploads->submit());
+}
+
+void VulkanResourceManager::flushUploads()
+{
+    uploads->flush();
+}
+
+bool VulkanResourceManager::beginGeometryDefragmentationPass()
+{
+    // The copies of the pass have to see what the uploads wrote
+    flushUploads();
+
+    std::vector<VulkanBufferMove> moves;
+    if (!device.getAllocator().beginDefragmentationPass(commandPool, device.getGraphicsQueue(), moves))
+        return false;
+
+    std::unordered_map<VkBuffer, VkBuffer> movedHandles;
+    for (const auto& move : moves)
+        movedHandles[move.oldBuffer] = move.buffer->getHandle();
+    auto follow = [&movedHandles](VkDescriptorBufferInfo& range) {
+        auto it = movedHandles.find(range.buffer);
+        if (it != movedHandles.end())
+            range.buffer = it->second;
+    };
+    for (auto& geometry : geometries) {
+        follow(geometry.vertexBuffer);
+        follow(geometry.indexBuffer);
+        follow(geometry.matBuffer);
+        follow(geometry.matIndicesBuffer);
+    }
+    for (auto& mesh : meshes) {
+        follow(mesh.vertexBuffer);
+        follow(mesh.indexBuffer);
+        follow(mesh.matBuffer);
+        follow(mesh.matIndicesBuffer);
+    }
+    return true;
+}
+
+void VulkanResourceManager::endGeometryDefragmentationPass()
+{
+    device.getAllocator().endDefragmentationPass();
+}
+
 VulkanBuffer& VulkanResourceManager::requireBuffer(VkDeviceSize bufferSize, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties)
 {
     auto buffer = new VulkanBuffer(device, bufferSize, usage, properties);
@@ -314,23 +654,418 @@ VulkanDescriptorPool& VulkanResourceManager::requireDescriptorPool(const std::ve
     return *descriptorPool;
 }
 
-VulkanTexture& VulkanResourceManager::requireTexture(const char* filename, VkSampler sampler)
+TextureID VulkanResourceManager::acquireTexture(const char* filename, VkSampler sampler, const EmbeddedImage* embedded)
 {
-    auto texture = new VulkanTexture(device, filename, sampler, commandPool, device.getGraphicsQueue());
-    textureMap.emplace_back(texture);
-    return *texture;
+    ++textureCacheStats.requests;
+
+    TexturePathKey pathKey{ normalizeTexturePath(filename), sampler };
+    auto pathIt = texturePathCache.find(pathKey);
+    if (pathIt != texturePathCache.end())
+        return retainTexture(pathIt->second, textureCacheStats.pathHits);
+
+    // Copies of an image under other names share one texture as well
+    std::vector<char> fileBytes;
+    auto bytes = getTextureBytes(filename, embedded, fileBytes);
+    TextureContentKey contentKey{ hashBytes(bytes.data(), bytes.size()), bytes.size(), sampler };
+    auto contentIt = textureContentCache.find(contentKey);
+    if (contentIt != textureContentCache.end()) {
+        TextureID id = contentIt->second;
+        textureEntries[id].paths.push_back(pathKey);
+        texturePathCache.emplace(std::move(pathKey), id);
+        return retainTexture(id, textureCacheStats.contentHits);
+    }
+
+    auto mips = std::make_unique<TextureMipChain>(decodeTextureMipChain(bytes.data(), bytes.size()));
+    TextureID id = addStreamedTexture(std::move(mips), sampler, 1);
+    cacheTexture(id, std::move(pathKey), contentKey);
+    return id;
+}
+
+void VulkanResourceManager::loadTextures(const std::vector<Texture>& textures, VkSampler sampler, ThreadPool& pool)
+{
+    struct TextureFile
+    {
+        const Texture* texture;
+        TexturePathKey pathKey;
+        std::vector<char> fileBytes;
+        TextureBytes bytes;
+        TextureContentKey contentKey;
+        VkDeviceSize stagingSize;
+        std::unique_ptr<TextureMipChain> mips;
+        double mipSeconds;
+    };
+
+    PhaseClock clock;
+
+    std::vector<TextureFile> files;
+    std::set<TexturePathKey> listed;
+    for (const auto& texture : textures) {
+        TexturePathKey pathKey{ normalizeTexturePath(texture.path.c_str()), sampler };
+        if (texturePathCache.count(pathKey) == 0 && listed.insert(pathKey).second)
+            files.push_back({ &texture, std::move(pathKey) });
+    }
+
+    pool.parallelFor(files.size(), [&](size_t i) {
+        auto& file = files[i];
+        file.bytes = getTextureBytes(file.texture->path.c_str(), &file.texture->embedded, file.fileBytes);
+        file.contentKey = { hashBytes(file.bytes.data(), file.bytes.size()), file.bytes.size(), sampler };
+        file.stagingSize = getTextureImageSize(file.bytes.data(), file.bytes.size());
+    });
+    clock.lap(textureLoadTimings.read);
+
+    // A copy of a cached or an earlier file is left to acquireTexture, which finds it by content
+    std::vector<TextureFile*> decodes;
+    std::set<TextureContentKey> contents;
+    for (auto& file : files) {
+        if (textureContentCache.count(file.contentKey) == 0 && contents.insert(file.contentKey).second)
+            decodes.push_back(&file);
+    }
+
+    // Decode a batch on all threads, then upload its coarse levels
+    for (size_t begin = 0; begin < decodes.size(); ) {
+        size_t end = begin + 1;
+        VkDeviceSize batchSize = decodes[begin]->stagingSize;
+        while (end < decodes.size() && batchSize + decodes[end]->stagingSize <= TEXTURE_STAGING_BUDGET)
+            batchSize += decodes[end++]->stagingSize;
+
+        pool.parallelFor(end - begin, [&](size_t i) {
+            auto& file = *decodes[begin + i];
+            file.mips = std::make_unique<TextureMipChain>(
+                decodeTextureMipChain(file.bytes.data(), file.bytes.size(), &file.mipSeconds));
+            file.fileBytes = {};
+        });
+        clock.lap(textureLoadTimings.decode);
+
+        for (size_t i = begin; i < end; ++i) {
+            auto& file = *decodes[i];
+            textureLoadTimings.mips += file.mipSeconds;
+            TextureID id = addStreamedTexture(std::move(file.mips), sampler, 0);
+            cacheTexture(id, std::move(file.pathKey), file.contentKey);
+        }
+        clock.lap(textureLoadTimings.upload);
+        begin = end;
+    }
+}
+
+void VulkanResourceManager::releaseTexture(TextureID id)
+{
+    if (id >= textureEntries.size() || textureEntries[id].refCount == 0) {
+        throw std::runtime_error("texture released more often than acquired!");
+    }
+
+    auto& entry = textureEntries[id];
+    if (--entry.refCount > 0)
+        return;
+
+    for (const auto& path : entry.paths)
+        texturePathCache.erase(path);
+    if (entry.cached)
+        textureContentCache.erase(entry.content);
+
+    --textureCacheStats.textures;
+    textureCacheStats.residentBytes -= entry.size;
+    if (entry.mips) {
+        --textureStreamingStats.textures;
+        textureStreamingStats.hostBytes -= getMipChainSize(*entry.mips);
+        textureStreamingStats.residentBytes -= getMipChainSize(*entry.mips, entry.firstLevel);
+    }
+
+    // The GPU may still copy into a replacement
+    for (auto& pending : pendingTextures) {
+        if (pending.id == id)
+            pending.released = true;
+    }
+
+    textureMap[id].reset();
+    entry = {};
+    freeTextureSlots.push_back(id);
+}
+
+TextureID VulkanResourceManager::requireTexture(const char* filename, VkSampler sampler, const EmbeddedImage* embedded)
+{
+    TextureID id = acquireTexture(filename, sampler, embedded);
+    auto& entry = textureEntries[id];
+    if (entry.mips && !entry.pinned) {
+        entry.pinned = true;
+        // Replaced and uploaded right here, a swap in swapPendingTextures would retire the texture the caller keeps.
+        // A replacement still uploading is dropped, the frames sample the current one until their descriptors change.
+        if (entry.firstLevel > 0 || entry.streaming) {
+            for (auto& pending : pendingTextures) {
+                if (pending.id == id)
+                    pending.released = true;
+            }
+            entry.streaming = false;
+            auto texture = createStreamedTexture(id, 0);
+            // Also completes any copy into the current one, which the next updateTextureStreaming destroys
+            flushUploads();
+            retiredTextures.push_back(std::move(textureMap[id]));
+            textureMap[id] = std::move(texture);
+            streamedTextures.push_back(id);
+        }
+    }
+    return id;
 }
 
 VulkanTexture& VulkanResourceManager::requireTexture(const void* data, size_t size, VkExtent3D extent, VkFormat format, VkSampler sampler)
 {
-    auto texture = new VulkanTexture(device, data, size, extent, format, sampler, commandPool, device.getGraphicsQueue());
-    textureMap.emplace_back(texture);
-    return *texture;
+    auto id = addTexture(std::make_unique<VulkanTexture>(device, data, size, extent, format, sampler, *uploads));
+    return *textureMap[id];
+}
+
+TextureID VulkanResourceManager::addTexture(std::unique_ptr<VulkanTexture> texture, uint32_t refCount)
+{
+    TextureID id = textureMap.size();
+    if (!freeTextureSlots.empty()) {
+        id = freeTextureSlots.back();
+        freeTextureSlots.pop_back();
+    }
+    else {
+        textureMap.emplace_back();
+        textureEntries.emplace_back();
+    }
+
+    auto& entry = textureEntries[id];
+    entry.refCount = refCount;
+    entry.size = texture->getMemorySize();
+    textureMap[id] = std::move(texture);
+
+    ++textureCacheStats.textures;
+    textureCacheStats.residentBytes += entry.size;
+    return id;
+}
+
+void VulkanResourceManager::cacheTexture(TextureID id, TexturePathKey pathKey, const TextureContentKey& contentKey)
+{
+    auto& entry = textureEntries[id];
+    entry.cached = true;
+    entry.content = contentKey;
+    entry.paths.push_back(pathKey);
+    texturePathCache.emplace(std::move(pathKey), id);
+    textureContentCache.emplace(contentKey, id);
+}
+
+TextureID VulkanResourceManager::retainTexture(TextureID id, uint32_t& hits)
+{
+    auto& entry = textureEntries[id];
+    if (entry.refCount > 0) {
+        ++hits;
+        textureCacheStats.savedBytes += entry.size;
+    }
+    ++entry.refCount;
+    return id;
+}
+
+TextureID VulkanResourceManager::addStreamedTexture(std::unique_ptr<TextureMipChain> mips, VkSampler sampler, uint32_t refCount)
+{
+    uint32_t level = getCoarseLevel(*mips);
+    TextureID id = addTexture(std::make_unique<VulkanTexture>(device, *mips, level, sampler, *uploads), refCount);
+
+    ++textureStreamingStats.textures;
+    textureStreamingStats.hostBytes += getMipChainSize(*mips);
+    textureStreamingStats.residentBytes += getMipChainSize(*mips, level);
+
+    auto& entry = textureEntries[id];
+    entry.firstLevel = level;
+    entry.wantedLevel = level;
+    entry.mips = std::move(mips);
+    return id;
+}
+
+void VulkanResourceManager::streamTexture(TextureID id, uint32_t firstLevel)
+{
+    auto texture = createStreamedTexture(id, firstLevel);
+    textureEntries[id].streaming = true;
+    pendingTextures.push_back({ id, std::move(texture) });
+}
+
+std::unique_ptr<VulkanTexture> VulkanResourceManager::createStreamedTexture(TextureID id, uint32_t firstLevel)
+{
+    auto& entry = textureEntries[id];
+    auto texture = std::make_unique<VulkanTexture>(device, *entry.mips, firstLevel,
+        textureMap[id]->getImageInfo().sampler, *uploads);
+
+    textureCacheStats.residentBytes -= entry.size;
+    entry.size = texture->getMemorySize();
+    textureCacheStats.residentBytes += entry.size;
+
+    auto uploaded = getMipChainSize(*entry.mips, firstLevel);
+    textureStreamingStats.residentBytes -= getMipChainSize(*entry.mips, entry.firstLevel);
+    textureStreamingStats.residentBytes += uploaded;
+    textureStreamingStats.uploadedBytes += uploaded;
+    entry.firstLevel = firstLevel;
+    return texture;
+}
+
+void VulkanResourceManager::swapPendingTextures()
+{
+    uint64_t visible = uploads->poll();
+    size_t kept = 0;
+    for (size_t i = 0; i < pendingTextures.size(); ++i) {
+        auto& pending = pendingTextures[i];
+        bool done = pending.uploadValue > 0 &&
+            (pending.released ? uploads->isComplete(pending.uploadValue) : pending.uploadValue <= visible);
+        if (!done) {
+            if (i != kept)
+                pendingTextures[kept] = std::move(pending);
+            ++kept;
+            continue;
+        }
+        if (pending.released)
+            continue;
+
+        textureEntries[pending.id].streaming = false;
+        ++textureStreamingStats.swaps;
+        // The descriptors still point at the old image until they are written again
+        retiredTextures.push_back(std::move(textureMap[pending.id]));
+        textureMap[pending.id] = std::move(pending.texture);
+        streamedTextures.push_back(pending.id);
+    }
+    pendingTextures.resize(kept);
+
+    textureStreamingStats.uploading = toU32(std::count_if(pendingTextures.begin(), pendingTextures.end(),
+        [](const PendingTexture& pending) { return !pending.released; }));
+}
+
+std::vector<TextureID> VulkanResourceManager::updateTextureStreaming(const glm::mat4& viewProj, const glm::vec3& viewPos, float projScale)
+{
+    // The frame that could still sample them has finished
+    retiredTextures.clear();
+    ++streamingFrame;
+    auto& stats = textureStreamingStats;
+    stats.uploadedBytes = 0;
+    stats.swaps = 0;
+
+    // Finest level a visible mesh shows of each texture: texels per pixel of a texture one texel wide
+    // is uvDensity * distance / (scale * projScale), each doubling of it skips a level
+    for (auto& entry : textureEntries)
+        entry.wantedLevel = UINT32_MAX;
+    for (const auto& mesh : meshes) {
+        const auto& geometry = geometries[mesh.geometry];
+        if (geometry.textures.empty() || geometry.uvDensity <= 0.0f)
+            continue;
+
+        float scale = getMaxScale(mesh.tranformMatrix);
+        glm::vec3 center = mesh.tranformMatrix * glm::vec4(geometry.boundsCenter, 1.0f);
+        float radius = geometry.boundsRadius * scale;
+        if (!isSphereInFrustum(viewProj, center, radius))
+            continue;
+
+        float distance = glm::length(center - viewPos) - radius;
+        float texelScale = distance > 0.0f ? geometry.uvDensity * distance / (scale * projScale) : 0.0f;
+        for (TextureID id : geometry.textures) {
+            auto& entry = textureEntries[id];
+            if (!entry.mips)
+                continue;
+            float texels = texelScale * float(std::max(entry.mips->extent.width, entry.mips->extent.height));
+            uint32_t level = texels > 1.0f ? static_cast<uint32_t>(std::log2(texels)) : 0;
+            entry.wantedLevel = std::min(entry.wantedLevel, level);
+            entry.lastSeenFrame = streamingFrame;
+        }
+    }
+
+    struct StreamPlan
+    {
+        TextureID id;
+        uint32_t coarseLevel;
+        uint32_t level;
+    };
+    std::vector<StreamPlan> plans;
+    VkDeviceSize plannedBytes = 0;
+    for (TextureID id = 0; id < textureEntries.size(); ++id) {
+        auto& entry = textureEntries[id];
+        if (!entry.mips)
+            continue;
+        uint32_t coarseLevel = getCoarseLevel(*entry.mips);
+        if (entry.pinned)
+            entry.wantedLevel = 0;
+        else
+            entry.wantedLevel = std::min(entry.wantedLevel, coarseLevel);
+        // Finer levels nothing asks for any more stay until the budget needs their memory
+        uint32_t level = std::min(entry.firstLevel, entry.wantedLevel);
+        plans.push_back({ id, coarseLevel, level });
+        plannedBytes += getMipChainSize(*entry.mips, level);
+    }
+
+    if (plannedBytes > stats.budget) {
+        // Levels finer than wanted go first, those of the textures unseen the longest before the rest
+        std::sort(plans.begin(), plans.end(), [this](const StreamPlan& a, const StreamPlan& b) {
+            return textureEntries[a.id].lastSeenFrame < textureEntries[b.id].lastSeenFrame;
+        });
+        for (auto& plan : plans) {
+            if (plannedBytes <= stats.budget)
+                break;
+            const auto& entry = textureEntries[plan.id];
+            if (plan.level < entry.wantedLevel) {
+                plannedBytes -= getMipChainSize(*entry.mips, plan.level) - getMipChainSize(*entry.mips, entry.wantedLevel);
+                plan.level = entry.wantedLevel;
+            }
+        }
+
+        // Then wanted levels, always the largest finest level of all textures
+        std::priority_queue<std::pair<VkDeviceSize, size_t>> finest;
+        auto pushFinest = [&](size_t i) {
+            const auto& plan = plans[i];
+            const auto& entry = textureEntries[plan.id];
+            if (!entry.pinned && plan.level < plan.coarseLevel)
+                finest.push({ VkDeviceSize(entry.mips->levels[plan.level].size()), i });
+        };
+        for (size_t i = 0; i < plans.size(); ++i)
+            pushFinest(i);
+        while (plannedBytes > stats.budget && !finest.empty()) {
+            auto [bytes, i] = finest.top();
+            finest.pop();
+            plannedBytes -= bytes;
+            ++plans[i].level;
+            pushFinest(i);
+        }
+    }
+
+    // Coarser textures first, they free memory, then finer ones up to the upload limit, the largest step first
+    std::vector<const StreamPlan*> upgrades;
+    stats.belowWanted = 0;
+    for (const auto& plan : plans) {
+        const auto& entry = textureEntries[plan.id];
+        // One replacement at a time
+        if (entry.streaming)
+            continue;
+        if (plan.level > entry.firstLevel)
+            streamTexture(plan.id, plan.level);
+        else if (plan.level < entry.firstLevel)
+            upgrades.push_back(&plan);
+    }
+    std::sort(upgrades.begin(), upgrades.end(), [this](const StreamPlan* a, const StreamPlan* b) {
+        return textureEntries[a->id].firstLevel - a->level > textureEntries[b->id].firstLevel - b->level;
+    });
+    VkDeviceSize upgradedBytes = 0;
+    for (const auto* plan : upgrades) {
+        if (upgradedBytes >= TEXTURE_STREAMING_UPLOAD_LIMIT)
+            break;
+        upgradedBytes += getMipChainSize(*textureEntries[plan->id].mips, plan->level);
+        streamTexture(plan->id, plan->level);
+    }
+
+    for (const auto& plan : plans) {
+        const auto& entry = textureEntries[plan.id];
+        if (entry.firstLevel > entry.wantedLevel)
+            ++stats.belowWanted;
+    }
+
+    // Copies on a transfer queue take a few frames, until then the frames keep sampling the old images
+    uint64_t uploadValue = submitUploads();
+    for (auto& pending : pendingTextures) {
+        if (pending.uploadValue == 0)
+            pending.uploadValue = uploadValue;
+    }
+    swapPendingTextures();
+
+    std::vector<TextureID> streamed;
+    streamed.swap(streamedTextures);
+    return streamed;
 }
 
 VulkanTexture& VulkanResourceManager::requireCubeMapTexture(const std::vector<std::string>& filenames, VkSampler sampler)
 {
-    auto texture = new VulkanTexture(device, filenames, sampler, commandPool, device.getGraphicsQueue());
+    auto texture = new VulkanTexture(device, filenames, sampler, *uploads);
     cubeMapTextureMap.emplace_back(texture);
     return *texture;
 }
@@ -394,24 +1129,24 @@ VulkanShaderModule VulkanResourceManager::createShaderModule(const char* filepat
     return VulkanShaderModule(device, shaderCode, stageFlag, name);
 }
 
-BlasInput VulkanResourceManager::requireBlasInput(const RenderMesh& mesh)
+BlasInput VulkanResourceManager::requireBlasInput(const RenderGeometry& geometry)
 {
-    VkDeviceAddress vertexAddress = getBufferDeviceAddress(device.getHandle(), mesh.vertexBuffer.buffer);
-    VkDeviceAddress indexAddress = getBufferDeviceAddress(device.getHandle(), mesh.indexBuffer.buffer);
+    VkDeviceAddress vertexAddress = getBufferDeviceAddress(device.getHandle(), geometry.vertexBuffer.buffer) + geometry.vertexBuffer.offset;
+    VkDeviceAddress indexAddress = getBufferDeviceAddress(device.getHandle(), geometry.indexBuffer.buffer) + geometry.indexBuffer.offset;
 
-    uint32_t maxPrimitiveCount = mesh.indexNum / 3;
+    uint32_t maxPrimitiveCount = geometry.indexNum / 3;
 
-    // Describe buffer as array of Vertex.
+    // Describe buffer as array of PackedVertex, the position is a full float vec3 at offset 0.
     VkAccelerationStructureGeometryTrianglesDataKHR triangles{};
     triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
     triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;  // vec3 vertex position data.
     triangles.vertexData.deviceAddress = vertexAddress;
-    triangles.vertexStride = sizeof(Vertex);
-    triangles.indexType = mesh.indexType;
+    triangles.vertexStride = sizeof(PackedVertex);
+    triangles.indexType = geometry.indexType;
     triangles.indexData.deviceAddress = indexAddress;
     // Indicate identity transform by setting transformData to null device pointer.
     //triangles.transformData = {};
-    triangles.maxVertex = mesh.vertexNum;
+    triangles.maxVertex = geometry.vertexNum;
 
     VkAccelerationStructureGeometryKHR asGeom{};
     asGeom.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
@@ -430,7 +1165,7 @@ BlasInput VulkanResourceManager::requireBlasInput(const RenderMesh& mesh)
     BlasInput input;
     input.asGeometry.emplace_back(asGeom);
     input.asBuildOffsetInfo.emplace_back(offset);
-    input.mesh = &mesh;
+    input.geometry = &geometry;
 
     return input;
 }
@@ -440,7 +1175,7 @@ VulkanAccelerationStructure VulkanResourceManager::requireAS(VkAccelerationStruc
     VulkanAccelerationStructure as{};
     as.buffer = &requireBuffer(info.size,
         VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
     info.buffer = as.buffer->getHandle();
 
@@ -449,6 +1184,28 @@ VulkanAccelerationStructure VulkanResourceManager::requireAS(VkAccelerationStruc
     return as;
 }
 
+VkDeviceSize VulkanResourceManager::getBufferMemorySize() const
+{
+    VkDeviceSize size = 0;
+    for (const auto& [handle, buffer] : bufferSet)
+        size += buffer->getSize();
+    return size + getGeometryArenaStats().blockBytes;
+}
+
+GeometryArenaStats VulkanResourceManager::getGeometryArenaStats() const
+{
+    GeometryArenaStats stats{};
+    for (const auto* arena : { vertexArena.get(), indexArena.get(), dataArena.get() }) {
+        auto arenaStats = arena->getStats();
+        stats.ranges += arenaStats.ranges;
+        stats.freeRanges += arenaStats.freeRanges;
+        stats.blocks += arenaStats.blocks;
+        stats.usedBytes += arenaStats.usedBytes;
+        stats.blockBytes += arenaStats.blockBytes;
+    }
+    return stats;
+}
+
 const std::vector<std::unique_ptr<VulkanTexture>>& VulkanResourceManager::getTextures() const
 {
     return textureMap;
@@ -1,25 +1,45 @@
 #pragma once
 
+#include <cmath>
 #include <string>
 #include <vector>
 #include <map>
+#include <tuple>
 #include <unordered_set>
 
 #include "Vertex.h"
 #include "Light.h"
 #include "Texture.h"
+#include "Geometry/Simplify.h"
 
 #include "VulkanCommon.h"
 #include "VulkanDescriptorSet.h"
 #include "VulkanTexture.h"
+#include "VulkanGeometryArena.h"
+#include "VulkanUploadContext.h"
+
+class ThreadPool;
 
 using RenderMeshID = uint64_t;
+using RenderGeometryID = uint64_t;
 using TextureID = uint64_t;
 
+// Decoded pixels loadTextures keeps in staging memory at once, a larger image is decoded alone
+constexpr VkDeviceSize TEXTURE_STAGING_BUDGET = 256ull << 20;
+
+// Streamed textures start with the levels at most this many texels wide and high, which always stay resident
+constexpr uint32_t TEXTURE_STREAMING_COARSE_SIZE = 128;
+// Default host size of the resident levels of all streamed textures together, see setTextureStreamingBudget.
+// The coarse levels stay even when they alone exceed it.
+constexpr VkDeviceSize TEXTURE_STREAMING_BUDGET = 512ull << 20;
+// Finer levels one updateTextureStreaming uploads, the first texture is uploaded even if it is larger
+constexpr VkDeviceSize TEXTURE_STREAMING_UPLOAD_LIMIT = 32ull << 20;
+
 // Information of a obj model when referenced in a shader
 struct ObjDesc
 {
     int      txtOffset;             // Texture index offset in the array of textures
+    int      indexSize;             // Bytes per index, 2 or 4
     uint64_t vertexAddress;         // Address of the Vertex buffer
     uint64_t indexAddress;          // Address of the index buffer
     uint64_t materialAddress;       // Address of the material buffer
@@ -49,6 +69,7 @@ struct SceneData {
     std::vector<std::vector<VulkanBuffer*>> uniformBuffers;
 
     void update() const;
+    // The buffers are persistently mapped, this copies data into them without mapping
     void updateData(uint32_t frameIdx, uint32_t binding, void* data, size_t size, uint32_t arrayElement = 0);
 };
 
@@ -112,10 +133,70 @@ struct RenderTexture
     TextureType type;
     const char* filepath;
     VkSampler sampler;
+    // Bytes of an image embedded in the scene file, filepath then only names it
+    const EmbeddedImage* embedded{ nullptr };
+};
+
+// Range of the shared index buffer drawn for one LOD
+struct RenderLod
+{
+    uint32_t firstIndex;
+    uint32_t indexNum;
+    float error;        // Object space, see MeshLod
 };
 
+// GPU buffers of one unique geometry, shared by every RenderMesh instancing it
+struct RenderGeometry
+{
+    VkIndexType indexType;
+    uint32_t indexNum;  // Full resolution only, the coarser LODs follow it in indexBuffer
+    uint32_t vertexNum;
+    // Ranges of the geometry arenas of VulkanResourceManager
+    VkDescriptorBufferInfo vertexBuffer;
+    VkDescriptorBufferInfo indexBuffer;
+    VkDescriptorBufferInfo matBuffer;
+    VkDescriptorBufferInfo matIndicesBuffer;
+    // vertexBuffer and indexBuffer offsets in vertices and indices, to draw with the arena buffers bound at 0
+    int32_t vertexOffset;
+    uint32_t firstIndex;
+
+    // lods[0] is the full resolution mesh
+    std::vector<RenderLod> lods;
+    // Object space bounding sphere
+    glm::vec3 boundsCenter;
+    float boundsRadius;
+
+    // Texture coordinate units per object space unit, from the UV and surface areas
+    // of the triangles, 0 without usable texture coordinates
+    float uvDensity;
+    // Every texture the material samples, texture streaming asks them for the footprint of this geometry
+    std::vector<TextureID> textures;
+};
+
+// Screen space error in pixels a coarser LOD may add, every step of lodBias doubles it
+constexpr float LOD_PIXEL_ERROR = 1.0f;
+
+// Pixels per unit of object space error at distance 1 for a vertical field of view
+inline float getLodProjScale(float fovy, uint32_t viewportHeight)
+{
+    return float(viewportHeight) / (2.0f * std::tan(fovy * 0.5f));
+}
+
+// Coarsest LOD whose error, placed at the closest point of the bounding sphere,
+// projects to at most LOD_PIXEL_ERROR * 2^lodBias pixels
+uint32_t selectRenderLod(const RenderGeometry& geometry, const glm::mat4& transform, 
+    const glm::vec3& viewPos, float projScale, float lodBias);
+
+// Coarsest LOD whose error projects to at most LOD_PIXEL_ERROR * 2^lodBias texels of a shadow map
+// of extent drawn with the orthographic lightSpace, a directional light cascade. The texel size
+// does not change with the distance there. UINT32_MAX when the bounds miss the cascade.
+uint32_t selectShadowLod(const RenderGeometry& geometry, const glm::mat4& transform,
+    const glm::mat4& lightSpace, VkExtent2D extent, float lodBias);
+
 struct RenderMesh
 {
+    RenderGeometryID geometry;
+
     VkIndexType indexType;
     uint32_t indexNum;
     uint32_t vertexNum;
@@ -123,6 +204,8 @@ struct RenderMesh
     VkDescriptorBufferInfo indexBuffer;
     VkDescriptorBufferInfo matBuffer;
     VkDescriptorBufferInfo matIndicesBuffer;
+    int32_t vertexOffset;
+    uint32_t firstIndex;
 
     glm::mat4 tranformMatrix{ 1.0f };
 
@@ -157,7 +240,7 @@ struct BlasInput
     std::vector<VkAccelerationStructureBuildRangeInfoKHR> asBuildOffsetInfo;
     VkBuildAccelerationStructureFlagsKHR                  flags{ 0 };
 
-    const RenderMesh* mesh;
+    const RenderGeometry* geometry;
 };
 
 struct VulkanAccelerationStructure
@@ -166,6 +249,42 @@ struct VulkanAccelerationStructure
     VulkanBuffer* buffer{ nullptr };
 };
 
+// Counters of the texture cache in VulkanResourceManager.
+// Bytes are the device memory of the images including their mips.
+struct TextureCacheStats
+{
+    uint32_t requests{ 0 };
+    uint32_t pathHits{ 0 };         // Same normalized path and sampler
+    uint32_t contentHits{ 0 };      // Other path, same file bytes and sampler
+    uint32_t textures{ 0 };         // Live textures, including loaded ones nothing acquired yet
+    VkDeviceSize residentBytes{ 0 };
+    VkDeviceSize savedBytes{ 0 };   // Allocations the hits did not make, never decreases
+};
+
+// Seconds loadTextures spent in each phase, summed over its calls.
+// mips adds up the time of every decoding thread and is part of decode.
+struct TextureLoadTimings
+{
+    double read{ 0.0 };     // Reading and hashing the files
+    double decode{ 0.0 };   // Wall time of the decoding batches
+    double mips{ 0.0 };
+    double upload{ 0.0 };   // Coarse levels, streaming uploads the rest later
+};
+
+// State of texture streaming after the last updateTextureStreaming.
+// Bytes are host sizes of the levels, not device allocations.
+struct TextureStreamingStats
+{
+    VkDeviceSize budget{ TEXTURE_STREAMING_BUDGET };
+    uint32_t textures{ 0 };         // With a mip chain on the host
+    uint32_t belowWanted{ 0 };      // Resident coarser than their footprint asks for
+    VkDeviceSize residentBytes{ 0 };
+    VkDeviceSize hostBytes{ 0 };    // Whole mip chains, kept to stream from
+    VkDeviceSize uploadedBytes{ 0 };
+    uint32_t swaps{ 0 };            // Textures whose image was replaced
+    uint32_t uploading{ 0 };        // Replacements whose upload is not visible to the graphics queue yet
+};
+
 class VulkanResourceManager
 {
 public:
@@ -184,6 +303,22 @@ public:
         const GltfMaterial& mat, 
         const std::vector<RenderTexture>& textures);
 
+    // Uploads the buffers once, any number of RenderMeshes can then instance them
+    RenderGeometryID requireRenderGeometry(
+        const std::vector<Vertex>& vertices,
+        const std::vector<uint32_t>& indices,
+        const GltfMaterial& mat,
+        const std::vector<RenderTexture>& textures,
+        const std::vector<MeshLod>& lods = {});
+
+    // A new instance of an uploaded geometry, only the transform is its own
+    RenderMeshID requireRenderMesh(RenderGeometryID geometry);
+
+    // Returns the arena ranges of the geometry for reuse and releases its textures,
+    // the ID stays valid as an empty geometry.
+    // Call it while the GPU uses none of its ranges or textures and no RenderMesh instancing it is drawn again.
+    void releaseRenderGeometry(RenderGeometryID id);
+
     Skybox& requireSkybox(
         const std::vector<Vertex>& vertices,
         const std::vector<uint32_t>& indices,
@@ -194,6 +329,7 @@ public:
     SceneData requireSceneData(const VulkanDescriptorSetLayout& descSetLayout, uint32_t threadCount,
         const std::map<uint32_t, std::pair<VkDeviceSize, size_t>>& bufferSizeInfos);
 
+    // The copy goes into the open upload batch, see submitUploads
     VulkanBuffer& requireBufferWithData(const void* data, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
     VulkanBuffer& requireBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
     
@@ -203,26 +339,83 @@ public:
         return requireBufferWithData(vec.data(), sizeof(T) * vec.size(), usage, properties);
     }
 
+    // 16-bit indices whenever vertexNum fits, 32-bit otherwise
+    VulkanBuffer& requireIndexBuffer(const std::vector<uint32_t>& indices, size_t vertexNum, 
+        VkBufferUsageFlags usage, VkIndexType& indexType);
+
     void destroyBuffer(VulkanBuffer* buffer);
 
+    // Buffers with data, geometry and textures are uploaded in batches, on the transfer queue when the
+    // device has one. submitUploads hands the open batch to the GPU and returns without waiting.
+    // Graphics work submitted after acquireUploads sees the data, it waits for copies on the transfer queue.
+    // flushUploads also waits for the graphics queue, for the host or other queues.
+    uint64_t submitUploads();
+    void acquireUploads();
+    void flushUploads();
+    const UploadStats& getUploadStats() const { return uploads->getStats(); }
+
     VulkanDescriptorSetLayout& requireDescriptorSetLayout(uint32_t set, const std::vector<VulkanShaderResource>& shaderResources);
     VulkanDescriptorSet& requireDescriptorSet(const VulkanDescriptorSetLayout& descSetLayout, const BindingMap<VkDescriptorBufferInfo>& bufferInfos, const BindingMap<VkDescriptorImageInfo>& imageInfos);
     VulkanDescriptorPool& requireDescriptorPool(const std::vector<VkDescriptorPoolSize>& poolSizes, uint32_t maxSets);
-    VulkanTexture& requireTexture(const char* filename, VkSampler sampler);
+    // File textures are shared: a path that normalizes to a cached one, or a file with the same bytes,
+    // returns the existing texture and adds a reference. Every call must be paired with releaseTexture.
+    // The returned index into getTextures() never changes while the texture is referenced,
+    // the texture behind it does when texture streaming changes its resident levels.
+    // An embedded image is decoded from its bytes, filename is the name it is cached under.
+    TextureID acquireTexture(const char* filename, VkSampler sampler, const EmbeddedImage* embedded = nullptr);
+    // Destroys the texture with its last reference, the slot may then be reused by a new texture
+    void releaseTexture(TextureID id);
+    // Reads and decodes the listed textures that are not cached yet on pool, then uploads them.
+    // Embedded images are decoded from their bytes instead of a file.
+    // The textures enter the cache without a reference, acquireTexture hands out the first one.
+    void loadTextures(const std::vector<Texture>& textures, VkSampler sampler, ThreadPool& pool);
+    // acquireTexture with all levels resident. The first call for a streamed texture replaces it by one with
+    // its whole mip chain and waits for the upload, the next updateTextureStreaming returns its ID like that of
+    // a swapped one.
+    // From then on streaming leaves it alone, so a pointer to it stays valid.
+    // Every call must be paired with releaseTexture as well.
+    TextureID requireTexture(const char* filename, VkSampler sampler, const EmbeddedImage* embedded = nullptr);
     VulkanTexture& requireTexture(const void* data, size_t size, VkExtent3D extent, VkFormat format, VkSampler sampler);
     VulkanTexture& requireCubeMapTexture(const std::vector<std::string>& filenames, VkSampler sampler);
 
+    // File textures are created with their coarse levels only. Each update estimates from the bounding
+    // spheres and UV density of the visible meshes the finest level each texture shows, then replaces
+    // textures by ones with more or fewer levels, keeping the finer levels within the budget.
+    // Call it while the GPU uses none of the textures, the replaced ones are destroyed at the next update.
+    // Returns the textures whose getImageInfo() changed, their descriptors must be written again.
+    std::vector<TextureID> updateTextureStreaming(const glm::mat4& viewProj, const glm::vec3& viewPos, float projScale);
+    void setTextureStreamingBudget(VkDeviceSize budget) { textureStreamingStats.budget = budget; }
+    const TextureStreamingStats& getTextureStreamingStats() const { return textureStreamingStats; }
+
+    // Geometry defragmentation compacts device memory by moving the geometry arena blocks, one pass of
+    // VulkanAllocator at a time. beginGeometryDefragmentationPass waits for the uploads, copies the blocks
+    // of the next pass and points the ranges of every geometry and RenderMesh at the moved ones.
+    // Addresses taken from the ranges, the ObjDesc of each mesh and BLAS inputs, must be taken again
+    // before the next frame is recorded. Built acceleration structures keep their own copy.
+    // Returns false without opening a pass once nothing is left to move.
+    // endGeometryDefragmentationPass frees the old blocks, call it once the frames recorded before the pass
+    // have retired. Arena blocks of another resource manager must not exist meanwhile, their ranges would not follow.
+    bool beginGeometryDefragmentationPass();
+    void endGeometryDefragmentationPass();
+
     VkSamplerCreateInfo getDefaultSamplerCreateInfo();
     VkSampler getDefaultSampler();
     VkSampler createSampler(VkSamplerCreateInfo* createInfo = nullptr);
     VulkanShaderModule createShaderModule(const char* filepath, VkShaderStageFlagBits stageFlag, const char* name);
 
     //raytracing
-    BlasInput requireBlasInput(const RenderMesh& mesh);
+    BlasInput requireBlasInput(const RenderGeometry& geometry);
     VulkanAccelerationStructure requireAS(VkAccelerationStructureCreateInfoKHR& info);
 
+    // Indexed by TextureID, released slots are null until reused
     const std::vector<std::unique_ptr<VulkanTexture>>& getTextures() const;
     size_t getTextureNum() const;
+    const TextureCacheStats& getTextureCacheStats() const { return textureCacheStats; }
+    const TextureLoadTimings& getTextureLoadTimings() const { return textureLoadTimings; }
+    // Sizes of the live buffers, staging buffers excluded
+    VkDeviceSize getBufferMemorySize() const;
+    // Vertex, index and material data of every geometry together
+    GeometryArenaStats getGeometryArenaStats() const;
     const std::vector<std::unique_ptr<VulkanTexture>>& getCubeMapTextures() const { return cubeMapTextureMap; }
     size_t getCubeMapTextureNum() const { return cubeMapTextureMap.size(); }
 
@@ -238,22 +431,108 @@ public:
         return meshes;
     }
 
+    inline const RenderGeometry& getRenderGeometry(RenderGeometryID id) const {
+        return geometries[id];
+    }
+
+    inline size_t getRenderGeometryNum() const {
+        return geometries.size();
+    }
+
     inline Skybox& getSkybox() { return *skybox; }
 
+    // Pool the manager records on, the acceleration structures of its scene are built with it too
+    VulkanCommandPool& getCommandPool() const { return commandPool; }
+
 private:
     const VulkanDevice& device;
     VulkanCommandPool& commandPool;
 
     std::unique_ptr<Skybox> skybox;
+    std::vector<RenderGeometry> geometries;
     std::vector<RenderMesh> meshes;
     std::vector<std::unique_ptr<VulkanTexture>> textureMap;
     std::vector<std::unique_ptr<VulkanTexture>> cubeMapTextureMap;
 
+    using TexturePathKey = std::pair<std::string, VkSampler>;
+    // Hash and size of the file bytes
+    using TextureContentKey = std::tuple<uint64_t, size_t, VkSampler>;
+    struct TextureCacheEntry
+    {
+        uint32_t refCount{ 0 };
+        VkDeviceSize size{ 0 };
+        std::vector<TexturePathKey> paths;
+        bool cached{ false };
+        TextureContentKey content{};
+
+        // Streamed textures only
+        std::unique_ptr<TextureMipChain> mips;
+        uint32_t firstLevel{ 0 };       // Finest resident level
+        uint32_t wantedLevel{ 0 };
+        uint64_t lastSeenFrame{ 0 };    // Last update a visible mesh used it
+        bool pinned{ false };           // Handed out by reference, all levels stay resident
+        bool streaming{ false };        // A replacement is in pendingTextures
+    };
+    // Parallel to textureMap
+    std::vector<TextureCacheEntry> textureEntries;
+    std::vector<TextureID> freeTextureSlots;
+    std::map<TexturePathKey, TextureID> texturePathCache;
+    std::map<TextureContentKey, TextureID> textureContentCache;
+    TextureCacheStats textureCacheStats;
+    TextureLoadTimings textureLoadTimings;
+
+    TextureID addTexture(std::unique_ptr<VulkanTexture> texture, uint32_t refCount = 1);
+    void cacheTexture(TextureID id, TexturePathKey pathKey, const TextureContentKey& contentKey);
+    // Counts a hit unless the texture was only loaded so far
+    TextureID retainTexture(TextureID id, uint32_t& hits);
+    // Adds the reference to the textures of the geometry, or drops it when the geometry holds one already
+    void addGeometryTexture(RenderGeometry& geometry, TextureID id);
+
+    // Uploads the coarse levels of the chain
+    TextureID addStreamedTexture(std::unique_ptr<TextureMipChain> mips, VkSampler sampler, uint32_t refCount);
+    // Uploads a replacement of the texture whose base level is firstLevel of its chain
+    void streamTexture(TextureID id, uint32_t firstLevel);
+    // The replacement itself, the entry and the stats already count it as resident
+    std::unique_ptr<VulkanTexture> createStreamedTexture(TextureID id, uint32_t firstLevel);
+
+    TextureStreamingStats textureStreamingStats;
+    uint64_t streamingFrame{ 0 };
+    std::vector<TextureID> streamedTextures;    // Since the last update
+    std::vector<std::unique_ptr<VulkanTexture>> retiredTextures;
+
+    // Replacements made by streamTexture, the old image stays in use until their upload is visible
+    struct PendingTexture
+    {
+        TextureID id;
+        std::unique_ptr<VulkanTexture> texture;
+        uint64_t uploadValue{ 0 };      // 0 until the batch is submitted
+        bool released{ false };         // The texture was released or replaced otherwise, the image only waits for its upload
+    };
+    std::vector<PendingTexture> pendingTextures;
+    // Swaps in the replacements whose upload the graphics queue sees
+    void swapPendingTextures();
+
     VkSampler defaultSampler;
     std::unordered_set<VkSampler> samplerSet;
 
     std::unordered_map<VulkanBuffer*, std::unique_ptr<VulkanBuffer>> bufferSet;
 
+    // Geometry data lives in a few shared buffers, split by usage and alignment
+    std::unique_ptr<VulkanUploadContext> uploads;
+    std::unique_ptr<VulkanGeometryArena> vertexArena;
+    std::unique_ptr<VulkanGeometryArena> indexArena;
+    std::unique_ptr<VulkanGeometryArena> dataArena;    // Materials and triangle material indices
+
+    struct ArenaUpload
+    {
+        VulkanGeometryArena* arena;
+        const void* data;
+        VkDeviceSize size;
+        VkDescriptorBufferInfo* range;
+    };
+    // Allocates the ranges and records the copies of the data into them
+    void uploadToArenas(const std::vector<ArenaUpload>& arenaUploads);
+
     std::vector<std::unique_ptr<VulkanDescriptorPool>> descriptorPools;
     std::unordered_set<std::unique_ptr<VulkanDescriptorSet>> descriptorSetSet;
 };
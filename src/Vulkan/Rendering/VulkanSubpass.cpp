@@ -2,7 +2,7 @@
 
 VulkanSubpass::VulkanSubpass(const VulkanDevice& device, VulkanResourceManager& resManager, VkExtent2D extent,
 	const std::vector<VulkanShaderResource> shaderRes, const VulkanRenderPass& renderPass, uint32_t subpass) :
-	device{ device }, resManager{ resManager }, extent{ extent }, renderPass{ renderPass }, subpass{ subpass }
+	device{ device }, resManager{ resManager }, extent{ extent }, subpass{ subpass }, renderPass{ renderPass }
 {
 }
 
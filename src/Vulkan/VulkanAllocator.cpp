@@ -0,0 +1,279 @@
+// volk loads the Vulkan functions, VMA takes them from vkGetInstanceProcAddr and vkGetDeviceProcAddr
+#define VMA_IMPLEMENTATION
+#define VMA_STATIC_VULKAN_FUNCTIONS 0
+#define VMA_DYNAMIC_VULKAN_FUNCTIONS 1
+
+#include "VulkanCommon.h"
+#include <vk_mem_alloc.h>
+
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanCommandPool.h"
+#include "VulkanQueue.h"
+#include "VulkanAllocator.h"
+
+VulkanAllocator::VulkanAllocator(const VulkanDevice& device, bool memoryBudget) :
+    device{ device }
+{
+    VmaVulkanFunctions functions{};
+    functions.vkGetInstanceProcAddr = vkGetInstanceProcAddr;
+    functions.vkGetDeviceProcAddr = vkGetDeviceProcAddr;
+
+    VmaAllocatorCreateInfo createInfo{};
+    // Every device is created with bufferDeviceAddress, see VulkanDevice
+    createInfo.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+    if (memoryBudget)
+        createInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    createInfo.vulkanApiVersion = VK_API_VERSION_1_2;
+    createInfo.physicalDevice = device.getGPU().getHandle();
+    createInfo.device = device.getHandle();
+    // The instance volk was loaded with, VulkanInstance does that before any device exists
+    createInfo.instance = volkGetLoadedInstance();
+    createInfo.pVulkanFunctions = &functions;
+
+    if (vmaCreateAllocator(&createInfo, &allocator) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create memory allocator!");
+    }
+}
+
+VulkanAllocator::~VulkanAllocator()
+{
+    if (pass)
+        endDefragmentationPass();
+    if (context != VK_NULL_HANDLE)
+        endDefragmentation();
+    if (allocator != VK_NULL_HANDLE) {
+        vmaDestroyAllocator(allocator);
+    }
+}
+
+VmaAllocation VulkanAllocator::createBuffer(const VkBufferCreateInfo& info, VkMemoryPropertyFlags properties, VkBuffer& buffer,
+    uint8_t** mappedData) const
+{
+    VmaAllocationCreateInfo allocInfo{};
+    allocInfo.requiredFlags = properties;
+    if (mappedData)
+        allocInfo.flags |= VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VmaAllocation allocation;
+    VmaAllocationInfo allocationInfo{};
+    if (vmaCreateBuffer(allocator, &info, &allocInfo, &buffer, &allocation, &allocationInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate buffer memory!");
+    }
+    if (mappedData)
+        *mappedData = static_cast<uint8_t*>(allocationInfo.pMappedData);
+    return allocation;
+}
+
+VmaAllocation VulkanAllocator::createImage(const VkImageCreateInfo& info, VkMemoryPropertyFlags properties, VkImage& image) const
+{
+    if (vkCreateImage(device.getHandle(), &info, nullptr, &image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device.getHandle(), image, &memRequirements);
+
+    // Render targets are recreated with the swap chain, a block of their own is freed with them
+    constexpr VkImageUsageFlags renderTargetUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+        VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+    VmaAllocationCreateInfo allocInfo{};
+    allocInfo.requiredFlags = properties;
+    bool dedicated = (info.usage & renderTargetUsage) != 0 || memRequirements.size >= DEDICATED_IMAGE_SIZE;
+    if (dedicated)
+        allocInfo.flags |= VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+
+    VmaAllocation allocation;
+    if (vmaAllocateMemoryForImage(allocator, image, &allocInfo, &allocation, nullptr) != VK_SUCCESS) {
+        vkDestroyImage(device.getHandle(), image, nullptr);
+        throw std::runtime_error("failed to allocate image memory!");
+    }
+    if (vmaBindImageMemory(allocator, allocation, image) != VK_SUCCESS) {
+        vmaFreeMemory(allocator, allocation);
+        vkDestroyImage(device.getHandle(), image, nullptr);
+        throw std::runtime_error("failed to bind image memory!");
+    }
+
+    return allocation;
+}
+
+void VulkanAllocator::destroyBuffer(VkBuffer buffer, VmaAllocation allocation) const
+{
+    vmaDestroyBuffer(allocator, buffer, allocation);
+}
+
+void VulkanAllocator::destroyImage(VkImage image, VmaAllocation allocation) const
+{
+    vmaDestroyImage(allocator, image, allocation);
+}
+
+void VulkanAllocator::setMovable(VmaAllocation allocation, VulkanBuffer* buffer) const
+{
+    vmaSetAllocationUserData(allocator, allocation, buffer);
+}
+
+uint8_t* VulkanAllocator::map(VmaAllocation allocation) const
+{
+    void* data;
+    if (vmaMapMemory(allocator, allocation, &data) != VK_SUCCESS) {
+        throw std::runtime_error("failed to map memory!");
+    }
+    return static_cast<uint8_t*>(data);
+}
+
+void VulkanAllocator::unmap(VmaAllocation allocation) const
+{
+    vmaUnmapMemory(allocator, allocation);
+}
+
+void VulkanAllocator::flush(VmaAllocation allocation, VkDeviceSize offset, VkDeviceSize size) const
+{
+    vmaFlushAllocation(allocator, allocation, offset, size);
+}
+
+void VulkanAllocator::invalidate(VmaAllocation allocation, VkDeviceSize offset, VkDeviceSize size) const
+{
+    vmaInvalidateAllocation(allocator, allocation, offset, size);
+}
+
+VkDeviceMemory VulkanAllocator::getMemory(VmaAllocation allocation) const
+{
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(allocator, allocation, &info);
+    return info.deviceMemory;
+}
+
+VkMemoryPropertyFlags VulkanAllocator::getMemoryProperties(VmaAllocation allocation) const
+{
+    VkMemoryPropertyFlags properties;
+    vmaGetAllocationMemoryProperties(allocator, allocation, &properties);
+    return properties;
+}
+
+VulkanAllocatorStats VulkanAllocator::getStats(bool detailed) const
+{
+    VulkanAllocatorStats stats{};
+
+    // Budgets are kept up to date by VMA, cheap enough for every frame
+    const VkPhysicalDeviceMemoryProperties* memoryProperties;
+    vmaGetMemoryProperties(allocator, &memoryProperties);
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    vmaGetHeapBudgets(allocator, budgets);
+    for (uint32_t heap = 0; heap < memoryProperties->memoryHeapCount; ++heap) {
+        const auto& budget = budgets[heap];
+        stats.allocations += budget.statistics.allocationCount;
+        stats.blocks += budget.statistics.blockCount;
+        stats.allocatedBytes += budget.statistics.allocationBytes;
+        stats.blockBytes += budget.statistics.blockBytes;
+    }
+
+    if (detailed) {
+        VmaTotalStatistics total;
+        vmaCalculateStatistics(allocator, &total);
+        stats.unusedRanges = total.total.unusedRangeCount;
+        stats.largestUnusedRange = total.total.unusedRangeSizeMax;
+        VkDeviceSize unusedBytes = stats.blockBytes - stats.allocatedBytes;
+        if (unusedBytes > 0)
+            stats.fragmentation = 1.0f - static_cast<float>(static_cast<double>(stats.largestUnusedRange) / unusedBytes);
+    }
+    return stats;
+}
+
+bool VulkanAllocator::beginDefragmentationPass(const VulkanCommandPool& commandPool, const VulkanQueue& queue,
+    std::vector<VulkanBufferMove>& moves)
+{
+    if (pass) {
+        throw std::runtime_error("failed to begin defragmentation pass, the last one is still open!");
+    }
+    if (context == VK_NULL_HANDLE) {
+        VmaDefragmentationInfo info{};
+        info.flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT;
+        if (vmaBeginDefragmentation(allocator, &info, &context) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin defragmentation!");
+        }
+    }
+
+    auto movesInfo = std::make_unique<VmaDefragmentationPassMoveInfo>();
+    if (vmaBeginDefragmentationPass(allocator, context, movesInfo.get()) == VK_SUCCESS) {
+        endDefragmentation();
+        return false;
+    }
+
+    // Copy each movable buffer into a new buffer bound to its destination, the old buffer
+    // and memory stay as they are until the pass ends
+    size_t firstMove = moves.size();
+    auto commandBuffer = commandPool.beginSingleTimeCommands();
+    for (uint32_t i = 0; i < movesInfo->moveCount; ++i) {
+        auto& move = movesInfo->pMoves[i];
+        VmaAllocationInfo allocInfo;
+        vmaGetAllocationInfo(allocator, move.srcAllocation, &allocInfo);
+        auto* buffer = static_cast<VulkanBuffer*>(allocInfo.pUserData);
+        if (buffer == nullptr) {
+            move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            continue;
+        }
+
+        VkBufferCreateInfo bufferInfo{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+        bufferInfo.size = buffer->size;
+        bufferInfo.usage = buffer->usage;
+        device.setUploadSharing(bufferInfo);
+        VkBuffer newBuffer;
+        if (vkCreateBuffer(device.getHandle(), &bufferInfo, nullptr, &newBuffer) != VK_SUCCESS) {
+            move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            continue;
+        }
+        if (vmaBindBufferMemory(allocator, move.dstTmpAllocation, newBuffer) != VK_SUCCESS) {
+            vkDestroyBuffer(device.getHandle(), newBuffer, nullptr);
+            move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            continue;
+        }
+
+        VkBufferCopy region{ 0, 0, buffer->size };
+        vkCmdCopyBuffer(commandBuffer->getHandle(), buffer->buffer, newBuffer, 1, &region);
+        moves.push_back({ buffer, newBuffer });
+    }
+    commandPool.endSingleTimeCommands(*commandBuffer, queue);
+
+    // Frames recorded from now on use the new handles, the old ones retire with the pass
+    for (size_t i = firstMove; i < moves.size(); ++i) {
+        auto& move = moves[i];
+        std::swap(move.buffer->buffer, move.oldBuffer);
+        retiredBuffers.push_back(move.oldBuffer);
+    }
+    pass = std::move(movesInfo);
+    return true;
+}
+
+void VulkanAllocator::endDefragmentationPass()
+{
+    if (!pass) {
+        throw std::runtime_error("failed to end defragmentation pass, none is open!");
+    }
+
+    for (VkBuffer buffer : retiredBuffers) {
+        vkDestroyBuffer(device.getHandle(), buffer, nullptr);
+    }
+    retiredBuffers.clear();
+
+    // Frees the memory the moved buffers left
+    VkResult result = vmaEndDefragmentationPass(allocator, context, pass.get());
+    pass.reset();
+    if (result == VK_SUCCESS)
+        endDefragmentation();
+}
+
+void VulkanAllocator::endDefragmentation()
+{
+    if (pass) {
+        throw std::runtime_error("failed to end defragmentation, a pass is still open!");
+    }
+
+    VmaDefragmentationStats vmaStats{};
+    vmaEndDefragmentation(allocator, context, &vmaStats);
+    context = VK_NULL_HANDLE;
+
+    defragmentationStats.movedBuffers = vmaStats.allocationsMoved;
+    defragmentationStats.movedBytes = vmaStats.bytesMoved;
+    defragmentationStats.freedBlocks = vmaStats.deviceMemoryBlocksFreed;
+    defragmentationStats.freedBytes = vmaStats.bytesFreed;
+}
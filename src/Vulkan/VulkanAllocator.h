@@ -0,0 +1,117 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "VulkanCommon.h"
+
+// Same declarations as in vk_mem_alloc.h, which only VulkanAllocator.cpp includes
+typedef struct VmaAllocator_T* VmaAllocator;
+typedef struct VmaAllocation_T* VmaAllocation;
+typedef struct VmaDefragmentationContext_T* VmaDefragmentationContext;
+struct VmaDefragmentationPassMoveInfo;
+
+class VulkanDevice;
+class VulkanBuffer;
+class VulkanCommandPool;
+class VulkanQueue;
+
+// Images at least this large get a VkDeviceMemory of their own, as do render targets
+constexpr VkDeviceSize DEDICATED_IMAGE_SIZE = 16 * 1024 * 1024;
+
+struct VulkanAllocatorStats
+{
+    uint32_t allocations{ 0 };          // Live buffers and images
+    uint32_t blocks{ 0 };               // VkDeviceMemory objects, dedicated ones included
+    VkDeviceSize allocatedBytes{ 0 };
+    VkDeviceSize blockBytes{ 0 };
+    // Only filled by getStats(true), they walk every block
+    uint32_t unusedRanges{ 0 };
+    VkDeviceSize largestUnusedRange{ 0 };
+    // 1 - largest unused range / unused bytes, 0 while the free space of the blocks is one range
+    float fragmentation{ 0.0f };
+};
+
+struct VulkanDefragmentationStats
+{
+    uint32_t movedBuffers{ 0 };
+    VkDeviceSize movedBytes{ 0 };
+    uint32_t freedBlocks{ 0 };
+    VkDeviceSize freedBytes{ 0 };
+};
+
+// A buffer moved by a defragmentation pass, buffer has the new handle and oldBuffer the one it replaced
+struct VulkanBufferMove
+{
+    VulkanBuffer* buffer;
+    VkBuffer oldBuffer;
+};
+
+// Device memory of buffers and images through VMA. Resources are sub-allocated from large
+// blocks, so a scene needs a few dozen vkAllocateMemory calls instead of one per resource.
+// Render targets and large images get dedicated allocations.
+class VulkanAllocator
+{
+public:
+    VulkanAllocator(const VulkanDevice& device, bool memoryBudget);
+
+    VulkanAllocator(const VulkanAllocator&) = delete;
+
+    ~VulkanAllocator();
+
+    VmaAllocator getHandle() const { return allocator; }
+
+    // properties are required, not preferred, like findMemoryType. With mappedData the memory is
+    // mapped until the buffer is destroyed and mappedData is set to it.
+    VmaAllocation createBuffer(const VkBufferCreateInfo& info, VkMemoryPropertyFlags properties, VkBuffer& buffer,
+        uint8_t** mappedData = nullptr) const;
+    VmaAllocation createImage(const VkImageCreateInfo& info, VkMemoryPropertyFlags properties, VkImage& image) const;
+    void destroyBuffer(VkBuffer buffer, VmaAllocation allocation) const;
+    void destroyImage(VkImage image, VmaAllocation allocation) const;
+
+    // Marks the allocation of buffer as one defragmentation may move, buffer has to follow moves of the object
+    void setMovable(VmaAllocation allocation, VulkanBuffer* buffer) const;
+
+    // Mapping is reference counted per block, several allocations of a block may be mapped at once
+    uint8_t* map(VmaAllocation allocation) const;
+    void unmap(VmaAllocation allocation) const;
+    // Makes host writes visible to the device, nothing happens on coherent memory
+    void flush(VmaAllocation allocation, VkDeviceSize offset, VkDeviceSize size) const;
+    // Makes device writes visible to the host, nothing happens on coherent memory
+    void invalidate(VmaAllocation allocation, VkDeviceSize offset, VkDeviceSize size) const;
+
+    VkDeviceMemory getMemory(VmaAllocation allocation) const;
+    // Of the memory type VMA picked, which may have more than the required properties
+    VkMemoryPropertyFlags getMemoryProperties(VmaAllocation allocation) const;
+
+    VulkanAllocatorStats getStats(bool detailed = false) const;
+
+    // Defragmentation compacts the blocks by moving the buffers created as movable, images and other
+    // buffers stay. It runs in passes, at most one is open at a time.
+    // beginDefragmentationPass copies the buffers of the next pass and blocks until the copies on queue
+    // are done, moved buffers have their new handles and device addresses from then on. Descriptors and
+    // addresses taken from them have to be written again before the next frame is recorded.
+    // Returns false without opening a pass once nothing is left to move.
+    bool beginDefragmentationPass(const VulkanCommandPool& commandPool, const VulkanQueue& queue,
+        std::vector<VulkanBufferMove>& moves);
+    // Destroys the old buffers of the open pass and frees their memory. Until then they keep the same
+    // bytes as the moved ones, so call it once every frame recorded before the pass has retired.
+    // Moved buffers must not be destroyed while their pass is open.
+    void endDefragmentationPass();
+    // Stops defragmentation between passes, the next beginDefragmentationPass starts over
+    void endDefragmentation();
+    bool isDefragmenting() const { return context != VK_NULL_HANDLE; }
+    bool isDefragmentationPassOpen() const { return pass != nullptr; }
+    // Of the last finished defragmentation
+    const VulkanDefragmentationStats& getDefragmentationStats() const { return defragmentationStats; }
+
+private:
+    const VulkanDevice& device;
+
+    VmaAllocator allocator{ VK_NULL_HANDLE };
+
+    VmaDefragmentationContext context{ VK_NULL_HANDLE };
+    std::unique_ptr<VmaDefragmentationPassMoveInfo> pass;
+    std::vector<VkBuffer> retiredBuffers;
+    VulkanDefragmentationStats defragmentationStats{};
+};
@@ -1,6 +1,9 @@
+#include <algorithm>
 #include <memory>
 #include <vector>
 #include <chrono>
+#include <cstdio>
+#include <cstring>
 
 #define TINYGLTF_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
@@ -10,11 +13,64 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "../Camera.h"
+#include "../StressScene.h"
+#include "../GLTF/GLTFCooked.h"
 #include "../Platform/GlfwWindow.h"
+#include "../Utils/ThreadPool.h"
 #include "VulkanInclude.h"
 #include "VulkanCommon.h"
 #include "VulkanApplication.h"
 
+namespace {
+    // A scene request with this prefix generates a stress scene instead of loading a file:
+    // "stress:<instances>:<unique ratio>:<point lights>:<dir lights>", the default assets.
+    // The options travel in the request, so the loading thread shares no state with the GUI.
+    const char* STRESS_SCENE_PREFIX = "stress:";
+
+    std::string getStressSceneRequest(const StressSceneOptions& options)
+    {
+        char request[128];
+        snprintf(request, sizeof(request), "%s%u:%.3f:%u:%u", STRESS_SCENE_PREFIX,
+            options.instanceNum, options.uniqueRatio, options.pointLightNum, options.dirLightNum);
+        return request;
+    }
+
+    bool parseStressSceneRequest(const std::string& request, StressSceneOptions& options)
+    {
+        if (request.compare(0, strlen(STRESS_SCENE_PREFIX), STRESS_SCENE_PREFIX) != 0)
+            return false;
+        return sscanf(request.c_str() + strlen(STRESS_SCENE_PREFIX), "%u:%f:%u:%u",
+            &options.instanceNum, &options.uniqueRatio, &options.pointLightNum, &options.dirLightNum) == 4;
+    }
+
+    std::vector<VkAccelerationStructureInstanceKHR> getTlasInstances(VulkanResourceManager& resManager,
+        const std::unordered_map<const Mesh*, RenderMeshID>& renderMeshes, const VulkanRayTracingBuilder& rtBuilder)
+    {
+        std::vector<VkAccelerationStructureInstanceKHR> tlas;
+        tlas.reserve(renderMeshes.size());
+        for (const auto& [p_mesh, id] : renderMeshes)
+        {
+            const auto& mat = p_mesh->geometry->mat;
+            VkGeometryInstanceFlagsKHR flags{};
+            if (mat.alphaMode == 0 || (mat.pbrBaseColorFactor.w == 1.0f && mat.pbrBaseColorTexture == -1))
+                flags |= VK_GEOMETRY_INSTANCE_FORCE_OPAQUE_BIT_KHR;
+            // Need to skip the cull flag in traceray_rtx for double sided materials
+            if (mat.doubleSided == 1)
+                flags |= VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+
+            VkAccelerationStructureInstanceKHR rayInst{};
+            rayInst.transform = toTransformMatrixKHR(resManager.getRenderMesh(id).tranformMatrix); // Position of the instance
+            rayInst.instanceCustomIndex = id; // gl_InstanceCustomIndexEXT
+            rayInst.accelerationStructureReference = rtBuilder.getBlasDeviceAddress(toU32(resManager.getRenderMesh(id).geometry));
+            rayInst.flags = flags;
+            rayInst.mask = 0xFF; //  Only be hit if rayMask & instance.mask != 0
+            rayInst.instanceShaderBindingTableRecordOffset = 0; // We will use the same hit group for all objects
+            tlas.emplace_back(rayInst);
+        }
+        return tlas;
+    }
+}
+
 VulkanApplication::VulkanApplication() :
     threadCount{ 1 }
 {
@@ -61,41 +117,99 @@ VulkanApplication::VulkanApplication() :
     renderContext = std::make_unique<VulkanRenderContext>(*device, surface, window->getExtent(), threadCount);
 
     gui = std::make_unique<GUI>(*instance, *window, *device, renderContext->getRenderPass());
+
+    sceneLoader = std::make_unique<VulkanSceneLoader>([this](const std::string& filename, SceneLoadProgress& progress) {
+        return createScene(filename, progress);
+    });
 }
 
 void VulkanApplication::loadScene(const char* filename)
 {
-    device->waitIdle();
+    SceneLoadProgress progress;
+    activateScene(createScene(filename, progress));
+}
 
-    resManager.reset();
-    scene.reset();
-    graphicBuilder.reset();
-    rtBuilder.reset();
-    renderPipeline.reset();
-    renderMeshes.clear();
+void VulkanApplication::loadSceneAsync(const char* filename)
+{
+    sceneLoader->request(filename);
+}
 
-    resManager = std::make_unique<VulkanResourceManager>(*device, device->getCommandPool());
-    resManager->requireTexture("assets/textures/black.jpg", resManager->getDefaultSampler());
+std::unique_ptr<LoadedScene> VulkanApplication::createScene(const std::string& filename, SceneLoadProgress& progress) const
+{
+    auto loaded = std::make_unique<LoadedScene>();
+    loaded->commandPool = std::make_unique<VulkanCommandPool>(*device, device->getGraphicsQueue().getFamilyIndex());
+    loaded->resManager = std::make_unique<VulkanResourceManager>(*device, *loaded->commandPool);
+    auto& resManager = *loaded->resManager;
+    resManager.requireTexture("assets/textures/black.jpg", resManager.getDefaultSampler());
+
+    progress.setPhase(SceneLoadPhase::Parsing);
+    loaded->scene = std::make_unique<Scene>();
+    auto& scene = *loaded->scene;
+    scene.getActiveCamera()->position = { 2.522, 0.90, 0.029 };
+    scene.getActiveCamera()->yaw = -182;
+    scene.getActiveCamera()->pitch = 0.79;
+    reinterpret_cast<FPSCamera*>(scene.getActiveCamera())->rotate(0, 0);
+    StressSceneOptions stressOptions{};
+    if (parseStressSceneRequest(filename, stressOptions)) {
+        addStressScene(scene, stressOptions);
+    }
+    else {
+        GltfImportOptions options;
+        options.useCookedCache = true;
+        options.cookedCacheDir = COOKED_CACHE_DIR;
+        options.onPrimitiveDecoded = [&progress](size_t done, size_t total) { progress.setProgress(done, total); };
+        scene.addModelsFromGltfFile(filename.c_str(), options);
+    }
+    scene.updateTransforms();
+    const auto& graph = scene.getGraph();
+    loaded->nodeRenderMeshes.resize(graph.getNodeNum());
+
+    if (progress.isCancelled())
+        return nullptr;
+    progress.setPhase(SceneLoadPhase::Uploading);
+
+    std::unordered_set<const MeshGeometry*> uniqueGeometries;
+    for (const auto& [name, model] : scene.getModelMap()) {
+        for (auto& mesh : model->getMeshes())
+            uniqueGeometries.insert(mesh.geometry.get());
+    }
 
-    Model* model{ nullptr };
-    scene = std::make_unique<Scene>();
-    scene->getActiveCamera()->position = { 2.522, 0.90, 0.029 };
-    scene->getActiveCamera()->yaw = -182;
-    scene->getActiveCamera()->pitch = 0.79;
-    reinterpret_cast<FPSCamera*>(scene->getActiveCamera())->rotate(0, 0);
-    scene->addModelsFromGltfFile(filename);
+    VkSampler sampler = resManager.createSampler();
+    // Every texture of the scene is decoded on all cores before the first upload
+    {
+        std::vector<Texture> textures;
+        for (const auto* geometry : uniqueGeometries) {
+            for (const auto& texture : geometry->textures)
+                textures.push_back(texture);
+        }
+        ThreadPool pool;
+        resManager.loadTextures(textures, sampler, pool);
+    }
 
-    VkSampler sampler = resManager->createSampler();
-    for (const auto& [name, model] : scene->getModelMap()) {
+    // Meshes sharing a geometry are uploaded once and become instances of it
+    std::unordered_map<const MeshGeometry*, RenderGeometryID> renderGeometries;
+    for (const auto& [name, model] : scene.getModelMap()) {
         for (auto& mesh : model->getMeshes()) {
-            std::vector<RenderTexture> textures;
-            for (const auto& texture : mesh.textures) {
-                textures.push_back({ texture.type, texture.path.c_str(), sampler });
+            auto it = renderGeometries.find(mesh.geometry.get());
+            if (it == renderGeometries.end()) {
+                if (progress.isCancelled())
+                    return nullptr;
+
+                const auto& geometry = *mesh.geometry;
+                std::vector<RenderTexture> textures;
+                for (const auto& texture : geometry.textures) {
+                    textures.push_back({ texture.type, texture.path.c_str(), sampler, &texture.embedded });
+                }
+
+                auto geometryID = resManager.requireRenderGeometry(geometry.vertices, geometry.indices, geometry.mat, textures, geometry.lods);
+                it = renderGeometries.emplace(&geometry, geometryID).first;
+                progress.setProgress(renderGeometries.size(), uniqueGeometries.size());
             }
 
-            auto id = resManager->requireRenderMesh(mesh.vertices, mesh.indices, mesh.mat, textures);
-            renderMeshes.emplace(&mesh, id);
-            resManager->getRenderMesh(id).tranformMatrix = model->transComp.getTransformMatrix() * mesh.transComp.getTransformMatrix();
+            auto id = resManager.requireRenderMesh(it->second);
+            loaded->renderMeshes.emplace(&mesh, id);
+            loaded->nodeRenderMeshes[model->node].emplace_back(&mesh, id);
+            resManager.getRenderMesh(id).tranformMatrix = graph.getWorldTransform(model->node) * mesh.transComp.getTransformMatrix();
         }
     }
 
@@ -117,9 +231,9 @@ void VulkanApplication::loadScene(const char* filename)
     info.mipLodBias = 0.0f;
     info.minLod = 0.0f;
     info.maxLod = 100.0f;
-    auto& cube = scene->loadGLTFFile("assets/models/cube/cube.gltf")[0]->getMeshes()[0];
-    resManager->requireSkybox(
-        cube.vertices, cube.indices, 
+    auto& cube = scene.loadGLTFFile("assets/models/cube/cube.gltf")[0]->getMeshes()[0];
+    resManager.requireSkybox(
+        cube.geometry->vertices, cube.geometry->indices, 
         {
             "assets/textures/skybox/right.jpg",
             "assets/textures/skybox/left.jpg",
@@ -128,7 +242,43 @@ void VulkanApplication::loadScene(const char* filename)
             "assets/textures/skybox/front.jpg",
             "assets/textures/skybox/back.jpg"
         },
-        resManager->createSampler(&info));
+        resManager.createSampler(&info));
+
+    // Frames are submitted to the graphics queue after the uploads
+    resManager.acquireUploads();
+
+    if (rtSupport) {
+        if (progress.isCancelled())
+            return nullptr;
+        progress.setPhase(SceneLoadPhase::Building);
+        loaded->rtBuilder = buildAccelerationStructures(resManager, loaded->renderMeshes);
+    }
+    return loaded;
+}
+
+void VulkanApplication::activateScene(std::unique_ptr<LoadedScene> loaded)
+{
+    // The old scene may still be in flight, the frames are the only graphics work that uses it
+    renderContext->waitFrames();
+    stopGeometryDefragmentation();
+
+    // Nothing draws the old geometry anymore
+    if (resManager) {
+        for (RenderGeometryID id = 0; id < resManager->getRenderGeometryNum(); ++id)
+            resManager->releaseRenderGeometry(id);
+    }
+
+    graphicBuilder.reset();
+    rtBuilder.reset();
+    renderPipeline.reset();
+
+    // Old manager first, it was recording on the old pool
+    resManager = std::move(loaded->resManager);
+    resCommandPool = std::move(loaded->commandPool);
+    rtBuilder = std::move(loaded->rtBuilder);
+    scene = std::move(loaded->scene);
+    renderMeshes = std::move(loaded->renderMeshes);
+    nodeRenderMeshes = std::move(loaded->nodeRenderMeshes);
 
     graphicBuilder = std::make_unique<VulkanGraphicsBuilder>(*device, *resManager, window->getExtent());
 
@@ -147,6 +297,7 @@ void VulkanApplication::loadScene(const char* filename)
     renderPipeline->getPipelineState().depthStencilState.depth_write_enable = VK_FALSE;
     renderPipeline->recreatePipeline(renderContext->getSwapChain().getExtent(), renderContext->getRenderPass());
 
+    VkSampler sampler = resManager->createSampler();
     postData = resManager->requireSceneData(*renderPipeline->getDescriptorSetLayouts()[0], threadCount, {});
     for (auto& descSet : postData.descriptorSets) {
         descSet->addWrite(0, VkDescriptorImageInfo{ sampler, graphicBuilder->getOffscreenColor()->getHandle(), VK_IMAGE_LAYOUT_GENERAL });
@@ -154,12 +305,17 @@ void VulkanApplication::loadScene(const char* filename)
     postData.update();
 
     if (rtSupport)
-        buildRayTracing();
+        createRayTracingPipeline();
+
+    resetFrameCount();
 }
 
 VulkanApplication::~VulkanApplication()
 {
+    sceneLoader.reset();
+
     resManager.reset();
+    resCommandPool.reset();
 
     gui.reset();
 
@@ -176,16 +332,17 @@ VulkanApplication::~VulkanApplication()
     window.reset();
 }
 
-void VulkanApplication::buildRayTracing()
+std::unique_ptr<VulkanRayTracingBuilder> VulkanApplication::buildAccelerationStructures(
+    VulkanResourceManager& resManager, const std::unordered_map<const Mesh*, RenderMeshID>& renderMeshes) const
 {
-    rtBuilder = std::make_unique<VulkanRayTracingBuilder>(*device, *resManager, *graphicBuilder->getOffscreenColor());
+    auto rtBuilder = std::make_unique<VulkanRayTracingBuilder>(*device, resManager);
 
-    // BLAS - Storing each primitive in a geometry
+    // BLAS - One per unique geometry, instances share it through the TLAS
     std::vector<BlasInput> allBlas;
-    allBlas.reserve(renderMeshes.size());
-    for (const auto& [p_mesh, id] : renderMeshes)
+    allBlas.reserve(resManager.getRenderGeometryNum());
+    for (RenderGeometryID id = 0; id < resManager.getRenderGeometryNum(); ++id)
     {
-        auto blas = resManager->requireBlasInput(resManager->getRenderMesh(id));
+        auto blas = resManager.requireBlasInput(resManager.getRenderGeometry(id));
 
         // We could add more geometry in each BLAS, but we add only one for now
         allBlas.emplace_back(blas);
@@ -193,32 +350,23 @@ void VulkanApplication::buildRayTracing()
     rtBuilder->buildBlas(allBlas, VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR);
 
     // TLAS
-    std::vector<VkAccelerationStructureInstanceKHR> tlas;
-    tlas.reserve(renderMeshes.size());
-    uint32_t i = 0;
-    for (const auto& [p_mesh, id] : renderMeshes)
-    {
-        VkGeometryInstanceFlagsKHR flags{};
-        if (p_mesh->mat.alphaMode == 0 || (p_mesh->mat.pbrBaseColorFactor.w == 1.0f && p_mesh->mat.pbrBaseColorTexture == -1))
-            flags |= VK_GEOMETRY_INSTANCE_FORCE_OPAQUE_BIT_KHR;
-        // Need to skip the cull flag in traceray_rtx for double sided materials
-        if (p_mesh->mat.doubleSided == 1)
-            flags |= VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
-
-        VkAccelerationStructureInstanceKHR rayInst{};
-        rayInst.transform = toTransformMatrixKHR(resManager->getRenderMesh(id).tranformMatrix); // Position of the instance
-        rayInst.instanceCustomIndex = id; // gl_InstanceCustomIndexEXT
-        rayInst.accelerationStructureReference = rtBuilder->getBlasDeviceAddress(i);
-        rayInst.flags = flags;
-        rayInst.mask = 0xFF; //  Only be hit if rayMask & instance.mask != 0
-        rayInst.instanceShaderBindingTableRecordOffset = 0; // We will use the same hit group for all objects
-        tlas.emplace_back(rayInst);
-
-        ++i;
-    }
-    rtBuilder->buildTlas(tlas, 
+    rtBuilder->buildTlas(getTlasInstances(resManager, renderMeshes, *rtBuilder), 
         VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR);
+    return rtBuilder;
+}
+
+void VulkanApplication::stopGeometryDefragmentation()
+{
+    auto& allocator = device->getAllocator();
+    if (allocator.isDefragmentationPassOpen())
+        resManager->endGeometryDefragmentationPass();
+    if (allocator.isDefragmenting())
+        allocator.endDefragmentation();
+    defragmentGeometry = false;
+}
 
+void VulkanApplication::createRayTracingPipeline()
+{
     std::vector<VulkanShaderModule> rtShaders{};
     rtShaders.emplace_back(resManager->createShaderModule("shaders/spv/raytrace.rgen.spv", VK_SHADER_STAGE_RAYGEN_BIT_KHR, "main"));
     rtShaders.back().addShaderResourcePushConstant(0, sizeof(PushConstantRayTracing));
@@ -236,7 +384,7 @@ void VulkanApplication::buildRayTracing()
     rtShaders.back().addShaderResourceUniform(ShaderResourceType::AccelerationStructure, 0, 0);
     rtShaders.back().addShaderResourceUniform(ShaderResourceType::StorageImage, 0, 1);
 
-    rtBuilder->createRayTracingPipeline(rtShaders, *graphicBuilder->getGlobalData().descSetLayout, *graphicBuilder->getLightData().descSetLayout);
+    rtBuilder->createRayTracingPipeline(*graphicBuilder->getOffscreenColor(), rtShaders, *graphicBuilder->getGlobalData().descSetLayout, *graphicBuilder->getLightData().descSetLayout);
     rtBuilder->createRtShaderBindingTable();
 }
 
@@ -249,6 +397,8 @@ void VulkanApplication::mainLoop()
     int sceneSum = sizeof(sceneNames) / sizeof(char*);
 
     static int sceneItem = 0;
+    // Generated by the Stress Scene controls of the Scenes panel
+    static StressSceneOptions stressOptions{};
 
     loadScene(sceneFilePath[sceneItem]);
 
@@ -261,6 +411,22 @@ void VulkanApplication::mainLoop()
     {
         glfwPollEvents();
 
+        // Frame boundary, nothing of the current scene is being recorded
+        if (auto loaded = sceneLoader->poll())
+            activateScene(std::move(loaded));
+
+        // The old blocks of a defragmentation pass retire with the frames recorded before it. One pass runs
+        // per frame, none while a scene loads into a resource manager whose ranges would not follow.
+        if (device->getAllocator().isDefragmentationPassOpen()) {
+            renderContext->waitFrames();
+            resManager->endGeometryDefragmentationPass();
+        }
+        if (defragmentGeometry && !sceneLoader->isLoading()) {
+            defragmentGeometry = resManager->beginGeometryDefragmentationPass();
+            if (defragmentGeometry)
+                graphicBuilder->updateObjDescs();
+        }
+
         bool changed = false;
         bool sceneChanged = false;
         bool cameraChanged = false;
@@ -379,7 +545,65 @@ void VulkanApplication::mainLoop()
         if (ImGui::CollapsingHeader("Scenes", ImGuiTreeNodeFlags_DefaultOpen))
         {
             sceneChanged = ImGui::Combo("Scene", &sceneItem, sceneNames, sceneSum);
-            changed |= sceneChanged;
+
+            if (sceneLoader->isLoading()) {
+                ImGui::Text("Loading %s", sceneLoader->getFilename().c_str());
+                ImGui::ProgressBar(sceneLoader->getProgress(), ImVec2(-1.0f, 0.0f), getSceneLoadPhaseName(sceneLoader->getPhase()));
+            }
+            else if (!sceneLoader->getError().empty()) {
+                ImGui::TextWrapped("Failed to load %s: %s", sceneLoader->getFilename().c_str(), sceneLoader->getError().c_str());
+            }
+
+            if (ImGui::TreeNode("Stress Scene")) {
+                int instanceNum = static_cast<int>(stressOptions.instanceNum);
+                int pointLightNum = static_cast<int>(stressOptions.pointLightNum);
+                int dirLightNum = static_cast<int>(stressOptions.dirLightNum);
+                if (ImGui::InputInt("Instances", &instanceNum, 100, 10000))
+                    stressOptions.instanceNum = static_cast<uint32_t>(std::clamp(instanceNum, 1, 1000000));
+                ImGui::SliderFloat("Unique Ratio", &stressOptions.uniqueRatio, 0.0f, 1.0f);
+                // The scene keeps its default directional light
+                if (ImGui::SliderInt("Point Lights", &pointLightNum, 0, static_cast<int>(MAX_LIGHT_NUM)))
+                    stressOptions.pointLightNum = static_cast<uint32_t>(pointLightNum);
+                if (ImGui::SliderInt("Dir Lights", &dirLightNum, 0, static_cast<int>(MAX_LIGHT_NUM) - 1))
+                    stressOptions.dirLightNum = static_cast<uint32_t>(dirLightNum);
+                if (ImGui::Button("Generate"))
+                    loadSceneAsync(getStressSceneRequest(stressOptions).c_str());
+                ImGui::TreePop();
+            }
+
+            const auto& textureStats = resManager->getTextureCacheStats();
+            ImGui::Text("Textures %u (%.1f MiB), %u of %u requests shared, %.1f MiB saved", 
+                textureStats.textures, textureStats.residentBytes / (1024.0 * 1024.0),
+                textureStats.pathHits + textureStats.contentHits, textureStats.requests,
+                textureStats.savedBytes / (1024.0 * 1024.0));
+
+            const auto& streamingStats = resManager->getTextureStreamingStats();
+            int budget = static_cast<int>(streamingStats.budget >> 20);
+            if (ImGui::SliderInt("Texture Budget (MiB)", &budget, 16, 4096))
+                resManager->setTextureStreamingBudget(VkDeviceSize(budget) << 20);
+            ImGui::Text("Streaming %u textures, %.1f of %.1f MiB resident, %u below wanted level, %u swaps, %u uploading", 
+                streamingStats.textures, streamingStats.residentBytes / (1024.0 * 1024.0),
+                streamingStats.hostBytes / (1024.0 * 1024.0), streamingStats.belowWanted, streamingStats.swaps,
+                streamingStats.uploading);
+
+            const auto arenaStats = resManager->getGeometryArenaStats();
+            ImGui::Text("Geometry %u ranges in %u buffers, %.1f of %.1f MiB used",
+                arenaStats.ranges, arenaStats.blocks,
+                arenaStats.usedBytes / (1024.0 * 1024.0), arenaStats.blockBytes / (1024.0 * 1024.0));
+
+            const auto memoryStats = device->getAllocator().getStats();
+            ImGui::Text("Device memory %u allocations in %u blocks, %.1f of %.1f MiB used",
+                memoryStats.allocations, memoryStats.blocks,
+                memoryStats.allocatedBytes / (1024.0 * 1024.0), memoryStats.blockBytes / (1024.0 * 1024.0));
+
+            if (defragmentGeometry)
+                ImGui::Text("Defragmenting geometry");
+            else if (ImGui::Button("Defragment Geometry"))
+                defragmentGeometry = true;
+            const auto& defragStats = device->getAllocator().getDefragmentationStats();
+            ImGui::Text("Last defragmentation moved %u buffers (%.1f MiB), freed %u blocks (%.1f MiB)",
+                defragStats.movedBuffers, defragStats.movedBytes / (1024.0 * 1024.0),
+                defragStats.freedBlocks, defragStats.freedBytes / (1024.0 * 1024.0));
         }
 
         if (ImGui::CollapsingHeader("Camera"))
@@ -423,13 +647,12 @@ void VulkanApplication::mainLoop()
 
         drawFrame();
 
-        if (sceneChanged) {
-            loadScene(sceneFilePath[sceneItem]);
-            continue;
-        }
+        if (sceneChanged)
+            loadSceneAsync(sceneFilePath[sceneItem]);
     }
 
     device->waitIdle();
+    stopGeometryDefragmentation();
 }
 
 void VulkanApplication::drawFrame()
@@ -523,8 +746,6 @@ void VulkanApplication::recordCommand(VulkanCommandBuffer &commandBuffer, const
     
     commandBuffer.bindPipeline(renderPipeline->getGraphicsPipeline());
 
-    auto extent = renderContext->getSwapChain().getExtent();
-    auto aspectRatio = static_cast<float>(extent.width) / static_cast<float>(extent.height);
     vkCmdPushConstants(commandBuffer.getHandle(), 
         renderPipeline->getPipelineLayout().getHandle(), 
         VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(pcPost), &pcPost);
@@ -546,13 +767,11 @@ void VulkanApplication::recordCommand(VulkanCommandBuffer &commandBuffer, const
     }
 }
 
-void VulkanApplication::updateUniformBuffer(uint32_t currentImage)
+void VulkanApplication::updateUniformBuffer(uint32_t /*currentImage*/)
 {
-    static auto startTime = std::chrono::high_resolution_clock::now();
-    static auto lastTime = startTime;
+    static auto lastTime = std::chrono::high_resolution_clock::now();
 
     auto currentTime = std::chrono::high_resolution_clock::now();
-    float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
     float deltaTime = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - lastTime).count();
     lastTime = currentTime;
 
@@ -560,46 +779,30 @@ void VulkanApplication::updateUniformBuffer(uint32_t currentImage)
     auto view = camera->calcLookAt();
     view = processInput(window->getHandle(), view, *camera, deltaTime);
 
-    auto extent = renderContext->getSwapChain().getExtent();
-
-    for (const auto& [mesh, id] : renderMeshes) {
-        resManager->getRenderMesh(id).tranformMatrix = 
-            mesh->parent->transComp.getTransformMatrix() * mesh->transComp.getTransformMatrix();
+    // Only subtrees whose transforms changed since the last frame are touched
+    if (scene->updateTransforms() > 0) {
+        const auto& graph = scene->getGraph();
+        for (auto [first, end] : graph.getChangedRanges()) {
+            for (NodeID node = first; node < end; ++node) {
+                for (const auto& [mesh, id] : nodeRenderMeshes[node])
+                    resManager->getRenderMesh(id).tranformMatrix = graph.getWorldTransform(node) * mesh->transComp.getTransformMatrix();
+            }
+        }
     }
 
     graphicBuilder->update(deltaTime, scene.get());
+    // Streamed textures changed their levels, the accumulated samples used the old ones
+    if (resManager->getTextureStreamingStats().swaps > 0)
+        resetFrameCount();
 
-    pcRay.dirLightNum = scene->getDirLightMap().size();
-    pcRay.pointLightNum = scene->getPointLightMap().size();
+    pcRay.dirLightNum = std::min(MAX_LIGHT_NUM, toU32(scene->getDirLightMap().size()));
+    pcRay.pointLightNum = std::min(MAX_LIGHT_NUM, toU32(scene->getPointLightMap().size()));
 }
 
 void VulkanApplication::updateTlas()
 {
-    std::vector<VkAccelerationStructureInstanceKHR> tlas;
-    tlas.reserve(renderMeshes.size());
-    uint32_t i = 0;
-    for (const auto& [p_mesh, id] : renderMeshes)
-    {
-        VkGeometryInstanceFlagsKHR flags{};
-        if (p_mesh->mat.alphaMode == 0 || (p_mesh->mat.pbrBaseColorFactor.w == 1.0f && p_mesh->mat.pbrBaseColorTexture == -1))
-            flags |= VK_GEOMETRY_INSTANCE_FORCE_OPAQUE_BIT_KHR;
-        // Need to skip the cull flag in traceray_rtx for double sided materials
-        if (p_mesh->mat.doubleSided == 1)
-            flags |= VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
-
-        VkAccelerationStructureInstanceKHR rayInst{};
-        rayInst.transform = toTransformMatrixKHR(resManager->getRenderMesh(id).tranformMatrix); // Position of the instance
-        rayInst.instanceCustomIndex = id; // gl_InstanceCustomIndexEXT
-        rayInst.accelerationStructureReference = rtBuilder->getBlasDeviceAddress(i);
-        rayInst.flags = flags;
-        rayInst.mask = 0xFF; //  Only be hit if rayMask & instance.mask != 0
-        rayInst.instanceShaderBindingTableRecordOffset = 0; // We will use the same hit group for all objects
-        tlas.emplace_back(rayInst);
-
-        ++i;
-    }
     rtBuilder->buildTlas(
-        tlas,
+        getTlasInstances(*resManager, renderMeshes, *rtBuilder),
         VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR, 
         true
     );
@@ -770,7 +973,7 @@ void VulkanApplication::mouse_callback(GLFWwindow* window, double xpos, double y
     lastY = ypos;
 }
 
-void VulkanApplication::scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+void VulkanApplication::scroll_callback(GLFWwindow* window, double /*xoffset*/, double yoffset)
 {
     const float SCROLL_SENSITIVITY = 0.3;
     auto app = reinterpret_cast<VulkanApplication*>(glfwGetWindowUserPointer(window));
@@ -798,7 +1001,7 @@ void VulkanApplication::drop_callback(GLFWwindow* window, int count, const char*
             }
         }
         std::cout << pathNew << std::endl;
-        app->loadScene(pathNew.c_str());
+        app->loadSceneAsync(pathNew.c_str());
     }
     //if (count == 1)
     //{
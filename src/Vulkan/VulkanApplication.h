@@ -12,6 +12,7 @@
 #include "../Camera.h"
 #include "../Model.h"
 #include "VulkanInclude.h"
+#include "VulkanSceneLoader.h"
 #include "../GUI/GUI.h"
 
 class GlfwWindow;
@@ -57,9 +58,14 @@ public:
 
     ~VulkanApplication();
 
+    // Blocks until the scene is loaded and swapped in
     void loadScene(const char* filename);
 
-    void buildRayTracing();
+    // Loads on a background thread while the current scene keeps rendering,
+    // mainLoop swaps the new scene in at a frame boundary
+    void loadSceneAsync(const char* filename);
+
+    void createRayTracingPipeline();
 
     void mainLoop();
 
@@ -88,6 +94,8 @@ private:
 
 	std::unique_ptr<VulkanDevice> device;
 
+    // Pool resManager uploads with, each loaded scene brings its own
+    std::unique_ptr<VulkanCommandPool> resCommandPool;
     std::unique_ptr<VulkanResourceManager> resManager;
     std::unique_ptr<VulkanRayTracingBuilder> rtBuilder;
     std::unique_ptr<VulkanGraphicsBuilder> graphicBuilder;
@@ -98,15 +106,30 @@ private:
     std::unique_ptr<VulkanRenderPipeline> renderPipeline;
 
     std::unique_ptr<Scene> scene;
+    std::unique_ptr<VulkanSceneLoader> sceneLoader;
     
     SceneData postData;
     std::unordered_map<const Mesh*, RenderMeshID> renderMeshes;
+    // RenderMeshes of every scene graph node, refreshed when the node's world transform changes
+    std::vector<std::vector<std::pair<const Mesh*, RenderMeshID>>> nodeRenderMeshes;
 
     std::unique_ptr<GUI> gui;
     bool useRayTracer = true;
     glm::vec4 clearColor{ 0.5f, 0.8f, 0.9f, 1.0f };
     PushConstantRayTracing pcRay{};
     PushConstantPost pcPost{ 0, 2, 1.0, 1.0, 1.0 };
+    // Set by the GUI, a defragmentation pass runs at each frame boundary until nothing is left to move
+    bool defragmentGeometry{ false };
+
+    // Thread safe: only creates new objects, uploads through its own command pool
+    std::unique_ptr<LoadedScene> createScene(const std::string& filename, SceneLoadProgress& progress) const;
+    // Thread safe like createScene, builds on the command pool of resManager
+    std::unique_ptr<VulkanRayTracingBuilder> buildAccelerationStructures(
+        VulkanResourceManager& resManager, const std::unordered_map<const Mesh*, RenderMeshID>& renderMeshes) const;
+    // Render thread, replaces the current scene and rebuilds the renderers around it
+    void activateScene(std::unique_ptr<LoadedScene> loaded);
+    // Ends the open defragmentation pass, the frames recorded before it must have retired
+    void stopGeometryDefragmentation();
 
     std::vector<const char*> getRequiredInstanceExtensions();
     static void mouse_callback(GLFWwindow* window, double xpos, double ypos);
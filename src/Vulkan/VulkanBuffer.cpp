@@ -4,39 +4,29 @@
 
 #include <cstring>
 
-VulkanBuffer::VulkanBuffer(const VulkanDevice &device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) : 
-    device{device}, size{size}, usage{usage}, properties{properties}
+VulkanBuffer::VulkanBuffer(const VulkanDevice &device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+    bool movable, BufferMapping mapping) :
+    device{device}, size{size}, usage{usage}, properties{properties}, movable{movable}
 {
-    VkBufferCreateInfo bufferInfo{};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = size;
-    bufferInfo.usage = usage;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    // Defragmentation would move the mapping along with the memory
+    persistent = (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !movable && mapping == BufferMapping::Persistent;
 
-    if (vkCreateBuffer(device.getHandle(), &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
-    {
-        throw std::runtime_error("failed to create buffer!");
+    // Moves are copies on the GPU
+    if (movable) {
+        this->usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
     }
 
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(device.getHandle(), buffer, &memRequirements);
-
-    VkMemoryAllocateFlagsInfo allocFlagsInfo{ VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO };
-    if (hasFlag(usage, VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT)) {
-        allocFlagsInfo.flags |= VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
-    }
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = device.getGPU().findMemoryType(memRequirements.memoryTypeBits, properties);
-    allocInfo.pNext = &allocFlagsInfo;
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = this->usage;
+    device.setUploadSharing(bufferInfo);
 
-    if (vkAllocateMemory(device.getHandle(), &allocInfo, nullptr, &memory) != VK_SUCCESS)
-    {
-        throw std::runtime_error("failed to allocate buffer memory!");
+    allocation = device.getAllocator().createBuffer(bufferInfo, properties, buffer, persistent ? &mappedData : nullptr);
+    coherent = (device.getAllocator().getMemoryProperties(allocation) & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+    if (movable) {
+        device.getAllocator().setMovable(allocation, this);
     }
-
-    vkBindBufferMemory(device.getHandle(), buffer, memory, 0);
 }
 
 VulkanBuffer::VulkanBuffer(VulkanBuffer&& other) noexcept:
@@ -44,41 +34,66 @@ VulkanBuffer::VulkanBuffer(VulkanBuffer&& other) noexcept:
     size{other.size},
     usage{other.usage},
     properties{other.properties},
+    movable{other.movable},
+    persistent{other.persistent},
+    coherent{other.coherent},
     buffer{other.buffer},
-    memory{other.memory},
+    allocation{other.allocation},
     mappedData{other.mappedData}
 {
     other.buffer = VK_NULL_HANDLE;
-    other.memory = VK_NULL_HANDLE;
+    other.allocation = VK_NULL_HANDLE;
+    if (movable && allocation != VK_NULL_HANDLE) {
+        device.getAllocator().setMovable(allocation, this);
+    }
 }
 
 VulkanBuffer::~VulkanBuffer()
 {
     if (buffer != VK_NULL_HANDLE) {
-        vkDestroyBuffer(device.getHandle(), buffer, nullptr);
-        vkFreeMemory(device.getHandle(), memory, nullptr);
+        // VMA frees no allocation that is still mapped, the persistent mapping it undoes itself
+        if (mappedData != nullptr && !persistent)
+            unmap();
+        device.getAllocator().destroyBuffer(buffer, allocation);
     }
 }
 
 uint8_t* VulkanBuffer::map()
 {
-    vkMapMemory(device.getHandle(), memory, this->offset, this->size, 0, &mappedData);
-    return reinterpret_cast<uint8_t*>(mappedData);
+    if (!persistent)
+        mappedData = device.getAllocator().map(allocation);
+    return mappedData;
 }
 
 void VulkanBuffer::unmap()
 {
     assert(mappedData != nullptr);
-    vkUnmapMemory(device.getHandle(), memory);
+    if (persistent)
+        return;
+    device.getAllocator().unmap(allocation);
+    mappedData = nullptr;
 }
 
 void VulkanBuffer::update(const void *data, VkDeviceSize size, VkDeviceSize offset)
 {
     auto* mdata = map();
-    memcpy(reinterpret_cast<uint8_t *>(mdata) + offset, data, static_cast<size_t>(size));
+    memcpy(mdata + offset, data, static_cast<size_t>(size));
+    flush(offset, size);
     unmap();
 }
 
+void VulkanBuffer::flush(VkDeviceSize offset, VkDeviceSize size)
+{
+    if (!coherent)
+        device.getAllocator().flush(allocation, offset, size);
+}
+
+void VulkanBuffer::invalidate(VkDeviceSize offset, VkDeviceSize size)
+{
+    if (!coherent)
+        device.getAllocator().invalidate(allocation, offset, size);
+}
+
 VkDescriptorBufferInfo VulkanBuffer::getBufferInfo() const
 {
     VkDescriptorBufferInfo bufferInfo{};
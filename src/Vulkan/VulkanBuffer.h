@@ -2,34 +2,61 @@
 
 #include "VulkanCommon.h"
 #include "VulkanDevice.h"
+#include "VulkanAllocator.h"
+
+// How a host visible buffer is mapped. Persistent maps it once at creation, so writes are plain
+// copies into getMappedData. OnDemand maps it in each map or update call.
+enum class BufferMapping
+{
+    Persistent,
+    OnDemand
+};
 
 class VulkanBuffer
 {
 public:
-    VulkanBuffer(const VulkanDevice& device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+    // Memory comes from the device's VulkanAllocator. A movable buffer may be moved by
+    // a defragmentation pass of VulkanAllocator, it gets a new handle then and is mapped on demand.
+    // mapping only matters for HOST_VISIBLE properties.
+    VulkanBuffer(const VulkanDevice& device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+        bool movable = false, BufferMapping mapping = BufferMapping::Persistent);
     VulkanBuffer(VulkanBuffer&& other) noexcept;
     VulkanBuffer(const VulkanBuffer&) = delete;
 
     ~VulkanBuffer();
 
+    // On a persistently mapped buffer map returns the mapping and unmap does nothing
     uint8_t* map();
     void unmap();
+    // Copies data into the mapped memory and flushes it
     void update(const void* data, VkDeviceSize size, VkDeviceSize offset = 0);
+    // Make host writes visible to the device and device writes visible to the host.
+    // Only memory that is not HOST_COHERENT needs them, they return right away otherwise.
+    void flush(VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+    void invalidate(VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
 
     VkDescriptorBufferInfo getBufferInfo() const;
 
     VkBuffer getHandle() const;
+    VkDeviceSize getSize() const { return size; }
+    // Null unless the buffer is persistently mapped
+    uint8_t* getMappedData() const { return persistent ? mappedData : nullptr; }
+    bool isCoherent() const { return coherent; }
 
 private:
+    friend class VulkanAllocator;
+
 	const VulkanDevice& device;
 
-    VkDeviceSize offset{ 0 };
 	VkDeviceSize size;
 	VkBufferUsageFlags usage;
 	VkMemoryPropertyFlags properties;
+    bool movable;
+    bool persistent{ false };
+    bool coherent{ false };
 
     VkBuffer buffer{ VK_NULL_HANDLE };
-    VkDeviceMemory memory{ VK_NULL_HANDLE };
+    VmaAllocation allocation{ VK_NULL_HANDLE };
 
-    void* mappedData{ nullptr };
-};
\ No newline at end of file
+    uint8_t* mappedData{ nullptr };
+};
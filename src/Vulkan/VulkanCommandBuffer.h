@@ -35,10 +35,20 @@ public:
 
 	void drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance);
 
-	void copyBufferToImage(const VulkanBuffer& buffer, const VulkanImage& image);
+	// Base level of every layer, packed one after the other from bufferOffset on
+	void copyBufferToImage(const VulkanBuffer& buffer, const VulkanImage& image, VkDeviceSize bufferOffset = 0);
+
+	void copyBufferToImage(const VulkanBuffer& buffer, const VulkanImage& image, const std::vector<VkBufferImageCopy>& regions);
 
 	void copyBuffer(VulkanBuffer& srcBuffer, VulkanBuffer& dstBuffer, VkDeviceSize size);
 
+	void copyBuffer(VulkanBuffer& srcBuffer, VulkanBuffer& dstBuffer, const std::vector<VkBufferCopy>& regions);
+
+	void transitionImageLayout(const VulkanImage& image, VkImageLayout oldLayout, VkImageLayout newLayout);
+
+	// Blits every level from the one above, the image goes from TRANSFER_DST_OPTIMAL to SHADER_READ_ONLY_OPTIMAL
+	void generateMipmaps(const VulkanImage& image);
+
 	const VkCommandBuffer& getHandle() const;
 
 private:
@@ -3,6 +3,7 @@
 #include "VulkanImage.h"
 #include "VulkanCommandBuffer.h"
 #include "VulkanQueue.h"
+#include "VulkanFence.h"
 #include "VulkanCommandPool.h"
 
 VulkanCommandPool::VulkanCommandPool(const VulkanDevice& device, uint32_t queueFamilyIndex) :
@@ -33,90 +34,33 @@ std::shared_ptr<VulkanCommandBuffer> VulkanCommandPool::beginSingleTimeCommands(
 void VulkanCommandPool::endSingleTimeCommands(VulkanCommandBuffer& commandBuffer, const VulkanQueue& queue) const {
     commandBuffer.end();
 
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer.getHandle();
-
-    queue.submit(commandBuffer);
-    queue.waitIdle();
+    // Wait for this submission only, the queue may also be busy with frames of the render loop
+    VulkanFence fence{ device };
+    fence.reset();
+    queue.submit(commandBuffer, {}, {}, {}, fence.getHandle());
+    fence.wait();
 }
 
 void VulkanCommandPool::transitionImageLayout(const VulkanImage &image, VkImageLayout oldLayout, VkImageLayout newLayout, const VulkanQueue& queue) const {
-    VkFormat format = image.getFormat();
     auto commandBuffer = beginSingleTimeCommands();
 
-    VkImageMemoryBarrier barrier{};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.oldLayout = oldLayout;
-    barrier.newLayout = newLayout;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image = image.getHandle();
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = image.getMipLevels();
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = image.getArrayLayers();
-
-    if (newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-        if (hasStencilComponent(format)) {
-            barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
-        }
-    }
-    else {
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    }
-
-    VkPipelineStageFlags sourceStage;
-    VkPipelineStageFlags destinationStage;
-
-    if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-        sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    }
-    else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    }
-    else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    commandBuffer->transitionImageLayout(image, oldLayout, newLayout);
 
-        sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        destinationStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    }
-    else {
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = 0;
+    endSingleTimeCommands(*commandBuffer, queue);
+}
 
-        sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        destinationStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-        //throw std::invalid_argument("unsupported layout transition!");
-    }
+void VulkanCommandPool::copyBufferToImage(const VulkanBuffer& buffer, const VulkanImage& image, const VulkanQueue& queue) const {
+    auto commandBuffer = beginSingleTimeCommands();
 
-    vkCmdPipelineBarrier(
-        commandBuffer->getHandle(),
-        sourceStage, destinationStage,
-        0,
-        0, nullptr,
-        0, nullptr,
-        1, &barrier
-    );
+    commandBuffer->copyBufferToImage(buffer, image);
 
     endSingleTimeCommands(*commandBuffer, queue);
 }
 
-void VulkanCommandPool::copyBufferToImage(const VulkanBuffer& buffer, const VulkanImage& image, const VulkanQueue& queue) const {
+void VulkanCommandPool::copyBufferToImage(const VulkanBuffer& buffer, const VulkanImage& image, const std::vector<VkBufferImageCopy>& regions, const VulkanQueue& queue) const {
     auto commandBuffer = beginSingleTimeCommands();
 
-    commandBuffer->copyBufferToImage(buffer, image);
+    commandBuffer->copyBufferToImage(buffer, image, regions);
 
     endSingleTimeCommands(*commandBuffer, queue);
 }
@@ -131,99 +75,9 @@ void VulkanCommandPool::copyBuffer(VulkanBuffer& srcBuffer, VulkanBuffer& dstBuf
 
 void VulkanCommandPool::generateMipmaps(const VulkanImage& image, const VulkanQueue& queue) const
 {
-    VkFormatProperties formatProperties;
-    vkGetPhysicalDeviceFormatProperties(device.getGPU().getHandle(), image.getFormat(), &formatProperties);
-    if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
-        throw std::runtime_error("texture image format does not support linear blitting!");
-    }
-
-    uint32_t arrayLayers = image.getArrayLayers();
-
     auto commandBuffer = beginSingleTimeCommands();
 
-    // we will resue this barrier info
-    VkImageMemoryBarrier barrier{};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.image = image.getHandle();
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = arrayLayers;
-    barrier.subresourceRange.levelCount = 1;
-
-    int32_t mipWidth = image.getExtent().width;
-    int32_t mipHeight = image.getExtent().height;
-
-    for (uint32_t i = 1; i < image.getMipLevels(); i++) {
-        // generate mipmap i, trans from mimap i - 1
-        barrier.subresourceRange.baseMipLevel = i - 1;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-
-        vkCmdPipelineBarrier(
-            commandBuffer->getHandle(),
-            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
-            0,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier
-        );
-
-        VkImageBlit blit{};
-        blit.srcOffsets[0] = { 0, 0, 0 };
-        blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
-
-        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        blit.srcSubresource.mipLevel = i - 1; // last mipmap
-        blit.srcSubresource.baseArrayLayer = 0;
-        blit.srcSubresource.layerCount = arrayLayers;
-
-        blit.dstOffsets[0] = { 0, 0, 0 };
-        blit.dstOffsets[1] = { mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1 };
-
-        blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        blit.dstSubresource.mipLevel = i; // new mipmap
-        blit.dstSubresource.baseArrayLayer = 0;
-        blit.dstSubresource.layerCount = arrayLayers;
-
-        vkCmdBlitImage(commandBuffer->getHandle(),
-            image.getHandle(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-            image.getHandle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            1, &blit,
-            VK_FILTER_LINEAR);
-
-        // the i - 1 mipmap will nerver be used again, transition to read only
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        vkCmdPipelineBarrier(commandBuffer->getHandle(),
-            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier);
-
-        // shrink size
-        if (mipWidth > 1) mipWidth /= 2;
-        if (mipHeight > 1) mipHeight /= 2;
-    }
-
-    // transition the last mipmap to readonly
-    barrier.subresourceRange.baseMipLevel = image.getMipLevels() - 1;
-    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-    vkCmdPipelineBarrier(commandBuffer->getHandle(),
-        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-        0, nullptr,
-        0, nullptr,
-        1, &barrier);
+    commandBuffer->generateMipmaps(image);
 
     endSingleTimeCommands(*commandBuffer, queue);
 }
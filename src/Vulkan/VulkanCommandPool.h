@@ -22,6 +22,9 @@ public:
 
     void copyBufferToImage(const VulkanBuffer& buffer, const VulkanImage& image, const VulkanQueue& queue) const;
 
+    // One region per mip level or layer stored in the buffer
+    void copyBufferToImage(const VulkanBuffer& buffer, const VulkanImage& image, const std::vector<VkBufferImageCopy>& regions, const VulkanQueue& queue) const;
+
     void copyBuffer(VulkanBuffer& srcBuffer, VulkanBuffer& dstBuffer, VkDeviceSize size, const VulkanQueue& queue) const;
 
     void generateMipmaps(const VulkanImage& image, const VulkanQueue& queue) const;
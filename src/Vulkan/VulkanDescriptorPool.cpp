@@ -5,7 +5,7 @@
 
 VulkanDescriptorPool::VulkanDescriptorPool(
     const VulkanDevice& device, const std::vector<VkDescriptorPoolSize>& poolSizes, uint32_t maxSets) :
-    device{ device }, poolSizes{ poolSizes }, maxSets{ maxSets }
+    device{ device }, maxSets{ maxSets }, poolSizes{ poolSizes }
 {
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
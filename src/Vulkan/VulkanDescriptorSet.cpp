@@ -35,6 +35,8 @@ VulkanDescriptorSet::~VulkanDescriptorSet() {
 void VulkanDescriptorSet::update()
 {
     vkUpdateDescriptorSets(device.getHandle(), toU32(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    // Array writes point into their caller's vectors, never apply them twice
+    descriptorWrites.clear();
 }
 
 VkWriteDescriptorSet VulkanDescriptorSet::makeWrite(uint32_t dstBinding, uint32_t arrayElement)
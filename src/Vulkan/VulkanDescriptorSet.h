@@ -19,6 +19,7 @@ public:
 
     ~VulkanDescriptorSet();
 
+	// Applies the writes added since the last update
 	void update();
 	VkWriteDescriptorSet makeWrite(uint32_t	dstBinding, uint32_t arrayElement = 0);
 	void addWrite(uint32_t dstBinding, const VkDescriptorBufferInfo& bufferInfo, uint32_t arrayElement = 0);
@@ -71,9 +71,8 @@ VulkanDescriptorSetLayout::VulkanDescriptorSetLayout(const VulkanDevice& device,
 }
 
 VulkanDescriptorSetLayout::VulkanDescriptorSetLayout(VulkanDescriptorSetLayout&& other) noexcept :
-    device{ other.device }, set{ other.set },
-    shaderResources{ other.shaderResources } , bindings{ other.bindings }, bindingFlags{ other.bindingFlags },
-    descriptorSetLayout{ other.descriptorSetLayout }
+    device{ other.device }, set{ other.set }, descriptorSetLayout{ other.descriptorSetLayout },
+    shaderResources{ other.shaderResources } , bindings{ other.bindings }, bindingFlags{ other.bindingFlags }
 {
     other.descriptorSetLayout = VK_NULL_HANDLE;
 }
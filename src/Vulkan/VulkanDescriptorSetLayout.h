@@ -23,11 +23,11 @@ public:
     uint32_t getSetIndex() const;
 
 private:
+    const VulkanDevice& device;
+
     uint32_t set;
     VkDescriptorSetLayout descriptorSetLayout;
     std::vector<VulkanShaderResource> shaderResources;
     std::vector<VkDescriptorSetLayoutBinding> bindings;
     std::vector<VkDescriptorSetLayoutCreateFlags> bindingFlags;
-
-    const VulkanDevice& device;
 };
\ No newline at end of file
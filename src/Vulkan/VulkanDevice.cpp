@@ -2,7 +2,9 @@
 
 #include "VulkanQueue.h"
 #include "VulkanCommandPool.h"
+#include "VulkanAllocator.h"
 
+#include <algorithm>
 #include <cstring>
 
 VulkanDevice::VulkanDevice(const VulkanPhysicalDevice &physicalDevice, VkSurfaceKHR surface,
@@ -16,10 +18,23 @@ VulkanDevice::VulkanDevice(const VulkanPhysicalDevice &physicalDevice, VkSurface
 
     std::vector<const char *> enabledExtensions(requiredExtentions.begin(), requiredExtentions.end());
 
+    auto isEnabled = [&enabledExtensions](const char* name) {
+        return std::find_if(enabledExtensions.begin(), enabledExtensions.end(), [name](const char* extension) {
+            return strcmp(extension, name) == 0; }) != enabledExtensions.end();
+    };
+    const auto& availableExtensions = physicalDevice.getExtensions();
+    // Lets VMA track heap usage against the budget of the driver
+    features.memoryBudget = std::find_if(availableExtensions.begin(), availableExtensions.end(), [](const VkExtensionProperties& extension) {
+        return strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0; }) != availableExtensions.end();
+    if (features.memoryBudget && !isEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+        enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
     QueueFamilyIndices indices = physicalDevice.findQueueFamilies(surface);
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+    if (indices.transferFamily)
+        uniqueQueueFamilies.insert(indices.transferFamily.value());
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -36,6 +51,8 @@ VulkanDevice::VulkanDevice(const VulkanPhysicalDevice &physicalDevice, VkSurface
     deviceFeatures.features.geometryShader = VK_BOOL(features.geometryShader);
     deviceFeatures.features.shaderInt64 = VK_TRUE;
     deviceFeatures.features.imageCubeArray = VK_TRUE;
+    // KTX2 textures may hold BCn blocks
+    deviceFeatures.features.textureCompressionBC = physicalDevice.getFeatures2().features.textureCompressionBC;
 
     VkPhysicalDeviceShaderClockFeaturesKHR clockFreature{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_CLOCK_FEATURES_KHR };
     if (features.shaderClock) {
@@ -53,6 +70,8 @@ VulkanDevice::VulkanDevice(const VulkanPhysicalDevice &physicalDevice, VkSurface
     features12.runtimeDescriptorArray = VK_TRUE;
     features12.descriptorIndexing = VK_TRUE;
     features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    // VulkanUploadContext counts its submissions on a timeline semaphore
+    features12.timelineSemaphore = VK_TRUE;
 
     clockFreature.pNext = &features12;
 
@@ -95,14 +114,22 @@ VulkanDevice::VulkanDevice(const VulkanPhysicalDevice &physicalDevice, VkSurface
         throw std::runtime_error("failed to create logical device!");
     }
 
+    allocator = std::make_unique<VulkanAllocator>(*this, features.memoryBudget);
+
     graphicsQueue = std::make_unique<VulkanQueue>(*this, indices.graphicsFamily.value());
     presentQueue = std::make_unique<VulkanQueue>(*this, indices.presentFamily.value());
+    if (indices.transferFamily) {
+        transferQueue = std::make_unique<VulkanQueue>(*this, indices.transferFamily.value());
+        uploadFamilies[0] = indices.graphicsFamily.value();
+        uploadFamilies[1] = indices.transferFamily.value();
+    }
 
     commandPool = std::make_unique<VulkanCommandPool>(*this, indices.graphicsFamily.value());
 }
 
 VulkanDevice::~VulkanDevice() {
     commandPool = nullptr;
+    allocator = nullptr;
 
     if (device != VK_NULL_HANDLE) {
         vkDestroyDevice(device, nullptr);
@@ -110,6 +137,7 @@ VulkanDevice::~VulkanDevice() {
 }
 
 void VulkanDevice::waitIdle() const {
+    std::lock_guard<std::mutex> lock(queueMutex);
     vkDeviceWaitIdle(device);
 }
 
@@ -118,5 +146,20 @@ VkDevice VulkanDevice::getHandle() const { return device; }
 const VulkanPhysicalDevice& VulkanDevice::getGPU() const { return physicalDevice; }
 const VulkanDeviceFeature& VulkanDevice::getFeatures() const { return features; }
 VulkanCommandPool& VulkanDevice::getCommandPool() const { return *commandPool; }
+
+VulkanAllocator& VulkanDevice::getAllocator() const { return *allocator; }
 VulkanQueue& VulkanDevice::getGraphicsQueue() const { return *graphicsQueue; }
 VulkanQueue& VulkanDevice::getPresentQueue() const { return *presentQueue; }
+VulkanQueue& VulkanDevice::getTransferQueue() const { return transferQueue ? *transferQueue : *graphicsQueue; }
+
+void VulkanDevice::setUploadSharing(VkBufferCreateInfo& info) const
+{
+    if (transferQueue && (info.usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT)) {
+        info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        info.queueFamilyIndexCount = 2;
+        info.pQueueFamilyIndices = uploadFamilies;
+    }
+    else {
+        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+}
@@ -10,18 +10,22 @@
 #include <set>
 #include <vector>
 #include <memory>
+#include <mutex>
 
 #include "VulkanCommon.h"
 #include "VulkanPhysicalDevice.h"
 
 class VulkanQueue;
 class VulkanCommandPool;
+class VulkanAllocator;
 
 struct VulkanDeviceFeature {
     bool geometryShader;
     bool shaderClock;
     bool rtPipeline;
     bool accelerationStructure;
+    // VK_EXT_memory_budget, enabled whenever the GPU has it
+    bool memoryBudget;
 };
 
 class VulkanDevice {
@@ -33,13 +37,25 @@ public:
 
     void waitIdle() const;
 
+    // Queue submission, present and wait idle need external synchronization.
+    // Held by every VulkanQueue call so that a loading thread can submit next to the render loop.
+    std::mutex& getQueueMutex() const { return queueMutex; }
+
     VkDevice getHandle() const;
 
     const VulkanPhysicalDevice& getGPU() const;
     const VulkanDeviceFeature& getFeatures() const;
     VulkanCommandPool& getCommandPool() const;
+    // Device memory of every VulkanBuffer and VulkanImage
+    VulkanAllocator& getAllocator() const;
     VulkanQueue& getGraphicsQueue() const;
     VulkanQueue& getPresentQueue() const;
+    // Of a transfer only family when the GPU has one, the graphics queue otherwise
+    VulkanQueue& getTransferQueue() const;
+    bool hasTransferQueue() const { return transferQueue != nullptr; }
+    // Buffers the transfer queue writes are shared by it and the graphics queue, so they need no
+    // ownership transfers. Sets the sharing mode of info for them, exclusive without a transfer queue.
+    void setUploadSharing(VkBufferCreateInfo& info) const;
 
 private:
     const VulkanPhysicalDevice& physicalDevice;
@@ -47,8 +63,14 @@ private:
 
     std::unique_ptr<VulkanQueue> graphicsQueue;
     std::unique_ptr<VulkanQueue> presentQueue;
+    std::unique_ptr<VulkanQueue> transferQueue;
+    uint32_t uploadFamilies[2]{};   // Graphics and transfer
 
     std::unique_ptr<VulkanCommandPool> commandPool;
+
+    std::unique_ptr<VulkanAllocator> allocator;
+
+    mutable std::mutex queueMutex;
     
     VulkanDeviceFeature features{};
 };
@@ -10,7 +10,7 @@ VulkanImage::VulkanImage(const VulkanDevice &device, const VulkanImageCreateInfo
 VulkanImage::VulkanImage(const VulkanDevice& device, const VkExtent3D& extent, VkFormat format, VkImageTiling tiling,
     VkImageUsageFlags usage, VkImageCreateFlags flags, VkMemoryPropertyFlags properties,
     uint32_t mipLevels, uint32_t arrayLayers) :
-    extent{ extent }, device{ device }, format{ format }, sampleCount{ VK_SAMPLE_COUNT_1_BIT },
+    device{ device }, extent{ extent }, format{ format }, sampleCount{ VK_SAMPLE_COUNT_1_BIT },
     usage{ usage }, flags{ flags }, mipLevels{ mipLevels }, arrayLayers{ arrayLayers }
 {
     VkImageCreateInfo imageInfo{};
@@ -27,55 +27,41 @@ VulkanImage::VulkanImage(const VulkanDevice& device, const VkExtent3D& extent, V
     imageInfo.samples = sampleCount;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-    if (vkCreateImage(device.getHandle(), &imageInfo, nullptr, &image) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create image!");
-    }
-
-    VkMemoryRequirements memRequirements;
-    vkGetImageMemoryRequirements(device.getHandle(), image, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = device.getGPU().findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(device.getHandle(), &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate image memory!");
-    }
-
-    vkBindImageMemory(device.getHandle(), image, imageMemory, 0);
+    allocation = device.getAllocator().createImage(imageInfo, properties, image);
 }
 
 VulkanImage::VulkanImage(const VulkanDevice& device, VkImage handle, const VkExtent3D& extent, VkFormat format, VkImageUsageFlags usage, uint32_t mipLevels) :
-    device{ device }, image{ handle }, extent{ extent }, format{ format }, usage{ usage }, sampleCount{ VK_SAMPLE_COUNT_1_BIT }, mipLevels{ mipLevels }
+    device{ device }, image{ handle }, extent{ extent }, format{ format }, sampleCount{ VK_SAMPLE_COUNT_1_BIT }, usage{ usage }, mipLevels{ mipLevels }
 {
 }
 
 VulkanImage::VulkanImage(VulkanImage&& other) noexcept :
     device{ other.device },
     image{ other.image },
-    imageMemory{ other.imageMemory },
+    allocation{ other.allocation },
     extent{ other.extent },
     format{ other.format },
+    sampleCount{ other.sampleCount },
     usage{ other.usage },
     flags{ other.flags },
-    sampleCount{ other.sampleCount },
     mipLevels{ other.mipLevels },
     arrayLayers{ other.arrayLayers }
 {
     other.image = VK_NULL_HANDLE;
-    other.imageMemory = VK_NULL_HANDLE;
+    other.allocation = VK_NULL_HANDLE;
 }
 
 VulkanImage::~VulkanImage() {
-    if (image != VK_NULL_HANDLE && imageMemory != VK_NULL_HANDLE) {
-        vkDestroyImage(device.getHandle(), image, nullptr);
-        vkFreeMemory(device.getHandle(), imageMemory, nullptr);
+    if (image != VK_NULL_HANDLE && allocation != VK_NULL_HANDLE) {
+        device.getAllocator().destroyImage(image, allocation);
     }
 }
 
 VkImage VulkanImage::getHandle() const { return image; }
-VkDeviceMemory VulkanImage::getMemory() const { return imageMemory; }
+VkDeviceMemory VulkanImage::getMemory() const
+{
+    return allocation != VK_NULL_HANDLE ? device.getAllocator().getMemory(allocation) : VK_NULL_HANDLE;
+}
 
 const VkExtent3D &VulkanImage::getExtent() const { return extent; }
 VkFormat VulkanImage::getFormat() const { return format; }
@@ -2,6 +2,7 @@
 
 #include "VulkanCommon.h"
 #include "VulkanDevice.h"
+#include "VulkanAllocator.h"
 
 struct VulkanImageCreateInfo
 {
@@ -46,8 +47,11 @@ public:
     const VulkanDevice& getDevice() const;
 
 private:
+    const VulkanDevice &device;
+
     VkImage image{};
-    VkDeviceMemory imageMemory{};
+    // Null for images the swap chain owns
+    VmaAllocation allocation{ VK_NULL_HANDLE };
 
     VkExtent3D extent{};
     VkFormat format{};
@@ -57,6 +61,4 @@ private:
     uint32_t mipLevels{ 1 };
     uint32_t arrayLayers{ 1 };
     VkImageLayout initialLayout{};
-
-    const VulkanDevice &device;
 };
\ No newline at end of file
@@ -2,7 +2,8 @@
 #include "VulkanImage.h"
 #include "VulkanImageView.h"
 
-VulkanImageView::VulkanImageView(const VulkanImage &image, VkFormat format, uint32_t baseLayer, uint32_t layerCount):
+VulkanImageView::VulkanImageView(const VulkanImage &image, VkFormat format, uint32_t baseLayer, uint32_t layerCount,
+    VkComponentMapping components):
 image{image}, baseLayer{baseLayer}, layerCount{layerCount}
 {
     if (format == VK_FORMAT_UNDEFINED) {
@@ -33,6 +34,7 @@ image{image}, baseLayer{baseLayer}, layerCount{layerCount}
     viewInfo.image = image.getHandle();
     viewInfo.viewType = viewType;
     viewInfo.format = format;
+    viewInfo.components = components;
     viewInfo.subresourceRange.aspectMask = aspectFlags;
     viewInfo.subresourceRange.baseMipLevel = 0;
     viewInfo.subresourceRange.levelCount = image.getMipLevels();
@@ -10,7 +10,9 @@ public:
     //@param format : VK_FORMAT_UNDEFINED for same format with image
     //@param arrayLayer : baseArrayLayer in subResourceRange
     //@param layerCount : layerCount in subResourceRange, 0 for same layerCount with image
-    VulkanImageView(const VulkanImage& image, VkFormat format = VK_FORMAT_UNDEFINED, uint32_t baseLayer = 0, uint32_t layerCount = 0);
+    //@param components : channel swizzle, identity by default
+    VulkanImageView(const VulkanImage& image, VkFormat format = VK_FORMAT_UNDEFINED, uint32_t baseLayer = 0, uint32_t layerCount = 0,
+        VkComponentMapping components = {});
 
     VulkanImageView(VulkanImageView&) = delete;
 
@@ -27,11 +29,11 @@ public:
     const VulkanImage& getImage() const { return image; }
 
 private:
+    const VulkanImage& image;
+
     VkImageView imageView{};
     
     VkFormat format;
     uint32_t baseLayer;
     uint32_t layerCount;
-
-    const VulkanImage& image;
 };
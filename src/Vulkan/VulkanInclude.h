@@ -4,6 +4,7 @@
 
 #include "VulkanInstance.h"
 #include "VulkanDevice.h"
+#include "VulkanAllocator.h"
 #include "VulkanPhysicalDevice.h"
 #include "VulkanSwapChain.h"
 #include "VulkanImage.h"
@@ -87,8 +87,8 @@ VulkanPhysicalDevice& VulkanInstance::getSuitableGPU(VkSurfaceKHR surface, const
     }
 }
 
-VKAPI_ATTR VkBool32 VKAPI_CALL VulkanInstance::debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
-    VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData) {
+VKAPI_ATTR VkBool32 VKAPI_CALL VulkanInstance::debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT /*messageSeverity*/,
+    VkDebugUtilsMessageTypeFlagsEXT /*messageType*/, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* /*pUserData*/) {
     std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
 
     return VK_FALSE;
@@ -164,7 +164,7 @@ bool VulkanInstance::isDeviceSuitable(VkSurfaceKHR surface, VulkanPhysicalDevice
 
     bool extensionsSupported = checkDeviceExtensionSupport(device, deviceExtentions);
 
-    bool swapChainAdequate = device.isSwapChainSupported(surface);
+    bool swapChainAdequate = surface == VK_NULL_HANDLE || device.isSwapChainSupported(surface);
 
     return queueFamiliseSupported && extensionsSupported && swapChainAdequate;
 }
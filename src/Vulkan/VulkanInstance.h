@@ -17,6 +17,7 @@ public:
 
     VkInstance getHandle() const;
 
+    // surface may be VK_NULL_HANDLE for a headless device, the present queue is then the graphics queue
     VulkanPhysicalDevice& getSuitableGPU(VkSurfaceKHR surface, const std::vector<const char*> deviceExtentions) const;
 
 private:
@@ -80,7 +80,10 @@ QueueFamilyIndices VulkanPhysicalDevice::findQueueFamilies(VkSurfaceKHR surface)
 		}
 
 		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport);
+		if (surface != VK_NULL_HANDLE)
+			vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport);
+		else // Headless, nothing is presented and the graphics queue stands in
+			presentSupport = indices.graphicsFamily == i;
 
 		if (presentSupport) {
 			indices.presentFamily = i;
@@ -93,6 +96,14 @@ QueueFamilyIndices VulkanPhysicalDevice::findQueueFamilies(VkSurfaceKHR surface)
 		i++;
 	}
 
+	for (uint32_t family = 0; family < queueFamilies.size(); ++family) {
+		VkQueueFlags flags = queueFamilies[family].queueFlags;
+		if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+			indices.transferFamily = family;
+			break;
+		}
+	}
+
 	return indices;
 }
 
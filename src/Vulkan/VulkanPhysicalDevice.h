@@ -8,6 +8,9 @@
 struct QueueFamilyIndices {
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> presentFamily;
+	// A family with transfer but neither graphics nor compute, the copy engine that runs next to rendering.
+	// Optional, uploads go to the graphics queue without it.
+	std::optional<uint32_t> transferFamily;
 
 	bool isComplete();
 };
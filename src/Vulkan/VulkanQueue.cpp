@@ -19,11 +19,12 @@ void VulkanQueue::submit(const VulkanCommandBuffer& commandBuffer) const {
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer.getHandle();
 
+	std::lock_guard<std::mutex> lock(device.getQueueMutex());
 	vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
 }
 
 void VulkanQueue::submit(const VulkanCommandBuffer& commandBuffer, const std::vector<VkSemaphore>& waitSemaphores, const std::vector<VkPipelineStageFlags>& waitStages,
-	const std::vector<VkSemaphore>& signalSemaphores, VkFence fence)
+	const std::vector<VkSemaphore>& signalSemaphores, VkFence fence) const
 {
 	VkSubmitInfo submitInfo{};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -38,11 +39,42 @@ void VulkanQueue::submit(const VulkanCommandBuffer& commandBuffer, const std::ve
 	submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
 	submitInfo.pSignalSemaphores = signalSemaphores.data();
 
+	std::lock_guard<std::mutex> lock(device.getQueueMutex());
 	if (vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS) {
 		throw std::runtime_error("failed to submit draw command buffer!");
 	}
 }
 
+void VulkanQueue::submit(const VulkanCommandBuffer& commandBuffer, VkSemaphore timeline, uint64_t signalValue,
+	uint64_t waitValue, VkPipelineStageFlags waitStage) const
+{
+	VkTimelineSemaphoreSubmitInfo timelineInfo{ VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &signalValue;
+	if (waitValue > 0) {
+		timelineInfo.waitSemaphoreValueCount = 1;
+		timelineInfo.pWaitSemaphoreValues = &waitValue;
+	}
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer.getHandle();
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &timeline;
+	if (waitValue > 0) {
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &timeline;
+		submitInfo.pWaitDstStageMask = &waitStage;
+	}
+
+	std::lock_guard<std::mutex> lock(device.getQueueMutex());
+	if (vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+		throw std::runtime_error("failed to submit command buffer!");
+	}
+}
+
 VkResult VulkanQueue::present(const std::vector<VkSemaphore>& waitSemaphores, const std::vector<VkSwapchainKHR>& swapChains, uint32_t imageIndex) {
 	VkPresentInfoKHR presentInfo{};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -55,10 +87,12 @@ VkResult VulkanQueue::present(const std::vector<VkSemaphore>& waitSemaphores, co
 	presentInfo.pImageIndices = &imageIndex;
 	presentInfo.pResults = nullptr; // Optional
 
+	std::lock_guard<std::mutex> lock(device.getQueueMutex());
 	return vkQueuePresentKHR(queue, &presentInfo);
 }
 
 void VulkanQueue::waitIdle() const {
+	std::lock_guard<std::mutex> lock(device.getQueueMutex());
 	vkQueueWaitIdle(queue);
 }
 
@@ -15,7 +15,12 @@ public:
 	void submit(const VulkanCommandBuffer& commandBuffer) const;
 
 	void submit(const VulkanCommandBuffer& commandBuffer, const std::vector<VkSemaphore>& waitSemaphores, const std::vector<VkPipelineStageFlags>& waitStages,
-		const std::vector<VkSemaphore>& signalSemaphores, VkFence fence);
+		const std::vector<VkSemaphore>& signalSemaphores, VkFence fence) const;
+
+	// Sets the timeline semaphore to signalValue once the command buffer completes.
+	// With a waitValue, waitStage of the command buffer and later submissions waits for the semaphore to reach it.
+	void submit(const VulkanCommandBuffer& commandBuffer, VkSemaphore timeline, uint64_t signalValue,
+		uint64_t waitValue = 0, VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT) const;
 
 	VkResult present(const std::vector<VkSemaphore>& waitSemaphores, const std::vector<VkSwapchainKHR>& swapChains, uint32_t imageIndex);
 
@@ -0,0 +1,115 @@
+#include "VulkanSceneLoader.h"
+
+#include <algorithm>
+#include <exception>
+
+const char* getSceneLoadPhaseName(SceneLoadPhase phase)
+{
+    switch (phase)
+    {
+    case SceneLoadPhase::Idle: return "Idle";
+    case SceneLoadPhase::Parsing: return "Parsing";
+    case SceneLoadPhase::Uploading: return "Uploading";
+    case SceneLoadPhase::Building: return "Building";
+    case SceneLoadPhase::Ready: return "Ready";
+    case SceneLoadPhase::Failed: return "Failed";
+    }
+    return "Unknown";
+}
+
+void SceneLoadProgress::setPhase(SceneLoadPhase phase)
+{
+    progress = 0.f;
+    this->phase = phase;
+}
+
+void SceneLoadProgress::setProgress(size_t done, size_t total)
+{
+    progress = total == 0 ? 1.f : std::min(1.f, float(done) / float(total));
+}
+
+VulkanSceneLoader::VulkanSceneLoader(LoadFunc load) :
+    load{ std::move(load) }
+{
+}
+
+VulkanSceneLoader::~VulkanSceneLoader()
+{
+    if (progress)
+        progress->cancel();
+    join();
+}
+
+void VulkanSceneLoader::request(const std::string& filename)
+{
+    if (!thread.joinable()) {
+        start(filename);
+        return;
+    }
+
+    // The running load is superseded, stop it at its next check
+    pendingFilename = filename;
+    progress->cancel();
+}
+
+std::unique_ptr<LoadedScene> VulkanSceneLoader::poll()
+{
+    std::unique_ptr<LoadedScene> loaded;
+    if (thread.joinable() && finished) {
+        join();
+        loaded = std::move(result);
+        error = std::move(threadError);
+        if (error.empty())
+            progress.reset();
+    }
+
+    if (!thread.joinable() && !pendingFilename.empty()) {
+        // A newer scene was asked for while this one loaded
+        loaded.reset();
+        start(pendingFilename);
+        pendingFilename.clear();
+    }
+    return loaded;
+}
+
+SceneLoadPhase VulkanSceneLoader::getPhase() const
+{
+    return progress ? progress->getPhase() : SceneLoadPhase::Idle;
+}
+
+float VulkanSceneLoader::getProgress() const
+{
+    return progress ? progress->getProgress() : 0.f;
+}
+
+void VulkanSceneLoader::start(const std::string& filename)
+{
+    this->filename = filename;
+    error.clear();
+    result.reset();
+    threadError.clear();
+    finished = false;
+    progress = std::make_unique<SceneLoadProgress>();
+
+    thread = std::thread([this, filename, &progress = *progress]() {
+        try {
+            result = load(filename, progress);
+            progress.setPhase(result ? SceneLoadPhase::Ready : SceneLoadPhase::Idle);
+        }
+        catch (const std::exception& e) {
+            threadError = e.what();
+            progress.setPhase(SceneLoadPhase::Failed);
+        }
+        catch (...) {
+            threadError = "unknown error";
+            progress.setPhase(SceneLoadPhase::Failed);
+        }
+        finished = true;
+    });
+}
+
+void VulkanSceneLoader::join()
+{
+    if (thread.joinable())
+        thread.join();
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../Scene.h"
+#include "VulkanCommandPool.h"
+#include "Rendering/VulkanResource.h"
+#include "Rendering/VulkanRayTracingBuilder.h"
+
+enum class SceneLoadPhase
+{
+    Idle,
+    Parsing,    // glTF parse and primitive decode
+    Uploading,  // Textures and geometry buffers into the new VulkanResourceManager
+    Building,   // Acceleration structures of the ray tracer
+    Ready,      // Waiting to be swapped in at the next frame boundary
+    Failed
+};
+
+const char* getSceneLoadPhaseName(SceneLoadPhase phase);
+
+// Written by the loading thread, read by the render thread
+class SceneLoadProgress
+{
+public:
+    // Resets the progress of the phase to 0
+    void setPhase(SceneLoadPhase phase);
+    void setProgress(size_t done, size_t total);
+
+    SceneLoadPhase getPhase() const { return phase; }
+    // 0 to 1 within the current phase
+    float getProgress() const { return progress; }
+
+    void cancel() { cancelled = true; }
+    bool isCancelled() const { return cancelled; }
+
+private:
+    std::atomic<SceneLoadPhase> phase{ SceneLoadPhase::Idle };
+    std::atomic<float> progress{ 0.f };
+    std::atomic<bool> cancelled{ false };
+};
+
+// Everything a scene load builds off the render thread.
+// resManager records its uploads on commandPool, so the pool lives as long as the manager.
+// rtBuilder holds the built acceleration structures when ray tracing is supported, its pipeline
+// is created by the render thread.
+struct LoadedScene
+{
+    std::unique_ptr<VulkanCommandPool> commandPool;
+    std::unique_ptr<VulkanResourceManager> resManager;
+    std::unique_ptr<VulkanRayTracingBuilder> rtBuilder;
+    std::unique_ptr<Scene> scene;
+    std::unordered_map<const Mesh*, RenderMeshID> renderMeshes;
+    std::vector<std::vector<std::pair<const Mesh*, RenderMeshID>>> nodeRenderMeshes;
+};
+
+// Runs one scene load at a time on a background thread. Every call is made from the render thread,
+// which picks the finished scene up with poll at a frame boundary.
+class VulkanSceneLoader
+{
+public:
+    // Returns nullptr when the load was cancelled, throws on failure
+    using LoadFunc = std::function<std::unique_ptr<LoadedScene>(const std::string& filename, SceneLoadProgress& progress)>;
+
+    explicit VulkanSceneLoader(LoadFunc load);
+    // Cancels the running load and waits for it
+    ~VulkanSceneLoader();
+
+    VulkanSceneLoader(const VulkanSceneLoader&) = delete;
+    VulkanSceneLoader& operator=(const VulkanSceneLoader&) = delete;
+
+    // Starts loading right away when idle. A request made during a load waits for it to finish
+    // and replaces any earlier request that is still waiting.
+    void request(const std::string& filename);
+
+    // Returns the finished scene once, nullptr while loading or after a failure.
+    // Starts the waiting request, if any.
+    std::unique_ptr<LoadedScene> poll();
+
+    bool isLoading() const { return thread.joinable(); }
+    SceneLoadPhase getPhase() const;
+    float getProgress() const;
+    const std::string& getFilename() const { return filename; }
+    // Message of the last failed load, empty if the last load succeeded
+    const std::string& getError() const { return error; }
+
+private:
+    LoadFunc load;
+
+    std::thread thread;
+    std::unique_ptr<SceneLoadProgress> progress;
+    std::atomic<bool> finished{ false };
+    // Written by the thread before it sets finished
+    std::unique_ptr<LoadedScene> result;
+    std::string threadError;
+
+    std::string filename;
+    std::string pendingFilename;
+    std::string error;
+
+    void start(const std::string& filename);
+    void join();
+};
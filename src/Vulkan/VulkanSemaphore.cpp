@@ -10,6 +10,21 @@ VulkanSemaphore::VulkanSemaphore(const VulkanDevice& device):
 	vkCreateSemaphore(device.getHandle(), &createInfo, VK_NULL_HANDLE, &semaphore);
 }
 
+VulkanSemaphore::VulkanSemaphore(const VulkanDevice& device, uint64_t initialValue) :
+	device{ device }, semaphore{}
+{
+	VkSemaphoreTypeCreateInfo typeInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue = initialValue;
+
+	VkSemaphoreCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	createInfo.pNext = &typeInfo;
+	if (vkCreateSemaphore(device.getHandle(), &createInfo, VK_NULL_HANDLE, &semaphore) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create timeline semaphore!");
+	}
+}
+
 VulkanSemaphore::VulkanSemaphore(VulkanSemaphore&& other) noexcept:
 	device{ other.device }, semaphore{other.semaphore}
 {
@@ -22,3 +37,19 @@ VulkanSemaphore::~VulkanSemaphore() {
 }
 
 VkSemaphore VulkanSemaphore::getHandle() const { return semaphore; }
+
+uint64_t VulkanSemaphore::getValue() const
+{
+	uint64_t value = 0;
+	vkGetSemaphoreCounterValue(device.getHandle(), semaphore, &value);
+	return value;
+}
+
+void VulkanSemaphore::wait(uint64_t value) const
+{
+	VkSemaphoreWaitInfo waitInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO };
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &semaphore;
+	waitInfo.pValues = &value;
+	vkWaitSemaphores(device.getHandle(), &waitInfo, UINT64_MAX);
+}
@@ -8,6 +8,9 @@ class VulkanSemaphore
 public:
 	VulkanSemaphore(const VulkanDevice& device);
 
+	// A timeline semaphore counting up from initialValue
+	VulkanSemaphore(const VulkanDevice& device, uint64_t initialValue);
+
 	VulkanSemaphore(const VulkanSemaphore&) = delete;
 
 	VulkanSemaphore(VulkanSemaphore&& other) noexcept;
@@ -16,6 +19,10 @@ public:
 
 	VkSemaphore getHandle() const;
 
+	// Timeline semaphores only
+	uint64_t getValue() const;
+	void wait(uint64_t value) const;
+
 private:
 	const VulkanDevice& device;
 	VkSemaphore semaphore;
@@ -1,3 +1,7 @@
+#include <algorithm>
+#include <cstring>
+#include <string>
+
 #include <stb_image.h>
 
 #include "VulkanCommon.h"
@@ -9,9 +13,13 @@
 #include "VulkanQueue.h"
 #include "VulkanTexture.h"
 
+#include "Utils/Ktx2.h"
+#include "Image/MipChain.h"
+#include "Utils/PhaseClock.h"
+
 VulkanTexture::VulkanTexture(
     const VulkanDevice& device, const void* data, size_t size, VkExtent3D extent, VkFormat format, VkSampler sampler,
-    const VulkanCommandPool& commandPool, const VulkanQueue& queue) :
+    VulkanUploadContext& uploads) :
     device{ device }, sampler{ sampler }, mipLevels{ 1 }, arrayLayers{ 1 }
 {
     image = std::make_unique<VulkanImage>(
@@ -24,60 +32,315 @@ VulkanTexture::VulkanTexture(
 
     imageView = std::make_unique<VulkanImageView>(*image);
 
-    if (data != nullptr) {
+    if (data == nullptr) {
         return;
     }
 
-    VulkanBuffer stagingBuffer{ device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT };
-    stagingBuffer.update(data, size);
+    auto staging = uploads.allocateStaging(size);
+    memcpy(staging.data, data, size);
 
-    commandPool.transitionImageLayout(*image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, queue);
-    commandPool.copyBufferToImage(stagingBuffer, *image, queue);
-    //commandPool.transitionImageLayout(*image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, queue);
+    auto& commandBuffer = uploads.getCommandBuffer();
+    commandBuffer.transitionImageLayout(*image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    commandBuffer.copyBufferToImage(*staging.buffer, *image, staging.offset);
+    uploads.releaseImage(*image);
 }
 
-VulkanTexture::VulkanTexture(
-    const VulkanDevice& device, const char* filename, VkSampler sampler,
-    const VulkanCommandPool& commandPool, const VulkanQueue& queue) :
-    device{ device }, sampler{ sampler }, mipLevels{ 1 }, arrayLayers{ 1 }
+namespace {
+    TextureStaging stagePixels(const VulkanDevice& device, stbi_uc* pixels, int texWidth, int texHeight)
+    {
+        if (!pixels) {
+            throw std::runtime_error("failed to load texture image!");
+        }
+        std::unique_ptr<stbi_uc, void(*)(void*)> owner{ pixels, stbi_image_free };
+
+        TextureStaging staging{};
+        staging.extent = { static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), 1 };
+        VkDeviceSize imageSize = VkDeviceSize(texWidth) * texHeight * 4;
+        staging.buffer = std::make_unique<VulkanBuffer>(device, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        staging.buffer->update(pixels, imageSize);
+        return staging;
+    }
+
+    struct BlockFormat
+    {
+        VkFormat format;
+        uint32_t blockBytes;
+        uint32_t blockSize;     // Texels along each side of a block
+    };
+
+    // Formats a KTX2 texture may use
+    const BlockFormat BLOCK_FORMATS[] = {
+        { VK_FORMAT_BC1_RGB_UNORM_BLOCK, 8, 4 },
+        { VK_FORMAT_BC1_RGB_SRGB_BLOCK, 8, 4 },
+        { VK_FORMAT_BC1_RGBA_UNORM_BLOCK, 8, 4 },
+        { VK_FORMAT_BC1_RGBA_SRGB_BLOCK, 8, 4 },
+        { VK_FORMAT_BC3_UNORM_BLOCK, 16, 4 },
+        { VK_FORMAT_BC3_SRGB_BLOCK, 16, 4 },
+        { VK_FORMAT_BC4_UNORM_BLOCK, 8, 4 },
+        { VK_FORMAT_BC4_SNORM_BLOCK, 8, 4 },
+        { VK_FORMAT_BC5_UNORM_BLOCK, 16, 4 },
+        { VK_FORMAT_BC5_SNORM_BLOCK, 16, 4 },
+        { VK_FORMAT_BC7_UNORM_BLOCK, 16, 4 },
+        { VK_FORMAT_BC7_SRGB_BLOCK, 16, 4 },
+        { VK_FORMAT_R8G8B8A8_UNORM, 4, 1 },
+        { VK_FORMAT_R8G8B8A8_SRGB, 4, 1 },
+    };
+
+    const BlockFormat& getBlockFormat(uint32_t vkFormat)
+    {
+        for (const auto& blockFormat : BLOCK_FORMATS) {
+            if (blockFormat.format == static_cast<VkFormat>(vkFormat))
+                return blockFormat;
+        }
+        throw std::runtime_error("unsupported KTX2 texture format " + std::to_string(vkFormat) + "!");
+    }
+
+    // One of "rgba01" per component, like "rg01"
+    VkComponentMapping getSwizzle(const std::string& swizzle)
+    {
+        auto component = [&swizzle](size_t i) {
+            switch (i < swizzle.size() ? swizzle[i] : "rgba"[i]) {
+            case 'r': return VK_COMPONENT_SWIZZLE_R;
+            case 'g': return VK_COMPONENT_SWIZZLE_G;
+            case 'b': return VK_COMPONENT_SWIZZLE_B;
+            case 'a': return VK_COMPONENT_SWIZZLE_A;
+            case '0': return VK_COMPONENT_SWIZZLE_ZERO;
+            case '1': return VK_COMPONENT_SWIZZLE_ONE;
+            }
+            throw std::runtime_error("invalid KTX2 swizzle " + swizzle + "!");
+        };
+        return { component(0), component(1), component(2), component(3) };
+    }
+
+    void checkKtx2LevelSize(const Ktx2Texture& ktx, const BlockFormat& blockFormat, uint32_t level)
+    {
+        uint32_t width = std::max(1u, ktx.width >> level);
+        uint32_t height = std::max(1u, ktx.height >> level);
+        uint32_t blocksX = (width + blockFormat.blockSize - 1) / blockFormat.blockSize;
+        uint32_t blocksY = (height + blockFormat.blockSize - 1) / blockFormat.blockSize;
+        if (ktx.levels[level].size != VkDeviceSize(blocksX) * blocksY * blockFormat.blockBytes) {
+            throw std::runtime_error("KTX2 level size does not match its format!");
+        }
+    }
+
+    // Every level goes into one staging buffer, block sizes keep the regions aligned
+    TextureStaging stageKtx2(const VulkanDevice& device, const void* encoded, size_t size)
+    {
+        auto ktx = parseKtx2(encoded, size);
+        const auto& blockFormat = getBlockFormat(ktx.vkFormat);
+
+        TextureStaging staging{};
+        staging.extent = { ktx.width, ktx.height, 1 };
+        staging.format = blockFormat.format;
+        if (!ktx.swizzle.empty())
+            staging.components = getSwizzle(ktx.swizzle);
+
+        VkDeviceSize stagingSize = 0;
+        for (uint32_t i = 0; i < ktx.levels.size(); ++i) {
+            uint32_t width = std::max(1u, ktx.width >> i);
+            uint32_t height = std::max(1u, ktx.height >> i);
+            checkKtx2LevelSize(ktx, blockFormat, i);
+
+            VkBufferImageCopy region{};
+            region.bufferOffset = stagingSize;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = i;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent = { width, height, 1 };
+            staging.levels.push_back(region);
+
+            stagingSize += ktx.levels[i].size;
+        }
+
+        staging.buffer = std::make_unique<VulkanBuffer>(device, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        auto* mapped = staging.buffer->map();
+        for (size_t i = 0; i < ktx.levels.size(); ++i) {
+            memcpy(mapped + staging.levels[i].bufferOffset,
+                static_cast<const uint8_t*>(encoded) + ktx.levels[i].offset, ktx.levels[i].size);
+        }
+        staging.buffer->unmap();
+        return staging;
+    }
+
+    TextureStaging decodeTextureFile(const VulkanDevice& device, const char* filename)
+    {
+        auto bytes = readFile(filename);
+        return decodeTextureImage(device, bytes.data(), bytes.size());
+    }
+}
+
+TextureStaging decodeTextureImage(const VulkanDevice& device, const void* encoded, size_t size)
 {
+    if (isKtx2(encoded, size))
+        return stageKtx2(device, encoded, size);
+
+    int texWidth, texHeight, texChannels;
+    stbi_uc* pixels = stbi_load_from_memory(static_cast<const stbi_uc*>(encoded), static_cast<int>(size),
+        &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+    return stagePixels(device, pixels, texWidth, texHeight);
+}
+
+VkDeviceSize getTextureImageSize(const void* encoded, size_t size)
+{
+    if (isKtx2(encoded, size)) {
+        try {
+            VkDeviceSize stagingSize = 0;
+            for (const auto& level : parseKtx2(encoded, size).levels)
+                stagingSize += level.size;
+            return stagingSize;
+        }
+        catch (const std::runtime_error&) {
+            return 0;
+        }
+    }
+
     int texWidth, texHeight, texChannels;
-    stbi_uc* pixels = stbi_load(filename, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    VkDeviceSize imageSize = texWidth * texHeight * 4;
-    mipLevels = toU32(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+    if (!stbi_info_from_memory(static_cast<const stbi_uc*>(encoded), static_cast<int>(size), &texWidth, &texHeight, &texChannels))
+        return 0;
+    return VkDeviceSize(texWidth) * texHeight * 4;
+}
 
+TextureMipChain decodeTextureMipChain(const void* encoded, size_t size, double* mipSeconds)
+{
+    TextureMipChain chain{};
+    if (isKtx2(encoded, size)) {
+        auto ktx = parseKtx2(encoded, size);
+        const auto& blockFormat = getBlockFormat(ktx.vkFormat);
+        chain.extent = { ktx.width, ktx.height, 1 };
+        chain.format = blockFormat.format;
+        if (!ktx.swizzle.empty())
+            chain.components = getSwizzle(ktx.swizzle);
+
+        for (uint32_t i = 0; i < ktx.levels.size(); ++i) {
+            checkKtx2LevelSize(ktx, blockFormat, i);
+            const auto* level = static_cast<const uint8_t*>(encoded) + ktx.levels[i].offset;
+            chain.levels.emplace_back(level, level + ktx.levels[i].size);
+        }
+        return chain;
+    }
 
+    int texWidth, texHeight, texChannels;
+    stbi_uc* pixels = stbi_load_from_memory(static_cast<const stbi_uc*>(encoded), static_cast<int>(size),
+        &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
     if (!pixels) {
         throw std::runtime_error("failed to load texture image!");
     }
+    std::unique_ptr<stbi_uc, void(*)(void*)> owner{ pixels, stbi_image_free };
 
-    VulkanBuffer stagingBuffer{ device, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT };
-    stagingBuffer.update(pixels, imageSize);
+    chain.extent = { static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), 1 };
+    PhaseClock clock;
+    // Same filter as the blits of generateMipmaps
+    for (auto& level : buildMipChain(pixels, chain.extent.width, chain.extent.height, MipFilter::Linear))
+        chain.levels.push_back(std::move(level.rgba));
+    if (mipSeconds)
+        clock.lap(*mipSeconds);
+    return chain;
+}
 
-    stbi_image_free(pixels);
+VkDeviceSize getMipChainSize(const TextureMipChain& chain, uint32_t firstLevel)
+{
+    VkDeviceSize size = 0;
+    for (size_t i = firstLevel; i < chain.levels.size(); ++i)
+        size += chain.levels[i].size();
+    return size;
+}
+
+void VulkanTexture::createImage(VkExtent3D extent, VkFormat format, uint32_t levels)
+{
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    if (levels > 0) {
+        mipLevels = levels;
+
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(device.getGPU().getHandle(), format, &formatProperties);
+        if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+            throw std::runtime_error("texture image format is not supported by the GPU!");
+        }
+    }
+    else {
+        mipLevels = toU32(std::floor(std::log2(std::max(extent.width, extent.height)))) + 1;
+        // The mips are blitted from the level above
+        usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
 
     image = std::make_unique<VulkanImage>(
-        device, VkExtent3D{ static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), 1 },
-        VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
-        VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        device, extent,
+        format, VK_IMAGE_TILING_OPTIMAL,
+        usage,
         0, 
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mipLevels
     );
+}
+
+VulkanTexture::VulkanTexture(
+    const VulkanDevice& device, TextureStaging staging, VkSampler sampler, VulkanUploadContext& uploads) :
+    device{ device }, sampler{ sampler }, mipLevels{ 1 }, arrayLayers{ 1 }
+{
+    bool storedMips = !staging.levels.empty();
+    createImage(staging.extent, staging.format, storedMips ? toU32(staging.levels.size()) : 0);
 
-    commandPool.transitionImageLayout(*image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, queue);
-    commandPool.copyBufferToImage(stagingBuffer, *image, queue);
-    //commandPool.transitionImageLayout(*image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, queue);
+    auto& commandBuffer = uploads.getCommandBuffer();
+    commandBuffer.transitionImageLayout(*image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    if (storedMips)
+        commandBuffer.copyBufferToImage(*staging.buffer, *image, staging.levels);
+    else
+        commandBuffer.copyBufferToImage(*staging.buffer, *image);
+    uploads.releaseImage(*image, !storedMips);
+    uploads.release(std::move(staging.buffer));
 
-    commandPool.generateMipmaps(*image, queue);
+    imageView = std::make_unique<VulkanImageView>(*image, VK_FORMAT_UNDEFINED, 0, 0, staging.components);
+}
 
-    imageView = std::make_unique<VulkanImageView>(*image);
+VulkanTexture::VulkanTexture(
+    const VulkanDevice& device, const TextureMipChain& chain, uint32_t firstLevel, VkSampler sampler,
+    VulkanUploadContext& uploads) :
+    device{ device }, sampler{ sampler }, mipLevels{ 1 }, arrayLayers{ 1 }
+{
+    if (firstLevel >= chain.levels.size()) {
+        throw std::runtime_error("texture mip chain has no level " + std::to_string(firstLevel) + "!");
+    }
+
+    VkExtent3D extent{ std::max(1u, chain.extent.width >> firstLevel), std::max(1u, chain.extent.height >> firstLevel), 1 };
+    createImage(extent, chain.format, toU32(chain.levels.size()) - firstLevel);
+
+    // The levels go straight from the chain into the staging ring, block sizes keep the regions aligned
+    auto staging = uploads.allocateStaging(getMipChainSize(chain, firstLevel));
+    std::vector<VkBufferImageCopy> regions;
+    VkDeviceSize offset = 0;
+    for (uint32_t i = firstLevel; i < chain.levels.size(); ++i) {
+        VkBufferImageCopy region{};
+        region.bufferOffset = staging.offset + offset;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = i - firstLevel;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = { std::max(1u, chain.extent.width >> i), std::max(1u, chain.extent.height >> i), 1 };
+        regions.push_back(region);
+
+        memcpy(staging.data + offset, chain.levels[i].data(), chain.levels[i].size());
+        offset += chain.levels[i].size();
+    }
+
+    auto& commandBuffer = uploads.getCommandBuffer();
+    commandBuffer.transitionImageLayout(*image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    commandBuffer.copyBufferToImage(*staging.buffer, *image, regions);
+    uploads.releaseImage(*image);
+
+    imageView = std::make_unique<VulkanImageView>(*image, VK_FORMAT_UNDEFINED, 0, 0, chain.components);
+}
+
+VulkanTexture::VulkanTexture(
+    const VulkanDevice& device, const char* filename, VkSampler sampler, VulkanUploadContext& uploads) :
+    VulkanTexture(device, decodeTextureFile(device, filename), sampler, uploads)
+{
 }
 
 VulkanTexture::VulkanTexture(
     const VulkanDevice& device, const std::vector<std::string>& filenames, VkSampler sampler,
-    const VulkanCommandPool& commandPool, const VulkanQueue& queue) :
+    VulkanUploadContext& uploads) :
     device{ device }, sampler{ sampler }, mipLevels{ 1 }
 {
     arrayLayers = toU32(filenames.size());
@@ -124,10 +387,12 @@ VulkanTexture::VulkanTexture(
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mipLevels, arrayLayers
         );
 
-    commandPool.transitionImageLayout(*image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, queue);
-    commandPool.copyBufferToImage(*stagingBuffer, *image, queue);
+    auto& commandBuffer = uploads.getCommandBuffer();
+    commandBuffer.transitionImageLayout(*image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    commandBuffer.copyBufferToImage(*stagingBuffer, *image);
 
-    commandPool.generateMipmaps(*image, queue);
+    uploads.releaseImage(*image, true);
+    uploads.release(std::move(stagingBuffer));
 
     imageView = std::make_unique<VulkanImageView>(*image);
 }
@@ -144,4 +409,9 @@ VkDescriptorImageInfo VulkanTexture::getImageInfo() const {
     imageInfo.sampler = sampler;
 
     return imageInfo;
-}
\ No newline at end of file
+}
+VkDeviceSize VulkanTexture::getMemorySize() const {
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(device.getHandle(), image->getHandle(), &requirements);
+    return requirements.size;
+}
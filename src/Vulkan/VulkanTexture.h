@@ -7,7 +7,47 @@
 #include "VulkanCommandPool.h"
 #include "VulkanBuffer.h"
 #include "VulkanQueue.h"
+#include "VulkanUploadContext.h"
 
+// Pixels of an image file in host visible memory, ready to be copied into a texture
+struct TextureStaging
+{
+    VkExtent3D extent{};
+    VkFormat format{ VK_FORMAT_R8G8B8A8_UNORM };
+    std::unique_ptr<VulkanBuffer> buffer;
+    // Stored mip chain, one region per level. Empty if the buffer only holds
+    // the base level and the mips are generated after the upload.
+    std::vector<VkBufferImageCopy> levels;
+    // From the KTXswizzle of cooked textures, identity otherwise
+    VkComponentMapping components{};
+};
+
+// Decodes a JPEG, PNG, ... file held in memory with stb_image into RGBA8.
+// KTX2 files are staged as they are, in their BCn or RGBA8 format with their stored mips.
+// Safe to call from any thread.
+TextureStaging decodeTextureImage(const VulkanDevice& device, const void* encoded, size_t size);
+// Bytes decodeTextureImage will stage for the file, 0 if the header is not understood
+VkDeviceSize getTextureImageSize(const void* encoded, size_t size);
+
+// Every level of a texture kept on the host, texture streaming uploads a range of it
+struct TextureMipChain
+{
+    VkExtent3D extent{};    // Of levels[0]
+    VkFormat format{ VK_FORMAT_R8G8B8A8_UNORM };
+    VkComponentMapping components{};
+    // Finest first, tightly packed texels or blocks
+    std::vector<std::vector<uint8_t>> levels;
+};
+
+// Decodes like decodeTextureImage, but the levels stay on the host. JPEG, PNG, ... files
+// get their mips box filtered on the CPU, KTX2 files keep their stored mips.
+// Safe to call from any thread. mipSeconds, if set, gets the time spent filtering the mips added.
+TextureMipChain decodeTextureMipChain(const void* encoded, size_t size, double* mipSeconds = nullptr);
+// Host bytes of levels [firstLevel, levels.size())
+VkDeviceSize getMipChainSize(const TextureMipChain& chain, uint32_t firstLevel = 0);
+
+// The constructors record their upload into the open batch of uploads, the texture may be
+// sampled by graphics work submitted once the batch is visible, see VulkanUploadContext.
 class VulkanTexture
 {
 public:
@@ -18,29 +58,46 @@ public:
         VkExtent3D extent,
         VkFormat format,
         VkSampler sampler,
-        const VulkanCommandPool& commandPool,
-        const VulkanQueue& queue
+        VulkanUploadContext& uploads
+    );
+
+    // Uploads decoded pixels, generating the mips unless the staging holds them.
+    // The staging buffer lives until the batch is done.
+    VulkanTexture(
+        const VulkanDevice& device,
+        TextureStaging staging,
+        VkSampler sampler,
+        VulkanUploadContext& uploads
+    );
+
+    // Uploads levels [firstLevel, levels.size()) of chain, which the texture has as levels [0, ...)
+    VulkanTexture(
+        const VulkanDevice& device,
+        const TextureMipChain& chain,
+        uint32_t firstLevel,
+        VkSampler sampler,
+        VulkanUploadContext& uploads
     );
 
     VulkanTexture(
         const VulkanDevice& device, 
         const char* filename, 
         VkSampler sampler, 
-        const VulkanCommandPool& commandPool, 
-        const VulkanQueue& queue
+        VulkanUploadContext& uploads
     );
 
     VulkanTexture(
         const VulkanDevice& device, 
         const std::vector<std::string>& filenames, 
         VkSampler sampler, 
-        const VulkanCommandPool& commandPool, 
-        const VulkanQueue& queue
+        VulkanUploadContext& uploads
     );
 
     ~VulkanTexture();
 
     VkDescriptorImageInfo getImageInfo() const;
+    // Device memory of the image with all mips and layers
+    VkDeviceSize getMemorySize() const;
 
 private:
     const VulkanDevice& device;
@@ -50,4 +107,7 @@ private:
     VkSampler sampler;
     uint32_t mipLevels;
     uint32_t arrayLayers;
+
+    // levels 0 makes room for a full mip chain blitted from the base level
+    void createImage(VkExtent3D extent, VkFormat format, uint32_t levels);
 };
\ No newline at end of file
@@ -0,0 +1,250 @@
+#include "VulkanCommon.h"
+#include "VulkanDevice.h"
+#include "VulkanQueue.h"
+#include "VulkanUploadContext.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    VkDeviceSize alignUp(VkDeviceSize offset, VkDeviceSize alignment)
+    {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+}
+
+VulkanUploadContext::VulkanUploadContext(const VulkanDevice& device, VkDeviceSize stagingSize) :
+    device{ device }, queue{ device.getTransferQueue() }, graphicsQueue{ device.getGraphicsQueue() },
+    commandPool{ device, queue.getFamilyIndex() }, timeline{ device, 0 }
+{
+    if (device.hasTransferQueue()) {
+        acquirePool = std::make_unique<VulkanCommandPool>(device, graphicsQueue.getFamilyIndex());
+        stats.transferQueue = true;
+    }
+
+    // Copies into images need offsets aligned to the texel block, 16 bytes covers the compressed formats
+    stagingAlignment = std::max<VkDeviceSize>(16, device.getGPU().getProperties().limits.optimalBufferCopyOffsetAlignment);
+
+    staging = std::make_unique<VulkanBuffer>(device, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    stagingData = staging->getMappedData();
+}
+
+VulkanUploadContext::~VulkanUploadContext()
+{
+    // The graphics half of a batch is not submitted any more, nothing uses its images now
+    for (const auto& batch : inFlight)
+        timeline.wait(batch.acquired ? batch.value : batch.copyValue);
+    inFlight.clear();
+}
+
+UploadStaging VulkanUploadContext::allocateStaging(VkDeviceSize size)
+{
+    size = alignUp(std::max<VkDeviceSize>(size, 1), stagingAlignment);
+    stats.stagedBytes += size;
+
+    VkDeviceSize ringSize = staging->getSize();
+    if (size > ringSize) {
+        auto buffer = std::make_unique<VulkanBuffer>(device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        UploadStaging allocation{ buffer.get(), 0, buffer->getMappedData() };
+        release(std::move(buffer));
+        return allocation;
+    }
+
+    retire();
+    for (;;) {
+        if (stagingUsed == 0)
+            stagingHead = 0;
+
+        // Allocations are contiguous, the end of the ring is skipped when size does not fit in front of it
+        bool wrap = stagingHead + size > ringSize;
+        VkDeviceSize padding = wrap ? ringSize - stagingHead : 0;
+        if (stagingUsed + padding + size <= ringSize) {
+            VkDeviceSize offset = wrap ? 0 : stagingHead;
+            stagingHead = offset + size;
+            stagingUsed += padding + size;
+            open.stagingBytes += padding + size;
+            return { staging.get(), offset, stagingData + offset };
+        }
+
+        // The ring is full, wait for the oldest batch reading it. The open batch holds all of it when nothing is in flight.
+        if (inFlight.empty())
+            submit();
+        ++stats.stalls;
+        wait(inFlight.front().value);
+    }
+}
+
+VulkanCommandBuffer& VulkanUploadContext::getCommandBuffer()
+{
+    if (!open.commandBuffer) {
+        open.commandBuffer = std::make_unique<VulkanCommandBuffer>(commandPool);
+        open.commandBuffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    }
+    return *open.commandBuffer;
+}
+
+void VulkanUploadContext::uploadBuffer(const void* data, VkDeviceSize size, VulkanBuffer& dst, VkDeviceSize dstOffset)
+{
+    // A copy region may not be empty
+    if (size == 0)
+        return;
+
+    auto allocation = allocateStaging(size);
+    memcpy(allocation.data, data, static_cast<size_t>(size));
+
+    VkBufferCopy region{ allocation.offset, dstOffset, size };
+    getCommandBuffer().copyBuffer(*allocation.buffer, dst, { region });
+}
+
+void VulkanUploadContext::release(std::unique_ptr<VulkanBuffer> buffer)
+{
+    open.released.push_back(std::move(buffer));
+}
+
+void VulkanUploadContext::releaseImage(const VulkanImage& image, bool generateMipmaps)
+{
+    VkImageMemoryBarrier barrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = generateMipmaps ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    if (acquirePool) {
+        barrier.srcQueueFamilyIndex = queue.getFamilyIndex();
+        barrier.dstQueueFamilyIndex = graphicsQueue.getFamilyIndex();
+    }
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = generateMipmaps ? VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT;
+    barrier.image = image.getHandle();
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, image.getMipLevels(), 0, image.getArrayLayers() };
+    open.images.push_back(barrier);
+
+    if (generateMipmaps)
+        open.mipmapped.push_back(&image);
+}
+
+uint64_t VulkanUploadContext::submit()
+{
+    retire();
+    if (!open.commandBuffer && open.stagingBytes == 0 && open.released.empty())
+        return submittedValue;
+
+    auto& commandBuffer = getCommandBuffer();
+    if (!acquirePool) {
+        // Later submissions to the queue read what this batch wrote, whatever stage they read it in
+        VkMemoryBarrier barrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer.getHandle(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+            1, &barrier, 0, nullptr, toU32(open.images.size()), open.images.data());
+        for (const auto* image : open.mipmapped)
+            commandBuffer.generateMipmaps(*image);
+    }
+    else if (!open.images.empty()) {
+        // Release half of the ownership transfers, the graphics queue acquires the images in submitAcquire
+        std::vector<VkImageMemoryBarrier> releases = open.images;
+        for (auto& barrier : releases)
+            barrier.dstAccessMask = 0;
+        vkCmdPipelineBarrier(commandBuffer.getHandle(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+            0, nullptr, 0, nullptr, toU32(releases.size()), releases.data());
+    }
+
+    if (commandBuffer.end() != VK_SUCCESS) {
+        throw std::runtime_error("failed to record upload command buffer!");
+    }
+    if (acquirePool) {
+        open.copyValue = ++submittedValue;
+        open.value = ++submittedValue;
+        queue.submit(commandBuffer, timeline.getHandle(), open.copyValue);
+    }
+    else {
+        open.value = ++submittedValue;
+        queue.submit(commandBuffer, timeline.getHandle(), open.value);
+        open.acquired = true;
+        visibleValue = open.value;
+    }
+    ++stats.batches;
+
+    inFlight.push_back(std::move(open));
+    open = {};
+    return submittedValue;
+}
+
+void VulkanUploadContext::submitAcquire(Batch& batch)
+{
+    batch.acquireCommandBuffer = std::make_unique<VulkanCommandBuffer>(*acquirePool);
+    auto& commandBuffer = *batch.acquireCommandBuffer;
+    commandBuffer.begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+    // The semaphore wait holds the transfer stage, the barrier extends it to every later stage
+    // and makes the buffer writes visible to them
+    VkMemoryBarrier barrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    for (auto& image : batch.images)
+        image.srcAccessMask = 0;
+    vkCmdPipelineBarrier(commandBuffer.getHandle(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+        1, &barrier, 0, nullptr, toU32(batch.images.size()), batch.images.data());
+    for (const auto* image : batch.mipmapped)
+        commandBuffer.generateMipmaps(*image);
+
+    if (commandBuffer.end() != VK_SUCCESS) {
+        throw std::runtime_error("failed to record upload command buffer!");
+    }
+    graphicsQueue.submit(commandBuffer, timeline.getHandle(), batch.value, batch.copyValue, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    batch.acquired = true;
+    visibleValue = batch.value;
+}
+
+uint64_t VulkanUploadContext::poll()
+{
+    // In batch order, the values on the semaphore only go up
+    uint64_t completed = timeline.getValue();
+    for (auto& batch : inFlight) {
+        if (batch.acquired)
+            continue;
+        if (batch.copyValue > completed)
+            break;
+        submitAcquire(batch);
+    }
+    return visibleValue;
+}
+
+void VulkanUploadContext::acquire(uint64_t value)
+{
+    for (auto& batch : inFlight) {
+        if (batch.value > value)
+            break;
+        if (!batch.acquired) {
+            timeline.wait(batch.copyValue);
+            submitAcquire(batch);
+        }
+    }
+}
+
+bool VulkanUploadContext::isComplete(uint64_t value) const
+{
+    return timeline.getValue() >= value;
+}
+
+void VulkanUploadContext::wait(uint64_t value)
+{
+    acquire(value);
+    timeline.wait(value);
+    retire();
+}
+
+void VulkanUploadContext::flush()
+{
+    wait(submit());
+}
+
+void VulkanUploadContext::retire()
+{
+    poll();
+    uint64_t completed = timeline.getValue();
+    while (!inFlight.empty() && inFlight.front().acquired && inFlight.front().value <= completed) {
+        stagingUsed -= inFlight.front().stagingBytes;
+        inFlight.pop_front();
+    }
+}
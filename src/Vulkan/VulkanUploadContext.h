@@ -0,0 +1,122 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "VulkanCommon.h"
+#include "VulkanBuffer.h"
+#include "VulkanImage.h"
+#include "VulkanCommandBuffer.h"
+#include "VulkanCommandPool.h"
+#include "VulkanSemaphore.h"
+
+class VulkanQueue;
+
+// Size of the staging ring of a VulkanUploadContext, a larger upload gets a staging buffer of its own
+constexpr VkDeviceSize UPLOAD_STAGING_SIZE = 64ull << 20;
+
+// Host visible memory of one upload, to be written before the copies reading it are submitted
+struct UploadStaging
+{
+    VulkanBuffer* buffer;
+    VkDeviceSize offset;
+    uint8_t* data;
+};
+
+struct UploadStats
+{
+    uint32_t batches{ 0 };          // Submits
+    VkDeviceSize stagedBytes{ 0 };
+    uint32_t stalls{ 0 };           // Waits for staging memory the GPU was still reading
+    bool transferQueue{ false };    // The copies run on a queue of their own
+};
+
+// Records uploads into one command buffer and submits them as a batch without waiting for the GPU.
+// The host only waits in acquire and wait, or when the staging ring is full. Like a command pool,
+// a context belongs to one thread.
+//
+// Without a transfer queue a batch is one submit to the graphics queue that ends with a barrier,
+// so graphics work submitted after it sees its data.
+// With one the copies run there, next to rendering, and signal the timeline semaphore when done.
+// poll then submits the other half of the batch to the graphics queue: it waits for that value,
+// acquires the images the transfer queue released and blits their mips, which a transfer queue can't.
+// A batch is visible to graphics work submitted after its second half. Buffers are shared by both
+// queue families, see VulkanDevice::setUploadSharing, and need no ownership transfer.
+class VulkanUploadContext
+{
+public:
+    VulkanUploadContext(const VulkanDevice& device, VkDeviceSize stagingSize = UPLOAD_STAGING_SIZE);
+
+    VulkanUploadContext(const VulkanUploadContext&) = delete;
+
+    // Waits for the submitted copies, the open batch is dropped
+    ~VulkanUploadContext();
+
+    // Staging memory aligned for buffer and image copies. It may submit the open batch to make room,
+    // call it before getCommandBuffer for the commands reading the memory.
+    UploadStaging allocateStaging(VkDeviceSize size);
+    // Command buffer of the open batch for the transfer queue, begun on first use
+    VulkanCommandBuffer& getCommandBuffer();
+
+    void uploadBuffer(const void* data, VkDeviceSize size, VulkanBuffer& dst, VkDeviceSize dstOffset = 0);
+    // Destroys buffer once the open batch completes
+    void release(std::unique_ptr<VulkanBuffer> buffer);
+    // Hands the image, in TRANSFER_DST_OPTIMAL after the copies into it, to the graphics queue in
+    // SHADER_READ_ONLY_OPTIMAL. generateMipmaps blits its levels from the base level on the way.
+    void releaseImage(const VulkanImage& image, bool generateMipmaps = false);
+
+    // Submits the open batch if it holds anything. Returns the semaphore value at which every batch so far is done.
+    uint64_t submit();
+    // Submits the graphics half of the batches whose copies are done. Returns the value up to which
+    // the batches are visible to graphics work submitted from now on.
+    uint64_t poll();
+    // Makes the batches up to value visible to graphics work submitted from now on, waits for their copies
+    void acquire(uint64_t value);
+    bool isComplete(uint64_t value) const;
+    void wait(uint64_t value);
+    // Submits and waits for everything
+    void flush();
+
+    bool hasTransferQueue() const { return acquirePool != nullptr; }
+    VkSemaphore getSemaphore() const { return timeline.getHandle(); }
+    const UploadStats& getStats() const { return stats; }
+
+private:
+    struct Batch
+    {
+        uint64_t copyValue{ 0 };    // Signaled by the transfer queue, with one
+        uint64_t value{ 0 };
+        bool acquired{ false };     // Visible to later graphics work
+        std::unique_ptr<VulkanCommandBuffer> commandBuffer;
+        std::unique_ptr<VulkanCommandBuffer> acquireCommandBuffer;
+        std::vector<VkImageMemoryBarrier> images;
+        std::vector<const VulkanImage*> mipmapped;
+        VkDeviceSize stagingBytes{ 0 };     // Of the ring, padding included
+        std::vector<std::unique_ptr<VulkanBuffer>> released;
+    };
+
+    const VulkanDevice& device;
+    const VulkanQueue& queue;
+    const VulkanQueue& graphicsQueue;
+    VulkanCommandPool commandPool;
+    std::unique_ptr<VulkanCommandPool> acquirePool;     // Of the graphics queue, with a transfer queue
+    VulkanSemaphore timeline;
+    uint64_t submittedValue{ 0 };
+    uint64_t visibleValue{ 0 };
+
+    // Ring of host visible memory, allocations follow head and are freed in batch order
+    std::unique_ptr<VulkanBuffer> staging;
+    uint8_t* stagingData;
+    VkDeviceSize stagingAlignment;
+    VkDeviceSize stagingHead{ 0 };
+    VkDeviceSize stagingUsed{ 0 };
+
+    Batch open;
+    std::deque<Batch> inFlight;
+    UploadStats stats;
+
+    void submitAcquire(Batch& batch);
+    // Frees the staging memory and buffers of completed batches
+    void retire();
+};